@@ -32,7 +32,22 @@ HEADERS += \
     $$PWD/include/DS_DefaultProtocols.h \
     $$PWD/include/DS_Timer.h \
     $$PWD/include/DS_Queue.h \
-    $$PWD/include/DS_String.h
+    $$PWD/include/DS_String.h \
+    $$PWD/include/DS_Quality.h \
+    $$PWD/include/DS_Atomic.h \
+    $$PWD/include/DS_Statistics.h \
+    $$PWD/include/DS_Loopback.h \
+    $$PWD/include/DS_Capture.h \
+    $$PWD/include/DS_Replay.h \
+    $$PWD/include/DS_Packet.h \
+    $$PWD/include/DS_Autodetect.h \
+    $$PWD/include/DS_Discovery.h \
+    $$PWD/include/DS_Watchdog.h \
+    $$PWD/include/DS_Realtime.h \
+    $$PWD/include/DS_Interface.h \
+    $$PWD/include/DS_Context.h \
+    $$PWD/include/DS_Scheduler.h \
+    $$PWD/include/DS_Metrics.h
 
 SOURCES += \
     $$PWD/src/protocols/frc_2014.c \
@@ -51,7 +66,21 @@ SOURCES += \
     $$PWD/src/array.c \
     $$PWD/src/timer.c \
     $$PWD/src/queue.c \
-    $$PWD/src/string.c
+    $$PWD/src/string.c \
+    $$PWD/src/quality.c \
+    $$PWD/src/statistics.c \
+    $$PWD/src/loopback.c \
+    $$PWD/src/capture.c \
+    $$PWD/src/replay.c \
+    $$PWD/src/packet.c \
+    $$PWD/src/autodetect.c \
+    $$PWD/src/discovery.c \
+    $$PWD/src/watchdog.c \
+    $$PWD/src/realtime.c \
+    $$PWD/src/interface.c \
+    $$PWD/src/context.c \
+    $$PWD/src/scheduler.c \
+    $$PWD/src/metrics.c
     
 include ($$PWD/lib/Socky/Socky.pri)
 
@@ -0,0 +1,10 @@
+#-------------------------------------------------------------------------------
+# LibDS benchmarks
+#-------------------------------------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    micro \
+    latency \
+    scaling
@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <LibDS.h>
+#include <DS_Atomic.h>
+
+#include <math.h>
+#include <socky.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define ROBOT_PORT     1110
+#define DS_PORT        1150
+#define MAX_SAMPLES    (1 << 20)
+#define MAX_STRESS     64
+#define TOGGLE_PERIOD  250 /* Time between enable/disable requests (ms) */
+#define ENABLED_BIT    0x04
+#define TAG_GENERAL    0x01
+
+/**
+ * Holds the samples (in nanoseconds) of a measurement
+ */
+typedef struct {
+    const char* name;
+    int count;
+    uint64_t* samples;
+} Samples;
+
+/*
+ * Measurements
+ */
+static Samples periods = {"Send period", 0, NULL};
+static Samples round_trips = {"Round-trip time", 0, NULL};
+static Samples enable_delays = {"Enable to wire", 0, NULL};
+
+/*
+ * State shared between threads
+ */
+static volatile int running = 1;
+static volatile uint64_t sent_at [65536];
+static volatile uint64_t toggle_time = 0;
+static volatile uint64_t toggle_state = 0; /* 0 = none, 1 = disable, 2 = enable */
+
+//----------------------------------------------------------------------------//
+// Timestamping transport                                                     //
+//----------------------------------------------------------------------------//
+
+/**
+ * Adds a sample to the given measurement
+ */
+static void add_sample (Samples* samples, const uint64_t value)
+{
+    if (samples->count < MAX_SAMPLES)
+        samples->samples [samples->count++] = value;
+}
+
+static void stamp_open (DS_Socket* ptr)
+{
+    DS_SockyTransport()->open (ptr);
+}
+
+static void stamp_close (DS_Socket* ptr)
+{
+    DS_SockyTransport()->close (ptr);
+}
+
+static int stamp_fd (const DS_Socket* ptr)
+{
+    return DS_SockyTransport()->fd (ptr);
+}
+
+/**
+ * Registers the time at which each robot packet is handed to the OS
+ */
+static int stamp_send (const DS_Socket* ptr, const char* data, const int len)
+{
+    if (len >= 2) {
+        uint16_t index = (uint16_t) (((uint8_t) data [0] << 8) | (uint8_t) data [1]);
+        DS_AtomicStore64 (&sent_at [index], DS_GetTimeNs());
+    }
+
+    return DS_SockyTransport()->send (ptr, data, len);
+}
+
+/**
+ * Measures the round-trip time of each robot reply as soon as the socket
+ * thread receives it
+ */
+static int stamp_recv_view (DS_Socket* ptr, const char** data)
+{
+    int len = DS_SockyTransport()->recv_view (ptr, data);
+
+    if (len >= 2) {
+        uint64_t now = DS_GetTimeNs();
+        uint16_t index = (uint16_t) (((uint8_t) (*data) [0] << 8) | (uint8_t) (*data) [1]);
+        uint64_t sent = DS_AtomicLoad64 (&sent_at [index]);
+
+        if (sent > 0 && now > sent) {
+            add_sample (&round_trips, now - sent);
+            DS_AtomicStore64 (&sent_at [index], 0);
+        }
+    }
+
+    return len;
+}
+
+static const DS_Transport StampTransport = {
+    "timestamp",
+    &stamp_open,
+    &stamp_close,
+    &stamp_send,
+    &stamp_recv_view,
+    &stamp_fd,
+};
+
+//----------------------------------------------------------------------------//
+// Simulated robot                                                            //
+//----------------------------------------------------------------------------//
+
+/**
+ * Answers every DS packet received on port 1110 with a 2015-style status
+ * packet (robot code present, 12.5 V), and records the arrival time of
+ * the packets and of the enabled bit
+ */
+static void* run_robot (void* ptr)
+{
+    (void) ptr;
+
+    char port [12];
+    snprintf (port, sizeof (port), "%d", ROBOT_PORT);
+    int sock_in = create_server_udp (port, SOCKY_IPv4, 0);
+    int sock_out = create_client_udp (SOCKY_IPv4, 0);
+
+    snprintf (port, sizeof (port), "%d", DS_PORT);
+    struct addrinfo* ds = get_address_info ("127.0.0.1", port, SOCKY_UDP, SOCKY_IPv4);
+
+    if (sock_in <= 0 || sock_out <= 0 || !ds) {
+        fprintf (stderr, "Cannot open simulated robot sockets\n");
+        running = 0;
+        return NULL;
+    }
+
+    uint64_t last = 0;
+    while (running) {
+        fd_set set;
+        struct timeval tv = {0, 100000};
+
+        FD_ZERO (&set);
+        FD_SET (sock_in, &set);
+        if (select (sock_in + 1, &set, NULL, NULL, &tv) <= 0)
+            continue;
+
+        char packet [1024];
+        int len = recv (sock_in, packet, sizeof (packet), 0);
+        uint64_t now = DS_GetTimeNs();
+        if (len < 6 || packet [2] != TAG_GENERAL)
+            continue;
+
+        /* Send period */
+        if (last > 0)
+            add_sample (&periods, now - last);
+        last = now;
+
+        /* Enabled bit */
+        uint64_t state = DS_AtomicLoadAcquire64 (&toggle_state);
+        int enabled = (packet [3] & ENABLED_BIT) != 0;
+        if (state > 0 && enabled == (state == 2)) {
+            add_sample (&enable_delays, now - DS_AtomicLoad64 (&toggle_time));
+            DS_AtomicStoreRelease64 (&toggle_state, 0);
+        }
+
+        /* Reply: echoed index, tag, control, status, voltage, request */
+        char reply [8] = {packet [0], packet [1], TAG_GENERAL, packet [3], 0x20, 12, (char) 0x80, 0};
+        sendto (sock_out, reply, sizeof (reply), 0, ds->ai_addr, ds->ai_addrlen);
+    }
+
+    freeaddrinfo (ds);
+    socket_close (sock_in);
+    socket_close (sock_out);
+    return NULL;
+}
+
+//----------------------------------------------------------------------------//
+// CPU stress                                                                 //
+//----------------------------------------------------------------------------//
+
+static void* run_stress (void* ptr)
+{
+    (void) ptr;
+    volatile uint64_t value = 1;
+
+    while (running)
+        value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    return NULL;
+}
+
+//----------------------------------------------------------------------------//
+// Report                                                                     //
+//----------------------------------------------------------------------------//
+
+static int compare_samples (const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Returns the given percentile of the sorted samples (in microseconds)
+ */
+static double percentile (const Samples* samples, const double p)
+{
+    int index = (int) (p / 100 * (samples->count - 1) + 0.5);
+    return samples->samples [index] / 1000.0;
+}
+
+/**
+ * Prints the statistics and a log2 histogram of the given measurement.
+ * If \a nominal is not 0, the jitter (deviation from \a nominal) is also
+ * reported.
+ */
+static void print_samples (Samples* samples, const uint64_t nominal)
+{
+    int i;
+    printf ("\n%s (%d samples)\n", samples->name, samples->count);
+    if (samples->count == 0)
+        return;
+
+    /* Sort samples and compute mean, deviation and jitter */
+    double sum = 0, sum_sq = 0, jitter = 0, max_jitter = 0;
+    qsort (samples->samples, samples->count, sizeof (uint64_t), &compare_samples);
+
+    for (i = 0; i < samples->count; ++i) {
+        double value = samples->samples [i] / 1000.0;
+        double deviation = value - nominal / 1000.0;
+
+        sum += value;
+        sum_sq += value * value;
+        jitter += deviation < 0 ? -deviation : deviation;
+        max_jitter = DS_Max (max_jitter, deviation < 0 ? -deviation : deviation);
+    }
+
+    double mean = sum / samples->count;
+    double variance = sum_sq / samples->count - mean * mean;
+    double stddev = variance > 0 ? sqrt (variance) : 0;
+
+    printf ("  min %.1f us, mean %.1f us, stddev %.1f us\n", percentile (samples, 0), mean, stddev);
+    printf ("  p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+            percentile (samples, 50), percentile (samples, 90),
+            percentile (samples, 99), percentile (samples, 99.9),
+            percentile (samples, 100));
+
+    if (nominal > 0)
+        printf ("  jitter: mean %.1f us, max %.1f us (nominal %.1f ms)\n",
+                jitter / samples->count, max_jitter, nominal / 1e6);
+
+    /* Build log2 histogram (microseconds) */
+    int buckets [40] = {0};
+    int first = 40, last = 0, peak = 1;
+    for (i = 0; i < samples->count; ++i) {
+        int bucket = 0;
+        uint64_t us = samples->samples [i] / 1000;
+        while (us > 1 && bucket < 39) {
+            us >>= 1;
+            ++bucket;
+        }
+
+        ++buckets [bucket];
+        first = DS_Min (first, bucket);
+        last = DS_Max (last, bucket);
+        peak = DS_Max (peak, buckets [bucket]);
+    }
+
+    for (i = first; i <= last; ++i) {
+        char bar [51];
+        int width = buckets [i] * 50 / peak;
+        memset (bar, '#', width);
+        bar [width] = '\0';
+        printf ("  %9llu us | %7d | %s\n", 1ULL << i, buckets [i], bar);
+    }
+}
+
+/**
+ * Prints the command line options of the application
+ */
+static void usage (const char* name)
+{
+    printf ("Usage: %s [options]\n\n", name);
+    printf ("Measures the send period jitter, the round-trip time and the enable\n");
+    printf ("latency of LibDS against a simulated robot on 127.0.0.1.\n\n");
+    printf ("Options:\n");
+    printf ("  -p <year>    Protocol to use (2015 or 2016, default 2016)\n");
+    printf ("  -d <secs>    Duration of the test (default 10 seconds)\n");
+    printf ("  -s <count>   Number of CPU stress threads (default 0)\n");
+    printf ("  -h           Show this message\n");
+}
+
+/**
+ * Main entry point of the application
+ */
+int main (int argc, char** argv)
+{
+    int i;
+    int year = 2016;
+    int duration = 10;
+    int stress = 0;
+
+    /* Parse options */
+    for (i = 1; i < argc; ++i) {
+        if (strcmp (argv [i], "-p") == 0 && i + 1 < argc)
+            year = atoi (argv [++i]);
+        else if (strcmp (argv [i], "-d") == 0 && i + 1 < argc)
+            duration = atoi (argv [++i]);
+        else if (strcmp (argv [i], "-s") == 0 && i + 1 < argc)
+            stress = atoi (argv [++i]);
+        else {
+            usage (argv [0]);
+            return strcmp (argv [i], "-h") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    /* Get protocol */
+    DS_Protocol protocol;
+    if (year == 2015)
+        protocol = DS_GetProtocolFRC_2015();
+    else if (year == 2016)
+        protocol = DS_GetProtocolFRC_2016();
+    else {
+        fprintf (stderr, "Unsupported protocol: %d\n", year);
+        return EXIT_FAILURE;
+    }
+
+    /* Only talk to the robot, and timestamp its packets */
+    protocol.fms_socket.disabled = 1;
+    protocol.radio_socket.disabled = 1;
+    protocol.netconsole_socket.disabled = 1;
+    protocol.robot_socket.transport = &StampTransport;
+
+    /* Allocate sample buffers */
+    periods.samples = (uint64_t*) calloc (MAX_SAMPLES, sizeof (uint64_t));
+    round_trips.samples = (uint64_t*) calloc (MAX_SAMPLES, sizeof (uint64_t));
+    enable_delays.samples = (uint64_t*) calloc (MAX_SAMPLES, sizeof (uint64_t));
+
+    /* Start the DS */
+    DS_Init();
+    DS_SetCustomRobotAddress ("127.0.0.1");
+    DS_ConfigureProtocol (&protocol);
+
+    /* Start simulated robot and stress threads */
+    pthread_t robot;
+    pthread_t stress_threads [MAX_STRESS];
+    stress = DS_Min (DS_Max (stress, 0), MAX_STRESS);
+    pthread_create (&robot, NULL, &run_robot, NULL);
+    for (i = 0; i < stress; ++i)
+        pthread_create (&stress_threads [i], NULL, &run_stress, NULL);
+
+    /* Wait for robot communications */
+    uint64_t start = DS_GetTimeNs();
+    while (running && !DS_GetRobotCommunications()) {
+        if (DS_GetTimeNs() - start > 5000000000ULL) {
+            fprintf (stderr, "Robot communications not established\n");
+            running = 0;
+        }
+
+        DS_Sleep (10);
+    }
+
+    /* Toggle the enabled state periodically */
+    int enabled = 0;
+    start = DS_GetTimeNs();
+    while (running && DS_GetTimeNs() - start < (uint64_t) duration * 1000000000ULL) {
+        /* Stagger requests, so that they do not align with the send timer */
+        DS_Sleep (TOGGLE_PERIOD + rand() % 20);
+
+        enabled = !enabled;
+        DS_AtomicStore64 (&toggle_time, DS_GetTimeNs());
+        DS_AtomicStoreRelease64 (&toggle_state, enabled ? 2 : 1);
+        DS_SetRobotEnabled (enabled);
+    }
+
+    /* Stop threads */
+    running = 0;
+    pthread_join (robot, NULL);
+    for (i = 0; i < stress; ++i)
+        pthread_join (stress_threads [i], NULL);
+
+    /* Get protocol-level trip time before closing the DS */
+    DS_CommsQuality quality;
+    DS_GetCommsQuality (DS_CHANNEL_ROBOT, &quality);
+    DS_Close();
+
+    /* Print report */
+    printf ("FRC %d protocol, %d s, %d stress threads\n", year, duration, stress);
+    printf ("Protocol trip time (last 10 s): mean %.3f ms, max %.3f ms, loss %.2f %%\n",
+            quality.last_ten_seconds.trip_time,
+            quality.last_ten_seconds.max_trip_time,
+            quality.last_ten_seconds.loss);
+
+    print_samples (&periods, (uint64_t) protocol.robot_interval * 1000000);
+    print_samples (&round_trips, 0);
+    print_samples (&enable_delays, 0);
+
+    free (periods.samples);
+    free (round_trips.samples);
+    free (enable_delays.samples);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,39 @@
+#-------------------------------------------------------------------------------
+# Remove Qt dependency
+#-------------------------------------------------------------------------------
+
+CONFIG += console
+CONFIG += release
+
+CONFIG -= qt
+CONFIG -= app_bundle
+
+DEFINES -= UNICODE QT_LARGEFILE_SUPPORT
+
+#-------------------------------------------------------------------------------
+# Deploy options
+#-------------------------------------------------------------------------------
+
+TARGET = LibDS-bench
+
+#-------------------------------------------------------------------------------
+# Count allocations by wrapping the allocator (GNU linker only)
+#-------------------------------------------------------------------------------
+
+linux* {
+    DEFINES += BENCH_COUNT_ALLOCS
+    QMAKE_LFLAGS += -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+}
+
+#-------------------------------------------------------------------------------
+# Include libraries
+#-------------------------------------------------------------------------------
+
+include ($$PWD/../../LibDS.pri)
+
+#-------------------------------------------------------------------------------
+# Import source code
+#-------------------------------------------------------------------------------
+
+SOURCES += \
+    $$PWD/src/main.c
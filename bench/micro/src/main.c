@@ -0,0 +1,481 @@
+/*
+ * Copyright (C) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <LibDS.h>
+#include <DS_Queue.h>
+#include <DS_Atomic.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define MAX_BENCHMARKS  32
+#define DEFAULT_RUNS    5
+#define DEFAULT_MIN_MS  200
+
+/*
+ * Allocation counters, updated by the allocator wrappers
+ */
+static volatile uint64_t alloc_count = 0;
+static volatile uint64_t alloc_bytes = 0;
+
+#ifdef BENCH_COUNT_ALLOCS
+extern void* __real_malloc (size_t size);
+extern void* __real_calloc (size_t count, size_t size);
+extern void* __real_realloc (void* ptr, size_t size);
+
+void* __wrap_malloc (size_t size)
+{
+    DS_AtomicAdd64 (&alloc_count, 1);
+    DS_AtomicAdd64 (&alloc_bytes, size);
+    return __real_malloc (size);
+}
+
+void* __wrap_calloc (size_t count, size_t size)
+{
+    DS_AtomicAdd64 (&alloc_count, 1);
+    DS_AtomicAdd64 (&alloc_bytes, count * size);
+    return __real_calloc (count, size);
+}
+
+void* __wrap_realloc (void* ptr, size_t size)
+{
+    DS_AtomicAdd64 (&alloc_count, 1);
+    DS_AtomicAdd64 (&alloc_bytes, size);
+    return __real_realloc (ptr, size);
+}
+#endif
+
+/**
+ * Describes a benchmark, the \c run function executes the measured
+ * operation \a iterations times
+ */
+typedef struct {
+    char name [64];
+    void (*run) (const uint64_t iterations);
+    const DS_Protocol* protocol;
+} Benchmark;
+
+/**
+ * Holds the results of a benchmark
+ */
+typedef struct {
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+} Result;
+
+static int benchmark_count = 0;
+static Benchmark benchmarks [MAX_BENCHMARKS];
+
+/*
+ * Protocol under test and sample robot packets
+ */
+static DS_Protocol protocols [4];
+static const DS_Protocol* current = NULL;
+static DS_String robot_packets [4];
+
+/*
+ * Data used by the benchmarks
+ */
+static DS_Queue queue;
+static uint8_t crc_buffer [1024];
+
+/*
+ * Prevents the compiler from removing the benchmarked operations
+ */
+static volatile uint64_t sink = 0;
+
+//----------------------------------------------------------------------------//
+// Benchmarks                                                                 //
+//----------------------------------------------------------------------------//
+
+static void bench_str_append (const uint64_t iterations)
+{
+    uint64_t i;
+    DS_String string = DS_StrNewLen (0);
+
+    for (i = 0; i < iterations; ++i) {
+        DS_StrAppend (&string, (uint8_t) i);
+
+        if (DS_StrLen (&string) >= 1024) {
+            DS_StrRmBuf (&string);
+            string = DS_StrNewLen (0);
+        }
+    }
+
+    sink += DS_StrLen (&string);
+    DS_StrRmBuf (&string);
+}
+
+static void bench_str_join (const uint64_t iterations)
+{
+    uint64_t i;
+    DS_String second = DS_StrNew ("World");
+
+    for (i = 0; i < iterations; ++i) {
+        DS_String first = DS_StrNew ("Hello ");
+        DS_StrJoin (&first, &second);
+        sink += DS_StrLen (&first);
+        DS_StrRmBuf (&first);
+    }
+
+    DS_StrRmBuf (&second);
+}
+
+static void bench_str_format (const uint64_t iterations)
+{
+    uint64_t i;
+    for (i = 0; i < iterations; ++i) {
+        DS_String string = DS_StrFormat ("Loaded %s protocol (%d)", "FRC 2016", (int) i);
+        sink += DS_StrLen (&string);
+        DS_StrRmBuf (&string);
+    }
+}
+
+static void bench_queue_push_pop (const uint64_t iterations)
+{
+    uint64_t i;
+    DS_Event event;
+    memset (&event, 0, sizeof (event));
+
+    for (i = 0; i < iterations; ++i) {
+        event.robot.code = (int) i;
+        DS_QueuePush (&queue, &event);
+        sink += ((DS_Event*) DS_QueueGetFirst (&queue))->robot.code;
+        DS_QueuePop (&queue);
+    }
+}
+
+static void bench_crc32 (const uint64_t iterations)
+{
+    uint64_t i;
+    for (i = 0; i < iterations; ++i) {
+        crc_buffer [0] = (uint8_t) i;
+        sink += DS_CRC32 (crc_buffer, sizeof (crc_buffer));
+    }
+}
+
+static void bench_create_robot_packet (const uint64_t iterations)
+{
+    uint64_t i;
+    for (i = 0; i < iterations; ++i) {
+        DS_String packet = current->create_robot_packet();
+        sink += DS_StrLen (&packet);
+        DS_StrRmBuf (&packet);
+    }
+}
+
+static void bench_update_robot_packet (const uint64_t iterations)
+{
+    uint64_t i;
+    for (i = 0; i < iterations; ++i)
+        sink += DS_StrLen (current->update_robot_packet());
+}
+
+static void bench_read_robot_packet (const uint64_t iterations)
+{
+    uint64_t i;
+    const DS_String* packet = &robot_packets [current - protocols];
+
+    for (i = 0; i < iterations; ++i)
+        sink += current->read_robot_packet (packet);
+}
+
+static void bench_joysticks (const uint64_t iterations)
+{
+    uint64_t i;
+    for (i = 0; i < iterations; ++i) {
+        int axis = (int) (i % 6);
+        int button = (int) (i % 12);
+
+        DS_SetJoystickAxis (0, axis, (float) (i & 0xFF) / 255);
+        DS_SetJoystickButton (0, button, (int) (i & 1));
+        DS_SetJoystickHat (0, 0, (int) (i % 8) * 45);
+
+        sink += (uint64_t) (DS_GetJoystickAxis (0, axis) * 100);
+        sink += DS_GetJoystickButton (0, button);
+        sink += DS_GetJoystickHat (0, 0);
+    }
+}
+
+//----------------------------------------------------------------------------//
+// Benchmark runner                                                           //
+//----------------------------------------------------------------------------//
+
+/**
+ * Registers a benchmark with the given \a name
+ */
+static void add (const char* name,
+                 void (*run) (const uint64_t),
+                 const DS_Protocol* protocol)
+{
+    if (benchmark_count >= MAX_BENCHMARKS)
+        return;
+
+    Benchmark* benchmark = &benchmarks [benchmark_count++];
+    snprintf (benchmark->name, sizeof (benchmark->name), "%s", name);
+    benchmark->run = run;
+    benchmark->protocol = protocol;
+}
+
+/**
+ * Runs the given \a benchmark \a iterations times and returns the elapsed
+ * time in nanoseconds
+ */
+static uint64_t measure (const Benchmark* benchmark,
+                         const uint64_t iterations,
+                         Result* result)
+{
+    current = benchmark->protocol;
+
+    uint64_t count = DS_AtomicLoad64 (&alloc_count);
+    uint64_t bytes = DS_AtomicLoad64 (&alloc_bytes);
+    uint64_t start = DS_GetTimeNs();
+
+    benchmark->run (iterations);
+
+    uint64_t elapsed = DS_GetTimeNs() - start;
+
+    if (result) {
+        result->iterations = iterations;
+        result->ns_per_op = (double) elapsed / iterations;
+        result->allocs_per_op = (double) (DS_AtomicLoad64 (&alloc_count) - count) / iterations;
+        result->bytes_per_op = (double) (DS_AtomicLoad64 (&alloc_bytes) - bytes) / iterations;
+    }
+
+    return elapsed;
+}
+
+/**
+ * Compares two results by their time per operation
+ */
+static int compare_results (const void* a, const void* b)
+{
+    double x = ((const Result*) a)->ns_per_op;
+    double y = ((const Result*) b)->ns_per_op;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Finds the number of iterations needed to run the given \a benchmark for
+ * at least \a min_ms milliseconds, then runs it \a runs times and writes the
+ * median result to \a result
+ */
+static void run_benchmark (const Benchmark* benchmark,
+                           const int runs,
+                           const int min_ms,
+                           Result* result)
+{
+    int i;
+    Result samples [16];
+    uint64_t iterations = 1;
+    uint64_t target = (uint64_t) min_ms * 1000000;
+
+    /* Calibrate (this also warms up the caches) */
+    while (1) {
+        uint64_t elapsed = measure (benchmark, iterations, NULL);
+        if (elapsed >= target / 10 || iterations >= (1ULL << 40)) {
+            if (elapsed > 0)
+                iterations = DS_Max (1, iterations * target / elapsed);
+            break;
+        }
+
+        iterations *= 10;
+    }
+
+    /* Measure */
+    for (i = 0; i < runs; ++i)
+        measure (benchmark, iterations, &samples [i]);
+
+    qsort (samples, runs, sizeof (Result), &compare_results);
+    *result = samples [runs / 2];
+}
+
+/**
+ * Creates the sample robot packets and registers the protocol benchmarks
+ */
+static void init_protocols (void)
+{
+    int i;
+    const char* names [4] = {"frc_2014", "frc_2015", "frc_2016", "frc_2018"};
+
+    protocols [0] = DS_GetProtocolFRC_2014();
+    protocols [1] = DS_GetProtocolFRC_2015();
+    protocols [2] = DS_GetProtocolFRC_2016();
+    protocols [3] = DS_GetProtocolFRC_2018();
+
+    /* 2014 robot packet: status, voltage and echoed packet index */
+    robot_packets [0] = DS_StrNewLen (1024);
+    DS_StrSetChar (&robot_packets [0], 1, 0x12);
+
+    /* 2015+ robot packet: index, tag, control, status, voltage, request */
+    for (i = 1; i < 4; ++i) {
+        robot_packets [i] = DS_StrNewLen (8);
+        DS_StrSetChar (&robot_packets [i], 1, 0x01);
+        DS_StrSetChar (&robot_packets [i], 3, 0x30);
+        DS_StrSetChar (&robot_packets [i], 4, 0x0c);
+        DS_StrSetChar (&robot_packets [i], 5, 0x80);
+    }
+
+    /* Register benchmarks */
+    for (i = 0; i < 4; ++i) {
+        char name [64];
+
+        snprintf (name, sizeof (name), "protocol/%s/create_robot_packet", names [i]);
+        add (name, &bench_create_robot_packet, &protocols [i]);
+
+        if (protocols [i].update_robot_packet) {
+            snprintf (name, sizeof (name), "protocol/%s/update_robot_packet", names [i]);
+            add (name, &bench_update_robot_packet, &protocols [i]);
+        }
+
+        snprintf (name, sizeof (name), "protocol/%s/read_robot_packet", names [i]);
+        add (name, &bench_read_robot_packet, &protocols [i]);
+    }
+}
+
+/**
+ * Prints the command line options of the application
+ */
+static void usage (const char* name)
+{
+    printf ("Usage: %s [options]\n\n", name);
+    printf ("Runs the LibDS microbenchmarks and prints the results as JSON.\n\n");
+    printf ("Options:\n");
+    printf ("  -f <text>  Only run benchmarks whose name contains <text>\n");
+    printf ("  -n <runs>  Number of measured runs per benchmark (default %d)\n", DEFAULT_RUNS);
+    printf ("  -t <ms>    Minimum duration of each run (default %d ms)\n", DEFAULT_MIN_MS);
+    printf ("  -o <file>  Write the results to the given file\n");
+    printf ("  -h         Show this message\n");
+}
+
+/**
+ * Main entry point of the application
+ */
+int main (int argc, char** argv)
+{
+    int i;
+    FILE* out = stdout;
+    int first = 1;
+    int runs = DEFAULT_RUNS;
+    int min_ms = DEFAULT_MIN_MS;
+    const char* filter = NULL;
+
+    /* Parse options */
+    for (i = 1; i < argc; ++i) {
+        if (strcmp (argv [i], "-f") == 0 && i + 1 < argc)
+            filter = argv [++i];
+        else if (strcmp (argv [i], "-n") == 0 && i + 1 < argc) {
+            runs = atoi (argv [++i]);
+            runs = DS_Min (DS_Max (runs, 1), 16);
+        }
+        else if (strcmp (argv [i], "-t") == 0 && i + 1 < argc) {
+            min_ms = atoi (argv [++i]);
+            min_ms = DS_Max (min_ms, 1);
+        }
+        else if (strcmp (argv [i], "-o") == 0 && i + 1 < argc) {
+            out = fopen (argv [++i], "w");
+            if (!out) {
+                fprintf (stderr, "Cannot open %s\n", argv [i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            usage (argv [0]);
+            return strcmp (argv [i], "-h") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    /* Initialize LibDS, without any network or event loop activity */
+    DS_Protocol protocol = DS_GetProtocolFRC_2016();
+    protocol.fms_socket.disabled = 1;
+    protocol.radio_socket.disabled = 1;
+    protocol.robot_socket.disabled = 1;
+    protocol.netconsole_socket.disabled = 1;
+
+    DS_Init();
+    DS_ConfigureProtocol (&protocol);
+    Protocols_Suspend (1);
+
+    /* Initialize benchmark data */
+    DS_JoysticksAdd (6, 1, 12);
+    DS_QueueInit (&queue, 50, sizeof (DS_Event));
+    for (i = 0; i < (int) sizeof (crc_buffer); ++i)
+        crc_buffer [i] = (uint8_t) (i * 31);
+
+    /* Register benchmarks */
+    add ("string/append", &bench_str_append, NULL);
+    add ("string/join", &bench_str_join, NULL);
+    add ("string/format", &bench_str_format, NULL);
+    add ("queue/push_pop", &bench_queue_push_pop, NULL);
+    add ("crc32/1024", &bench_crc32, NULL);
+    init_protocols();
+    add ("joysticks/set_get", &bench_joysticks, NULL);
+
+    /* Run benchmarks and print JSON report */
+    fprintf (out, "{\n");
+    fprintf (out, "  \"library\": \"LibDS\",\n");
+    fprintf (out, "  \"version\": \"%s\",\n", DS_GetVersion());
+    fprintf (out, "  \"build_date\": \"%s %s\",\n", DS_GetBuildDate(), DS_GetBuildTime());
+#ifdef BENCH_COUNT_ALLOCS
+    fprintf (out, "  \"allocations_counted\": true,\n");
+#else
+    fprintf (out, "  \"allocations_counted\": false,\n");
+#endif
+    fprintf (out, "  \"runs\": %d,\n", runs);
+    fprintf (out, "  \"benchmarks\": [");
+
+    for (i = 0; i < benchmark_count; ++i) {
+        Result result;
+        const Benchmark* benchmark = &benchmarks [i];
+
+        if (filter && !strstr (benchmark->name, filter))
+            continue;
+
+        run_benchmark (benchmark, runs, min_ms, &result);
+
+        fprintf (out, "%s\n    {\"name\": \"%s\", \"iterations\": %llu, "
+                 "\"ns_per_op\": %.3f, \"allocs_per_op\": %.3f, "
+                 "\"bytes_per_op\": %.3f}", first ? "" : ",", benchmark->name,
+                 (unsigned long long) result.iterations, result.ns_per_op,
+                 result.allocs_per_op, result.bytes_per_op);
+        fflush (out);
+        first = 0;
+    }
+
+    fprintf (out, "\n  ]\n}\n");
+
+    /* Clean up */
+    for (i = 0; i < 4; ++i)
+        DS_StrRmBuf (&robot_packets [i]);
+
+    DS_QueueFree (&queue);
+    DS_Close();
+
+    if (out != stdout)
+        fclose (out);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <LibDS.h>
+
+#include <time.h>
+#include <socky.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define ROBOT_BASE_PORT 21000 /* Port of the simulated robot of session 0 */
+#define DS_BASE_PORT    22000 /* Port of the DS of session 0 */
+#define MAX_SESSIONS    300   /* Keeps the descriptors below FD_SETSIZE */
+#define MAX_VALUES      16
+#define MAX_SAMPLES     (1 << 22)
+#define WARMUP          1000  /* Time before the measurement starts (ms) */
+#define TAG_GENERAL     0x01
+
+/**
+ * Holds the result of a run
+ */
+typedef struct {
+    int threads;
+    int comms;
+    double cpu;
+    double p50;
+    double p99;
+    double p999;
+    double max;
+    DS_SchedulerStats stats;
+} Result;
+
+/*
+ * State shared with the simulated robots
+ */
+static volatile int running = 0;
+static volatile int measuring = 0;
+static int session_count = 0;
+static uint64_t nominal = 0;
+static int sample_count = 0;
+static uint64_t* samples = NULL;
+
+//----------------------------------------------------------------------------//
+// Simulated robots                                                           //
+//----------------------------------------------------------------------------//
+
+/**
+ * Answers the DS packets of every session (received on port 21000 + i) with
+ * a 2015-style status packet sent to port 22000 + i, and records how far
+ * the period between two packets of a session is from the nominal period
+ */
+static void* run_robots (void* ptr)
+{
+    (void) ptr;
+
+    int i;
+    char port [12];
+    int sock_out = create_client_udp (SOCKY_IPv4, 0);
+    int* sock_in = (int*) calloc (session_count, sizeof (int));
+    uint64_t* last = (uint64_t*) calloc (session_count, sizeof (uint64_t));
+    struct addrinfo** ds = (struct addrinfo**) calloc (session_count, sizeof (struct addrinfo*));
+
+    int max_fd = 0;
+    for (i = 0; i < session_count; ++i) {
+        snprintf (port, sizeof (port), "%d", ROBOT_BASE_PORT + i);
+        sock_in [i] = create_server_udp (port, SOCKY_IPv4, 0);
+
+        snprintf (port, sizeof (port), "%d", DS_BASE_PORT + i);
+        ds [i] = get_address_info ("127.0.0.1", port, SOCKY_UDP, SOCKY_IPv4);
+
+        if (sock_in [i] <= 0 || sock_in [i] >= FD_SETSIZE || !ds [i]) {
+            fprintf (stderr, "Cannot open simulated robot sockets\n");
+            running = 0;
+            break;
+        }
+
+        max_fd = DS_Max (max_fd, sock_in [i]);
+    }
+
+    while (running) {
+        fd_set set;
+        struct timeval tv = {0, 100000};
+
+        FD_ZERO (&set);
+        for (i = 0; i < session_count; ++i)
+            FD_SET (sock_in [i], &set);
+
+        if (select (max_fd + 1, &set, NULL, NULL, &tv) <= 0)
+            continue;
+
+        for (i = 0; i < session_count; ++i) {
+            if (!FD_ISSET (sock_in [i], &set))
+                continue;
+
+            char packet [1024];
+            int len = recv (sock_in [i], packet, sizeof (packet), 0);
+            uint64_t now = DS_GetTimeNs();
+            if (len < 6 || packet [2] != TAG_GENERAL)
+                continue;
+
+            /* Deviation of the send period from the nominal period */
+            if (measuring && last [i] > 0 && sample_count < MAX_SAMPLES) {
+                uint64_t period = now - last [i];
+                samples [sample_count++] = period > nominal ? period - nominal
+                                                            : nominal - period;
+            }
+
+            last [i] = now;
+
+            /* Reply: echoed index, tag, control, status, voltage, request */
+            char reply [8] = {packet [0], packet [1], TAG_GENERAL, packet [3], 0x20, 12, (char) 0x80, 0};
+            sendto (sock_out, reply, sizeof (reply), 0, ds [i]->ai_addr, ds [i]->ai_addrlen);
+        }
+    }
+
+    for (i = 0; i < session_count; ++i) {
+        if (sock_in [i] > 0)
+            socket_close (sock_in [i]);
+        if (ds [i])
+            freeaddrinfo (ds [i]);
+    }
+
+    socket_close (sock_out);
+    free (sock_in);
+    free (last);
+    free (ds);
+    return NULL;
+}
+
+//----------------------------------------------------------------------------//
+// Runs                                                                       //
+//----------------------------------------------------------------------------//
+
+/**
+ * Returns the number of threads of the process, or -1 if it is unknown
+ */
+static int thread_count (void)
+{
+    int threads = -1;
+
+#if defined __linux__
+    char line [256];
+    FILE* file = fopen ("/proc/self/status", "r");
+    if (!file)
+        return -1;
+
+    while (fgets (line, sizeof (line), file))
+        if (sscanf (line, "Threads: %d", &threads) == 1)
+            break;
+
+    fclose (file);
+#endif
+
+    return threads;
+}
+
+static int compare_samples (const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Returns the given percentile of the sorted samples (in microseconds)
+ */
+static double percentile (const double p)
+{
+    if (sample_count == 0)
+        return 0;
+
+    int index = (int) (p / 100 * (sample_count - 1) + 0.5);
+    return samples [index] / 1000.0;
+}
+
+/**
+ * Runs the given number of \a sessions for \a duration seconds, stepped by
+ * a pool of \a workers threads (one per CPU if 0), or by their own protocol
+ * threads if \a workers is negative
+ *
+ * \returns 1 on success, 0 if the run could not be started
+ */
+static int run (const int workers, const int sessions, const int duration,
+                Result* result)
+{
+    int i;
+    memset (result, 0, sizeof (Result));
+
+    if (workers >= 0 && !DS_SchedulerStart (workers)) {
+        fprintf (stderr, "Cannot start the scheduler\n");
+        return 0;
+    }
+
+    /* Start the simulated robots */
+    running = 1;
+    measuring = 0;
+    sample_count = 0;
+    session_count = sessions;
+    pthread_t robots;
+    pthread_create (&robots, NULL, &run_robots, NULL);
+
+    /* Start the driver stations, they only talk to their robot */
+    DS_Context** contexts = (DS_Context**) calloc (sessions, sizeof (DS_Context*));
+    for (i = 0; i < sessions; ++i) {
+        contexts [i] = DS_ContextCreate();
+        DS_ContextMakeCurrent (contexts [i]);
+
+        DS_Protocol protocol = DS_GetProtocolFRC_2015();
+        protocol.fms_socket.disabled = 1;
+        protocol.radio_socket.disabled = 1;
+        protocol.netconsole_socket.disabled = 1;
+        protocol.robot_socket.in_port = DS_BASE_PORT + i;
+        protocol.robot_socket.out_port = ROBOT_BASE_PORT + i;
+        nominal = (uint64_t) protocol.robot_interval * 1000000ULL;
+
+        DS_Init();
+        DS_SetCustomRobotAddress ("127.0.0.1");
+        DS_ConfigureProtocol (&protocol);
+    }
+
+    DS_ContextMakeCurrent (NULL);
+
+    /* Measure the send periods, the threads and the CPU time */
+    DS_Sleep (WARMUP);
+    clock_t cpu = clock();
+    uint64_t start = DS_GetTimeNs();
+    measuring = running;
+
+    DS_Sleep (duration * 500);
+    result->threads = thread_count();
+    DS_Sleep (duration * 500);
+
+    measuring = 0;
+    double wall = (DS_GetTimeNs() - start) / 1e9;
+    result->cpu = (double) (clock() - cpu) / CLOCKS_PER_SEC / wall * 100;
+
+    /* Count the sessions that talk to their robot */
+    for (i = 0; i < sessions; ++i) {
+        DS_ContextMakeCurrent (contexts [i]);
+        result->comms += DS_GetRobotCommunications();
+    }
+
+    DS_ContextMakeCurrent (NULL);
+    DS_GetSchedulerStats (&result->stats);
+
+    /* Stop everything */
+    for (i = 0; i < sessions; ++i)
+        DS_ContextDestroy (contexts [i]);
+
+    if (workers >= 0)
+        DS_SchedulerStop();
+
+    running = 0;
+    pthread_join (robots, NULL);
+    free (contexts);
+
+    /* Compute the jitter percentiles */
+    qsort (samples, sample_count, sizeof (uint64_t), &compare_samples);
+    result->p50 = percentile (50);
+    result->p99 = percentile (99);
+    result->p999 = percentile (99.9);
+    result->max = percentile (100);
+
+    return 1;
+}
+
+//----------------------------------------------------------------------------//
+// Report                                                                     //
+//----------------------------------------------------------------------------//
+
+/**
+ * Reads a comma-separated list of integers in \a values
+ *
+ * \returns the number of values
+ */
+static int parse_list (const char* text, int* values)
+{
+    int count = 0;
+    char* end = NULL;
+
+    while (count < MAX_VALUES && *text) {
+        values [count++] = (int) strtol (text, &end, 10);
+        if (end == text)
+            return 0;
+
+        text = (*end == ',') ? end + 1 : end;
+    }
+
+    return count;
+}
+
+/**
+ * Prints the command line options of the application
+ */
+static void usage (const char* name)
+{
+    printf ("Usage: %s [options]\n\n", name);
+    printf ("Runs many driver stations (FRC 2015 protocol) against simulated robots on\n");
+    printf ("127.0.0.1 and reports the send period jitter, the threads and the CPU\n");
+    printf ("usage of each combination of sessions and workers.\n\n");
+    printf ("Options:\n");
+    printf ("  -n <list>    Numbers of sessions (default 1,10,50,100, max %d)\n", MAX_SESSIONS);
+    printf ("  -w <list>    Numbers of scheduler workers, 0 for one per CPU and -1 for\n");
+    printf ("               one protocol thread per session (default -1,0)\n");
+    printf ("  -d <secs>    Duration of each run (default 3 seconds)\n");
+    printf ("  -h           Show this message\n\n");
+    printf ("Use taskset (or similar) to change the number of CPUs of the process.\n");
+}
+
+/**
+ * Main entry point of the application
+ */
+int main (int argc, char** argv)
+{
+    int i, j;
+    int duration = 3;
+    int workers [MAX_VALUES] = {-1, 0};
+    int sessions [MAX_VALUES] = {1, 10, 50, 100};
+    int worker_values = 2;
+    int session_values = 4;
+
+    /* Parse options */
+    for (i = 1; i < argc; ++i) {
+        if (strcmp (argv [i], "-n") == 0 && i + 1 < argc)
+            session_values = parse_list (argv [++i], sessions);
+        else if (strcmp (argv [i], "-w") == 0 && i + 1 < argc)
+            worker_values = parse_list (argv [++i], workers);
+        else if (strcmp (argv [i], "-d") == 0 && i + 1 < argc)
+            duration = atoi (argv [++i]);
+        else {
+            usage (argv [0]);
+            return strcmp (argv [i], "-h") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    /* Check the duration and the number of sessions */
+    if (duration < 1 || session_values == 0 || worker_values == 0) {
+        usage (argv [0]);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < session_values; ++i) {
+        if (sessions [i] < 1 || sessions [i] > MAX_SESSIONS) {
+            fprintf (stderr, "Invalid number of sessions: %d\n", sessions [i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    samples = (uint64_t*) calloc (MAX_SAMPLES, sizeof (uint64_t));
+
+    /* Run every combination */
+    printf ("Send period jitter (|period - 20 ms|) of %d s runs\n\n", duration);
+    printf ("workers sessions threads   cpu %%  comms   p50 us   p99 us  p99.9 us   max us  late us  steals\n");
+    for (i = 0; i < worker_values; ++i) {
+        for (j = 0; j < session_values; ++j) {
+            Result r;
+            if (!run (workers [i], sessions [j], duration, &r))
+                continue;
+
+            char name [16];
+            if (workers [i] < 0)
+                snprintf (name, sizeof (name), "none");
+            else
+                snprintf (name, sizeof (name), "%d", r.stats.workers);
+
+            printf ("%7s %8d %7d %7.1f %6d %8.1f %8.1f %9.1f %8.1f %8.1f %7lu\n",
+                    name, sessions [j], r.threads, r.cpu, r.comms,
+                    r.p50, r.p99, r.p999, r.max,
+                    r.stats.mean_lateness * 1000.0, r.stats.steals);
+            fflush (stdout);
+        }
+    }
+
+    free (samples);
+    return EXIT_SUCCESS;
+}
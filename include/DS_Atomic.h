@@ -0,0 +1,124 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_ATOMIC_H
+#define _LIB_DS_ATOMIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#if defined _MSC_VER
+    #include <windows.h>
+    #define DS_CACHELINE_ALIGN __declspec (align (64))
+#else
+    #define DS_CACHELINE_ALIGN __attribute__ ((aligned (64)))
+#endif
+
+/*
+ * Relaxed atomic operations on 64-bit counters. These functions only
+ * guarantee that readers never observe torn values, they do not order
+ * other memory operations.
+ */
+
+static inline void DS_AtomicAdd64 (volatile uint64_t* ptr, const uint64_t value)
+{
+#if defined _MSC_VER
+    InterlockedExchangeAdd64 ((volatile LONG64*) ptr, (LONG64) value);
+#else
+    __atomic_fetch_add (ptr, value, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline uint64_t DS_AtomicLoad64 (const volatile uint64_t* ptr)
+{
+#if defined _MSC_VER
+    return (uint64_t) InterlockedCompareExchange64 ((volatile LONG64*) ptr, 0, 0);
+#else
+    return __atomic_load_n (ptr, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void DS_AtomicStore64 (volatile uint64_t* ptr, const uint64_t value)
+{
+#if defined _MSC_VER
+    InterlockedExchange64 ((volatile LONG64*) ptr, (LONG64) value);
+#else
+    __atomic_store_n (ptr, value, __ATOMIC_RELAXED);
+#endif
+}
+
+/*
+ * Ordered atomic operations, used to hand data over to another thread.
+ * On MSVC, the interlocked functions are full memory barriers.
+ */
+
+static inline uint64_t DS_AtomicLoadAcquire64 (const volatile uint64_t* ptr)
+{
+#if defined _MSC_VER
+    return (uint64_t) InterlockedCompareExchange64 ((volatile LONG64*) ptr, 0, 0);
+#else
+    return __atomic_load_n (ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void DS_AtomicStoreRelease64 (volatile uint64_t* ptr, const uint64_t value)
+{
+#if defined _MSC_VER
+    InterlockedExchange64 ((volatile LONG64*) ptr, (LONG64) value);
+#else
+    __atomic_store_n (ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline void DS_AtomicFence (void)
+{
+#if defined _MSC_VER
+    MemoryBarrier();
+#else
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline int DS_AtomicCompareExchange64 (volatile uint64_t* ptr,
+                                              uint64_t expected,
+                                              const uint64_t desired)
+{
+#if defined _MSC_VER
+    return (uint64_t) InterlockedCompareExchange64 ((volatile LONG64*) ptr,
+                                                    (LONG64) desired,
+                                                    (LONG64) expected) == expected;
+#else
+    return __atomic_compare_exchange_n (ptr, &expected, desired, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -47,6 +47,23 @@ extern "C" {
 #define RECONFIGURE_ROBOT 0x04
 #define RECONFIGURE_ALL   0x01 | 0x02 | 0x04
 
+/**
+ * Holds the robot status used by the protocols to generate their packets,
+ * the values are the same as the ones returned by the getters
+ */
+typedef struct {
+    int team;
+    int robot_enabled;
+    float robot_voltage;
+    int emergency_stopped;
+    int fms_communications;
+    int radio_communications;
+    int robot_communications;
+    DS_Position robot_position;
+    DS_Alliance robot_alliance;
+    DS_ControlMode control_mode;
+} DS_ConfigSnapshot;
+
 /* Misc */
 extern void CFG_ReconfigureAddresses (const int flags);
 
@@ -71,6 +88,7 @@ extern int CFG_GetFMSCommunications (void);
 extern int CFG_GetRadioCommunications (void);
 extern int CFG_GetRobotCommunications (void);
 extern DS_ControlMode CFG_GetControlMode (void);
+extern void CFG_GetSnapshot (DS_ConfigSnapshot* snapshot);
 
 /* Setters */
 extern void CFG_SetRobotCode (const int code);
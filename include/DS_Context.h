@@ -0,0 +1,88 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_CONTEXT_H
+#define _LIB_DS_CONTEXT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * Thread affinity:
+ *
+ * The functions of the API do not take a context, every call works on the
+ * context of the calling thread:
+ *
+ *    - Threads started by the library (event loop, sockets, timers, etc.)
+ *      use the context of the thread that started them
+ *    - Any other thread (including the main thread of the application and
+ *      the threads of a GUI or a thread pool) uses the default context
+ *      until it calls DS_ContextMakeCurrent()
+ *
+ * So a thread that was not started by the library must call
+ * DS_ContextMakeCurrent() before its first call to the API, otherwise it
+ * silently reads and changes the default context. The selection is kept
+ * until the thread selects another context, and a context must not be
+ * destroyed while another thread still has it selected.
+ */
+
+/**
+ * Holds the state of a driver station (the loaded protocol, the robot
+ * status, the joysticks, the events, etc.), the structure is opaque
+ */
+typedef struct _DS_Context DS_Context;
+
+/**
+ * Identifies the state of a module, each module declares a static key
+ * initialized to zero and the library assigns it a slot on first use
+ */
+typedef volatile uint64_t DS_ContextKey;
+
+/* Module functions */
+extern int Context_CreateThread (pthread_t* thread,
+                                 void* (*function) (void*),
+                                 void* arg);
+extern void Context_ForEach (void (*function) (void* data), void* data);
+
+/* Public functions */
+extern DS_Context* DS_ContextCreate (void);
+extern DS_Context* DS_DefaultContext (void);
+extern DS_Context* DS_CurrentContext (void);
+extern uint64_t DS_ContextId (const DS_Context* context);
+extern void DS_ContextDestroy (DS_Context* context);
+extern void DS_ContextMakeCurrent (DS_Context* context);
+extern void* DS_ContextState (DS_ContextKey* key, const size_t size,
+                              void (*init) (void* state),
+                              void (*release) (void* state));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
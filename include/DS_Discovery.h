@@ -0,0 +1,64 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_DISCOVERY_H
+#define _LIB_DS_DISCOVERY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "DS_Socket.h"
+#include "DS_String.h"
+
+/**
+ * Holds the state of an address that the robot discovery probes
+ */
+typedef struct {
+    char address [512]; /**< Address of the robot (name or IP) */
+    int resolved;       /**< 1 if the address lookup succeeded */
+    int selected;       /**< 1 if the robot socket uses this address */
+    int responding;     /**< 1 if the robot replied recently */
+    uint64_t replies;   /**< Number of robot packets received from it */
+    uint64_t reply_age; /**< Nanoseconds since the last reply (0 if none) */
+} DS_RobotAddress;
+
+/* Module functions */
+extern void Discovery_Close (void);
+extern char* Discovery_GetAddress (void);
+extern void Discovery_PacketSent (const DS_Socket* robot, const DS_String* data);
+extern void Discovery_PacketReceived (const DS_Socket* robot);
+
+/* Discovery functions */
+extern int DS_GetRobotDiscoveryEnabled (void);
+extern void DS_SetRobotDiscoveryEnabled (const int enabled);
+extern int DS_GetRobotAddresses (DS_RobotAddress* addresses, const int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_INTERFACE_H
+#define _LIB_DS_INTERFACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "DS_Types.h"
+#include "DS_Socket.h"
+
+/**
+ * Holds the state of a network interface used (or usable) by the library
+ */
+typedef struct {
+    char name [64];    /**< Interface name or local address, empty for any */
+    char address [64]; /**< IPv4 address of the interface, empty if unknown */
+    int up;            /**< 1 if the interface exists and is up */
+    int bound;         /**< 1 if a channel socket is bound to the interface */
+    int reachable;     /**< 1 if a channel bound to it has communications */
+} DS_InterfaceStatus;
+
+/* Module functions */
+extern void Interface_Configure (DS_Socket* socket, const DS_Channel channel);
+
+/* Public functions */
+extern char* DS_GetChannelInterface (const DS_Channel channel);
+extern void DS_SetNetworkInterface (const char* name);
+extern void DS_SetChannelInterface (const DS_Channel channel, const char* name);
+extern void DS_GetInterfaceStatus (const DS_Channel channel,
+                                   DS_InterfaceStatus* status);
+extern int DS_GetNetworkInterfaces (DS_InterfaceStatus* list, const int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
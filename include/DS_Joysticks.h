@@ -28,8 +28,21 @@
 extern "C" {
 #endif
 
+/**
+ * Represents a joystick and its information
+ */
+typedef struct _joystick {
+    int* hats;       /**< An array with the hat angles */
+    float* axes;    /**< An array with the axis values */
+    int* buttons;    /**< An array with the button states */
+    int num_axes;    /**< The number of axes of the joystick */
+    int num_hats;    /**< The number of hats of the joystick */
+    int num_buttons; /**< The number of buttons of the joystick */
+} DS_Joystick;
+
 extern void Joysticks_Init (void);
 extern void Joysticks_Close (void);
+extern DS_Joystick** Joysticks_List (int* count);
 
 extern int DS_GetJoystickCount (void);
 extern int DS_GetJoystickNumHats (int joystick);
@@ -0,0 +1,49 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_LOOPBACK_H
+#define _LIB_DS_LOOPBACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "DS_Socket.h"
+
+/* Module functions */
+extern void Loopback_Close (void);
+
+/* Transport functions */
+extern const DS_Transport* DS_LoopbackTransport (void);
+
+/* Simulated host functions */
+extern void DS_LoopbackFlush (const int port);
+extern int DS_LoopbackWrite (const int port, const char* data, const int len);
+extern int DS_LoopbackRead (const int port, char* data, const int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
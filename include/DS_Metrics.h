@@ -0,0 +1,83 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LIB_DS_METRICS_H
+#define _LIB_DS_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "DS_Types.h"
+#include "DS_String.h"
+
+/**
+ * Represents the kind of a metric
+ */
+typedef enum {
+    DS_METRIC_COUNTER = 0,   /**< Value that only goes up */
+    DS_METRIC_GAUGE = 1,     /**< Value that goes up and down */
+    DS_METRIC_HISTOGRAM = 2, /**< Observations counted in fixed buckets */
+} DS_MetricType;
+
+/**
+ * Represents the formats in which the metrics can be exported
+ */
+typedef enum {
+    DS_METRICS_PROMETHEUS = 0, /**< Prometheus text exposition format */
+    DS_METRICS_JSON = 1,       /**< JSON document */
+} DS_MetricsFormat;
+
+/* Module functions */
+extern void Metrics_Close (void);
+extern void Metrics_TripTime (const DS_Channel channel, const uint64_t time);
+extern void Metrics_LoopIteration (const uint64_t duration, const uint64_t lateness);
+extern void Metrics_SocketDrop (void);
+extern void Metrics_EventQueued (const int count);
+
+/* Registration functions */
+extern int DS_MetricCounter (const char* name, const char* label, const char* help);
+extern int DS_MetricGauge (const char* name, const char* label, const char* help);
+extern int DS_MetricHistogram (const char* name, const char* label, const char* help,
+                               const uint64_t* bounds, const int count,
+                               const double scale);
+
+/* Update functions */
+extern void DS_MetricAdd (const int id, const int64_t value);
+extern void DS_MetricSet (const int id, const int64_t value);
+extern void DS_MetricObserve (const int id, const uint64_t value);
+
+/* Export functions */
+extern uint64_t DS_MetricValue (const int id);
+extern DS_String DS_MetricsExport (const DS_MetricsFormat format);
+extern int DS_MetricsWriteFile (const char* path, const DS_MetricsFormat format);
+extern int DS_MetricsServe (const char* path);
+extern void DS_MetricsStopServing (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_PACKET_H
+#define _LIB_DS_PACKET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "DS_String.h"
+
+/**
+ * Byte order of a multi-byte packet field
+ */
+typedef enum {
+    DS_BIG_ENDIAN,
+    DS_LITTLE_ENDIAN,
+} DS_Endianness;
+
+/**
+ * Describes a single field of a packet. When encoding, the value returned
+ * by \c get (or the constant \c value if \c get is \c NULL) is written to
+ * the bits selected by \c mask. The \c get function receives the source
+ * given to \c DS_PacketEncode(), so that the protocol can look up its state
+ * once per packet instead of once per field. When decoding, the masked bits are shifted
+ * down and given to \c set.
+ *
+ * Fields that share a byte must use different masks. Fields are encoded
+ * and decoded in the order in which they appear in the layout.
+ */
+typedef struct {
+    const char* name;           /**< Name of the field, used for debugging */
+    int offset;                 /**< Position of the first byte of the field */
+    int width;                  /**< Number of bytes (1 to 4) */
+    DS_Endianness endianness;   /**< Byte order of the field */
+    uint32_t mask;              /**< Bits used by the field, 0 for all bits */
+    uint32_t value;             /**< Constant value, used if \c get is NULL */
+    int (*get) (const void* source); /**< Returns the value to encode */
+    void (*set) (const int value); /**< Receives the decoded value */
+} DS_Field;
+
+/**
+ * Describes the fixed part of a packet as a list of fields
+ */
+typedef struct {
+    const DS_Field* fields; /**< The fields of the packet */
+    int count;              /**< Number of fields */
+    int size;               /**< Minimum size of the packet in bytes */
+} DS_PacketLayout;
+
+/**
+ * Decodes the payload of a tag, \a len is the number of payload bytes
+ */
+typedef void (*DS_TagHandler) (const uint8_t* payload, const int len);
+
+/**
+ * Declares a packet layout from a static array of fields
+ */
+#define DS_LAYOUT(fields, size) { fields, sizeof (fields) / sizeof (fields [0]), size }
+
+/* Encoding and decoding functions */
+extern void DS_PacketEncode (const DS_PacketLayout* layout, char* data,
+                             const void* source);
+extern int DS_PacketDecode (const DS_PacketLayout* layout, const DS_String* data);
+extern int DS_PacketReadTags (const DS_String* data, const int offset,
+                              const DS_TagHandler handlers [256]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
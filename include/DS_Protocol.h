@@ -41,10 +41,26 @@ typedef struct _protocol {
     DS_String (*create_radio_packet) (void);
     DS_String (*create_robot_packet) (void);
 
+    /*
+     * Optional: patch a persistent packet owned by the protocol and return
+     * it, so that the packet does not need to be built (and freed) on every
+     * tick. Set to NULL to use the create_*_packet functions instead.
+     */
+    const DS_String* (*update_fms_packet) (void);
+    const DS_String* (*update_radio_packet) (void);
+    const DS_String* (*update_robot_packet) (void);
+
     int (*read_fms_packet) (const DS_String*);
     int (*read_radio_packet) (const DS_String*);
     int (*read_robot_packet) (const DS_String*);
 
+    /*
+     * Optional: return 1 if the given data looks like a robot packet of the
+     * protocol, without changing the robot status. This is used by the
+     * protocol auto-detection, protocols without it cannot be detected.
+     */
+    int (*probe_robot_packet) (const DS_String*);
+
     void (*reset_fms) (void);
     void (*reset_radio) (void);
     void (*reset_robot) (void);
@@ -68,9 +84,50 @@ typedef struct _protocol {
     DS_Socket netconsole_socket;
 } DS_Protocol;
 
+/*
+ * Single-protocol builds: define LIBDS_STATIC_PROTOCOL as FRC_2014, FRC_2015,
+ * FRC_2016 or FRC_2018 to compile the packet functions of that protocol into
+ * the event loop as direct calls. Only that protocol can be configured.
+ */
+#if defined LIBDS_STATIC_PROTOCOL
+    #define FRC_2014 2014
+    #define FRC_2015 2015
+    #define FRC_2016 2016
+    #define FRC_2018 2018
+
+    extern int Protocol_IsStatic (const DS_Protocol* ptr);
+
+    extern const DS_String* Protocol_UpdateFMSPacket (void);
+    extern const DS_String* Protocol_UpdateRadioPacket (void);
+    extern const DS_String* Protocol_UpdateRobotPacket (void);
+
+    extern int Protocol_ReadFMSPacket (const DS_String* data);
+    extern int Protocol_ReadRadioPacket (const DS_String* data);
+    extern int Protocol_ReadRobotPacket (const DS_String* data);
+#endif
+
 extern void Protocols_Init();
 extern void Protocols_Close();
+extern void Protocols_Unload();
+extern void Protocols_Suspend (const int suspend);
+extern void Protocols_Reconfigure (const int flags);
+extern void Protocols_LoadDetected (const DS_Protocol* ptr,
+                                    const uint64_t start_time,
+                                    const DS_String* packet,
+                                    const uint64_t packet_time);
+extern uint64_t Protocols_Step (const uint64_t now);
+extern void Protocols_WatchdogExpired (const DS_Channel channel);
+extern int Protocols_WatchdogTimeout (const DS_Channel channel);
+extern int Protocols_ReadPacket (const DS_Channel channel, const DS_String* data,
+                                 const uint64_t time);
+extern DS_Socket* Protocols_GetSocket (const DS_Channel channel);
 extern void DS_ConfigureProtocol (const DS_Protocol* ptr);
+extern void DS_GetChannelMarks (const DS_Channel channel, DS_SocketMarks* marks);
+extern int DS_GetChannelTimestamping (const DS_Channel channel);
+extern int DS_GetChannelFd (const DS_Channel channel);
+extern uint64_t DS_Step (const uint64_t now);
+extern uint64_t DS_NextDeadline (void);
+extern int DS_RetryLookups (void);
 
 extern unsigned long DS_SentFMSBytes();
 extern unsigned long DS_SentRadioBytes();
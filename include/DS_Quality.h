@@ -0,0 +1,80 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_QUALITY_H
+#define _LIB_DS_QUALITY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "DS_Types.h"
+
+/**
+ * Holds the packet statistics of a channel during a sliding time window
+ */
+typedef struct {
+    int received;        /**< Number of unique packets received */
+    int lost;            /**< Number of packet indexes that never arrived */
+    int duplicated;      /**< Number of packets received more than once */
+    int out_of_order;    /**< Number of packets received after a newer one */
+    int stale;           /**< Packets too old to be tracked, ignored */
+    float loss;          /**< Lost packets, as a percentage of expected ones */
+    float trip_time;     /**< Average trip time (in milliseconds) */
+    float max_trip_time; /**< Maximum trip time (in milliseconds) */
+} DS_CommsWindow;
+
+/**
+ * Represents the communications quality of a channel, as shown in the
+ * trip time/lost packets graph of the FRC Driver Station
+ */
+typedef struct {
+    DS_CommsWindow last_second;      /**< Statistics of the last second */
+    DS_CommsWindow last_ten_seconds; /**< Statistics of the last 10 seconds */
+} DS_CommsQuality;
+
+/* Module functions */
+extern void Quality_Init (void);
+extern void Quality_Close (void);
+extern void Quality_Reset (const DS_Channel channel);
+
+/* Sequence tracking functions (used by the protocols) */
+extern void Quality_PacketSent (const DS_Channel channel, const uint16_t index);
+extern void Quality_PacketReceived (const DS_Channel channel, const uint16_t index);
+extern void Quality_PacketTransmitted (const DS_Channel channel, const uint64_t time,
+                                       const int64_t id);
+extern void Quality_PacketTimestamped (const DS_Channel channel, const uint32_t id,
+                                       const uint64_t time);
+extern void Quality_SetReceiveTime (const DS_Channel channel, const uint64_t time);
+
+/* Public functions */
+extern void DS_GetCommsQuality (const DS_Channel channel, DS_CommsQuality* quality);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_REALTIME_H
+#define _LIB_DS_REALTIME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Threads of the library that can be configured by the real-time options
+ */
+typedef enum {
+    DS_THREAD_PROTOCOL, /**< Protocol event loop (sends and reads packets) */
+    DS_THREAD_IO,       /**< Socket and timer threads */
+} DS_ThreadRole;
+
+/**
+ * Holds the real-time settings of the library
+ */
+typedef struct {
+    int enabled;           /**< 1 to apply the settings, 0 for OS defaults */
+    int protocol_priority; /**< SCHED_FIFO priority of the protocol thread */
+    int io_priority;       /**< SCHED_FIFO priority of the I/O threads */
+    int protocol_cpu;      /**< CPU of the protocol thread, -1 for any CPU */
+    int io_cpu;            /**< CPU of the I/O threads, -1 for any CPU */
+    int lock_memory;       /**< 1 to lock (and prefault) the process memory */
+    int busy_poll;         /**< 1 to spin on the robot socket (burns a CPU) */
+    int spin_budget;       /**< Microseconds to spin before yielding the CPU */
+} DS_RealtimeOptions;
+
+/* Module functions */
+extern void Realtime_ConfigureThread (const DS_ThreadRole role,
+                                      const char* name);
+extern void Realtime_ConfigureWorker (const int cpu, const char* name);
+extern int Realtime_Generation (void);
+extern int Realtime_BusyPoll (void);
+extern int Realtime_SpinBudget (void);
+extern void Realtime_Yield (void);
+
+/* Public functions */
+extern void DS_GetRealtimeOptions (DS_RealtimeOptions* options);
+extern int DS_SetRealtimeOptions (const DS_RealtimeOptions* options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_REPLAY_H
+#define _LIB_DS_REPLAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Holds the settings of a replay
+ */
+typedef struct {
+    int realtime;  /**< 1 to keep the recorded timing, 0 to go full speed */
+    FILE* events;  /**< Stream in which to write the events, may be NULL */
+} DS_ReplayOptions;
+
+/**
+ * Holds the results of a replay
+ */
+typedef struct {
+    int frames;              /**< Number of frames in the capture file */
+    int fms_packets;         /**< Number of replayed FMS packets */
+    int radio_packets;       /**< Number of replayed radio packets */
+    int robot_packets;       /**< Number of replayed robot packets */
+    int netconsole_messages; /**< Number of replayed NetConsole messages */
+    int decode_failures;     /**< Packets rejected by the protocol */
+    int events;              /**< Number of generated events */
+    uint64_t duration;       /**< Recorded time span (in nanoseconds) */
+    uint64_t elapsed;        /**< Time spent replaying (in nanoseconds) */
+} DS_ReplayResult;
+
+extern int DS_Replay (const char* path,
+                      const DS_ReplayOptions* options,
+                      DS_ReplayResult* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LIB_DS_SCHEDULER_H
+#define _LIB_DS_SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Holds the statistics of the scheduler since it was started
+ */
+typedef struct {
+    int workers;          /**< Number of worker threads */
+    int sessions;         /**< Number of scheduled contexts */
+    unsigned long steps;  /**< Number of times that a context was stepped */
+    unsigned long steals; /**< Steps run by a worker that does not own them */
+    float max_lateness;   /**< Maximum delay of a step (in milliseconds) */
+    float mean_lateness;  /**< Average delay of a step (in milliseconds) */
+} DS_SchedulerStats;
+
+/* Module functions */
+extern int Scheduler_AddSession (void);
+extern void Scheduler_RemoveSession (void);
+
+/* Public functions */
+extern int DS_SchedulerStart (const int workers);
+extern int DS_SchedulerStop (void);
+extern int DS_SchedulerRunning (void);
+extern void DS_GetSchedulerStats (DS_SchedulerStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -33,6 +33,79 @@ extern "C" {
 #include "DS_Types.h"
 #include "DS_String.h"
 
+struct _DS_Socket;
+
+/*
+ * DSCP code points used to mark the packets of each channel
+ */
+#define DS_DSCP_DEFAULT 0  /**< Best effort (no mark) */
+#define DS_DSCP_CS1     8  /**< Low-priority data (e.g. NetConsole) */
+#define DS_DSCP_AF41    34 /**< Interactive traffic */
+#define DS_DSCP_EF      46 /**< Expedited forwarding (robot control) */
+
+/*
+ * Socket priorities (SO_PRIORITY) used to queue the packets of each channel
+ */
+#define DS_PRIORITY_DEFAULT     0 /**< Best effort */
+#define DS_PRIORITY_BULK        2 /**< Bulk data */
+#define DS_PRIORITY_INTERACTIVE 6 /**< Interactive (highest unprivileged) */
+
+/*
+ * Kernel timestamps used by a socket
+ */
+#define DS_TIMESTAMP_RX 0x01 /**< Received datagrams are timestamped */
+#define DS_TIMESTAMP_TX 0x02 /**< Sent datagrams are timestamped */
+
+/**
+ * Holds the QoS marks of the packets sent by a socket
+ */
+typedef struct {
+    int dscp;     /**< DSCP code point of the IP header, -1 if unknown */
+    int priority; /**< Socket priority (SO_PRIORITY), -1 if unknown */
+} DS_SocketMarks;
+
+/**
+ * Holds a lookup of the remote address of a threadless socket, the lookup
+ * keeps its own copy of the address so that it can run in another thread
+ */
+typedef struct {
+    char address [512];  /**< Host name to look up */
+    char service [12];   /**< Port number as a string */
+    uint64_t addr [16];  /**< Address found (a sockaddr) */
+    int length;          /**< Size of the address found, 0 if not found */
+} DS_SocketLookup;
+
+/**
+ * Defines the functions used by the sockets module to move data between
+ * a \c DS_Socket and the remote host. The default transport uses the UDP/TCP
+ * sockets provided by the operating system, but other transports (such as
+ * the in-process loopback transport) can be assigned to a socket before it
+ * is opened.
+ *
+ * Transports that have no file descriptor that can be watched with
+ * \c select() shall set the \c fd function to \c NULL. Such transports are
+ * opened in the calling thread, and the sockets module polls their
+ * \c recv_view function every time that the socket is read.
+ */
+typedef struct {
+    const char* name; /**< Name of the transport, used for debugging */
+
+    /** Creates the resources of the socket and updates its init. states */
+    void (*open) (struct _DS_Socket* ptr);
+
+    /** Releases the resources created by the \c open function */
+    void (*close) (struct _DS_Socket* ptr);
+
+    /** Sends \a len bytes to the remote host, returns -1 on failure */
+    int (*send) (const struct _DS_Socket* ptr, const char* data, const int len);
+
+    /** Points \a data to the next received datagram and returns its length */
+    int (*recv_view) (struct _DS_Socket* ptr, const char** data);
+
+    /** Returns the file descriptor that receives data (may be NULL) */
+    int (*fd) (const struct _DS_Socket* ptr);
+} DS_Transport;
+
 /**
  * Holds all the private (erm, dirty) variables that the sockets module needs
  * to operate with the data provided by a \c DS_Socket structure
@@ -44,15 +117,31 @@ typedef struct {
     int server_init;       /**< 1 if server is working, 0 if not */
     size_t buffer_size;    /**< Holds the number of received bytes */
     char buffer [4096];    /**< Holds the received data buffer */
+    char view [4096];      /**< Holds the datagram returned by the transport */
     char in_service [12];  /**< Holds the input port number as a string */
     char out_service [12]; /**< Holds the output port number as a string */
+    uint64_t out_addr [16]; /**< Resolved remote address (a sockaddr) */
+    int out_addr_len;       /**< Size of the resolved address, 0 if unknown */
+    uint64_t in_addr [16];  /**< Sender of the last datagram (a sockaddr) */
+    int in_addr_len;        /**< Size of the sender address, 0 if unknown */
+    volatile int open_count; /**< Incremented each time the socket is closed */
+    const DS_Transport* transport; /**< Transport used by the open socket */
+    int interface_bound;    /**< 1 if bound to the network interface */
+    DS_SocketMarks marks;   /**< QoS marks accepted by the OS */
+    int timestamping;       /**< DS_TIMESTAMP_* flags enabled by the OS */
+    uint64_t kernel_rx_time; /**< Kernel timestamp of the last datagram */
+    uint64_t rx_time;       /**< Receive time of the buffered datagram */
+    uint64_t tx_time;       /**< Transmit time of the last sent datagram */
+    uint32_t tx_id;         /**< Timestamp ID of the last sent datagram */
+    uint32_t tx_next_id;    /**< Timestamp ID of the next sent datagram */
+    int tx_pending;         /**< Transmit timestamps that were not read */
 } DS_SocketInfo;
 
 /**
  * Holds all the 'public' variables of a socket, these variables can be used
  * both the the networking module and the rest of the application.
  */
-typedef struct {
+typedef struct _DS_Socket {
     int in_port;           /**< Input port number */
     int out_port;          /**< Output port number */
     int disabled;          /**< 1 if socket shall not send or receive data */
@@ -60,6 +149,13 @@ typedef struct {
     char address [512];    /**< Address of remote host */
     DS_SocketType type;    /**< Type of socket (UDP/TCP) */
     DS_SocketInfo info;    /**< Ugly data about the socket */
+    const DS_Transport* transport; /**< Transport to use, NULL for default */
+    int busy_poll;         /**< 1 if the socket is polled by its reader */
+    char network_interface [64]; /**< Interface or local address to use */
+    int dscp;              /**< DSCP code point of sent packets, 0 for none */
+    int priority;          /**< Priority of sent packets, 0 for default */
+    int polled;            /**< 1 if the socket is read by its owner */
+    int threadless;        /**< 1 if the socket never starts a thread */
 } DS_Socket;
 
 /* For socket initialization */
@@ -69,14 +165,34 @@ extern DS_Socket* DS_SocketEmpty (void);
 extern void Sockets_Init (void);
 extern void Sockets_Close (void);
 
+/* Transport functions */
+extern const DS_Transport* DS_SockyTransport (void);
+extern const DS_Transport* DS_GetDefaultTransport (void);
+extern void DS_SetDefaultTransport (const DS_Transport* transport);
+
 /* Socket initializer and destructor functions */
 extern void DS_SocketOpen (DS_Socket* ptr);
 extern void DS_SocketClose (DS_Socket* ptr);
 
 /* I/O functions */
+extern int DS_SocketPoll (DS_Socket* ptr);
 extern DS_String DS_SocketRead (DS_Socket* ptr);
-extern int DS_SocketSend (const DS_Socket* ptr, const DS_String* data);
+extern int DS_SocketSend (DS_Socket* ptr, const DS_String* data);
+extern int DS_SocketCanSend (const DS_Socket* ptr);
 extern void DS_SocketChangeAddress (DS_Socket* ptr, const char* address);
+extern int DS_SocketLookupPrepare (const DS_Socket* ptr, DS_SocketLookup* lookup);
+extern void DS_SocketLookupRun (DS_SocketLookup* lookup);
+extern int DS_SocketLookupApply (DS_Socket* ptr, const DS_SocketLookup* lookup);
+extern void DS_SocketChangeInterface (DS_Socket* ptr, const char* name);
+extern int DS_SocketReceivedFrom (const DS_Socket* ptr, const DS_Socket* remote);
+extern void DS_SocketGetMarks (const DS_Socket* ptr, DS_SocketMarks* marks);
+extern int DS_SocketTimestamping (const DS_Socket* ptr);
+extern int DS_SocketDescriptor (const DS_Socket* ptr);
+extern uint64_t DS_SocketReceiveTime (const DS_Socket* ptr);
+extern uint64_t DS_SocketSendTime (const DS_Socket* ptr);
+extern uint32_t DS_SocketSendId (const DS_Socket* ptr);
+extern int DS_SocketReadTxTimestamps (DS_Socket* ptr, uint32_t* ids,
+                                      uint64_t* times, const int max);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,84 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_STATISTICS_H
+#define _LIB_DS_STATISTICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "DS_Types.h"
+
+/**
+ * Holds the traffic counters of a single channel
+ */
+typedef struct {
+    uint64_t sent_packets;         /**< Number of packets sent */
+    uint64_t sent_bytes;           /**< Number of bytes sent */
+    uint64_t received_packets;     /**< Number of packets received */
+    uint64_t received_bytes;       /**< Number of bytes received */
+    uint64_t socket_errors;        /**< Number of failed send operations */
+    uint64_t decode_failures;      /**< Number of packets rejected by protocol */
+    uint64_t watchdog_expirations; /**< Number of times comms were lost */
+    uint64_t first_packet_time;    /**< Time to first valid packet (in ns) */
+} DS_ChannelStats;
+
+/**
+ * Holds the traffic counters of every channel, the counters are reset
+ * when a new protocol is loaded
+ */
+typedef struct {
+    DS_ChannelStats fms;        /**< FMS channel counters */
+    DS_ChannelStats radio;      /**< Radio channel counters */
+    DS_ChannelStats robot;      /**< Robot channel counters */
+    DS_ChannelStats netconsole; /**< NetConsole channel counters */
+} DS_Stats;
+
+/* Module functions */
+extern void Statistics_Reset (void);
+extern void Statistics_ResetPackets (const DS_Channel channel);
+extern void Statistics_Start (const uint64_t time);
+
+/* Counter update functions */
+extern void Statistics_PacketSent (const DS_Channel channel, const int bytes);
+extern void Statistics_PacketReceived (const DS_Channel channel, const int bytes);
+extern void Statistics_DecodeFailure (const DS_Channel channel);
+extern void Statistics_PacketDecoded (const DS_Channel channel);
+extern void Statistics_WatchdogExpired (const DS_Channel channel);
+
+/* Counters since the last packet reset (used to calculate packet loss) */
+extern uint64_t Statistics_SentPackets (const DS_Channel channel);
+extern uint64_t Statistics_ReceivedPackets (const DS_Channel channel);
+
+/* Public functions */
+extern void DS_GetStatistics (DS_Stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
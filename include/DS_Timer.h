@@ -28,6 +28,7 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
 #include <pthread.h>
 
 /**
@@ -42,9 +43,20 @@ typedef struct _timer {
     int initialized;  /**< Set to \c 1 if the timer has been initialized */
 } DS_Timer;
 
+/**
+ * Functions of a clock that replaces the system clock, see \c DS_SetClock()
+ */
+typedef uint64_t (*DS_ClockFunc) (void);
+typedef void (*DS_SleepFunc) (const uint64_t time);
+
 extern void Timers_Init (void);
 extern void Timers_Close (void);
+extern void Timers_SystemSleep (const int millisecs);
 extern void DS_Sleep (const int millisecs);
+extern void DS_SleepUntil (const uint64_t time);
+extern uint64_t DS_GetTimeNs (void);
+extern int DS_SystemClock (void);
+extern int DS_SetClock (DS_ClockFunc now, DS_SleepFunc sleep_until);
 extern void DS_TimerStop (DS_Timer* timer);
 extern void DS_TimerStart (DS_Timer* timer);
 extern void DS_TimerReset (DS_Timer* timer);
@@ -50,6 +50,17 @@ typedef enum {
     DS_SOCKET_TCP,
 } DS_SocketType;
 
+typedef enum {
+    DS_CHANNEL_FMS,
+    DS_CHANNEL_RADIO,
+    DS_CHANNEL_ROBOT,
+    DS_CHANNEL_NETCONSOLE,
+} DS_Channel;
+
+typedef enum {
+    DS_INIT_MANUAL_PUMP = 0x01,
+} DS_InitFlags;
+
 #ifdef __cplusplus
 }
 #endif
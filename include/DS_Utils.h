@@ -55,6 +55,7 @@ typedef enum {
  * Misc functions
  */
 extern uint32_t DS_CRC32 (const void* buf, size_t size);
+extern uint32_t DS_CRC32Combine (const uint32_t crc1, const uint32_t crc2, size_t size2);
 extern uint8_t DS_FloatToByte (const float val, const float max);
 extern DS_String DS_GetStaticIP (const int net, const int team, const int host);
 extern void DS_ShowMessageBox (const DS_String* caption,
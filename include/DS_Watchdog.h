@@ -0,0 +1,78 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _LIB_DS_WATCHDOG_H
+#define _LIB_DS_WATCHDOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "DS_Types.h"
+
+/**
+ * Holds the settings of the receive watchdog of a channel
+ */
+typedef struct {
+    int adaptive;    /**< 1 to follow the packet arrival times, 0 for fixed */
+    float k;         /**< Standard deviations added to the mean interval */
+    int min_timeout; /**< Lower bound of the adaptive timeout (ms) */
+    int max_timeout; /**< Upper bound of the adaptive timeout (ms), 0 to use
+                          the fixed timeout of the protocol */
+} DS_WatchdogConfig;
+
+/**
+ * Holds the current state of the receive watchdog of a channel
+ */
+typedef struct {
+    int timeout;          /**< Timeout in use (ms), 0 if disabled */
+    int fixed_timeout;    /**< Timeout defined by the protocol (ms) */
+    int samples;          /**< Number of measured packet intervals */
+    float mean_interval;  /**< Average time between packets (ms) */
+    float stddev;         /**< Standard deviation of the interval (ms) */
+    float elapsed;        /**< Time since the last packet (ms) */
+    int expired;          /**< 1 if the watchdog expired since last packet */
+} DS_WatchdogState;
+
+/* Module functions */
+extern void Watchdog_Feed (const DS_Channel channel, const uint64_t now);
+extern int Watchdog_Check (const DS_Channel channel, const uint64_t now);
+extern void Watchdog_Reset (const DS_Channel channel, const int timeout,
+                            const uint64_t now);
+
+/* Public functions */
+extern void DS_GetWatchdogState (const DS_Channel channel,
+                                 DS_WatchdogState* state);
+extern void DS_GetWatchdogConfig (const DS_Channel channel,
+                                  DS_WatchdogConfig* config);
+extern void DS_SetWatchdogConfig (const DS_Channel channel,
+                                  const DS_WatchdogConfig* config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
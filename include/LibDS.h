@@ -34,13 +34,28 @@ extern "C" {
 #include "DS_Events.h"
 #include "DS_Client.h"
 #include "DS_Socket.h"
+#include "DS_Quality.h"
 #include "DS_Protocol.h"
+#include "DS_Statistics.h"
+#include "DS_Loopback.h"
+#include "DS_Capture.h"
+#include "DS_Replay.h"
+#include "DS_Autodetect.h"
+#include "DS_Discovery.h"
+#include "DS_Watchdog.h"
+#include "DS_Realtime.h"
+#include "DS_Interface.h"
+#include "DS_Context.h"
+#include "DS_Scheduler.h"
+#include "DS_Metrics.h"
 #include "DS_Joysticks.h"
 #include "DS_DefaultProtocols.h"
 
 extern void DS_Init (void);
+extern void DS_InitWithFlags (const int flags);
 extern void DS_Close (void);
 extern int DS_Initialized (void);
+extern int DS_ManualPump (void);
 
 extern char* DS_GetVersion (void);
 extern char* DS_GetBuildDate (void);
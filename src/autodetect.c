@@ -0,0 +1,437 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "LibDS.h"
+#include "DS_Utils.h"
+#include "DS_Timer.h"
+#include "DS_Client.h"
+#include "DS_Socket.h"
+#include "DS_Context.h"
+#include "DS_Protocol.h"
+#include "DS_Interface.h"
+#include "DS_Autodetect.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define MAX_CANDIDATES 8 /* Maximum number of protocols probed at once */
+#define POLL_INTERVAL  2 /* Milliseconds between each probe iteration */
+
+/**
+ * Holds a protocol that is being probed and the socket used to send
+ * its robot packets
+ */
+typedef struct {
+    DS_Protocol protocol;  /**< Copy of the candidate protocol */
+    DS_Socket probe;       /**< Sends the robot packets of the candidate */
+    DS_Socket* receiver;   /**< Socket that receives the robot replies */
+    uint64_t next_send;    /**< Time at which the next probe is sent */
+} Candidate;
+
+/**
+ * Holds the auto-detection state of a context
+ */
+typedef struct {
+    /* Probed protocols and the sockets listening for robot packets (one for
+     * each robot input port used by the candidates) */
+    Candidate candidates [MAX_CANDIDATES];
+    DS_Socket receivers [MAX_CANDIDATES];
+    int candidate_count;
+    int receiver_count;
+
+    /* Auto-detection thread state */
+    int running;
+    int thread_active;
+    uint64_t start_time;
+    pthread_t detect_thread;
+} State;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the auto-detection state of the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), NULL, NULL);
+}
+
+/**
+ * Returns the address used to probe the robot with the given \a protocol,
+ * the custom robot address is used for every candidate if the user set it
+ */
+static DS_String probe_address (const DS_Protocol* protocol)
+{
+    char* custom = DS_GetCustomRobotAddress();
+    DS_String address;
+
+    if (custom && strlen (custom) > 0 && strcmp (custom, DS_FallBackAddress))
+        address = DS_StrNew (custom);
+    else
+        address = protocol->robot_address();
+
+    DS_FREE (custom);
+    return address;
+}
+
+/**
+ * Returns the receiver socket that listens on the given \a port, a new
+ * receiver is registered if there is none
+ */
+static DS_Socket* get_receiver (const DS_Socket* robot_socket)
+{
+    State* s = state();
+
+    int i;
+    for (i = 0; i < s->receiver_count; ++i) {
+        if (s->receivers [i].in_port == robot_socket->in_port)
+            return &s->receivers [i];
+    }
+
+    DS_Socket* receiver = &s->receivers [s->receiver_count++];
+    memset (receiver, 0, sizeof (DS_Socket));
+    receiver->type = robot_socket->type;
+    receiver->in_port = robot_socket->in_port;
+    receiver->transport = robot_socket->transport;
+    Interface_Configure (receiver, DS_CHANNEL_ROBOT);
+    return receiver;
+}
+
+/**
+ * Opens the probe socket of each candidate and the receiver sockets
+ */
+static void open_sockets (void)
+{
+    State* s = state();
+
+    int i;
+    s->receiver_count = 0;
+
+    for (i = 0; i < s->candidate_count; ++i) {
+        Candidate* c = &s->candidates [i];
+        const DS_Socket* robot = &c->protocol.robot_socket;
+
+        /* Get the address of the robot for this protocol */
+        DS_String address = probe_address (&c->protocol);
+        char* str = DS_StrToChar (&address);
+
+        /* Configure the probe (replies are read by the receiver) */
+        memset (&c->probe, 0, sizeof (DS_Socket));
+        c->probe.in_port = 0;
+        c->probe.type = robot->type;
+        c->probe.out_port = robot->out_port;
+        c->probe.transport = robot->transport;
+        strncpy (c->probe.address, str, sizeof (c->probe.address) - 1);
+        Interface_Configure (&c->probe, DS_CHANNEL_ROBOT);
+
+        c->next_send = 0;
+        c->receiver = get_receiver (robot);
+
+        DS_FREE (str);
+        DS_StrRmBuf (&address);
+    }
+
+    for (i = 0; i < s->receiver_count; ++i)
+        DS_SocketOpen (&s->receivers [i]);
+
+    for (i = 0; i < s->candidate_count; ++i)
+        DS_SocketOpen (&s->candidates [i].probe);
+}
+
+/**
+ * Closes every socket used by the auto-detection
+ */
+static void close_sockets (void)
+{
+    State* s = state();
+
+    int i;
+    for (i = 0; i < s->candidate_count; ++i)
+        DS_SocketClose (&s->candidates [i].probe);
+
+    for (i = 0; i < s->receiver_count; ++i)
+        DS_SocketClose (&s->receivers [i]);
+}
+
+/**
+ * Sends the robot packet of the given \a candidate if its address has been
+ * resolved. Operating system sockets with an unresolved address are
+ * skipped, so that an unreachable mDNS name does not delay the other
+ * candidates.
+ */
+static void send_probe (Candidate* c, const uint64_t now)
+{
+    /* Not time to send a packet yet */
+    if (now < c->next_send)
+        return;
+
+    /* Address is not resolved (yet) */
+    if (c->probe.info.transport == DS_SockyTransport()
+            && c->probe.info.out_addr_len <= 0)
+        return;
+
+    /* Send the packet (in place if the protocol allows it) */
+    if (c->protocol.update_robot_packet)
+        DS_SocketSend (&c->probe, c->protocol.update_robot_packet());
+    else {
+        DS_String data = c->protocol.create_robot_packet();
+        DS_SocketSend (&c->probe, &data);
+        DS_StrRmBuf (&data);
+    }
+
+    c->next_send = now + (uint64_t) DS_Max (c->protocol.robot_interval, 1)
+                   * 1000000ULL;
+}
+
+/**
+ * Returns the candidate that sent the given \a data, which was received by
+ * the \a receiver socket. Candidates whose robot address does not match the
+ * sender are skipped, if the sender is unknown, the candidates are tried in
+ * the order given by the user.
+ *
+ * A candidate only wins if its probe function recognizes the packet. The
+ * probe does not change the robot status, so the candidates that lose do
+ * not leave their interpretation of the packet behind.
+ */
+static Candidate* match_packet (const DS_Socket* receiver,
+                                const DS_String* data)
+{
+    State* s = state();
+
+    int i;
+    for (i = 0; i < s->candidate_count; ++i) {
+        Candidate* c = &s->candidates [i];
+        if (c->receiver != receiver)
+            continue;
+
+        if (DS_SocketReceivedFrom (receiver, &c->probe) == 0)
+            continue;
+
+        if (c->protocol.probe_robot_packet (data))
+            return c;
+    }
+
+    return NULL;
+}
+
+/**
+ * Probes every candidate until one of them receives a valid robot packet,
+ * then the candidate is loaded as the current protocol and the packet is
+ * given to it (both under the protocol loop mutex, so that the event loop
+ * does not step the new protocol meanwhile)
+ */
+static void* run_autodetect (void* unused)
+{
+    State* s = state();
+
+    (void) unused;
+
+    Candidate* winner = NULL;
+    DS_String packet = DS_StrNewLen (0);
+    uint64_t packet_time = 0;
+
+    open_sockets();
+
+    while (s->running && !winner) {
+        int i;
+        uint64_t now = DS_GetTimeNs();
+
+        /* Send the robot packets */
+        for (i = 0; i < s->candidate_count; ++i)
+            send_probe (&s->candidates [i], now);
+
+        /* Read the robot replies */
+        for (i = 0; i < s->receiver_count && !winner; ++i) {
+            DS_String data = DS_SocketRead (&s->receivers [i]);
+
+            if (DS_StrLen (&data) > 0) {
+                winner = match_packet (&s->receivers [i], &data);
+                if (winner) {
+                    packet = DS_StrDup (&data);
+                    packet_time = DS_SocketReceiveTime (&s->receivers [i]);
+                }
+            }
+
+            DS_StrRmBuf (&data);
+        }
+
+        if (!winner)
+            DS_Sleep (POLL_INTERVAL);
+    }
+
+    /* Tear down the probes before the winner opens its own sockets */
+    close_sockets();
+
+    /* Load the winner (using the address that replied) and give it the
+     * packet that it received */
+    if (winner && s->running) {
+        memcpy (winner->protocol.robot_socket.address, winner->probe.address,
+                sizeof (winner->probe.address));
+
+        Protocols_LoadDetected (&winner->protocol, s->start_time,
+                                &packet, packet_time);
+    }
+
+    DS_StrRmBuf (&packet);
+    s->running = 0;
+    return NULL;
+}
+
+/**
+ * Stops the auto-detection thread (if running) and waits for it to finish,
+ * unless it is the calling thread
+ */
+static void stop_thread (void)
+{
+    State* s = state();
+
+    pthread_mutex_lock (&mutex);
+
+    if (s->thread_active
+            && !pthread_equal (s->detect_thread, pthread_self())) {
+        s->running = 0;
+        pthread_join (s->detect_thread, NULL);
+        s->thread_active = 0;
+    }
+
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Stops the protocol auto-detection
+ */
+void Autodetect_Close (void)
+{
+    stop_thread();
+}
+
+/**
+ * Stops the protocol auto-detection, the current protocol (if any) is left
+ * untouched. \c DS_ConfigureProtocol() calls this function, so loading a
+ * protocol always cancels the auto-detection.
+ */
+void DS_StopAutodetect (void)
+{
+    stop_thread();
+}
+
+/**
+ * Returns \c 1 if the protocol auto-detection is still probing the robot
+ */
+int DS_AutodetectRunning (void)
+{
+    State* s = state();
+
+    return s->running;
+}
+
+/**
+ * Unloads the current protocol and probes the robot with the robot packets
+ * of the given \a protocols at the same time. The first protocol that
+ * receives a valid robot packet is loaded (with \c DS_ConfigureProtocol())
+ * and the other probes are closed.
+ *
+ * The time between this call and the first robot packet is reported by
+ * the \c first_packet_time statistic of the robot channel.
+ *
+ * Each reply is checked with the \c probe_robot_packet function of the
+ * candidates, protocols without that function cannot be detected and are
+ * ignored.
+ *
+ * \note Protocols that use the same robot ports and packet format (such as
+ *       the 2015 and 2016 protocols) are told apart by the address of the
+ *       robot that replied. If the address is unknown (e.g. when using the
+ *       loopback transport) or a custom robot address is set, the first
+ *       matching protocol in the list is used.
+ *
+ * \param protocols array of candidate protocols, the protocols are copied
+ * \param count number of elements in the \a protocols array
+ *
+ * \returns 1 if the auto-detection was started, 0 on failure
+ */
+int DS_AutodetectProtocol (const DS_Protocol* protocols, const int count)
+{
+    State* s = state();
+
+    assert (protocols);
+
+    /* Check the number of protocols */
+    if (count <= 0 || count > MAX_CANDIDATES) {
+        fprintf (stderr, "DS_AutodetectProtocol: invalid protocol count %d\n",
+                 count);
+        return 0;
+    }
+
+    /* The probes are read by their own thread */
+    if (DS_ManualPump()) {
+        fprintf (stderr, "DS_AutodetectProtocol: not available in manual "
+                 "pump mode\n");
+        return 0;
+    }
+
+    /* Stop previous auto-detection and release the robot ports */
+    stop_thread();
+    Protocols_Unload();
+
+    pthread_mutex_lock (&mutex);
+
+    /* Copy the candidates */
+    int i;
+    s->candidate_count = 0;
+    for (i = 0; i < count; ++i) {
+#if defined LIBDS_STATIC_PROTOCOL
+        if (!Protocol_IsStatic (&protocols [i]))
+            continue;
+#endif
+        /* The replies of the robot cannot be matched to the protocol */
+        if (!protocols [i].probe_robot_packet) {
+            fprintf (stderr, "DS_AutodetectProtocol: %s cannot be detected\n",
+                     protocols [i].name.buf);
+            continue;
+        }
+
+        Candidate* c = &s->candidates [s->candidate_count++];
+        memset (c, 0, sizeof (Candidate));
+        c->protocol = protocols [i];
+    }
+
+    /* Start the probing thread */
+    s->running = 1;
+    s->start_time = DS_GetTimeNs();
+    int error = s->candidate_count == 0 ||
+                Context_CreateThread (&s->detect_thread, &run_autodetect, NULL);
+
+    if (error) {
+        s->running = 0;
+        fprintf (stderr, "DS_AutodetectProtocol: cannot start probing\n");
+    }
+
+    s->thread_active = !error;
+    pthread_mutex_unlock (&mutex);
+
+    return !error;
+}
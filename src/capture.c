@@ -0,0 +1,552 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "DS_Utils.h"
+#include "DS_Timer.h"
+#include "DS_Atomic.h"
+#include "DS_Capture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#if defined _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#define RING_SIZE      256        /* Must be a power of 2 */
+#define RING_MASK      (RING_SIZE - 1)
+#define MAX_DATAGRAM   4096       /* Same size as the buffer of a DS_Socket */
+#define HEADERS_SIZE   28         /* Size of the IPv4 + UDP headers */
+#define FLUSH_INTERVAL 1000000000 /* Flush the file every second */
+#define CHANNEL_COUNT  4
+
+/*
+ * pcapng block types and options
+ */
+#define SHB_TYPE         0x0A0D0D0A
+#define IDB_TYPE         0x00000001
+#define EPB_TYPE         0x00000006
+#define BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define LINKTYPE_RAW     101
+#define OPT_ENDOFOPT     0
+#define OPT_SHB_USERAPPL 4
+#define OPT_IF_NAME      2
+#define OPT_IF_TSRESOL   9
+#define OPT_EPB_FLAGS    2
+#define EPB_INBOUND      1
+#define EPB_OUTBOUND     2
+
+/**
+ * Holds a datagram waiting to be written to the capture file
+ */
+typedef struct {
+    volatile uint64_t sequence;
+    uint64_t timestamp;
+    uint32_t interface;
+    uint32_t outgoing;
+    uint32_t local_address;
+    uint32_t remote_address;
+    uint16_t local_port;
+    uint16_t remote_port;
+    int len;
+    uint8_t data [MAX_DATAGRAM];
+} Slot;
+
+/*
+ * Bounded multi-producer/single-consumer ring. Producers (the protocol event
+ * loop and the client thread) never block, if the ring is full the datagram
+ * is dropped and counted.
+ */
+static Slot* ring = NULL;
+static DS_CACHELINE_ALIGN volatile uint64_t tail = 0;
+static DS_CACHELINE_ALIGN uint64_t head = 0;
+
+/*
+ * Capture state
+ */
+static FILE* file = NULL;
+static pthread_t writer;
+static int writer_running = 0;
+static uint64_t epoch_offset = 0;
+static volatile uint64_t capturing = 0;
+static volatile uint64_t producers = 0;
+static volatile uint64_t dropped = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Interface names, indexed by DS_Channel
+ */
+static const char* interface_names [CHANNEL_COUNT] = {
+    "fms",
+    "radio",
+    "robot",
+    "netconsole",
+};
+
+/**
+ * Returns the number of nanoseconds elapsed since the Unix epoch
+ */
+static uint64_t get_epoch_ns (void)
+{
+#if defined _WIN32
+    FILETIME ft;
+    ULARGE_INTEGER time;
+    GetSystemTimeAsFileTime (&ft);
+    time.LowPart = ft.dwLowDateTime;
+    time.HighPart = ft.dwHighDateTime;
+    return (time.QuadPart - 116444736000000000ULL) * 100;
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+/**
+ * Returns the given dotted IPv4 \a address as a 32-bit number, or 0 if
+ * the address is a hostname
+ */
+static uint32_t parse_ipv4 (const char* address)
+{
+    int i;
+    uint32_t value = 0;
+
+    for (i = 0; i < 4; ++i) {
+        int digits = 0;
+        uint32_t octet = 0;
+
+        while (*address >= '0' && *address <= '9' && digits < 3) {
+            octet = octet * 10 + (uint32_t) (*address - '0');
+            ++address;
+            ++digits;
+        }
+
+        if (digits == 0 || octet > 255)
+            return 0;
+
+        value = (value << 8) | octet;
+
+        if (i < 3 && *address++ != '.')
+            return 0;
+    }
+
+    return *address == '\0' ? value : 0;
+}
+
+/**
+ * Writes a 16-bit big endian value to the given buffer
+ */
+static void put_be16 (uint8_t* buf, const uint32_t value)
+{
+    buf [0] = (uint8_t) (value >> 8);
+    buf [1] = (uint8_t) (value);
+}
+
+/**
+ * Writes a 32-bit big endian value to the given buffer
+ */
+static void put_be32 (uint8_t* buf, const uint32_t value)
+{
+    put_be16 (buf, value >> 16);
+    put_be16 (buf + 2, value);
+}
+
+/**
+ * Writes the IPv4 and UDP headers of the datagram stored in the given \a slot,
+ * so that Wireshark can identify the packets by their port numbers
+ */
+static void write_headers (uint8_t* buf, const Slot* slot)
+{
+    int i;
+    uint32_t sum = 0;
+    uint32_t src_addr = slot->outgoing ? slot->local_address : slot->remote_address;
+    uint32_t dst_addr = slot->outgoing ? slot->remote_address : slot->local_address;
+    uint16_t src_port = slot->outgoing ? slot->local_port : slot->remote_port;
+    uint16_t dst_port = slot->outgoing ? slot->remote_port : slot->local_port;
+
+    /* IPv4 header */
+    memset (buf, 0, HEADERS_SIZE);
+    buf [0] = 0x45;
+    put_be16 (buf + 2, HEADERS_SIZE + slot->len);
+    buf [6] = 0x40;
+    buf [8] = 64;
+    buf [9] = 17;
+    put_be32 (buf + 12, src_addr);
+    put_be32 (buf + 16, dst_addr);
+
+    /* IPv4 header checksum */
+    for (i = 0; i < 20; i += 2)
+        sum += ((uint32_t) buf [i] << 8) | buf [i + 1];
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    put_be16 (buf + 10, ~sum & 0xFFFF);
+
+    /* UDP header (checksum is optional in IPv4) */
+    put_be16 (buf + 20, src_port);
+    put_be16 (buf + 22, dst_port);
+    put_be16 (buf + 24, 8 + slot->len);
+}
+
+/**
+ * Appends a pcapng option to the given \a block and returns the new size
+ * of the block
+ */
+static int put_option (uint8_t* block, int size, const uint16_t code,
+                       const void* value, const uint16_t len)
+{
+    memcpy (block + size, &code, 2);
+    memcpy (block + size + 2, &len, 2);
+    memset (block + size + 4, 0, (len + 3) & ~3);
+
+    if (len > 0)
+        memcpy (block + size + 4, value, len);
+
+    return size + 4 + ((len + 3) & ~3);
+}
+
+/**
+ * Fills the type and length fields of the given \a block and writes it
+ * to the capture file
+ */
+static void write_block (uint8_t* block, int size, const uint32_t type)
+{
+    uint32_t total = (uint32_t) size + 4;
+    memcpy (block, &type, 4);
+    memcpy (block + 4, &total, 4);
+    memcpy (block + size, &total, 4);
+    fwrite (block, 1, total, file);
+}
+
+/**
+ * Writes the section header block and one interface description block for
+ * each communication channel
+ */
+static void write_file_header (void)
+{
+    int i;
+    int size;
+    uint8_t block [256];
+    uint32_t magic = BYTE_ORDER_MAGIC;
+    uint16_t version [2] = {1, 0};
+    int64_t section_length = -1;
+    const char* application = "LibDS";
+
+    /* Section header block */
+    size = 8;
+    memcpy (block + size, &magic, 4);
+    memcpy (block + size + 4, version, 4);
+    memcpy (block + size + 8, &section_length, 8);
+    size += 16;
+    size = put_option (block, size, OPT_SHB_USERAPPL, application, strlen (application));
+    size = put_option (block, size, OPT_ENDOFOPT, NULL, 0);
+    write_block (block, size, SHB_TYPE);
+
+    /* Interface description blocks (one per channel) */
+    for (i = 0; i < CHANNEL_COUNT; ++i) {
+        uint16_t linktype = LINKTYPE_RAW;
+        uint16_t reserved = 0;
+        uint32_t snaplen = HEADERS_SIZE + MAX_DATAGRAM;
+        uint8_t tsresol = 9;
+
+        size = 8;
+        memcpy (block + size, &linktype, 2);
+        memcpy (block + size + 2, &reserved, 2);
+        memcpy (block + size + 4, &snaplen, 4);
+        size += 8;
+        size = put_option (block, size, OPT_IF_NAME, interface_names [i],
+                           strlen (interface_names [i]));
+        size = put_option (block, size, OPT_IF_TSRESOL, &tsresol, 1);
+        size = put_option (block, size, OPT_ENDOFOPT, NULL, 0);
+        write_block (block, size, IDB_TYPE);
+    }
+}
+
+/**
+ * Writes the datagram stored in the given \a slot as an enhanced packet block
+ */
+static void write_packet (const Slot* slot)
+{
+    int size;
+    uint32_t fields [5];
+    uint32_t flags = slot->outgoing ? EPB_OUTBOUND : EPB_INBOUND;
+    uint8_t block [64 + HEADERS_SIZE + MAX_DATAGRAM];
+    uint32_t captured = HEADERS_SIZE + slot->len;
+    uint64_t timestamp = slot->timestamp + epoch_offset;
+
+    /* Packet header */
+    fields [0] = slot->interface;
+    fields [1] = (uint32_t) (timestamp >> 32);
+    fields [2] = (uint32_t) (timestamp);
+    fields [3] = captured;
+    fields [4] = captured;
+    memcpy (block + 8, fields, sizeof (fields));
+    size = 8 + sizeof (fields);
+
+    /* Packet data, padded to 32 bits */
+    write_headers (block + size, slot);
+    memcpy (block + size + HEADERS_SIZE, slot->data, slot->len);
+    memset (block + size + captured, 0, ((captured + 3) & ~3) - captured);
+    size += (captured + 3) & ~3;
+
+    /* Options */
+    size = put_option (block, size, OPT_EPB_FLAGS, &flags, 4);
+    size = put_option (block, size, OPT_ENDOFOPT, NULL, 0);
+    write_block (block, size, EPB_TYPE);
+}
+
+/**
+ * Writes every datagram queued in the ring and returns the number of
+ * written datagrams
+ */
+static int drain_ring (void)
+{
+    int count = 0;
+
+    while (1) {
+        Slot* slot = &ring [head & RING_MASK];
+        if (DS_AtomicLoadAcquire64 (&slot->sequence) != head + 1)
+            break;
+
+        write_packet (slot);
+        DS_AtomicStoreRelease64 (&slot->sequence, head + RING_SIZE);
+
+        ++head;
+        ++count;
+    }
+
+    return count;
+}
+
+/**
+ * Writes the queued datagrams to the capture file until the capture is
+ * stopped. Disk operations only happen in this thread, so that a slow disk
+ * never delays the protocol event loop.
+ */
+static void* run_writer (void* ptr)
+{
+    (void) ptr;
+    uint64_t last_flush = DS_GetTimeNs();
+
+    while (DS_AtomicLoadAcquire64 (&capturing)) {
+        if (drain_ring() == 0)
+            Timers_SystemSleep (10);
+
+        if (DS_GetTimeNs() - last_flush > FLUSH_INTERVAL) {
+            fflush (file);
+            last_flush = DS_GetTimeNs();
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Stops the capture (if any) and releases the memory used by this module
+ */
+void Capture_Close (void)
+{
+    DS_CaptureStop();
+}
+
+/**
+ * Queues the given \a data, which was sent (if \a outgoing is set to 1) or
+ * received by the given \a socket of the given \a channel, to be written in
+ * the capture file. This function does nothing if no capture is running.
+ *
+ * The packet is recorded with the given \a time (e.g. a kernel timestamp),
+ * or with the current time if \a time is 0.
+ */
+void Capture_Packet (const DS_Channel channel,
+                     const DS_Socket* socket,
+                     const DS_String* data,
+                     const int outgoing,
+                     const uint64_t time)
+{
+    /* Capture is disabled */
+    if (!DS_AtomicLoad64 (&capturing))
+        return;
+
+    /* Check arguments */
+    assert (socket);
+    assert (data);
+    if (DS_StrEmpty (data))
+        return;
+
+    /* Register this thread as a producer, so that the ring is not freed */
+    DS_AtomicAdd64 (&producers, 1);
+    DS_AtomicFence();
+    if (!DS_AtomicLoadAcquire64 (&capturing)) {
+        DS_AtomicAdd64 (&producers, (uint64_t) -1);
+        return;
+    }
+
+    /* Reserve a slot in the ring */
+    Slot* slot = NULL;
+    uint64_t pos = DS_AtomicLoad64 (&tail);
+    while (1) {
+        slot = &ring [pos & RING_MASK];
+        int64_t diff = (int64_t) (DS_AtomicLoadAcquire64 (&slot->sequence) - pos);
+
+        if (diff == 0 && DS_AtomicCompareExchange64 (&tail, pos, pos + 1))
+            break;
+
+        else if (diff < 0) {
+            slot = NULL;
+            break;
+        }
+
+        pos = DS_AtomicLoad64 (&tail);
+    }
+
+    /* Fill the slot and hand it to the writer thread */
+    if (slot) {
+        slot->timestamp = time > 0 ? time : DS_GetTimeNs();
+        slot->interface = (uint32_t) channel;
+        slot->outgoing = outgoing ? 1 : 0;
+        slot->local_address = 0;
+        slot->remote_address = parse_ipv4 (socket->address);
+        slot->local_port = (uint16_t) socket->in_port;
+        slot->remote_port = (uint16_t) socket->out_port;
+        slot->len = DS_Min ((int) data->len, MAX_DATAGRAM);
+        memcpy (slot->data, data->buf, slot->len);
+
+        DS_AtomicStoreRelease64 (&slot->sequence, pos + 1);
+    }
+
+    /* The ring is full */
+    else
+        DS_AtomicAdd64 (&dropped, 1);
+
+    DS_AtomicAdd64 (&producers, (uint64_t) -1);
+}
+
+/**
+ * Stops the current capture, writes the pending datagrams and closes the
+ * capture file
+ */
+void DS_CaptureStop (void)
+{
+    pthread_mutex_lock (&mutex);
+
+    if (writer_running) {
+        /* Stop accepting datagrams and wait for current producers */
+        DS_AtomicStoreRelease64 (&capturing, 0);
+        DS_AtomicFence();
+        while (DS_AtomicLoadAcquire64 (&producers) > 0)
+            Timers_SystemSleep (1);
+
+        /* Stop the writer and write the remaining datagrams */
+        pthread_join (writer, NULL);
+        drain_ring();
+
+        /* Close the file */
+        fclose (file);
+        file = NULL;
+        writer_running = 0;
+    }
+
+    DS_FREE (ring);
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Returns \c 1 if a capture is running, \c 0 if not
+ */
+int DS_CaptureRunning (void)
+{
+    return DS_AtomicLoad64 (&capturing) != 0;
+}
+
+/**
+ * Returns the number of datagrams that could not be captured because the
+ * writer thread could not keep up with the protocol
+ */
+uint64_t DS_CaptureDropped (void)
+{
+    return DS_AtomicLoad64 (&dropped);
+}
+
+/**
+ * Starts writing every datagram sent or received through the FMS, radio,
+ * robot and NetConsole sockets to a pcapng file at the given \a path.
+ *
+ * Each channel is written as a separate interface with nanosecond
+ * timestamps. The datagrams are wrapped in synthesized IPv4/UDP headers
+ * (using the socket ports), so that they can be inspected with Wireshark.
+ * If a capture is already running, it is stopped first.
+ *
+ * \returns \c 1 on success, \c 0 on failure
+ */
+int DS_CaptureStart (const char* path)
+{
+    int i;
+    assert (path);
+
+    /* Stop current capture */
+    DS_CaptureStop();
+
+    pthread_mutex_lock (&mutex);
+
+    /* Open the file and allocate the ring */
+    file = fopen (path, "wb");
+    ring = (Slot*) calloc (RING_SIZE, sizeof (Slot));
+    if (!file || !ring) {
+        if (file)
+            fclose (file);
+
+        file = NULL;
+        DS_FREE (ring);
+        pthread_mutex_unlock (&mutex);
+        return 0;
+    }
+
+    /* Initialize the ring */
+    head = 0;
+    DS_AtomicStore64 (&tail, 0);
+    DS_AtomicStore64 (&dropped, 0);
+    for (i = 0; i < RING_SIZE; ++i)
+        DS_AtomicStore64 (&ring [i].sequence, (uint64_t) i);
+
+    /* Write file header */
+    epoch_offset = get_epoch_ns() - DS_GetTimeNs();
+    write_file_header();
+
+    /* Start the writer thread */
+    DS_AtomicStoreRelease64 (&capturing, 1);
+    writer_running = (pthread_create (&writer, NULL, &run_writer, NULL) == 0);
+    if (!writer_running) {
+        DS_AtomicStoreRelease64 (&capturing, 0);
+        fclose (file);
+        file = NULL;
+        DS_FREE (ring);
+    }
+
+    pthread_mutex_unlock (&mutex);
+    return writer_running;
+}
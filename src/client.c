@@ -25,7 +25,11 @@
 #include "DS_Client.h"
 #include "DS_Config.h"
 #include "DS_String.h"
+#include "DS_Capture.h"
+#include "DS_Context.h"
 #include "DS_Protocol.h"
+#include "DS_Discovery.h"
+#include "DS_Statistics.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -34,20 +38,33 @@
 /*
  * Set the strings
  */
-static DS_String status_string;
-static DS_String custom_fms_address;
-static DS_String custom_radio_address;
-static DS_String custom_robot_address;
+typedef struct {
+    DS_String status_string;
+    DS_String custom_fms_address;
+    DS_String custom_radio_address;
+    DS_String custom_robot_address;
+} State;
+
+/**
+ * Returns the strings of the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), NULL, NULL);
+}
 
 /**
  * Allocates memory for the members of the client module
  */
 void Client_Init (void)
 {
-    status_string = DS_StrNew ("Loading...");
-    custom_fms_address = DS_StrNew (DS_FallBackAddress);
-    custom_radio_address = DS_StrNew (DS_FallBackAddress);
-    custom_robot_address = DS_StrNew (DS_FallBackAddress);
+    State* s = state();
+
+    s->status_string = DS_StrNew ("Loading...");
+    s->custom_fms_address = DS_StrNew (DS_FallBackAddress);
+    s->custom_radio_address = DS_StrNew (DS_FallBackAddress);
+    s->custom_robot_address = DS_StrNew (DS_FallBackAddress);
 
     DS_SetGameData ("");
 }
@@ -57,10 +74,12 @@ void Client_Init (void)
  */
 void Client_Close (void)
 {
-    DS_StrRmBuf (&status_string);
-    DS_StrRmBuf (&custom_fms_address);
-    DS_StrRmBuf (&custom_radio_address);
-    DS_StrRmBuf (&custom_robot_address);
+    State* s = state();
+
+    DS_StrRmBuf (&s->status_string);
+    DS_StrRmBuf (&s->custom_fms_address);
+    DS_StrRmBuf (&s->custom_radio_address);
+    DS_StrRmBuf (&s->custom_robot_address);
 }
 
 /**
@@ -70,7 +89,9 @@ void Client_Close (void)
  */
 char* DS_GetCustomFMSAddress (void)
 {
-    return DS_StrToChar (&custom_fms_address);
+    State* s = state();
+
+    return DS_StrToChar (&s->custom_fms_address);
 }
 
 /**
@@ -80,7 +101,9 @@ char* DS_GetCustomFMSAddress (void)
  */
 char* DS_GetCustomRadioAddress (void)
 {
-    return DS_StrToChar (&custom_radio_address);
+    State* s = state();
+
+    return DS_StrToChar (&s->custom_radio_address);
 }
 
 /**
@@ -90,7 +113,9 @@ char* DS_GetCustomRadioAddress (void)
  */
 char* DS_GetCustomRobotAddress (void)
 {
-    return DS_StrToChar (&custom_robot_address);
+    State* s = state();
+
+    return DS_StrToChar (&s->custom_robot_address);
 }
 
 /**
@@ -149,7 +174,9 @@ char* DS_GetDefaultRobotAddress (void)
  */
 char* DS_GetAppliedFMSAddress (void)
 {
-    if (DS_StrEmpty (&custom_fms_address))
+    State* s = state();
+
+    if (DS_StrEmpty (&s->custom_fms_address))
         return DS_GetDefaultFMSAddress();
     else
         return DS_GetCustomFMSAddress();
@@ -163,7 +190,9 @@ char* DS_GetAppliedFMSAddress (void)
  */
 char* DS_GetAppliedRadioAddress (void)
 {
-    if (DS_StrEmpty (&custom_radio_address))
+    State* s = state();
+
+    if (DS_StrEmpty (&s->custom_radio_address))
         return DS_GetDefaultRadioAddress();
     else
         return DS_GetCustomRadioAddress();
@@ -173,12 +202,21 @@ char* DS_GetAppliedRadioAddress (void)
  * Returns the address used to communicate with the robot.
  * If the user-set address is not empty, then this function will return the
  * user-set address. Otherwise, this function will return the address
- * specified  by the currently loaded protocol.
+ * selected by the robot discovery (if enabled) or the address specified by
+ * the currently loaded protocol.
  */
 char* DS_GetAppliedRobotAddress (void)
 {
-    if (DS_StrEmpty (&custom_robot_address))
+    State* s = state();
+
+    if (DS_StrEmpty (&s->custom_robot_address)) {
+        char* discovered = Discovery_GetAddress();
+        if (discovered)
+            return discovered;
+
         return DS_GetDefaultRobotAddress();
+    }
+
     else
         return DS_GetCustomRobotAddress();
 }
@@ -466,17 +504,19 @@ void DS_SetControlMode (const DS_ControlMode mode)
  */
 void DS_SetCustomFMSAddress (const char* address)
 {
+    State* s = state();
+
     assert (address);
 
     if (strlen (address) > 0) {
-        DS_StrRmBuf (&custom_fms_address);
-        custom_fms_address = DS_StrNew (address);
+        DS_StrRmBuf (&s->custom_fms_address);
+        s->custom_fms_address = DS_StrNew (address);
         CFG_ReconfigureAddresses (RECONFIGURE_FMS);
     }
 
     else {
-        DS_StrRmBuf (&custom_fms_address);
-        custom_fms_address = DS_StrNewLen (0);
+        DS_StrRmBuf (&s->custom_fms_address);
+        s->custom_fms_address = DS_StrNewLen (0);
         CFG_ReconfigureAddresses (RECONFIGURE_FMS);
     }
 }
@@ -486,17 +526,19 @@ void DS_SetCustomFMSAddress (const char* address)
  */
 void DS_SetCustomRadioAddress (const char* address)
 {
+    State* s = state();
+
     assert (address);
 
     if (strlen (address) > 0) {
-        DS_StrRmBuf (&custom_radio_address);
-        custom_radio_address = DS_StrNew (address);
+        DS_StrRmBuf (&s->custom_radio_address);
+        s->custom_radio_address = DS_StrNew (address);
         CFG_ReconfigureAddresses (RECONFIGURE_RADIO);
     }
 
     else {
-        DS_StrRmBuf (&custom_radio_address);
-        custom_radio_address = DS_StrNewLen (0);
+        DS_StrRmBuf (&s->custom_radio_address);
+        s->custom_radio_address = DS_StrNewLen (0);
         CFG_ReconfigureAddresses (RECONFIGURE_RADIO);
     }
 }
@@ -506,17 +548,19 @@ void DS_SetCustomRadioAddress (const char* address)
  */
 void DS_SetCustomRobotAddress (const char* address)
 {
+    State* s = state();
+
     assert (address);
 
     if (strlen (address) > 0) {
-        DS_StrRmBuf (&custom_robot_address);
-        custom_robot_address = DS_StrNew (address);
+        DS_StrRmBuf (&s->custom_robot_address);
+        s->custom_robot_address = DS_StrNew (address);
         CFG_ReconfigureAddresses (RECONFIGURE_ROBOT);
     }
 
     else {
-        DS_StrRmBuf (&custom_robot_address);
-        custom_robot_address = DS_StrNewLen (0);
+        DS_StrRmBuf (&s->custom_robot_address);
+        s->custom_robot_address = DS_StrNewLen (0);
         CFG_ReconfigureAddresses (RECONFIGURE_ROBOT);
     }
 }
@@ -528,8 +572,14 @@ void DS_SendNetConsoleMessage (const char* message)
 {
     assert (message);
 
-    if (DS_CurrentProtocol()) {
+    /* The message is dropped if NetConsole is not connected */
+    DS_Protocol* protocol = DS_CurrentProtocol();
+    if (protocol && DS_SocketCanSend (&protocol->netconsole_socket)) {
         DS_String data = DS_StrNew (message);
-        DS_SocketSend (&DS_CurrentProtocol()->netconsole_socket, &data);
+        int bytes = DS_SocketSend (&protocol->netconsole_socket, &data);
+        Statistics_PacketSent (DS_CHANNEL_NETCONSOLE, bytes);
+        Capture_Packet (DS_CHANNEL_NETCONSOLE, &protocol->netconsole_socket,
+                        &data, 1, DS_SocketSendTime (&protocol->netconsole_socket));
+        DS_StrRmBuf (&data);
     }
 }
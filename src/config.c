@@ -25,6 +25,7 @@
 #include "DS_Client.h"
 #include "DS_Events.h"
 #include "DS_Config.h"
+#include "DS_Context.h"
 #include "DS_Protocol.h"
 
 #include <math.h>
@@ -34,22 +35,66 @@
 /*
  * These variables hold the state(s) of the LibDS and its modules
  */
-static int team = 0;
-static int cpu_usage = -1;
-static int ram_usage = -1;
-static int disk_usage = -1;
-static int robot_code = -1;
-static DS_String game_data;
-static int robot_enabled = -1;
-static int can_utilization = -1;
-static float robot_voltage = -1;
-static int emergency_stopped = -1;
-static int fms_communications = -1;
-static int radio_communications = -1;
-static int robot_communications = -1;
-static DS_Position robot_position = DS_POSITION_1;
-static DS_Alliance robot_alliance = DS_ALLIANCE_RED;
-static DS_ControlMode control_mode = DS_CONTROL_TELEOPERATED;
+typedef struct {
+    int team;
+    int cpu_usage;
+    int ram_usage;
+    int disk_usage;
+    int robot_code;
+    DS_String game_data;
+    int robot_enabled;
+    int can_utilization;
+    float robot_voltage;
+    int emergency_stopped;
+    int fms_communications;
+    int radio_communications;
+    int robot_communications;
+    DS_Position robot_position;
+    DS_Alliance robot_alliance;
+    DS_ControlMode control_mode;
+} State;
+
+/**
+ * Assigns the initial values of the robot status of a new context
+ */
+static void init_state (void* ptr)
+{
+    State* s = (State*) ptr;
+
+    s->team = 0;
+    s->cpu_usage = -1;
+    s->ram_usage = -1;
+    s->disk_usage = -1;
+    s->robot_code = -1;
+    s->robot_enabled = -1;
+    s->can_utilization = -1;
+    s->robot_voltage = -1;
+    s->emergency_stopped = -1;
+    s->fms_communications = -1;
+    s->radio_communications = -1;
+    s->robot_communications = -1;
+    s->robot_position = DS_POSITION_1;
+    s->robot_alliance = DS_ALLIANCE_RED;
+    s->control_mode = DS_CONTROL_TELEOPERATED;
+}
+
+/**
+ * Releases the game data of a destroyed context
+ */
+static void release_state (void* ptr)
+{
+    DS_StrRmBuf (&((State*) ptr)->game_data);
+}
+
+/**
+ * Returns the robot status of the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State),
+                                     &init_state, &release_state);
+}
 
 /**
  * Ensures that the given \a input number is either \c 0 or \c 1
@@ -171,7 +216,9 @@ void CFG_ReconfigureAddresses (const int flags)
  */
 int CFG_GetTeamNumber (void)
 {
-    return DS_Max (team, 0);
+    State* s = state();
+
+    return DS_Max (s->team, 0);
 }
 
 /**
@@ -179,7 +226,9 @@ int CFG_GetTeamNumber (void)
  */
 int CFG_GetRobotCode (void)
 {
-    return robot_code == 1;
+    State* s = state();
+
+    return s->robot_code == 1;
 }
 
 /**
@@ -187,7 +236,9 @@ int CFG_GetRobotCode (void)
  */
 int CFG_GetRobotEnabled (void)
 {
-    return robot_enabled == 1;
+    State* s = state();
+
+    return s->robot_enabled == 1;
 }
 
 /**
@@ -195,7 +246,9 @@ int CFG_GetRobotEnabled (void)
  */
 int CFG_GetRobotCPUUsage (void)
 {
-    return DS_Max (cpu_usage, 0);
+    State* s = state();
+
+    return DS_Max (s->cpu_usage, 0);
 }
 
 /**
@@ -203,7 +256,9 @@ int CFG_GetRobotCPUUsage (void)
  */
 int CFG_GetRobotRAMUsage (void)
 {
-    return DS_Max (ram_usage, 0);
+    State* s = state();
+
+    return DS_Max (s->ram_usage, 0);
 }
 
 /**
@@ -211,7 +266,9 @@ int CFG_GetRobotRAMUsage (void)
  */
 int CFG_GetCANUtilization (void)
 {
-    return DS_Max (can_utilization, 0);
+    State* s = state();
+
+    return DS_Max (s->can_utilization, 0);
 }
 
 /**
@@ -219,7 +276,9 @@ int CFG_GetCANUtilization (void)
  */
 int CFG_GetRobotDiskUsage (void)
 {
-    return DS_Max (disk_usage, 0);
+    State* s = state();
+
+    return DS_Max (s->disk_usage, 0);
 }
 
 /**
@@ -227,7 +286,9 @@ int CFG_GetRobotDiskUsage (void)
  */
 float CFG_GetRobotVoltage (void)
 {
-    return DS_Max (robot_voltage, 0);
+    State* s = state();
+
+    return DS_Max (s->robot_voltage, 0);
 }
 
 /**
@@ -235,7 +296,9 @@ float CFG_GetRobotVoltage (void)
  */
 DS_String* CFG_GetGameData (void)
 {
-    return &game_data;
+    State* s = state();
+
+    return &s->game_data;
 }
 
 /**
@@ -245,7 +308,9 @@ DS_String* CFG_GetGameData (void)
  */
 DS_Alliance CFG_GetAlliance (void)
 {
-    return robot_alliance;
+    State* s = state();
+
+    return s->robot_alliance;
 }
 
 /**
@@ -256,7 +321,9 @@ DS_Alliance CFG_GetAlliance (void)
  */
 DS_Position CFG_GetPosition (void)
 {
-    return robot_position;
+    State* s = state();
+
+    return s->robot_position;
 }
 
 /**
@@ -264,7 +331,9 @@ DS_Position CFG_GetPosition (void)
  */
 int CFG_GetEmergencyStopped (void)
 {
-    return emergency_stopped == 1;
+    State* s = state();
+
+    return s->emergency_stopped == 1;
 }
 
 /**
@@ -273,7 +342,9 @@ int CFG_GetEmergencyStopped (void)
  */
 int CFG_GetFMSCommunications (void)
 {
-    return fms_communications == 1;
+    State* s = state();
+
+    return s->fms_communications == 1;
 }
 
 /**
@@ -282,7 +353,9 @@ int CFG_GetFMSCommunications (void)
  */
 int CFG_GetRadioCommunications (void)
 {
-    return radio_communications == 1;
+    State* s = state();
+
+    return s->radio_communications == 1;
 }
 
 /**
@@ -291,7 +364,9 @@ int CFG_GetRadioCommunications (void)
  */
 int CFG_GetRobotCommunications (void)
 {
-    return robot_communications == 1;
+    State* s = state();
+
+    return s->robot_communications == 1;
 }
 
 /**
@@ -302,7 +377,31 @@ int CFG_GetRobotCommunications (void)
  */
 DS_ControlMode CFG_GetControlMode (void)
 {
-    return control_mode;
+    State* s = state();
+
+    return s->control_mode;
+}
+
+/**
+ * Copies the robot status used to generate packets to the given \a snapshot,
+ * which is cheaper than calling each getter when building a packet
+ */
+void CFG_GetSnapshot (DS_ConfigSnapshot* snapshot)
+{
+    assert (snapshot);
+
+    State* s = state();
+
+    snapshot->team = DS_Max (s->team, 0);
+    snapshot->robot_enabled = s->robot_enabled == 1;
+    snapshot->robot_voltage = DS_Max (s->robot_voltage, 0);
+    snapshot->emergency_stopped = s->emergency_stopped == 1;
+    snapshot->fms_communications = s->fms_communications == 1;
+    snapshot->radio_communications = s->radio_communications == 1;
+    snapshot->robot_communications = s->robot_communications == 1;
+    snapshot->robot_position = s->robot_position;
+    snapshot->robot_alliance = s->robot_alliance;
+    snapshot->control_mode = s->control_mode;
 }
 
 /**
@@ -310,8 +409,10 @@ DS_ControlMode CFG_GetControlMode (void)
  */
 void CFG_SetRobotCode (const int code)
 {
-    if (robot_code != to_boolean (code)) {
-        robot_code = to_boolean (code);
+    State* s = state();
+
+    if (s->robot_code != to_boolean (code)) {
+        s->robot_code = to_boolean (code);
         create_robot_event (DS_ROBOT_CODE_CHANGED);
         create_robot_event (DS_STATUS_STRING_CHANGED);
     }
@@ -322,12 +423,14 @@ void CFG_SetRobotCode (const int code)
  */
 void CFG_SetGameData (const char* data)
 {
+    State* s = state();
+
     /* Check arguments */
     assert (data);
 
     /* Update game data */
-    DS_StrRmBuf (&game_data);
-    game_data = DS_StrNew (data);
+    DS_StrRmBuf (&s->game_data);
+    s->game_data = DS_StrNew (data);
 }
 
 /**
@@ -335,8 +438,10 @@ void CFG_SetGameData (const char* data)
  */
 void CFG_SetTeamNumber (const int number)
 {
-    if (team != number) {
-        team = number;
+    State* s = state();
+
+    if (s->team != number) {
+        s->team = number;
         CFG_ReconfigureAddresses (RECONFIGURE_ALL);
     }
 }
@@ -346,8 +451,10 @@ void CFG_SetTeamNumber (const int number)
  */
 void CFG_SetRobotEnabled (const int enabled)
 {
-    if (robot_enabled != to_boolean (enabled)) {
-        robot_enabled = to_boolean (enabled) && !CFG_GetEmergencyStopped();
+    State* s = state();
+
+    if (s->robot_enabled != to_boolean (enabled)) {
+        s->robot_enabled = to_boolean (enabled) && !CFG_GetEmergencyStopped();
         create_robot_event (DS_ROBOT_ENABLED_CHANGED);
         create_robot_event (DS_STATUS_STRING_CHANGED);
     }
@@ -359,8 +466,10 @@ void CFG_SetRobotEnabled (const int enabled)
  */
 void CFG_SetRobotCPUUsage (const int percent)
 {
-    if (cpu_usage != percent) {
-        cpu_usage = respect_range (percent, 0, 100);
+    State* s = state();
+
+    if (s->cpu_usage != percent) {
+        s->cpu_usage = respect_range (percent, 0, 100);
         create_robot_event (DS_ROBOT_CPU_INFO_CHANGED);
     }
 }
@@ -371,8 +480,10 @@ void CFG_SetRobotCPUUsage (const int percent)
  */
 void CFG_SetRobotRAMUsage (const int percent)
 {
-    if (ram_usage != percent) {
-        ram_usage = respect_range (percent, 0, 100);
+    State* s = state();
+
+    if (s->ram_usage != percent) {
+        s->ram_usage = respect_range (percent, 0, 100);
         create_robot_event (DS_ROBOT_RAM_INFO_CHANGED);
     }
 }
@@ -383,8 +494,10 @@ void CFG_SetRobotRAMUsage (const int percent)
  */
 void CFG_SetRobotDiskUsage (const int percent)
 {
-    if (disk_usage != percent) {
-        disk_usage = respect_range (percent, 0, 100);
+    State* s = state();
+
+    if (s->disk_usage != percent) {
+        s->disk_usage = respect_range (percent, 0, 100);
         create_robot_event (DS_ROBOT_DISK_INFO_CHANGED);
     }
 }
@@ -394,8 +507,10 @@ void CFG_SetRobotDiskUsage (const int percent)
  */
 void CFG_SetRobotVoltage (const float voltage)
 {
-    if (robot_voltage != voltage) {
-        robot_voltage = roundf (voltage * 100) / 100;
+    State* s = state();
+
+    if (s->robot_voltage != voltage) {
+        s->robot_voltage = roundf (voltage * 100) / 100;
         create_robot_event (DS_ROBOT_VOLTAGE_CHANGED);
     }
 }
@@ -405,8 +520,10 @@ void CFG_SetRobotVoltage (const float voltage)
  */
 void CFG_SetEmergencyStopped (const int stopped)
 {
-    if (emergency_stopped != to_boolean (stopped)) {
-        emergency_stopped = to_boolean (stopped);
+    State* s = state();
+
+    if (s->emergency_stopped != to_boolean (stopped)) {
+        s->emergency_stopped = to_boolean (stopped);
         create_robot_event (DS_ROBOT_ESTOP_CHANGED);
         create_robot_event (DS_STATUS_STRING_CHANGED);
     }
@@ -417,8 +534,10 @@ void CFG_SetEmergencyStopped (const int stopped)
  */
 void CFG_SetAlliance (const DS_Alliance alliance)
 {
-    if (robot_alliance != alliance) {
-        robot_alliance = alliance;
+    State* s = state();
+
+    if (s->robot_alliance != alliance) {
+        s->robot_alliance = alliance;
         create_robot_event (DS_ROBOT_STATION_CHANGED);
     }
 }
@@ -428,8 +547,10 @@ void CFG_SetAlliance (const DS_Alliance alliance)
  */
 void CFG_SetPosition (const DS_Position position)
 {
-    if (robot_position != position) {
-        robot_position = position;
+    State* s = state();
+
+    if (s->robot_position != position) {
+        s->robot_position = position;
         create_robot_event (DS_ROBOT_STATION_CHANGED);
     }
 }
@@ -439,8 +560,10 @@ void CFG_SetPosition (const DS_Position position)
  */
 void CFG_SetCANUtilization (const int utilization)
 {
-    if (can_utilization != utilization) {
-        can_utilization = utilization;
+    State* s = state();
+
+    if (s->can_utilization != utilization) {
+        s->can_utilization = utilization;
         create_robot_event (DS_ROBOT_CAN_UTIL_CHANGED);
     }
 }
@@ -450,8 +573,10 @@ void CFG_SetCANUtilization (const int utilization)
  */
 void CFG_SetControlMode (const DS_ControlMode mode)
 {
-    if (control_mode != mode) {
-        control_mode = mode;
+    State* s = state();
+
+    if (s->control_mode != mode) {
+        s->control_mode = mode;
         create_robot_event (DS_ROBOT_MODE_CHANGED);
         create_robot_event (DS_STATUS_STRING_CHANGED);
     }
@@ -462,12 +587,14 @@ void CFG_SetControlMode (const DS_ControlMode mode)
  */
 void CFG_SetFMSCommunications (const int communications)
 {
-    if (fms_communications != to_boolean (communications)) {
-        fms_communications = to_boolean (communications);
+    State* s = state();
+
+    if (s->fms_communications != to_boolean (communications)) {
+        s->fms_communications = to_boolean (communications);
 
         DS_Event event;
         event.fms.type = DS_FMS_COMMS_CHANGED;
-        event.fms.connected = fms_communications;
+        event.fms.connected = s->fms_communications;
         DS_AddEvent (&event);
 
         DS_ResetFMSPackets();
@@ -479,12 +606,14 @@ void CFG_SetFMSCommunications (const int communications)
  */
 void CFG_SetRadioCommunications (const int communications)
 {
-    if (radio_communications != to_boolean (communications)) {
-        radio_communications = to_boolean (communications);
+    State* s = state();
+
+    if (s->radio_communications != to_boolean (communications)) {
+        s->radio_communications = to_boolean (communications);
 
         DS_Event event;
         event.radio.type = DS_RADIO_COMMS_CHANGED;
-        event.radio.connected = fms_communications;
+        event.radio.connected = s->fms_communications;
         DS_AddEvent (&event);
 
         DS_ResetRadioPackets();
@@ -496,8 +625,10 @@ void CFG_SetRadioCommunications (const int communications)
  */
 void CFG_SetRobotCommunications (const int communications)
 {
-    if (robot_communications != to_boolean (communications)) {
-        robot_communications = to_boolean (communications);
+    State* s = state();
+
+    if (s->robot_communications != to_boolean (communications)) {
+        s->robot_communications = to_boolean (communications);
         create_robot_event (DS_ROBOT_COMMS_CHANGED);
         create_robot_event (DS_STATUS_STRING_CHANGED);
 
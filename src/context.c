@@ -0,0 +1,386 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "LibDS.h"
+#include "DS_Atomic.h"
+#include "DS_Context.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define MAX_STATES 64 /* Maximum number of modules that keep a state */
+#define STATE_ALIGN 64 /* States may hold cache-line aligned members */
+
+#if defined _MSC_VER
+    #define DS_THREAD_LOCAL __declspec (thread)
+#else
+    #define DS_THREAD_LOCAL __thread
+#endif
+
+/**
+ * Holds the state of a module in a context, the state pointer is published
+ * with release semantics so that it can be read without locking
+ */
+typedef struct {
+    volatile uint64_t state;
+    void* memory;
+    void (*release) (void* state);
+} ModuleState;
+
+/**
+ * Holds the states of the modules (indexed by the slot of their key), the
+ * number of threads that run on behalf of the context, and its place in
+ * the list of contexts
+ */
+struct _DS_Context {
+    ModuleState states [MAX_STATES];
+    volatile uint64_t threads;
+    pthread_mutex_t mutex;
+    uint64_t id;
+    DS_Context* next;
+};
+
+/**
+ * Holds the context of a new thread and the function that it runs
+ */
+typedef struct {
+    DS_Context* context;
+    void* (*function) (void*);
+    void* arg;
+} ThreadStart;
+
+/*
+ * The default context, used by threads that did not select a context
+ */
+static DS_Context default_context = {
+    { { 0, NULL, NULL } }, 0, PTHREAD_MUTEX_INITIALIZER, 0, NULL
+};
+
+/*
+ * Lists the contexts of the process (starting with the default context),
+ * and the identifier given to the next context
+ */
+static uint64_t next_id = 1;
+static pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Holds the current context of each thread (NULL for the default context)
+ */
+static DS_THREAD_LOCAL DS_Context* current = NULL;
+
+/*
+ * Number of slots given to the module keys, and the lock that assigns them
+ */
+static uint64_t slot_count = 0;
+static pthread_mutex_t slot_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the slot of the given \a key (plus one), assigning the next free
+ * slot if the key has none. Aborts if there are more modules than slots,
+ * since the states of the modules could not be kept apart.
+ */
+static uint64_t assign_slot (DS_ContextKey* key)
+{
+    pthread_mutex_lock (&slot_mutex);
+
+    uint64_t slot = DS_AtomicLoad64 (key);
+    if (slot == 0) {
+        if (slot_count >= MAX_STATES) {
+            fprintf (stderr, "DS_ContextState: more than %d module states\n",
+                     MAX_STATES);
+            abort();
+        }
+
+        slot = ++slot_count;
+        DS_AtomicStoreRelease64 (key, slot);
+    }
+
+    pthread_mutex_unlock (&slot_mutex);
+    return slot;
+}
+
+/**
+ * Allocates the state of the given \a slot in the \a context (aligned to a
+ * cache line), unless another thread did it in the meantime
+ */
+static void* create_state (DS_Context* context, const uint64_t slot,
+                           const size_t size,
+                           void (*init) (void* state),
+                           void (*release) (void* state))
+{
+    ModuleState* module = &context->states [slot - 1];
+
+    pthread_mutex_lock (&context->mutex);
+    void* state = (void*) (uintptr_t) module->state;
+
+    if (!state) {
+        void* memory = calloc (1, size + STATE_ALIGN);
+        if (!memory) {
+            fprintf (stderr, "DS_ContextState: cannot allocate state\n");
+            abort();
+        }
+
+        uintptr_t address = (uintptr_t) memory + STATE_ALIGN - 1;
+        state = (void*) (address - address % STATE_ALIGN);
+
+        if (init)
+            init (state);
+
+        module->memory = memory;
+        module->release = release;
+        DS_AtomicStoreRelease64 (&module->state, (uint64_t) (uintptr_t) state);
+    }
+
+    pthread_mutex_unlock (&context->mutex);
+    return state;
+}
+
+/**
+ * Makes the new thread use the context of the thread that created it,
+ * and runs the thread function
+ */
+static void* run_thread (void* data)
+{
+    assert (data);
+    ThreadStart start = * (ThreadStart*) data;
+    DS_FREE (data);
+
+    current = start.context;
+    void* result = start.function (start.arg);
+
+    DS_AtomicAdd64 (&start.context->threads, (uint64_t) -1);
+    return result;
+}
+
+/**
+ * Starts a thread that runs the given \a function with the given \a arg in
+ * the current context. The context is not destroyed while the thread runs.
+ *
+ * \returns 0 on success, an error number on failure (as \c pthread_create)
+ */
+int Context_CreateThread (pthread_t* thread, void* (*function) (void*),
+                          void* arg)
+{
+    assert (thread);
+    assert (function);
+
+    ThreadStart* start = (ThreadStart*) calloc (1, sizeof (ThreadStart));
+    if (!start)
+        return -1;
+
+    start->context = DS_CurrentContext();
+    start->function = function;
+    start->arg = arg;
+
+    DS_AtomicAdd64 (&start->context->threads, 1);
+    int error = pthread_create (thread, NULL, &run_thread, (void*) start);
+
+    if (error) {
+        DS_AtomicAdd64 (&start->context->threads, (uint64_t) -1);
+        DS_FREE (start);
+    }
+
+    return error;
+}
+
+/**
+ * Makes each context the current context of the calling thread and calls
+ * the given \a function with the given \a data. The previous context is
+ * selected again before returning.
+ *
+ * Contexts are not created nor destroyed while this function runs, so the
+ * \a function must not call \c DS_ContextCreate() or
+ * \c DS_ContextDestroy().
+ */
+void Context_ForEach (void (*function) (void* data), void* data)
+{
+    assert (function);
+
+    DS_Context* previous = current;
+    pthread_mutex_lock (&list_mutex);
+
+    DS_Context* context;
+    for (context = &default_context; context; context = context->next) {
+        current = context;
+        function (data);
+    }
+
+    pthread_mutex_unlock (&list_mutex);
+    current = previous;
+}
+
+/**
+ * Creates a new driver station context. Each context has its own protocol,
+ * sockets, robot status, joysticks and events, so that a single process can
+ * run several driver stations at once.
+ *
+ * Use \c DS_ContextMakeCurrent() to select the context used by the calling
+ * thread, and then call \c DS_Init() and the rest of the API as usual.
+ */
+DS_Context* DS_ContextCreate (void)
+{
+    DS_Context* context = (DS_Context*) calloc (1, sizeof (DS_Context));
+    if (!context)
+        return NULL;
+
+    pthread_mutex_init (&context->mutex, NULL);
+
+    /* Add the context to the end of the list */
+    pthread_mutex_lock (&list_mutex);
+    DS_Context* last = &default_context;
+    while (last->next)
+        last = last->next;
+
+    context->id = next_id++;
+    last->next = context;
+    pthread_mutex_unlock (&list_mutex);
+
+    return context;
+}
+
+/**
+ * Returns the context used by the threads that did not select a context,
+ * which is the only context of applications that ignore contexts
+ */
+DS_Context* DS_DefaultContext (void)
+{
+    return &default_context;
+}
+
+/**
+ * Returns the identifier of the given \a context, which is \c 0 for the
+ * default context and increases with each created context. Identifiers are
+ * not reused, they label the metrics of each context.
+ */
+uint64_t DS_ContextId (const DS_Context* context)
+{
+    return context ? context->id : 0;
+}
+
+/**
+ * Returns the context used by the calling thread
+ */
+DS_Context* DS_CurrentContext (void)
+{
+    if (current)
+        return current;
+
+    return &default_context;
+}
+
+/**
+ * Closes the driver station of the given \a context (if it is still
+ * initialized), waits for its threads to exit and releases its memory.
+ * The default context cannot be destroyed.
+ */
+void DS_ContextDestroy (DS_Context* context)
+{
+    if (!context || context == &default_context)
+        return;
+
+    /* Remove the context from the list */
+    pthread_mutex_lock (&list_mutex);
+    DS_Context* prev = &default_context;
+    while (prev->next && prev->next != context)
+        prev = prev->next;
+
+    if (prev->next == context)
+        prev->next = context->next;
+
+    pthread_mutex_unlock (&list_mutex);
+
+    /* Close the driver station in the context */
+    DS_Context* previous = current;
+    current = context;
+    DS_Close();
+    current = (previous == context) ? NULL : previous;
+
+    /* Wait for the threads of the context */
+    while (DS_AtomicLoad64 (&context->threads) > 0)
+        Timers_SystemSleep (1);
+
+    /* Release the module states */
+    int i;
+    for (i = 0; i < MAX_STATES; ++i) {
+        ModuleState* module = &context->states [i];
+        if (!module->memory)
+            continue;
+
+        if (module->release)
+            module->release ((void*) (uintptr_t) module->state);
+
+        DS_FREE (module->memory);
+    }
+
+    pthread_mutex_destroy (&context->mutex);
+    DS_FREE (context);
+}
+
+/**
+ * Selects the context used by the calling thread, every function of the
+ * API called by the thread uses that context. A \c NULL \a context selects
+ * the default context.
+ *
+ * Threads started by the library use the context of the thread that
+ * started them.
+ */
+void DS_ContextMakeCurrent (DS_Context* context)
+{
+    current = (context == &default_context) ? NULL : context;
+}
+
+/**
+ * Returns the state identified by \a key in the current context. The state
+ * is allocated (filled with zeros and given to \a init) the first time that
+ * it is requested in a context, and it is given to \a release before the
+ * context is destroyed.
+ *
+ * Modules (and custom protocols) keep their variables in a state, using a
+ * static \c DS_ContextKey initialized to zero as the \a key, so that each
+ * driver station of the process has its own copy of them. The key is given
+ * a slot the first time that it is used, after that, finding the state only
+ * takes two loads.
+ */
+void* DS_ContextState (DS_ContextKey* key, const size_t size,
+                       void (*init) (void* state),
+                       void (*release) (void* state))
+{
+    assert (key);
+    assert (size > 0);
+
+    DS_Context* context = current ? current : &default_context;
+
+    /* Give the module a slot the first time that it asks for its state */
+    uint64_t slot = DS_AtomicLoadAcquire64 (key);
+    if (slot == 0)
+        slot = assign_slot (key);
+
+    /* Return the existing state (states are never removed) */
+    uint64_t state = DS_AtomicLoadAcquire64 (&context->states [slot - 1].state);
+    if (state)
+        return (void*) (uintptr_t) state;
+
+    return create_state (context, slot, size, init, release);
+}
@@ -42,7 +42,42 @@
 
 #include "DS_Utils.h"
 
+#include <string.h>
 #include <assert.h>
+#include <pthread.h>
+
+/*
+ * Hardware accelerated implementations (selected at runtime)
+ */
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+    #define CRC32_PCLMUL 1
+    #include <immintrin.h>
+#elif defined __GNUC__ && defined __aarch64__ && defined __linux__
+    #define CRC32_ARMV8 1
+    #include <sys/auxv.h>
+    #include <asm/hwcap.h>
+
+    #if defined __clang__
+        #define CRC32_ARMV8_TARGET __attribute__ ((target ("crc")))
+        #define CRC32_ARMV8_BYTE(crc, byte) __builtin_arm_crc32b (crc, byte)
+        #define CRC32_ARMV8_WORD(crc, word) __builtin_arm_crc32d (crc, word)
+    #else
+        #define CRC32_ARMV8_TARGET __attribute__ ((target ("+crc")))
+        #define CRC32_ARMV8_BYTE(crc, byte) __builtin_aarch64_crc32b (crc, byte)
+        #define CRC32_ARMV8_WORD(crc, word) __builtin_aarch64_crc32x (crc, word)
+    #endif
+#endif
+
+/*
+ * Slicing-by-8 needs to read 32-bit words in little endian order
+ */
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    #define CRC32_SLICING 1
+#elif defined _WIN32
+    #define CRC32_SLICING 1
+#endif
+
+#define CRC32_POLY 0xEDB88320UL
 
 static uint32_t crc32_tab[] = {
     0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
@@ -90,17 +125,311 @@ static uint32_t crc32_tab[] = {
     0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
-uint32_t DS_CRC32 (const void* buf, size_t size)
+/*
+ * Tables used by the slicing-by-8 algorithm (the first table is crc32_tab),
+ * and powers of x used to combine checksums
+ */
+static uint32_t crc32_slices [8][256];
+static uint32_t x2n_table [32];
+
+/*
+ * Function used to update the CRC register with a buffer
+ */
+static uint32_t (*crc32_update) (uint32_t crc, const uint8_t* p, size_t size);
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Updates the CRC register one byte at a time
+ */
+static uint32_t crc32_bytes (uint32_t crc, const uint8_t* p, size_t size)
 {
-    assert (buf);
+    while (size--)
+        crc = crc32_tab [ (crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+/**
+ * Updates the CRC register eight bytes at a time
+ */
+static uint32_t crc32_slicing (uint32_t crc, const uint8_t* p, size_t size)
+{
+#ifdef CRC32_SLICING
+    while (size >= 8) {
+        uint32_t one, two;
+        memcpy (&one, p, 4);
+        memcpy (&two, p + 4, 4);
+        one ^= crc;
+
+        crc = crc32_slices [7][one & 0xFF] ^
+              crc32_slices [6][(one >> 8) & 0xFF] ^
+              crc32_slices [5][(one >> 16) & 0xFF] ^
+              crc32_slices [4][one >> 24] ^
+              crc32_slices [3][two & 0xFF] ^
+              crc32_slices [2][(two >> 8) & 0xFF] ^
+              crc32_slices [1][(two >> 16) & 0xFF] ^
+              crc32_slices [0][two >> 24];
 
-    const uint8_t* p;
-    uint32_t crc = 0xFFFFFFFFUL;
+        p += 8;
+        size -= 8;
+    }
+#endif
 
-    p = buf;
+    return crc32_bytes (crc, p, size);
+}
+
+#ifdef CRC32_PCLMUL
+/**
+ * Folds blocks of 16 bytes with carry-less multiplications, as described
+ * in "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ * Instruction" (Intel, 2009). The buffer must hold at least 64 bytes and its
+ * size must be a multiple of 16.
+ */
+__attribute__ ((target ("pclmul,sse4.1")))
+static uint32_t crc32_pclmul_blocks (uint32_t crc, const uint8_t* p, size_t size)
+{
+    static const uint64_t k1k2 [2] __attribute__ ((aligned (16))) = {0x0154442bd4, 0x01c6e41596};
+    static const uint64_t k3k4 [2] __attribute__ ((aligned (16))) = {0x01751997d0, 0x00ccaa009e};
+    static const uint64_t k5k0 [2] __attribute__ ((aligned (16))) = {0x0163cd6124, 0x0000000000};
+    static const uint64_t poly [2] __attribute__ ((aligned (16))) = {0x01db710641, 0x01f7011641};
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    /* Load the first 64 bytes and add the initial CRC */
+    x1 = _mm_loadu_si128 ((const __m128i*) (p + 0x00));
+    x2 = _mm_loadu_si128 ((const __m128i*) (p + 0x10));
+    x3 = _mm_loadu_si128 ((const __m128i*) (p + 0x20));
+    x4 = _mm_loadu_si128 ((const __m128i*) (p + 0x30));
+    x1 = _mm_xor_si128 (x1, _mm_cvtsi32_si128 ((int) crc));
+    x0 = _mm_load_si128 ((const __m128i*) k1k2);
+
+    p += 64;
+    size -= 64;
+
+    /* Fold four blocks in parallel */
+    while (size >= 64) {
+        x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128 (x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128 (x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128 (x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128 (x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128 (x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128 (x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128 ((const __m128i*) (p + 0x00));
+        y6 = _mm_loadu_si128 ((const __m128i*) (p + 0x10));
+        y7 = _mm_loadu_si128 ((const __m128i*) (p + 0x20));
+        y8 = _mm_loadu_si128 ((const __m128i*) (p + 0x30));
+
+        x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x5), y5);
+        x2 = _mm_xor_si128 (_mm_xor_si128 (x2, x6), y6);
+        x3 = _mm_xor_si128 (_mm_xor_si128 (x3, x7), y7);
+        x4 = _mm_xor_si128 (_mm_xor_si128 (x4, x8), y8);
+
+        p += 64;
+        size -= 64;
+    }
+
+    /* Fold the four blocks into one */
+    x0 = _mm_load_si128 ((const __m128i*) k3k4);
+
+    x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+    x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+    x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+    x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x4), x5);
+
+    /* Fold the remaining blocks of 16 bytes */
+    while (size >= 16) {
+        x2 = _mm_loadu_si128 ((const __m128i*) p);
+
+        x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+        x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x2), x5);
+
+        p += 16;
+        size -= 16;
+    }
+
+    /* Fold 128 bits to 64 bits */
+    x2 = _mm_clmulepi64_si128 (x1, x0, 0x10);
+    x3 = _mm_setr_epi32 (~0, 0, ~0, 0);
+    x1 = _mm_srli_si128 (x1, 8);
+    x1 = _mm_xor_si128 (x1, x2);
+
+    x0 = _mm_loadl_epi64 ((const __m128i*) k5k0);
+
+    x2 = _mm_srli_si128 (x1, 4);
+    x1 = _mm_and_si128 (x1, x3);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_xor_si128 (x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128 ((const __m128i*) poly);
+
+    x2 = _mm_and_si128 (x1, x3);
+    x2 = _mm_clmulepi64_si128 (x2, x0, 0x10);
+    x2 = _mm_and_si128 (x2, x3);
+    x2 = _mm_clmulepi64_si128 (x2, x0, 0x00);
+    x1 = _mm_xor_si128 (x1, x2);
+
+    return (uint32_t) _mm_extract_epi32 (x1, 1);
+}
+
+/**
+ * Updates the CRC register using PCLMULQDQ for the 16-byte blocks and
+ * slicing-by-8 for the remaining bytes
+ */
+static uint32_t crc32_pclmul (uint32_t crc, const uint8_t* p, size_t size)
+{
+    if (size >= 64) {
+        size_t blocks = size & ~((size_t) 15);
+        crc = crc32_pclmul_blocks (crc, p, blocks);
+        p += blocks;
+        size -= blocks;
+    }
+
+    return crc32_slicing (crc, p, size);
+}
+#endif
+
+#ifdef CRC32_ARMV8
+/**
+ * Updates the CRC register using the ARMv8 CRC32 instructions
+ */
+CRC32_ARMV8_TARGET
+static uint32_t crc32_armv8 (uint32_t crc, const uint8_t* p, size_t size)
+{
+    while (size > 0 && ((uintptr_t) p & 7)) {
+        crc = CRC32_ARMV8_BYTE (crc, *p++);
+        --size;
+    }
+
+    while (size >= 8) {
+        uint64_t value;
+        memcpy (&value, p, 8);
+        crc = CRC32_ARMV8_WORD (crc, value);
+        p += 8;
+        size -= 8;
+    }
 
     while (size--)
-        crc = crc32_tab [ (crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        crc = CRC32_ARMV8_BYTE (crc, *p++);
+
+    return crc;
+}
+#endif
+
+/**
+ * Multiplies \a a and \a b modulo the CRC polynomial
+ */
+static uint32_t multmodp (uint32_t a, uint32_t b)
+{
+    uint32_t m = (uint32_t) 1 << 31;
+    uint32_t p = 0;
+
+    while (m) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32_POLY : b >> 1;
+    }
+
+    return p;
+}
+
+/**
+ * Returns x^(n * 2^k) modulo the CRC polynomial
+ */
+static uint32_t x2nmodp (size_t n, unsigned k)
+{
+    uint32_t p = (uint32_t) 1 << 31;
+
+    while (n) {
+        if (n & 1)
+            p = multmodp (x2n_table [k & 31], p);
 
-    return crc ^ 0xFFFFFFFFUL;
+        n >>= 1;
+        ++k;
+    }
+
+    return p;
+}
+
+/**
+ * Generates the slicing-by-8 and combine tables, and selects the fastest
+ * implementation supported by the processor
+ */
+static void crc32_init (void)
+{
+    int i, k;
+    uint32_t p;
+
+    /* Slicing-by-8 tables */
+    for (i = 0; i < 256; ++i)
+        crc32_slices [0][i] = crc32_tab [i];
+
+    for (k = 1; k < 8; ++k) {
+        for (i = 0; i < 256; ++i) {
+            uint32_t crc = crc32_slices [k - 1][i];
+            crc32_slices [k][i] = (crc >> 8) ^ crc32_tab [crc & 0xFF];
+        }
+    }
+
+    /* Powers of x^(2^n) */
+    p = (uint32_t) 1 << 30;
+    x2n_table [0] = p;
+    for (i = 1; i < 32; ++i)
+        x2n_table [i] = p = multmodp (p, p);
+
+    /* Select implementation */
+    crc32_update = &crc32_slicing;
+
+#ifdef CRC32_PCLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports ("pclmul") && __builtin_cpu_supports ("sse4.1"))
+        crc32_update = &crc32_pclmul;
+#endif
+
+#ifdef CRC32_ARMV8
+    if (getauxval (AT_HWCAP) & HWCAP_CRC32)
+        crc32_update = &crc32_armv8;
+#endif
+}
+
+/**
+ * Returns the CRC32 checksum of the given \a buf with the given \a size
+ */
+uint32_t DS_CRC32 (const void* buf, size_t size)
+{
+    assert (buf);
+
+    pthread_once (&crc32_once, &crc32_init);
+    return crc32_update (0xFFFFFFFFUL, (const uint8_t*) buf, size) ^ 0xFFFFFFFFUL;
+}
+
+/**
+ * Returns the CRC32 checksum of two concatenated buffers, given the checksum
+ * of the first buffer (\a crc1), the checksum of the second buffer (\a crc2)
+ * and the size of the second buffer (\a size2).
+ *
+ * This is useful when the second buffer is constant, since its checksum
+ * can be calculated only once.
+ */
+uint32_t DS_CRC32Combine (const uint32_t crc1, const uint32_t crc2, size_t size2)
+{
+    pthread_once (&crc32_once, &crc32_init);
+    return multmodp (x2nmodp (size2, 3), crc1) ^ crc2;
 }
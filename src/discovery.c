@@ -0,0 +1,489 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "LibDS.h"
+#include "DS_Utils.h"
+#include "DS_Timer.h"
+#include "DS_Config.h"
+#include "DS_Client.h"
+#include "DS_Context.h"
+#include "DS_Protocol.h"
+#include "DS_Discovery.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define USB_ADDRESS      "172.22.11.2" /* roboRIO address over USB */
+#define MAX_PATHS        3    /* mDNS name, static IP and USB address */
+#define POLL_INTERVAL    50   /* Milliseconds between each update */
+#define MONITOR_INTERVAL 250  /* Probe interval once an address is selected */
+#define REPLY_TIMEOUT    1000 /* An address is responding if it replied since */
+#define FAILOVER_TIMEOUT 500  /* Silence of the selected address to fail over */
+
+/**
+ * Holds an address through which the robot may be reachable
+ */
+typedef struct {
+    DS_Socket probe;     /**< Sends the robot packets to the address */
+    uint64_t replies;    /**< Number of packets received from the address */
+    uint64_t last_reply; /**< Time of the last reply, 0 if none */
+    uint64_t last_probe; /**< Time of the last probe */
+} Path;
+
+/**
+ * Holds the discovery state of a context
+ */
+typedef struct {
+    /* Probed addresses */
+    Path paths [MAX_PATHS];
+    int path_count;
+    int selected;
+
+    /* Discovery thread state */
+    int enabled;
+    int thread_active;
+    pthread_t discovery_thread;
+} State;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Initializes the discovery state of a new context
+ */
+static void init_state (void* ptr)
+{
+    ((State*) ptr)->selected = -1;
+}
+
+/**
+ * Returns the discovery state of the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), &init_state, NULL);
+}
+
+/**
+ * Returns 1 if the given \a path replied during the last \a timeout
+ * milliseconds
+ */
+static int path_responding (const Path* path, const uint64_t now,
+                            const int timeout)
+{
+    return path->last_reply > 0 &&
+           now - path->last_reply < (uint64_t) timeout * 1000000ULL;
+}
+
+/**
+ * Returns the index of the path that uses the same address as the \a robot
+ * socket, or -1 if the robot socket uses another address
+ */
+static int active_path (const DS_Socket* robot)
+{
+    State* s = state();
+
+    int i;
+    for (i = 0; i < s->path_count; ++i) {
+        if (strcmp (s->paths [i].probe.address, robot->address) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * Closes the probe sockets and forgets every address
+ */
+static void clear_paths (void)
+{
+    State* s = state();
+
+    int i;
+    for (i = 0; i < s->path_count; ++i)
+        DS_SocketClose (&s->paths [i].probe);
+
+    s->path_count = 0;
+    s->selected = -1;
+}
+
+/**
+ * Fills the given \a addresses with the addresses at which the robot of the
+ * current team may be found and returns the number of addresses
+ */
+static int get_addresses (const DS_Protocol* protocol,
+                          char addresses [MAX_PATHS][512])
+{
+    DS_String list [MAX_PATHS];
+    list [0] = protocol->robot_address();
+    list [1] = DS_GetStaticIP (10, CFG_GetTeamNumber(), 2);
+    list [2] = DS_StrNew (USB_ADDRESS);
+
+    int i, j, count = 0;
+    for (i = 0; i < MAX_PATHS; ++i) {
+        char* str = DS_StrToChar (&list [i]);
+
+        /* Skip empty and repeated addresses */
+        int repeated = 0;
+        for (j = 0; j < count; ++j)
+            repeated |= (strcmp (addresses [j], str) == 0);
+
+        if (!repeated && strlen (str) > 0) {
+            memset (addresses [count], 0, 512);
+            strncpy (addresses [count], str, 511);
+            ++count;
+        }
+
+        DS_FREE (str);
+        DS_StrRmBuf (&list [i]);
+    }
+
+    return count;
+}
+
+/**
+ * Re-creates the probe sockets if the addresses of the robot changed
+ * (e.g. because the team number or the protocol changed)
+ */
+static void update_paths (const DS_Protocol* protocol)
+{
+    State* s = state();
+
+    char addresses [MAX_PATHS][512];
+    int count = get_addresses (protocol, addresses);
+
+    /* Check if the addresses or ports changed */
+    int i, changed = (count != s->path_count);
+    for (i = 0; i < count && !changed; ++i) {
+        const DS_Socket* probe = &s->paths [i].probe;
+        changed |= strcmp (probe->address, addresses [i]) != 0;
+        changed |= probe->out_port != protocol->robot_socket.out_port;
+        changed |= probe->transport != protocol->robot_socket.transport;
+    }
+
+    if (!changed)
+        return;
+
+    /* Open a probe socket for each address */
+    clear_paths();
+    for (i = 0; i < count; ++i) {
+        Path* path = &s->paths [i];
+        memset (path, 0, sizeof (Path));
+
+        path->probe.in_port = 0;
+        path->probe.type = protocol->robot_socket.type;
+        path->probe.out_port = protocol->robot_socket.out_port;
+        path->probe.transport = protocol->robot_socket.transport;
+        memcpy (path->probe.address, addresses [i], 512);
+
+        DS_SocketOpen (&path->probe);
+    }
+
+    s->path_count = count;
+}
+
+/**
+ * Selects the address used by the robot socket. The first address that
+ * replies is selected, and another address is only selected if the robot
+ * stops replying through the selected one.
+ *
+ * \returns 1 if the robot socket must change its address
+ */
+static int select_path (const DS_Protocol* protocol, const uint64_t now)
+{
+    State* s = state();
+    Path* paths = s->paths;
+
+    int i;
+    int best = -1;
+    int active = active_path (&protocol->robot_socket);
+
+    /* The user chose the robot address */
+    char* custom = DS_GetCustomRobotAddress();
+    int custom_set = custom && strlen (custom) > 0;
+    DS_FREE (custom);
+
+    if (custom_set)
+        return 0;
+
+    /* Keep the current address while the robot replies through it */
+    if (active >= 0 && path_responding (&paths [active], now, FAILOVER_TIMEOUT)) {
+        s->selected = active;
+        return 0;
+    }
+
+    /* Find the address that replied most recently */
+    for (i = 0; i < s->path_count; ++i) {
+        if (i != active && path_responding (&paths [i], now, REPLY_TIMEOUT)) {
+            if (best < 0 || paths [i].last_reply > paths [best].last_reply)
+                best = i;
+        }
+    }
+
+    if (best < 0)
+        return 0;
+
+    s->selected = best;
+    return 1;
+}
+
+/**
+ * Updates the probed addresses and changes the address of the robot socket
+ * when another address works better
+ */
+static void* run_discovery (void* unused)
+{
+    State* s = state();
+
+    (void) unused;
+
+    while (s->enabled) {
+        int reconfigure = 0;
+
+        pthread_mutex_lock (&mutex);
+        DS_Protocol* protocol = DS_CurrentProtocol();
+
+        if (protocol) {
+            update_paths (protocol);
+            reconfigure = select_path (protocol, DS_GetTimeNs());
+        }
+
+        else
+            clear_paths();
+
+        pthread_mutex_unlock (&mutex);
+
+        /* Let the protocol loop apply the new address (it calls
+         * Discovery_GetAddress()) when it does not use the robot socket */
+        if (reconfigure)
+            Protocols_Reconfigure (RECONFIGURE_ROBOT);
+
+        DS_Sleep (POLL_INTERVAL);
+    }
+
+    pthread_mutex_lock (&mutex);
+    clear_paths();
+    pthread_mutex_unlock (&mutex);
+
+    return NULL;
+}
+
+/**
+ * Stops the robot discovery
+ */
+void Discovery_Close (void)
+{
+    DS_SetRobotDiscoveryEnabled (0);
+}
+
+/**
+ * Returns the robot address selected by the discovery, or \c NULL if the
+ * discovery is disabled or no address has replied yet.
+ *
+ * \note The returned string must be freed with \c DS_FREE()
+ */
+char* Discovery_GetAddress (void)
+{
+    State* s = state();
+
+    char* address = NULL;
+
+    pthread_mutex_lock (&mutex);
+    if (s->enabled && s->selected >= 0 && s->selected < s->path_count) {
+        DS_String str = DS_StrNew (s->paths [s->selected].probe.address);
+        address = DS_StrToChar (&str);
+        DS_StrRmBuf (&str);
+    }
+    pthread_mutex_unlock (&mutex);
+
+    return address;
+}
+
+/**
+ * Sends the robot packet that was sent through the \a robot socket to the
+ * other addresses of the robot. Until an address replies, every packet is
+ * sent to every address, then they are only probed every
+ * \c MONITOR_INTERVAL milliseconds.
+ *
+ * The probes only use addresses that have already been looked up, so
+ * this function never waits for a DNS/mDNS lookup.
+ */
+void Discovery_PacketSent (const DS_Socket* robot, const DS_String* data)
+{
+    State* s = state();
+
+    assert (robot);
+    assert (data);
+
+    if (!s->enabled || pthread_mutex_trylock (&mutex) != 0)
+        return;
+
+    int i;
+    uint64_t now = DS_GetTimeNs();
+    uint64_t interval = (s->selected >= 0) ? MONITOR_INTERVAL * 1000000ULL : 0;
+
+    for (i = 0; i < s->path_count; ++i) {
+        Path* path = &s->paths [i];
+
+        /* The robot socket already sends to this address */
+        if (strcmp (path->probe.address, robot->address) == 0)
+            continue;
+
+        /* Address is not resolved yet or it is not time to probe it */
+        if (path->probe.info.out_addr_len <= 0
+                || now - path->last_probe < interval)
+            continue;
+
+        path->last_probe = now;
+        DS_SocketSend (&path->probe, data);
+    }
+
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Registers a valid robot packet received by the \a robot socket with the
+ * addresses that match the sender of the packet
+ */
+void Discovery_PacketReceived (const DS_Socket* robot)
+{
+    State* s = state();
+
+    assert (robot);
+
+    if (!s->enabled)
+        return;
+
+    pthread_mutex_lock (&mutex);
+
+    int i;
+    uint64_t now = DS_GetTimeNs();
+    for (i = 0; i < s->path_count; ++i) {
+        if (DS_SocketReceivedFrom (robot, &s->paths [i].probe) == 1) {
+            s->paths [i].replies++;
+            s->paths [i].last_reply = now;
+        }
+    }
+
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Returns \c 1 if the robot discovery is enabled
+ */
+int DS_GetRobotDiscoveryEnabled (void)
+{
+    State* s = state();
+
+    return s->enabled;
+}
+
+/**
+ * Enables or disables the robot discovery.
+ *
+ * When enabled, the robot is probed at its mDNS name, at its static IP
+ * (10.TE.AM.2) and at its USB address (172.22.11.2) at the same time. The
+ * first address that replies is used by the robot socket, and the other
+ * addresses are still probed so that the robot socket can switch to them
+ * if the robot stops replying through the selected address.
+ *
+ * The discovery does not change the robot address while a custom robot
+ * address is set. The discovery runs in its own thread, so it cannot be
+ * enabled when the DS is initialized with \c DS_INIT_MANUAL_PUMP.
+ */
+void DS_SetRobotDiscoveryEnabled (const int enable)
+{
+    State* s = state();
+
+    /* The application does not allow the library to start threads */
+    if (enable && DS_ManualPump()) {
+        fprintf (stderr, "DS_SetRobotDiscoveryEnabled: not available in "
+                 "manual pump mode\n");
+        return;
+    }
+
+    pthread_mutex_lock (&thread_mutex);
+
+    /* Start the discovery thread */
+    if (enable && !s->enabled) {
+        s->enabled = 1;
+        int error = Context_CreateThread (&s->discovery_thread,
+                                          &run_discovery, NULL);
+
+        if (error) {
+            s->enabled = 0;
+            fprintf (stderr, "DS_SetRobotDiscoveryEnabled: cannot start "
+                     "discovery thread\n");
+        }
+
+        s->thread_active = !error;
+    }
+
+    /* Stop the discovery thread */
+    else if (!enable && s->enabled) {
+        s->enabled = 0;
+        if (s->thread_active)
+            pthread_join (s->discovery_thread, NULL);
+
+        s->thread_active = 0;
+    }
+
+    pthread_mutex_unlock (&thread_mutex);
+}
+
+/**
+ * Copies the state of each probed robot address into the given
+ * \a addresses array (up to \a max elements).
+ *
+ * \returns the number of copied addresses
+ */
+int DS_GetRobotAddresses (DS_RobotAddress* addresses, const int max)
+{
+    State* s = state();
+
+    assert (addresses);
+
+    pthread_mutex_lock (&mutex);
+
+    int i;
+    int count = DS_Min (s->path_count, max);
+    uint64_t now = DS_GetTimeNs();
+    for (i = 0; i < count; ++i) {
+        const Path* path = &s->paths [i];
+        DS_RobotAddress* address = &addresses [i];
+
+        memcpy (address->address, path->probe.address, sizeof (address->address));
+        address->resolved = path->probe.info.out_addr_len > 0;
+        address->selected = (i == s->selected);
+        address->responding = path_responding (path, now, REPLY_TIMEOUT);
+        address->replies = path->replies;
+        address->reply_age = path->last_reply ? now - path->last_reply : 0;
+    }
+
+    pthread_mutex_unlock (&mutex);
+    return DS_Max (count, 0);
+}
@@ -23,19 +23,28 @@
 
 #include "DS_Queue.h"
 #include "DS_Events.h"
+#include "DS_Context.h"
+#include "DS_Metrics.h"
 
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
 
-static DS_Queue events;
+/**
+ * Returns the event queue of the current context
+ */
+static DS_Queue* queue (void)
+{
+    static DS_ContextKey key = 0;
+    return (DS_Queue*) DS_ContextState (&key, sizeof (DS_Queue), NULL, NULL);
+}
 
 /**
  * Initializes the event queue with an initial support for 50 events
  */
 void Events_Init (void)
 {
-    DS_QueueInit (&events, 50, sizeof (DS_Event));
+    DS_QueueInit (queue(), 50, sizeof (DS_Event));
 }
 
 /**
@@ -43,7 +52,8 @@ void Events_Init (void)
  */
 void Events_Close (void)
 {
-    DS_QueueFree (&events);
+    Metrics_EventQueued (-queue()->count);
+    DS_QueueFree (queue());
 }
 
 /**
@@ -54,7 +64,8 @@ void Events_Close (void)
 void DS_AddEvent (DS_Event* event)
 {
     assert (event);
-    DS_QueuePush (&events, (void*) event);
+    DS_QueuePush (queue(), (void*) event);
+    Metrics_EventQueued (1);
 }
 
 /**
@@ -67,10 +78,11 @@ void DS_AddEvent (DS_Event* event)
  */
 int DS_PollEvent (DS_Event* event)
 {
-    DS_Event* front = (DS_Event*) DS_QueueGetFirst (&events);
+    DS_Event* front = (DS_Event*) DS_QueueGetFirst (queue());
 
     if (front) {
-        DS_QueuePop (&events);
+        DS_QueuePop (queue());
+        Metrics_EventQueued (-1);
         memcpy (event, front, sizeof (DS_Event));
         return 1;
     }
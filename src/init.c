@@ -23,8 +23,36 @@
 
 #include "LibDS.h"
 #include "DS_Config.h"
+#include "DS_Capture.h"
+#include "DS_Metrics.h"
+#include "DS_Quality.h"
+#include "DS_Context.h"
 
-static int init = 0;
+#include <pthread.h>
+
+/*
+ * The sockets and the packet capture are shared by all the contexts, they
+ * are initialized with the first context and closed with the last one
+ */
+static int contexts = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Holds the initialized state and the init. flags of a context
+ */
+typedef struct {
+    int initialized;
+    int flags;
+} State;
+
+/**
+ * Returns the initialized state of the current context
+ */
+static State* init (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), NULL, NULL);
+}
 
 /**
  * Initializes all the modules of the LibDS library, you should call this
@@ -32,14 +60,36 @@ static int init = 0;
  * modules of the LibDS.
  */
 void DS_Init (void)
+{
+    DS_InitWithFlags (0);
+}
+
+/**
+ * Initializes all the modules of the LibDS library with the given \a flags
+ * (a combination of \c DS_InitFlags values).
+ *
+ * With \c DS_INIT_MANUAL_PUMP, the library starts no threads: the sockets
+ * are opened and read in the calling thread, and the application calls
+ * \c DS_Step() (when \c DS_NextDeadline() is reached, or when a descriptor
+ * returned by \c DS_GetChannelFd() is readable) to send, receive and check
+ * the watchdogs. The robot discovery and the protocol auto-detection need
+ * their own threads, so they are not available in this mode.
+ */
+void DS_InitWithFlags (const int flags)
 {
     if (!DS_Initialized()) {
-        init = 1;
+        init()->initialized = 1;
+        init()->flags = flags;
+
+        pthread_mutex_lock (&mutex);
+        if (contexts++ == 0)
+            Sockets_Init();
+        pthread_mutex_unlock (&mutex);
 
         Timers_Init();
         Client_Init();
         Events_Init();
-        Sockets_Init();
+        Quality_Init();
         Joysticks_Init();
         Protocols_Init();
     }
@@ -50,19 +100,32 @@ void DS_Init (void)
  * exiting your application. Failure to do this may result with socket
  * problems (regardless if you are using the offical DS or not), memory
  * problems and increased CPU usage (due to threads managed by the LibDS)
+ *
+ * Only the driver station of the current context is closed, see
+ * \c DS_ContextDestroy() for applications that use several contexts
  */
 void DS_Close (void)
 {
     if (DS_Initialized()) {
-        init = 0;
+        init()->initialized = 0;
 
+        Autodetect_Close();
+        Discovery_Close();
         Timers_Close();
-        Sockets_Close();
         Protocols_Close();
         Joysticks_Close();
+        Quality_Close();
 
         Events_Close();
         Client_Close();
+
+        pthread_mutex_lock (&mutex);
+        if (--contexts == 0) {
+            Capture_Close();
+            Metrics_Close();
+            Sockets_Close();
+        }
+        pthread_mutex_unlock (&mutex);
     }
 }
 
@@ -71,7 +134,16 @@ void DS_Close (void)
  */
 int DS_Initialized (void)
 {
-    return init;
+    return init()->initialized;
+}
+
+/**
+ * Returns \c 1 if the DS was initialized with \c DS_INIT_MANUAL_PUMP, in
+ * which case the application calls \c DS_Step() itself
+ */
+int DS_ManualPump (void)
+{
+    return init()->initialized && (init()->flags & DS_INIT_MANUAL_PUMP);
 }
 
 /**
@@ -0,0 +1,322 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "DS_Utils.h"
+#include "DS_Client.h"
+#include "DS_Socket.h"
+#include "DS_Context.h"
+#include "DS_Protocol.h"
+#include "DS_Interface.h"
+#include "DS_Statistics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#if !defined _WIN32
+    #include <net/if.h>
+    #include <ifaddrs.h>
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+#endif
+
+#define CHANNEL_COUNT 4
+
+/**
+ * Holds the interface name (or local address) of each channel of a context,
+ * empty for any
+ */
+typedef struct {
+    char interfaces [CHANNEL_COUNT][64];
+} State;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the interfaces of the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), NULL, NULL);
+}
+
+/**
+ * Copies the interface of the given \a channel into \a name
+ */
+static void get_interface (const DS_Channel channel, char* name, const int len)
+{
+    State* s = state();
+
+    assert (name);
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    pthread_mutex_lock (&mutex);
+    int size = DS_Min ((int) strlen (s->interfaces [channel]), len - 1);
+    memcpy (name, s->interfaces [channel], size);
+    name [size] = 0;
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Returns 1 if the remote host of the given \a channel is sending us data
+ */
+static int has_communications (const DS_Channel channel)
+{
+    switch (channel) {
+    case DS_CHANNEL_FMS:
+        return DS_GetFMSCommunications();
+    case DS_CHANNEL_RADIO:
+        return DS_GetRadioCommunications();
+    case DS_CHANNEL_ROBOT:
+        return DS_GetRobotCommunications();
+    case DS_CHANNEL_NETCONSOLE:
+        return Statistics_ReceivedPackets (DS_CHANNEL_NETCONSOLE) > 0;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns 1 if the given \a channel is bound to the interface with the
+ * given \a name or \a address
+ */
+static int channel_uses (const DS_Channel channel,
+                         const char* name, const char* address)
+{
+    char current [64];
+    get_interface (channel, current, sizeof (current));
+
+    if (strlen (current) == 0)
+        return 0;
+
+    return strcmp (current, name) == 0 || strcmp (current, address) == 0;
+}
+
+/**
+ * Returns 1 if the socket of the given \a channel is bound to its interface
+ */
+static int channel_bound (const DS_Channel channel)
+{
+    DS_Socket* socket = Protocols_GetSocket (channel);
+    return socket && socket->info.interface_bound;
+}
+
+/**
+ * Fills the address and state of the interface identified by the \a name
+ * of the given \a status (which may also be a local address)
+ */
+static void lookup_interface (DS_InterfaceStatus* status)
+{
+#if !defined _WIN32
+    struct ifaddrs* list = NULL;
+    if (getifaddrs (&list) != 0)
+        return;
+
+    struct ifaddrs* ifa;
+    for (ifa = list; ifa != NULL; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET)
+            continue;
+
+        char address [64] = {0};
+        const struct sockaddr_in* in = (const struct sockaddr_in*) ifa->ifa_addr;
+        inet_ntop (AF_INET, &in->sin_addr, address, sizeof (address));
+
+        if (strcmp (ifa->ifa_name, status->name) == 0
+                || strcmp (address, status->name) == 0) {
+            memcpy (status->address, address, sizeof (status->address));
+            status->up = (ifa->ifa_flags & IFF_UP) != 0;
+            break;
+        }
+    }
+
+    freeifaddrs (list);
+#else
+    (void) status;
+#endif
+}
+
+/**
+ * Copies the interface of the given \a channel into the given \a socket,
+ * this function is called before the socket is opened
+ */
+void Interface_Configure (DS_Socket* socket, const DS_Channel channel)
+{
+    assert (socket);
+
+    get_interface (channel, socket->network_interface,
+                   sizeof (socket->network_interface));
+}
+
+/**
+ * Returns the interface name (or local address) used by the given
+ * \a channel, an empty string means that the channel uses every interface
+ */
+char* DS_GetChannelInterface (const DS_Channel channel)
+{
+    char current [64];
+    get_interface (channel, current, sizeof (current));
+
+    DS_String str = DS_StrNew (current);
+    char* cstr = DS_StrToChar (&str);
+    DS_StrRmBuf (&str);
+
+    return cstr;
+}
+
+/**
+ * Binds the sockets of every channel to the given interface,
+ * \sa DS_SetChannelInterface()
+ */
+void DS_SetNetworkInterface (const char* name)
+{
+    int i;
+    for (i = 0; i < CHANNEL_COUNT; ++i)
+        DS_SetChannelInterface ((DS_Channel) i, name);
+}
+
+/**
+ * Binds the sockets of the given \a channel to a network interface, so that
+ * its packets are sent (and received) through that interface instead of
+ * the one chosen by the routing table.
+ *
+ * The \a name can be the name of an interface (e.g. "eth0"), which is bound
+ * with \c SO_BINDTODEVICE (Linux) or \c IP_BOUND_IF (macOS), or a local
+ * IPv4 address (e.g. "10.0.18.5"), which is used as the source address of
+ * the sent packets. An empty string (or \c NULL) restores the default.
+ *
+ * If a protocol is loaded, the sockets of the channel are re-opened.
+ *
+ * \note Binding a socket to an interface by its name may require elevated
+ *       privileges (e.g. \c CAP_NET_RAW on older Linux kernels), failures
+ *       are reported by \c DS_GetInterfaceStatus()
+ */
+void DS_SetChannelInterface (const DS_Channel channel, const char* name)
+{
+    State* s = state();
+
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    if (!name)
+        name = "";
+
+    /* Interface name is too long */
+    if (strlen (name) >= sizeof (s->interfaces [channel])) {
+        fprintf (stderr, "DS_SetChannelInterface: invalid interface\n");
+        return;
+    }
+
+    /* Change the interface */
+    pthread_mutex_lock (&mutex);
+    char* interface_name = s->interfaces [channel];
+    memset (interface_name, 0, sizeof (s->interfaces [channel]));
+    strncpy (interface_name, name, sizeof (s->interfaces [channel]) - 1);
+    pthread_mutex_unlock (&mutex);
+
+    /* Re-open the socket of the channel */
+    DS_Socket* socket = Protocols_GetSocket (channel);
+    if (socket && strcmp (socket->network_interface, name) != 0)
+        DS_SocketChangeInterface (socket, name);
+}
+
+/**
+ * Writes the state of the interface used by the given \a channel in
+ * \a status. The \c reachable flag is set if the channel has
+ * communications with its remote host, and (if the channel uses a specific
+ * interface) its sockets are bound to that interface.
+ */
+void DS_GetInterfaceStatus (const DS_Channel channel,
+                            DS_InterfaceStatus* status)
+{
+    assert (status);
+
+    memset (status, 0, sizeof (DS_InterfaceStatus));
+    get_interface (channel, status->name, sizeof (status->name));
+
+    /* Channel uses every interface */
+    if (strlen (status->name) == 0) {
+        status->reachable = has_communications (channel);
+        return;
+    }
+
+    lookup_interface (status);
+    status->bound = channel_bound (channel);
+    status->reachable = status->bound && has_communications (channel);
+}
+
+/**
+ * Writes the IPv4 interfaces of the computer in the given \a list, with the
+ * channels that are bound to each interface and their communication status.
+ * This can be used to choose the interface of the robot (e.g. Ethernet
+ * instead of Wi-Fi).
+ *
+ * \note This function is not available on Windows
+ *
+ * \returns the number of interfaces written in \a list
+ */
+int DS_GetNetworkInterfaces (DS_InterfaceStatus* list, const int max)
+{
+    assert (list);
+
+    int count = 0;
+
+#if !defined _WIN32
+    struct ifaddrs* addrs = NULL;
+    if (getifaddrs (&addrs) != 0)
+        return 0;
+
+    struct ifaddrs* ifa;
+    for (ifa = addrs; ifa != NULL && count < max; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET)
+            continue;
+
+        /* Get the name, address and state of the interface */
+        DS_InterfaceStatus* status = &list [count++];
+        memset (status, 0, sizeof (DS_InterfaceStatus));
+        const struct sockaddr_in* in = (const struct sockaddr_in*) ifa->ifa_addr;
+        inet_ntop (AF_INET, &in->sin_addr, status->address,
+                   sizeof (status->address));
+        strncpy (status->name, ifa->ifa_name, sizeof (status->name) - 1);
+        status->up = (ifa->ifa_flags & IFF_UP) != 0;
+
+        /* Check the channels that are bound to the interface */
+        int i;
+        for (i = 0; i < CHANNEL_COUNT; ++i) {
+            DS_Channel channel = (DS_Channel) i;
+            if (channel_uses (channel, status->name, status->address)
+                    && channel_bound (channel)) {
+                status->bound = 1;
+                status->reachable |= has_communications (channel);
+            }
+        }
+    }
+
+    freeifaddrs (addrs);
+#else
+    (void) max;
+#endif
+
+    return count;
+}
@@ -24,26 +24,20 @@
 #include "DS_Array.h"
 #include "DS_Config.h"
 #include "DS_Events.h"
+#include "DS_Context.h"
 #include "DS_Joysticks.h"
 
 #include <stdio.h>
+#include <assert.h>
 
 /**
- * Represents a joystick and its information
+ * Returns the array that holds all the joysticks of the current context
  */
-typedef struct _joystick {
-    int* hats;       /**< An array with the hat angles */
-    float* axes;    /**< An array with the axis values */
-    int* buttons;    /**< An array with the button states */
-    int num_axes;    /**< The number of axes of the joystick */
-    int num_hats;    /**< The number of hats of the joystick */
-    int num_buttons; /**< The number of buttons of the joystick */
-} DS_Joystick;
-
-/**
- * Holds all the joysticks
- */
-static DS_Array array;
+static DS_Array* joysticks (void)
+{
+    static DS_ContextKey key = 0;
+    return (DS_Array*) DS_ContextState (&key, sizeof (DS_Array), NULL, NULL);
+}
 
 /**
  * Registers a joystick event to the LibDS event system
@@ -62,8 +56,9 @@ static void register_event()
  */
 static DS_Joystick* get_joystick (int joystick)
 {
-    if ((int) array.used > joystick)
-        return (DS_Joystick*) array.data [joystick];
+    DS_Array* array = joysticks();
+    if ((int) array->used > joystick)
+        return (DS_Joystick*) array->data [joystick];
 
     return NULL;
 }
@@ -84,7 +79,7 @@ static int joystick_exists (int joystick)
  */
 void Joysticks_Init (void)
 {
-    DS_ArrayInit (&array, 6);
+    DS_ArrayInit (joysticks(), 6);
 }
 
 /**
@@ -92,16 +87,33 @@ void Joysticks_Init (void)
  */
 void Joysticks_Close (void)
 {
-    DS_ArrayFree (&array);
+    DS_ArrayFree (joysticks());
     register_event();
 }
 
+/**
+ * Returns the joysticks of the current context and writes their number to
+ * \a count, so that a protocol can read every joystick with one look-up.
+ *
+ * \note Unlike the public getters, the values are not neutralized when the
+ *       robot is disabled, the protocols must do it themselves
+ */
+DS_Joystick** Joysticks_List (int* count)
+{
+    assert (count);
+
+    DS_Array* array = joysticks();
+    *count = (int) array->used;
+
+    return (DS_Joystick**) array->data;
+}
+
 /**
  * Returns the number of joysticks registered with the LibDS
  */
 int DS_GetJoystickCount (void)
 {
-    return (int) array.used;
+    return (int) joysticks()->used;
 }
 
 /**
@@ -205,8 +217,8 @@ int DS_GetJoystickButton (int joystick, int button)
  */
 void DS_JoysticksReset (void)
 {
-    DS_ArrayFree (&array);
-    DS_ArrayInit (&array, 6);
+    DS_ArrayFree (joysticks());
+    DS_ArrayInit (joysticks(), 6);
 
     register_event();
 }
@@ -238,7 +250,7 @@ void DS_JoysticksAdd (const int axes, const int hats, const int buttons)
     joystick->buttons = calloc (buttons, sizeof (int));
 
     /* Register the new joystick in the joystick list */
-    DS_ArrayInsert (&array, (void*) joystick);
+    DS_ArrayInsert (joysticks(), (void*) joystick);
 
     /* Emit the joystick count changed event */
     register_event();
@@ -0,0 +1,250 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "DS_Utils.h"
+#include "DS_Loopback.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define MAX_MAILBOXES 32   /* Maximum number of ports in use at once */
+#define MAILBOX_SLOTS 64   /* Datagrams queued on each port */
+#define MAX_DATAGRAM  4096 /* Same size as the buffer of a DS_Socket */
+
+/**
+ * Holds a datagram waiting to be read
+ */
+typedef struct {
+    int len;
+    char data [MAX_DATAGRAM];
+} Datagram;
+
+/**
+ * Holds the datagrams sent to a port that have not been read yet
+ */
+typedef struct {
+    int port;
+    int head;
+    int count;
+    Datagram slots [MAILBOX_SLOTS];
+} Mailbox;
+
+static Mailbox* mailboxes [MAX_MAILBOXES];
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the mailbox of the given \a port, the mailbox is created if
+ * \a create is set to 1 and no mailbox exists for the port.
+ *
+ * \note This function must be called with the mutex locked
+ */
+static Mailbox* get_mailbox (const int port, const int create)
+{
+    int i;
+    int empty = -1;
+
+    for (i = 0; i < MAX_MAILBOXES; ++i) {
+        if (mailboxes [i] && mailboxes [i]->port == port)
+            return mailboxes [i];
+
+        if (!mailboxes [i] && empty < 0)
+            empty = i;
+    }
+
+    if (!create || empty < 0)
+        return NULL;
+
+    mailboxes [empty] = (Mailbox*) calloc (1, sizeof (Mailbox));
+    if (mailboxes [empty])
+        mailboxes [empty]->port = port;
+
+    return mailboxes [empty];
+}
+
+/**
+ * Queues \a len bytes of \a data on the given \a port. Like UDP, the datagram
+ * is silently dropped if nobody is reading the port fast enough.
+ */
+static int push (const int port, const char* data, const int len)
+{
+    if (!data || len < 0 || len > MAX_DATAGRAM)
+        return -1;
+
+    pthread_mutex_lock (&mutex);
+    Mailbox* box = get_mailbox (port, 1);
+
+    if (box && box->count < MAILBOX_SLOTS) {
+        Datagram* slot = &box->slots [(box->head + box->count) % MAILBOX_SLOTS];
+        memcpy (slot->data, data, len);
+        slot->len = len;
+        ++box->count;
+    }
+
+    pthread_mutex_unlock (&mutex);
+    return box ? len : -1;
+}
+
+/**
+ * Copies the oldest datagram queued on the given \a port into \a data and
+ * returns its length (or 0 if there are no queued datagrams). Datagrams
+ * larger than \a size are truncated.
+ */
+static int pop (const int port, char* data, const int size)
+{
+    int len = 0;
+
+    pthread_mutex_lock (&mutex);
+    Mailbox* box = get_mailbox (port, 0);
+
+    if (box && box->count > 0) {
+        Datagram* slot = &box->slots [box->head];
+        len = DS_Min (slot->len, size);
+        memcpy (data, slot->data, len);
+
+        box->head = (box->head + 1) % MAILBOX_SLOTS;
+        --box->count;
+    }
+
+    pthread_mutex_unlock (&mutex);
+    return len;
+}
+
+/**
+ * Discards any stale datagrams and marks the socket as initialized
+ */
+static void loopback_open (DS_Socket* ptr)
+{
+    DS_LoopbackFlush (ptr->in_port);
+
+    ptr->info.server_init = 1;
+    ptr->info.client_init = 1;
+}
+
+/**
+ * The loopback transport does not hold any resources for each socket
+ */
+static void loopback_close (DS_Socket* ptr)
+{
+    (void) ptr;
+}
+
+/**
+ * Queues the given \a data on the output port of the socket
+ */
+static int loopback_send (const DS_Socket* ptr, const char* data, const int len)
+{
+    return push (ptr->out_port, data, len);
+}
+
+/**
+ * Copies the oldest datagram queued on the input port of the socket to
+ * the view buffer of the socket
+ */
+static int loopback_recv_view (DS_Socket* ptr, const char** data)
+{
+    *data = ptr->info.view;
+    return pop (ptr->in_port, ptr->info.view, sizeof (ptr->info.view));
+}
+
+/*
+ * In-process transport, sockets exchange datagrams through memory queues
+ * indexed by port number instead of using the network stack
+ */
+static const DS_Transport LoopbackTransport = {
+    "loopback",
+    &loopback_open,
+    &loopback_close,
+    &loopback_send,
+    &loopback_recv_view,
+    NULL,
+};
+
+/**
+ * Deletes every mailbox and their queued datagrams
+ */
+void Loopback_Close (void)
+{
+    pthread_mutex_lock (&mutex);
+
+    int i;
+    for (i = 0; i < MAX_MAILBOXES; ++i)
+        DS_FREE (mailboxes [i]);
+
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Returns the loopback transport, which connects the sockets of the LibDS
+ * with a simulated robot (or FMS) running in the same process.
+ *
+ * Each port behaves like a UDP port of the local host: data sent by a socket
+ * is queued on its output port, and a socket reads the datagrams queued on
+ * its input port. The simulated host uses \c DS_LoopbackRead() and
+ * \c DS_LoopbackWrite() to exchange data with the sockets.
+ */
+const DS_Transport* DS_LoopbackTransport (void)
+{
+    return &LoopbackTransport;
+}
+
+/**
+ * Discards all the datagrams queued on the given \a port
+ */
+void DS_LoopbackFlush (const int port)
+{
+    pthread_mutex_lock (&mutex);
+
+    Mailbox* box = get_mailbox (port, 0);
+    if (box) {
+        box->head = 0;
+        box->count = 0;
+    }
+
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Sends \a len bytes of \a data to the loopback sockets that listen on the
+ * given \a port.
+ *
+ * \returns number of bytes written on success, -1 on failure
+ */
+int DS_LoopbackWrite (const int port, const char* data, const int len)
+{
+    return push (port, data, len);
+}
+
+/**
+ * Reads the oldest datagram sent by the loopback sockets to the given
+ * \a port and copies up to \a size bytes of it to \a data.
+ *
+ * \returns number of bytes read, 0 if no datagram is available
+ */
+int DS_LoopbackRead (const int port, char* data, const int size)
+{
+    assert (data);
+    return pop (port, data, size);
+}
@@ -0,0 +1,1233 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "LibDS.h"
+#include "DS_Utils.h"
+#include "DS_Timer.h"
+#include "DS_Atomic.h"
+#include "DS_Context.h"
+#include "DS_Metrics.h"
+#include "DS_Realtime.h"
+#include "DS_Statistics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <pthread.h>
+
+#if !defined _WIN32
+    #include <unistd.h>
+    #include <sys/un.h>
+    #include <sys/time.h>
+    #include <sys/types.h>
+    #include <sys/select.h>
+    #include <sys/socket.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL 0
+#endif
+
+#define SPRINTF_S snprintf
+#if defined _WIN32 && !defined __MINGW32__
+    #undef  SPRINTF_S
+    #define SPRINTF_S sprintf_s
+#endif
+
+#define MAX_METRICS   128 /* Metrics registered by the application */
+#define MAX_BUCKETS    16 /* Upper bounds of a histogram (+Inf not included) */
+#define NAME_LENGTH    64
+#define LABEL_LENGTH   32
+#define HELP_LENGTH   128
+#define REQUEST_SIZE  256 /* Bytes read from a client of the metrics socket */
+#define CHANNEL_COUNT   4
+
+/**
+ * Built-in metrics, they are exported for each driver station of the
+ * process
+ */
+enum {
+    SENT_PACKETS = 0,
+    SENT_BYTES,
+    SEND_ERRORS,
+    RECEIVED_PACKETS,
+    RECEIVED_BYTES,
+    DECODE_ERRORS,
+    WATCHDOG_EXPIRATIONS,
+    TRIP_TIME,
+    SOCKET_DROPS,
+    LOOP_TIME,
+    LOOP_LATENESS,
+    EVENT_QUEUE_DEPTH,
+    BUILTIN_COUNT
+};
+
+/**
+ * Describes a built-in metric, the metrics with \c per_channel set have
+ * a sample for each channel
+ */
+typedef struct {
+    int type;
+    int per_channel;
+    const char* name;
+    const char* help;
+} Builtin;
+
+/**
+ * Holds the description and the values of a metric.
+ *
+ * The description is written once (when the metric is registered), the
+ * values are updated with relaxed atomic operations, so that updating a
+ * metric never takes a lock or allocates memory.
+ *
+ * The built-in metrics are only generated while exporting, their \c context
+ * holds the identifier of the driver station that they belong to.
+ */
+typedef struct {
+    int type;
+    int bucket_count;
+    double scale;
+    char name [NAME_LENGTH];
+    char context [LABEL_LENGTH];
+    char label_key [LABEL_LENGTH];
+    char label_value [LABEL_LENGTH];
+    char help [HELP_LENGTH];
+    uint64_t bounds [MAX_BUCKETS];
+
+    /* Value of a counter or gauge, sum of the observations of a histogram */
+    DS_CACHELINE_ALIGN volatile uint64_t value;
+    volatile uint64_t buckets [MAX_BUCKETS + 1];
+} Metric;
+
+/**
+ * Growable text buffer used to generate the exports, the buffer is given to
+ * the caller as a \c DS_String once the export is complete
+ */
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} Buffer;
+
+/**
+ * Upper bounds (in nanoseconds) of the built-in time histograms
+ */
+static const uint64_t time_bounds [] = {
+    10000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000,
+    10000000, 25000000, 50000000, 100000000, 250000000, 500000000,
+    1000000000
+};
+
+#define TIME_BUCKETS ((int) (sizeof (time_bounds) / sizeof (time_bounds [0])))
+
+/**
+ * Holds the sum and the bucket counts of a built-in time histogram
+ */
+typedef struct {
+    volatile uint64_t sum;
+    volatile uint64_t buckets [TIME_BUCKETS + 1];
+} Histogram;
+
+/**
+ * Holds the built-in metrics of a context that are not already counted by
+ * the statistics module (the traffic counters are read from it instead)
+ */
+typedef struct {
+    Histogram trip_time [CHANNEL_COUNT];
+    Histogram loop_time;
+    Histogram loop_lateness;
+    volatile uint64_t socket_drops;
+    volatile uint64_t event_queue_depth;
+} State;
+
+/**
+ * Holds the values of the built-in metrics of a context, read at the
+ * beginning of an export
+ */
+typedef struct {
+    uint64_t context;
+    DS_ChannelStats channels [CHANNEL_COUNT];
+    State state;
+} Snapshot;
+
+/**
+ * Holds the snapshots of every driver station of the process
+ */
+typedef struct {
+    Snapshot* items;
+    int count;
+    int capacity;
+} SnapshotList;
+
+/*
+ * Descriptions of the built-in metrics
+ */
+static const Builtin builtins [BUILTIN_COUNT] = {
+    {DS_METRIC_COUNTER,   1, "ds_sent_packets_total",
+     "Packets sent through the channel"},
+    {DS_METRIC_COUNTER,   1, "ds_sent_bytes_total",
+     "Bytes sent through the channel"},
+    {DS_METRIC_COUNTER,   1, "ds_send_errors_total",
+     "Send operations that failed"},
+    {DS_METRIC_COUNTER,   1, "ds_received_packets_total",
+     "Packets received through the channel"},
+    {DS_METRIC_COUNTER,   1, "ds_received_bytes_total",
+     "Bytes received through the channel"},
+    {DS_METRIC_COUNTER,   1, "ds_decode_errors_total",
+     "Received packets that the protocol could not interpret"},
+    {DS_METRIC_COUNTER,   1, "ds_watchdog_expirations_total",
+     "Times the communications of the channel were lost"},
+    {DS_METRIC_HISTOGRAM, 1, "ds_round_trip_seconds",
+     "Time between sending a packet and receiving its echo"},
+    {DS_METRIC_COUNTER,   0, "ds_socket_drops_total",
+     "Received datagrams overwritten before they were read"},
+    {DS_METRIC_HISTOGRAM, 0, "ds_loop_iteration_seconds",
+     "Time spent sending, reading and checking the watchdogs"},
+    {DS_METRIC_HISTOGRAM, 0, "ds_loop_lateness_seconds",
+     "Delay between the deadline and the start of a loop iteration"},
+    {DS_METRIC_GAUGE,     0, "ds_event_queue_depth",
+     "Events waiting to be polled by the application"},
+};
+
+/*
+ * Metric registry
+ */
+static Metric metrics [MAX_METRICS];
+static volatile uint64_t metric_count = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Values of the channel label
+ */
+static const char* channels [CHANNEL_COUNT] = {"fms", "radio", "robot", "netconsole"};
+
+/*
+ * Metrics socket server
+ */
+static int server_fd = -1;
+static pthread_t server;
+static volatile int serving = 0;
+static char server_path [108] = {0};
+static pthread_mutex_t server_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the built-in metrics of the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), NULL, NULL);
+}
+
+/**
+ * Returns \c 1 if the given \a name is a valid Prometheus metric name (or
+ * label name if \a label is set)
+ */
+static int valid_name (const char* name, const int length, const int label)
+{
+    int i;
+    int len = (int) strlen (name);
+
+    if (len == 0 || len >= length)
+        return 0;
+
+    for (i = 0; i < len; ++i) {
+        char c = name [i];
+        int alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+        int digit = (c >= '0' && c <= '9');
+
+        if (!alpha && !(digit && i > 0) && !(c == ':' && !label))
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Splits the given "key=value" \a label into the label of the \a metric.
+ * A \c NULL or empty \a label leaves the metric without labels.
+ *
+ * \returns \c 1 on success, \c 0 if the label is invalid
+ */
+static int set_label (Metric* metric, const char* label)
+{
+    metric->label_key [0] = '\0';
+    metric->label_value [0] = '\0';
+
+    if (!label || !label [0])
+        return 1;
+
+    const char* equals = strchr (label, '=');
+    if (!equals || equals == label || equals - label >= LABEL_LENGTH)
+        return 0;
+
+    memcpy (metric->label_key, label, (size_t) (equals - label));
+    metric->label_key [equals - label] = '\0';
+
+    const char* value = equals + 1;
+    if (strlen (value) >= LABEL_LENGTH || strpbrk (value, "\"\\\n"))
+        return 0;
+
+    strcpy (metric->label_value, value);
+    return valid_name (metric->label_key, LABEL_LENGTH, 1);
+}
+
+/**
+ * Returns the identifier of the registered metric with the given \a name
+ * and \a label, or \c -1 if there is none.
+ * This function must be called with the registry mutex locked.
+ */
+static int find_metric (const char* name, const Metric* label)
+{
+    int i;
+    int count = (int) DS_AtomicLoad64 (&metric_count);
+
+    for (i = 0; i < count; ++i) {
+        if (strcmp (metrics [i].name, name) == 0
+                && strcmp (metrics [i].label_key, label->label_key) == 0
+                && strcmp (metrics [i].label_value, label->label_value) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * Adds a metric of the given \a type to the registry. If a metric with the
+ * same name and label already exists, its identifier is returned instead.
+ *
+ * \returns the identifier of the metric, or \c -1 on failure
+ */
+static int register_metric (const int type,
+                            const char* name,
+                            const char* label,
+                            const char* help,
+                            const uint64_t* bounds,
+                            const int count,
+                            const double scale)
+{
+    int i;
+    int id = -1;
+    Metric desc;
+
+    /* Check the description */
+    if (!name || !valid_name (name, NAME_LENGTH, 0) || !set_label (&desc, label))
+        return -1;
+    if (type == DS_METRIC_HISTOGRAM) {
+        if (!bounds || count < 1 || count > MAX_BUCKETS)
+            return -1;
+
+        for (i = 1; i < count; ++i) {
+            if (bounds [i] <= bounds [i - 1])
+                return -1;
+        }
+    }
+
+    pthread_mutex_lock (&mutex);
+
+    /* Metric already registered (a metric name cannot change its type) */
+    int existing = find_metric (name, &desc);
+    if (existing >= 0) {
+        id = (metrics [existing].type == type) ? existing : -1;
+        pthread_mutex_unlock (&mutex);
+        return id;
+    }
+
+    for (i = 0; i < (int) DS_AtomicLoad64 (&metric_count); ++i) {
+        if (strcmp (metrics [i].name, name) == 0 && metrics [i].type != type) {
+            pthread_mutex_unlock (&mutex);
+            return -1;
+        }
+    }
+
+    /* Fill the description and publish the metric */
+    id = (int) DS_AtomicLoad64 (&metric_count);
+    if (id < MAX_METRICS) {
+        Metric* metric = &metrics [id];
+
+        metric->type = type;
+        metric->scale = (scale > 0) ? scale : 1;
+        metric->bucket_count = (type == DS_METRIC_HISTOGRAM) ? count : 0;
+        strcpy (metric->name, name);
+        strcpy (metric->label_key, desc.label_key);
+        strcpy (metric->label_value, desc.label_value);
+        SPRINTF_S (metric->help, HELP_LENGTH, "%s", help ? help : "");
+
+        if (type == DS_METRIC_HISTOGRAM)
+            memcpy (metric->bounds, bounds, sizeof (uint64_t) * (size_t) count);
+
+        DS_AtomicStoreRelease64 (&metric_count, (uint64_t) id + 1);
+    }
+
+    else
+        id = -1;
+
+    pthread_mutex_unlock (&mutex);
+    return id;
+}
+
+/**
+ * Returns \c 1 if the given \a id is a registered metric of the given
+ * \a type
+ */
+static int valid_metric (const int id, const int type)
+{
+    if (id < 0 || (uint64_t) id >= DS_AtomicLoadAcquire64 (&metric_count))
+        return 0;
+
+    return metrics [id].type == type;
+}
+
+/**
+ * Counts the given \a value in the histogram with the given \a buckets and
+ * \a sum, using the given \a bounds
+ */
+static void observe (volatile uint64_t* buckets, volatile uint64_t* sum,
+                     const uint64_t* bounds, const int count,
+                     const uint64_t value)
+{
+    int bucket = 0;
+    while (bucket < count && value > bounds [bucket])
+        ++bucket;
+
+    DS_AtomicAdd64 (&buckets [bucket], 1);
+    DS_AtomicAdd64 (sum, value);
+}
+
+/**
+ * Copies the \a source histogram to \a target
+ */
+static void copy_histogram (Histogram* target, const Histogram* source)
+{
+    int i;
+    for (i = 0; i <= TIME_BUCKETS; ++i)
+        target->buckets [i] = DS_AtomicLoad64 (&source->buckets [i]);
+
+    target->sum = DS_AtomicLoad64 (&source->sum);
+}
+
+/**
+ * Adds a snapshot of the built-in metrics of the current context to the
+ * given list (a \c SnapshotList), this function is called for each context.
+ * Contexts without a running driver station are skipped.
+ */
+static void take_snapshot (void* data)
+{
+    int i;
+    SnapshotList* list = (SnapshotList*) data;
+
+    if (!DS_Initialized())
+        return;
+
+    /* Grow the list */
+    if (list->count == list->capacity) {
+        int capacity = DS_Max (list->capacity * 2, 8);
+        Snapshot* items = (Snapshot*) realloc (list->items,
+                                               sizeof (Snapshot) * (size_t) capacity);
+        if (!items)
+            return;
+
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    /* Read the traffic counters and the other metrics of the context */
+    DS_Stats stats;
+    State* s = state();
+    Snapshot* snapshot = &list->items [list->count++];
+
+    DS_GetStatistics (&stats);
+    snapshot->context = DS_ContextId (DS_CurrentContext());
+    snapshot->channels [DS_CHANNEL_FMS] = stats.fms;
+    snapshot->channels [DS_CHANNEL_RADIO] = stats.radio;
+    snapshot->channels [DS_CHANNEL_ROBOT] = stats.robot;
+    snapshot->channels [DS_CHANNEL_NETCONSOLE] = stats.netconsole;
+
+    for (i = 0; i < CHANNEL_COUNT; ++i)
+        copy_histogram (&snapshot->state.trip_time [i], &s->trip_time [i]);
+
+    copy_histogram (&snapshot->state.loop_time, &s->loop_time);
+    copy_histogram (&snapshot->state.loop_lateness, &s->loop_lateness);
+    snapshot->state.socket_drops = DS_AtomicLoad64 (&s->socket_drops);
+    snapshot->state.event_queue_depth = DS_AtomicLoad64 (&s->event_queue_depth);
+}
+
+/**
+ * Fills the given \a metric with the built-in metric of the given \a type
+ * (and \a channel, if the metric has one) of the given \a snapshot
+ */
+static void builtin_metric (Metric* metric, const int type,
+                            const Snapshot* snapshot, const int channel)
+{
+    int i;
+    const Histogram* histogram = NULL;
+    const Builtin* builtin = &builtins [type];
+    const DS_ChannelStats* stats = &snapshot->channels [channel];
+
+    /* Write the description */
+    metric->type = builtin->type;
+    metric->scale = (builtin->type == DS_METRIC_HISTOGRAM) ? 1e-9 : 1;
+    metric->bucket_count = (builtin->type == DS_METRIC_HISTOGRAM) ? TIME_BUCKETS : 0;
+    SPRINTF_S (metric->name, NAME_LENGTH, "%s", builtin->name);
+    SPRINTF_S (metric->help, HELP_LENGTH, "%s", builtin->help);
+    SPRINTF_S (metric->context, LABEL_LENGTH, "%llu",
+               (unsigned long long) snapshot->context);
+    SPRINTF_S (metric->label_key, LABEL_LENGTH, "%s",
+               builtin->per_channel ? "channel" : "");
+    SPRINTF_S (metric->label_value, LABEL_LENGTH, "%s",
+               builtin->per_channel ? channels [channel] : "");
+
+    /* Get the value */
+    switch (type) {
+    case SENT_PACKETS:
+        metric->value = stats->sent_packets;
+        break;
+    case SENT_BYTES:
+        metric->value = stats->sent_bytes;
+        break;
+    case SEND_ERRORS:
+        metric->value = stats->socket_errors;
+        break;
+    case RECEIVED_PACKETS:
+        metric->value = stats->received_packets;
+        break;
+    case RECEIVED_BYTES:
+        metric->value = stats->received_bytes;
+        break;
+    case DECODE_ERRORS:
+        metric->value = stats->decode_failures;
+        break;
+    case WATCHDOG_EXPIRATIONS:
+        metric->value = stats->watchdog_expirations;
+        break;
+    case SOCKET_DROPS:
+        metric->value = snapshot->state.socket_drops;
+        break;
+    case EVENT_QUEUE_DEPTH:
+        metric->value = snapshot->state.event_queue_depth;
+        break;
+    case TRIP_TIME:
+        histogram = &snapshot->state.trip_time [channel];
+        break;
+    case LOOP_TIME:
+        histogram = &snapshot->state.loop_time;
+        break;
+    case LOOP_LATENESS:
+        histogram = &snapshot->state.loop_lateness;
+        break;
+    }
+
+    /* Copy the histogram */
+    if (histogram) {
+        metric->value = histogram->sum;
+        memcpy (metric->bounds, time_bounds, sizeof (time_bounds));
+        for (i = 0; i <= TIME_BUCKETS; ++i)
+            metric->buckets [i] = histogram->buckets [i];
+    }
+}
+
+/**
+ * Appends the given \a length bytes of \a text to the \a output buffer
+ */
+static void append_text (Buffer* output, const char* text, const size_t length)
+{
+    if (output->len + length + 1 > output->capacity) {
+        size_t capacity = DS_Max (output->capacity * 2, output->len + length + 1);
+        char* data = (char*) realloc (output->data, capacity);
+        if (!data)
+            return;
+
+        output->data = data;
+        output->capacity = capacity;
+    }
+
+    memcpy (output->data + output->len, text, length);
+    output->len += length;
+    output->data [output->len] = '\0';
+}
+
+/**
+ * Appends the given formatted text to the \a output buffer
+ */
+static void append (Buffer* output, const char* format, ...)
+{
+    char text [256];
+
+    va_list args;
+    va_start (args, format);
+    int length = vsnprintf (text, sizeof (text), format, args);
+    va_end (args);
+
+    if (length > 0)
+        append_text (output, text, DS_Min ((size_t) length, sizeof (text) - 1));
+}
+
+/**
+ * Appends the given \a text to the \a output string, escaping the backslashes
+ * and line breaks (and the quotes and control characters if \a json is set)
+ */
+static void append_escaped (Buffer* output, const char* text, const int json)
+{
+    const char* c;
+    for (c = text; *c; ++c) {
+        if (*c == '\\')
+            append_text (output, "\\\\", 2);
+        else if (*c == '\n')
+            append_text (output, "\\n", 2);
+        else if (json && *c == '"')
+            append_text (output, "\\\"", 2);
+        else if (json && (unsigned char) *c < 0x20)
+            append (output, "\\u%04x", (unsigned char) *c);
+        else
+            append_text (output, c, 1);
+    }
+}
+
+/**
+ * Returns the name of the given metric \a type
+ */
+static const char* type_name (const int type)
+{
+    switch (type) {
+    case DS_METRIC_GAUGE:
+        return "gauge";
+    case DS_METRIC_HISTOGRAM:
+        return "histogram";
+    default:
+        return "counter";
+    }
+}
+
+/**
+ * Writes a snapshot of the buckets of the given histogram \a metric in
+ * \a buckets (as cumulative counts) and returns the total count
+ */
+static uint64_t read_buckets (const Metric* metric, uint64_t* buckets)
+{
+    int i;
+    uint64_t total = 0;
+
+    for (i = 0; i <= metric->bucket_count; ++i) {
+        total += DS_AtomicLoad64 (&metric->buckets [i]);
+        buckets [i] = total;
+    }
+
+    return total;
+}
+
+/**
+ * Writes the labels of the given \a metric to \a pairs as a list of
+ * key="value" pairs separated by commas (empty if there are none)
+ */
+static void label_pairs (const Metric* metric, char* pairs, const size_t size)
+{
+    pairs [0] = '\0';
+
+    if (metric->context [0] && metric->label_key [0])
+        SPRINTF_S (pairs, size, "context=\"%s\",%s=\"%s\"", metric->context,
+                   metric->label_key, metric->label_value);
+
+    else if (metric->context [0])
+        SPRINTF_S (pairs, size, "context=\"%s\"", metric->context);
+
+    else if (metric->label_key [0])
+        SPRINTF_S (pairs, size, "%s=\"%s\"", metric->label_key,
+                   metric->label_value);
+}
+
+/**
+ * Appends the HELP and TYPE lines of a metric in the Prometheus text format
+ */
+static void prometheus_description (Buffer* output, const char* name,
+                                    const char* help, const int type)
+{
+    append (output, "# HELP %s ", name);
+    append_escaped (output, help, 0);
+    append (output, "\n# TYPE %s %s\n", name, type_name (type));
+}
+
+/**
+ * Appends the samples of the given \a metric in the Prometheus text format
+ */
+static void prometheus_samples (Buffer* output, const Metric* metric)
+{
+    int i;
+    char pairs [LABEL_LENGTH * 4 + 16];
+    char labels [LABEL_LENGTH * 4 + 16] = {0};
+    char prefix [LABEL_LENGTH * 4 + 16] = {0};
+
+    label_pairs (metric, pairs, sizeof (pairs));
+    if (pairs [0]) {
+        SPRINTF_S (labels, sizeof (labels), "{%s}", pairs);
+        SPRINTF_S (prefix, sizeof (prefix), "%s,", pairs);
+    }
+
+    uint64_t value = DS_AtomicLoad64 (&metric->value);
+
+    if (metric->type == DS_METRIC_COUNTER)
+        append (output, "%s%s %llu\n", metric->name, labels,
+                (unsigned long long) value);
+
+    else if (metric->type == DS_METRIC_GAUGE)
+        append (output, "%s%s %lld\n", metric->name, labels,
+                (long long) (int64_t) value);
+
+    else {
+        uint64_t buckets [MAX_BUCKETS + 1];
+        uint64_t total = read_buckets (metric, buckets);
+
+        for (i = 0; i < metric->bucket_count; ++i)
+            append (output, "%s_bucket{%sle=\"%.9g\"} %llu\n", metric->name,
+                    prefix, (double) metric->bounds [i] * metric->scale,
+                    (unsigned long long) buckets [i]);
+
+        append (output, "%s_bucket{%sle=\"+Inf\"} %llu\n", metric->name,
+                prefix, (unsigned long long) total);
+        append (output, "%s_sum%s %.9g\n", metric->name, labels,
+                (double) value * metric->scale);
+        append (output, "%s_count%s %llu\n", metric->name, labels,
+                (unsigned long long) total);
+    }
+}
+
+/**
+ * Appends the built-in metrics of every \a snapshot and every registered
+ * metric in the Prometheus text exposition format, the metrics that share
+ * a name are grouped under a single description
+ */
+static void export_prometheus (Buffer* output, const SnapshotList* snapshots,
+                               const int count)
+{
+    int i, j, k;
+    Metric metric;
+
+    /* Write the built-in metrics of each driver station */
+    for (i = 0; i < BUILTIN_COUNT; ++i) {
+        prometheus_description (output, builtins [i].name, builtins [i].help,
+                                builtins [i].type);
+
+        for (j = 0; j < snapshots->count; ++j) {
+            for (k = 0; k < (builtins [i].per_channel ? CHANNEL_COUNT : 1); ++k) {
+                builtin_metric (&metric, i, &snapshots->items [j], k);
+                prometheus_samples (output, &metric);
+            }
+        }
+    }
+
+    /* Write the metrics of the application */
+    for (i = 0; i < count; ++i) {
+        /* Skip metrics that were written with an earlier metric */
+        for (j = 0; j < i; ++j) {
+            if (strcmp (metrics [j].name, metrics [i].name) == 0)
+                break;
+        }
+
+        if (j < i)
+            continue;
+
+        /* Write the description */
+        prometheus_description (output, metrics [i].name, metrics [i].help,
+                                metrics [i].type);
+
+        /* Write the samples of every metric with the same name */
+        for (j = i; j < count; ++j) {
+            if (strcmp (metrics [j].name, metrics [i].name) == 0)
+                prometheus_samples (output, &metrics [j]);
+        }
+    }
+}
+
+/**
+ * Appends the given \a metric as a JSON object, preceded by a comma unless
+ * it is the \a first metric
+ */
+static void json_metric (Buffer* output, const Metric* metric, const int first)
+{
+    int j;
+    uint64_t value = DS_AtomicLoad64 (&metric->value);
+
+    /* Write the description */
+    append (output, "%s{\"name\":\"%s\",\"type\":\"%s\",\"help\":\"",
+            first ? "" : ",", metric->name, type_name (metric->type));
+    append_escaped (output, metric->help, 1);
+    append (output, "\",\"labels\":{");
+    if (metric->context [0])
+        append (output, "\"context\":\"%s\"%s", metric->context,
+                metric->label_key [0] ? "," : "");
+    if (metric->label_key [0])
+        append (output, "\"%s\":\"%s\"", metric->label_key, metric->label_value);
+    append (output, "},");
+
+    /* Write the values */
+    if (metric->type == DS_METRIC_COUNTER)
+        append (output, "\"value\":%llu}", (unsigned long long) value);
+
+    else if (metric->type == DS_METRIC_GAUGE)
+        append (output, "\"value\":%lld}", (long long) (int64_t) value);
+
+    else {
+        uint64_t buckets [MAX_BUCKETS + 1];
+        uint64_t total = read_buckets (metric, buckets);
+
+        append (output, "\"count\":%llu,\"sum\":%.9g,\"buckets\":[",
+                (unsigned long long) total, (double) value * metric->scale);
+
+        for (j = 0; j < metric->bucket_count; ++j)
+            append (output, "{\"le\":%.9g,\"count\":%llu},",
+                    (double) metric->bounds [j] * metric->scale,
+                    (unsigned long long) buckets [j]);
+
+        append (output, "{\"le\":\"+Inf\",\"count\":%llu}]}",
+                (unsigned long long) total);
+    }
+}
+
+/**
+ * Appends the built-in metrics of every \a snapshot and every registered
+ * metric as a JSON document
+ */
+static void export_json (Buffer* output, const SnapshotList* snapshots,
+                         const int count)
+{
+    int i, j, k;
+    int first = 1;
+    Metric metric;
+
+    append (output, "{\"metrics\":[");
+
+    /* Write the built-in metrics of each driver station */
+    for (i = 0; i < BUILTIN_COUNT; ++i) {
+        for (j = 0; j < snapshots->count; ++j) {
+            for (k = 0; k < (builtins [i].per_channel ? CHANNEL_COUNT : 1); ++k) {
+                builtin_metric (&metric, i, &snapshots->items [j], k);
+                json_metric (output, &metric, first);
+                first = 0;
+            }
+        }
+    }
+
+    /* Write the metrics of the application */
+    for (i = 0; i < count; ++i) {
+        json_metric (output, &metrics [i], first);
+        first = 0;
+    }
+
+    append (output, "]}\n");
+}
+
+#if !defined _WIN32
+
+/**
+ * Writes the given \a length bytes of \a data to the \a client socket
+ */
+static void send_all (const int client, const char* data, const size_t length)
+{
+    size_t sent = 0;
+    while (sent < length) {
+        ssize_t bytes = send (client, data + sent, length - sent, MSG_NOSIGNAL);
+        if (bytes <= 0)
+            break;
+
+        sent += (size_t) bytes;
+    }
+}
+
+/**
+ * Answers a client of the metrics socket. A client writes the format that
+ * it wants ("prometheus" or "json") and reads the metrics until the socket
+ * is closed. HTTP requests are also answered (e.g. from
+ * "curl --unix-socket"), the JSON format is used if the path ends with
+ * "json".
+ */
+static void serve_client (const int client)
+{
+    char request [REQUEST_SIZE] = {0};
+
+    /* Read the request (but do not let a client block the server) */
+    struct timeval timeout = {1, 0};
+    setsockopt (client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+    ssize_t size = recv (client, request, sizeof (request) - 1, 0);
+    request [size > 0 ? size : 0] = '\0';
+
+    /* Get the requested format */
+    int http = (strncmp (request, "GET ", 4) == 0);
+    DS_MetricsFormat format = DS_METRICS_PROMETHEUS;
+    if (http) {
+        char* end = strpbrk (request + 4, " \r\n?");
+        if (end && end - request >= 8 && strncmp (end - 4, "json", 4) == 0)
+            format = DS_METRICS_JSON;
+    }
+
+    else if (strncmp (request, "json", 4) == 0)
+        format = DS_METRICS_JSON;
+
+    /* Generate the response */
+    Buffer header = {NULL, 0, 0};
+    DS_String body = DS_MetricsExport (format);
+    if (http)
+        append (&header, "HTTP/1.0 200 OK\r\nContent-Type: %s\r\n"
+                "Content-Length: %d\r\n\r\n", format == DS_METRICS_JSON ?
+                "application/json" : "text/plain; version=0.0.4",
+                DS_StrLen (&body));
+
+    /* Write the response */
+    send_all (client, header.data, header.len);
+    send_all (client, body.buf, body.len);
+
+    free (header.data);
+    DS_StrRmBuf (&body);
+}
+
+/**
+ * Accepts the clients of the metrics socket until the server is stopped
+ */
+static void* run_server (void* ptr)
+{
+    (void) ptr;
+    Realtime_ConfigureThread (DS_THREAD_IO, "ds-metrics");
+
+    while (serving) {
+        fd_set set;
+        FD_ZERO (&set);
+        FD_SET (server_fd, &set);
+
+        /* Wake up periodically to check if the server was stopped */
+        struct timeval timeout = {0, 100000};
+        if (select (server_fd + 1, &set, NULL, NULL, &timeout) <= 0)
+            continue;
+
+        int client = accept (server_fd, NULL, NULL);
+        if (client >= 0) {
+            serve_client (client);
+            close (client);
+        }
+    }
+
+    return NULL;
+}
+
+#endif
+
+/**
+ * Stops the metrics socket, this function is called when the last driver
+ * station of the process is closed
+ */
+void Metrics_Close (void)
+{
+    DS_MetricsStopServing();
+}
+
+/**
+ * Registers the round trip \a time (in nanoseconds) of a packet of the given
+ * \a channel in the current context
+ */
+void Metrics_TripTime (const DS_Channel channel, const uint64_t time)
+{
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    Histogram* h = &state()->trip_time [channel];
+    observe (h->buckets, &h->sum, time_bounds, TIME_BUCKETS, time);
+}
+
+/**
+ * Registers the \a duration of an iteration of the protocol loop and its
+ * \a lateness (the time between its deadline and its start), in nanoseconds
+ */
+void Metrics_LoopIteration (const uint64_t duration, const uint64_t lateness)
+{
+    State* s = state();
+
+    observe (s->loop_time.buckets, &s->loop_time.sum,
+             time_bounds, TIME_BUCKETS, duration);
+    observe (s->loop_lateness.buckets, &s->loop_lateness.sum,
+             time_bounds, TIME_BUCKETS, lateness);
+}
+
+/**
+ * Registers a received datagram that was replaced by a newer one before the
+ * library could read it
+ */
+void Metrics_SocketDrop (void)
+{
+    DS_AtomicAdd64 (&state()->socket_drops, 1);
+}
+
+/**
+ * Adds the given \a count to the number of events waiting in the event
+ * queue of the current context (a negative \a count removes events)
+ */
+void Metrics_EventQueued (const int count)
+{
+    DS_AtomicAdd64 (&state()->event_queue_depth, (uint64_t) (int64_t) count);
+}
+
+/**
+ * Registers a counter with the given \a name (e.g. "robot_commands_total").
+ *
+ * The \a label is either \c NULL or a "key=value" string (e.g.
+ * "team=3794"), metrics with the same name and different labels are exported
+ * together. Registering a metric that already exists returns its identifier.
+ *
+ * \returns the identifier of the counter, or \c -1 if the name or label are
+ *          invalid, or if the registry is full
+ */
+int DS_MetricCounter (const char* name, const char* label, const char* help)
+{
+    return register_metric (DS_METRIC_COUNTER, name, label, help, NULL, 0, 1);
+}
+
+/**
+ * Registers a gauge with the given \a name, see \c DS_MetricCounter()
+ */
+int DS_MetricGauge (const char* name, const char* label, const char* help)
+{
+    return register_metric (DS_METRIC_GAUGE, name, label, help, NULL, 0, 1);
+}
+
+/**
+ * Registers a histogram with the given \a name, see \c DS_MetricCounter().
+ *
+ * The histogram counts the observations that are lower or equal to each of
+ * the given \a bounds (up to 16 increasing values, the "+Inf" bucket is
+ * added automatically). The bounds and the sum of the observations are
+ * multiplied by \a scale when exported, e.g. observations in nanoseconds
+ * are exported in seconds with a \a scale of 1e-9.
+ */
+int DS_MetricHistogram (const char* name, const char* label, const char* help,
+                        const uint64_t* bounds, const int count,
+                        const double scale)
+{
+    return register_metric (DS_METRIC_HISTOGRAM, name, label, help,
+                            bounds, count, scale);
+}
+
+/**
+ * Adds the given \a value to the counter or gauge with the given \a id.
+ * Counters ignore negative values.
+ *
+ * This function takes no locks and does not allocate memory, so it can be
+ * called from time-critical code.
+ */
+void DS_MetricAdd (const int id, const int64_t value)
+{
+    if (valid_metric (id, DS_METRIC_GAUGE)
+            || (valid_metric (id, DS_METRIC_COUNTER) && value >= 0))
+        DS_AtomicAdd64 (&metrics [id].value, (uint64_t) value);
+}
+
+/**
+ * Changes the value of the gauge with the given \a id
+ */
+void DS_MetricSet (const int id, const int64_t value)
+{
+    if (valid_metric (id, DS_METRIC_GAUGE))
+        DS_AtomicStore64 (&metrics [id].value, (uint64_t) value);
+}
+
+/**
+ * Counts the given \a value in the histogram with the given \a id, this
+ * function takes no locks and does not allocate memory
+ */
+void DS_MetricObserve (const int id, const uint64_t value)
+{
+    if (valid_metric (id, DS_METRIC_HISTOGRAM))
+        observe (metrics [id].buckets, &metrics [id].value,
+                 metrics [id].bounds, metrics [id].bucket_count, value);
+}
+
+/**
+ * Returns the value of the counter or gauge with the given \a id (gauges
+ * should be cast to \c int64_t), or the number of observations of the
+ * histogram with the given \a id
+ */
+uint64_t DS_MetricValue (const int id)
+{
+    if (valid_metric (id, DS_METRIC_HISTOGRAM)) {
+        uint64_t buckets [MAX_BUCKETS + 1];
+        return read_buckets (&metrics [id], buckets);
+    }
+
+    if (valid_metric (id, DS_METRIC_COUNTER) || valid_metric (id, DS_METRIC_GAUGE))
+        return DS_AtomicLoad64 (&metrics [id].value);
+
+    return 0;
+}
+
+/**
+ * Returns a snapshot of every metric in the given \a format.
+ *
+ * The built-in metrics (packets, bytes, errors, socket drops, loop timing,
+ * round trip times and event queue depth) are exported for each initialized
+ * driver station of the process, with a \c context label that holds the
+ * identifier returned by \c DS_ContextId(). The traffic counters are read
+ * from \c DS_GetStatistics(), so they restart when a protocol is loaded.
+ *
+ * The values are read while the protocols update them, so each value is
+ * consistent by itself, but two values may belong to slightly different
+ * moments.
+ *
+ * The returned string must be freed with \c DS_StrRmBuf()
+ */
+DS_String DS_MetricsExport (const DS_MetricsFormat format)
+{
+    Buffer buffer = {NULL, 0, 0};
+    SnapshotList snapshots = {NULL, 0, 0};
+    int count = (int) DS_AtomicLoadAcquire64 (&metric_count);
+
+    /* Read the built-in metrics of every driver station */
+    Context_ForEach (&take_snapshot, &snapshots);
+
+    append_text (&buffer, "", 0);
+    if (format == DS_METRICS_JSON)
+        export_json (&buffer, &snapshots, count);
+    else
+        export_prometheus (&buffer, &snapshots, count);
+
+    free (snapshots.items);
+
+    DS_String output;
+    output.buf = buffer.data;
+    output.len = buffer.len;
+    return output;
+}
+
+/**
+ * Writes a snapshot of every metric in the given \a format to the file at the
+ * given \a path. The file is replaced atomically, so that a collector (e.g.
+ * the textfile collector of the Prometheus node exporter) never reads a
+ * partial file.
+ *
+ * \returns \c 1 on success, \c 0 on failure
+ */
+int DS_MetricsWriteFile (const char* path, const DS_MetricsFormat format)
+{
+    assert (path);
+
+    char temp [512];
+    SPRINTF_S (temp, sizeof (temp), "%s.tmp", path);
+
+    FILE* file = fopen (temp, "wb");
+    if (!file)
+        return 0;
+
+    DS_String data = DS_MetricsExport (format);
+    int ok = (fwrite (data.buf, 1, data.len, file) == data.len);
+    ok &= (fclose (file) == 0);
+    DS_StrRmBuf (&data);
+
+#if defined _WIN32
+    remove (path);
+#endif
+
+    if (!ok || rename (temp, path) != 0) {
+        remove (temp);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Starts answering metric requests on a Unix domain socket at the given
+ * \a path. A client writes "prometheus" or "json" and reads the metrics in
+ * that format, HTTP clients are also supported, e.g.:
+ *
+ *     curl --unix-socket /tmp/ds.sock http://localhost/metrics
+ *
+ * Any file at \a path is replaced. If the socket was already open, it is
+ * closed first.
+ *
+ * \returns \c 1 on success, \c 0 on failure
+ */
+int DS_MetricsServe (const char* path)
+{
+    assert (path);
+
+    DS_MetricsStopServing();
+
+#if defined _WIN32
+    fprintf (stderr, "DS_MetricsServe: not supported on Windows\n");
+    return 0;
+#else
+    struct sockaddr_un address;
+    if (strlen (path) >= sizeof (address.sun_path)
+            || strlen (path) >= sizeof (server_path))
+        return 0;
+
+    pthread_mutex_lock (&server_mutex);
+
+    /* Open the socket */
+    memset (&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    strcpy (address.sun_path, path);
+    unlink (path);
+
+    server_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0
+            || bind (server_fd, (struct sockaddr*) &address, sizeof (address)) != 0
+            || listen (server_fd, 8) != 0) {
+        if (server_fd >= 0)
+            close (server_fd);
+
+        server_fd = -1;
+        pthread_mutex_unlock (&server_mutex);
+        return 0;
+    }
+
+    /* Start the server thread */
+    strcpy (server_path, path);
+    serving = 1;
+    if (pthread_create (&server, NULL, &run_server, NULL) != 0) {
+        serving = 0;
+        close (server_fd);
+        unlink (server_path);
+        server_fd = -1;
+    }
+
+    pthread_mutex_unlock (&server_mutex);
+    return serving;
+#endif
+}
+
+/**
+ * Closes the metrics socket opened with \c DS_MetricsServe()
+ */
+void DS_MetricsStopServing (void)
+{
+#if !defined _WIN32
+    pthread_mutex_lock (&server_mutex);
+
+    if (serving) {
+        serving = 0;
+        pthread_join (server, NULL);
+
+        close (server_fd);
+        unlink (server_path);
+        server_fd = -1;
+    }
+
+    pthread_mutex_unlock (&server_mutex);
+#endif
+}
@@ -0,0 +1,195 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "DS_Packet.h"
+
+#include <assert.h>
+
+/**
+ * Returns the position of the lowest bit set in the given \a mask
+ */
+static int mask_shift (uint32_t mask)
+{
+    int shift = 0;
+    while (mask && !(mask & 1)) {
+        mask >>= 1;
+        ++shift;
+    }
+
+    return shift;
+}
+
+/**
+ * Returns the bits used by the given \a field
+ */
+static uint32_t field_mask (const DS_Field* field)
+{
+    if (field->mask)
+        return field->mask;
+
+    if (field->width >= 4)
+        return 0xffffffff;
+
+    return (1u << (field->width * 8)) - 1;
+}
+
+/**
+ * Returns the position of the n-th byte (from the most significant byte)
+ * of the given \a field
+ */
+static int byte_offset (const DS_Field* field, const int n)
+{
+    if (field->endianness == DS_LITTLE_ENDIAN)
+        return field->offset + field->width - 1 - n;
+
+    return field->offset + n;
+}
+
+/**
+ * Writes the value of every field of the \a layout to the given \a data
+ * buffer, which must hold at least \c layout->size bytes. The \a source
+ * is given to the \c get function of each field.
+ *
+ * Masked fields only change their own bits, so the rest of the byte(s)
+ * keep the value written by other fields (or by the protocol).
+ */
+void DS_PacketEncode (const DS_PacketLayout* layout, char* data,
+                      const void* source)
+{
+    assert (layout);
+    assert (data);
+
+    int i, n;
+    for (i = 0; i < layout->count; ++i) {
+        const DS_Field* field = &layout->fields [i];
+
+        /* Get the value to encode */
+        uint32_t mask = field_mask (field);
+        uint32_t value = field->get ? (uint32_t) field->get (source) : field->value;
+        value = (value << mask_shift (mask)) & mask;
+
+        /* Write each byte, keeping the bits that do not belong to the field */
+        for (n = 0; n < field->width; ++n) {
+            int shift = (field->width - 1 - n) * 8;
+            int pos = byte_offset (field, n);
+            uint8_t byte_mask = (uint8_t) (mask >> shift);
+
+            if (byte_mask == 0xff)
+                data [pos] = (char) (value >> shift);
+
+            else if (byte_mask) {
+                uint8_t byte = (uint8_t) data [pos] & ~byte_mask;
+                data [pos] = (char) (byte | ((uint8_t) (value >> shift) & byte_mask));
+            }
+        }
+    }
+}
+
+/**
+ * Reads every field of the \a layout from the given \a data and passes its
+ * value to the setter function of the field.
+ *
+ * Returns 0 if the packet is smaller than \c layout->size, 1 otherwise.
+ * Bytes that lie outside the packet are read as zero.
+ */
+int DS_PacketDecode (const DS_PacketLayout* layout, const DS_String* data)
+{
+    assert (layout);
+
+    /* Data pointer is invalid */
+    if (!data)
+        return 0;
+
+    /* Packet is too small */
+    int len = DS_StrLen (data);
+    if (len < layout->size)
+        return 0;
+
+    int i, n;
+    const uint8_t* bytes = (const uint8_t*) data->buf;
+    for (i = 0; i < layout->count; ++i) {
+        const DS_Field* field = &layout->fields [i];
+
+        /* Field is only used for encoding */
+        if (!field->set)
+            continue;
+
+        /* Read the field bytes */
+        uint32_t value = 0;
+        for (n = 0; n < field->width; ++n) {
+            int pos = byte_offset (field, n);
+            value = (value << 8) | (pos < len ? bytes [pos] : 0);
+        }
+
+        /* Pass the masked value to the setter */
+        uint32_t mask = field_mask (field);
+        field->set ((int) ((value & mask) >> mask_shift (mask)));
+    }
+
+    return 1;
+}
+
+/**
+ * Walks the length-prefixed tags of the given \a data, beginning at the
+ * given \a offset, and passes the payload of each tag to the handler
+ * registered for its ID in the \a handlers table.
+ *
+ * Each tag is made of a size byte (which counts the ID and the payload),
+ * the tag ID and the payload. Tags without a handler are skipped, and
+ * reading stops at the first truncated or empty tag.
+ *
+ * Returns the number of tags that were read
+ */
+int DS_PacketReadTags (const DS_String* data, const int offset,
+                       const DS_TagHandler handlers [256])
+{
+    assert (handlers);
+
+    /* Data pointer is invalid */
+    if (!data || offset < 0)
+        return 0;
+
+    int tags = 0;
+    int pos = offset;
+    int len = DS_StrLen (data);
+    const uint8_t* bytes = (const uint8_t*) data->buf;
+
+    while (pos + 1 < len) {
+        int size = bytes [pos];
+
+        /* Tag is empty or truncated */
+        if (size < 1 || pos + 1 + size > len)
+            break;
+
+        /* Dispatch the payload to the tag handler */
+        DS_TagHandler handler = handlers [bytes [pos + 1]];
+        if (handler)
+            handler (bytes + pos + 2, size - 1);
+
+        pos += size + 1;
+        ++tags;
+    }
+
+    return tags;
+}
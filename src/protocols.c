@@ -21,13 +21,25 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include "LibDS.h"
 #include "DS_Utils.h"
 #include "DS_Timer.h"
 #include "DS_Client.h"
 #include "DS_Config.h"
+#include "DS_Capture.h"
 #include "DS_Events.h"
+#include "DS_Context.h"
 #include "DS_Socket.h"
+#include "DS_Quality.h"
+#include "DS_Metrics.h"
 #include "DS_Protocol.h"
+#include "DS_Realtime.h"
+#include "DS_Scheduler.h"
+#include "DS_Watchdog.h"
+#include "DS_Autodetect.h"
+#include "DS_Interface.h"
+#include "DS_Discovery.h"
+#include "DS_Statistics.h"
 
 #include <stdio.h>
 #include <assert.h>
@@ -35,148 +47,279 @@
 #include <string.h>
 #include <pthread.h>
 
-#define SEND_PRECISION 1  /* Update the sender timers every millisecond */
-#define RECV_PRECISION 50 /* Update the watchdogs every 50 milliseconds */
+#define LOOP_INTERVAL  5  /* Read the sockets every 5 milliseconds */
+#define TX_BATCH       16 /* Transmit timestamps read per received packet */
 
 /*
- * Used to re-assing to 'empty' structure
+ * Packet functions of the protocol, called directly in single-protocol builds
+ * (otherwise, they are obtained from the protocol of the state \c s)
  */
-static const DS_Protocol EmptyProtocol;
+#if defined LIBDS_STATIC_PROTOCOL
+    #define UPDATE_FMS_PACKET   &Protocol_UpdateFMSPacket
+    #define UPDATE_RADIO_PACKET &Protocol_UpdateRadioPacket
+    #define UPDATE_ROBOT_PACKET &Protocol_UpdateRobotPacket
+    #define READ_FMS_PACKET     Protocol_ReadFMSPacket
+    #define READ_RADIO_PACKET   Protocol_ReadRadioPacket
+    #define READ_ROBOT_PACKET   Protocol_ReadRobotPacket
+#else
+    #define UPDATE_FMS_PACKET   s->protocol.update_fms_packet
+    #define UPDATE_RADIO_PACKET s->protocol.update_radio_packet
+    #define UPDATE_ROBOT_PACKET s->protocol.update_robot_packet
+    #define READ_FMS_PACKET     s->protocol.read_fms_packet
+    #define READ_RADIO_PACKET   s->protocol.read_radio_packet
+    #define READ_ROBOT_PACKET   s->protocol.read_robot_packet
+#endif
 
 /*
- * Protocol data
+ * Used to re-assing to 'empty' structure
  */
-static DS_Protocol protocol;
-static int enable_operations = 0;
+static const DS_Protocol EmptyProtocol;
 
-/*
- * Define the sender watchdogs (when one expires, we send a packet)
+/**
+ * Holds the protocol and the event loop of a context
  */
-static DS_Timer fms_send_timer;
-static DS_Timer radio_send_timer;
-static DS_Timer robot_send_timer;
+typedef struct {
+    /* Protocol data */
+    DS_Protocol protocol;
+    int enable_operations;
+
+    /* Time (from DS_GetTimeNs) at which the next packet of each channel is
+     * sent, 0 if the channel does not send packets */
+    uint64_t fms_send_time;
+    uint64_t radio_send_time;
+    uint64_t robot_send_time;
+
+    /* If set to anything else than 0, then the event loop will be allowed
+     * to run */
+    int running;
+
+    /* Protocol read success booleans (used to feed the watchdogs) */
+    int fms_read;
+    int radio_read;
+    int robot_read;
+
+    /* Holds the received data */
+    DS_String fms_data;
+    DS_String radio_data;
+    DS_String robot_data;
+    DS_String netcs_data;
+
+    /* If set to 1, the event loop does not send or receive any data, so that
+     * another module (e.g. the replay engine) can drive the protocol */
+    int suspended;
+    pthread_mutex_t loop_mutex;
+
+    /* The thread ID for the protocol event loop */
+    pthread_t event_thread;
+
+    /* Set to 1 if the context is stepped by the scheduler (its sockets are
+     * polled, and there is no event loop thread) */
+    int scheduled;
+
+    /* Set to 1 if the context is stepped by the application with DS_Step()
+     * (its sockets are threadless, and there is no event loop thread) */
+    int manual;
+
+    /* Time at which the protocol must be stepped again */
+    uint64_t next_deadline;
+
+    /* RECONFIGURE_* flags of the addresses to apply in the next step */
+    int reconfigure;
+} State;
 
-/*
- * Define the receiver watchdogs (when one expires, comms are lost)
+/**
+ * Initializes the event loop mutex of a new context
  */
-static DS_Timer fms_recv_timer;
-static DS_Timer radio_recv_timer;
-static DS_Timer robot_recv_timer;
+static void init_state (void* ptr)
+{
+    pthread_mutex_init (&((State*) ptr)->loop_mutex, NULL);
+}
 
-/*
- * If set to anything else than 0, then the event loop will be allowed to run
+/**
+ * Destroys the event loop mutex of a destroyed context
  */
-static int running = 0;
+static void release_state (void* ptr)
+{
+    pthread_mutex_destroy (&((State*) ptr)->loop_mutex);
+}
 
-/*
- * Protocol read success booleans (used to feed the watchdogs)
+/**
+ * Returns the protocol state of the current context
  */
-static int fms_read = 0;
-static int radio_read = 0;
-static int robot_read = 0;
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State),
+                                     &init_state, &release_state);
+}
 
-/*
- * Holds the received data
+/**
+ * Sends the given packet \a data through the given \a socket and registers
+ * it in the statistics, the trip time tracker and the capture.
+ *
+ * Packets are not sent (nor counted) while the socket has nowhere to send
+ * them (e.g. there is no FMS or the robot address is not resolved), so that
+ * only actual send failures are counted as socket errors.
  */
-static DS_String fms_data;
-static DS_String radio_data;
-static DS_String robot_data;
-static DS_String netcs_data;
+static void transmit (const DS_Channel channel,
+                      DS_Socket* socket,
+                      const DS_String* data)
+{
+    if (DS_SocketCanSend (socket)) {
+        int bytes = DS_SocketSend (socket, data);
+        int64_t id = -1;
+        if (bytes > 0 && (DS_SocketTimestamping (socket) & DS_TIMESTAMP_TX))
+            id = DS_SocketSendId (socket);
+
+        Statistics_PacketSent (channel, bytes);
+        Quality_PacketTransmitted (channel, DS_SocketSendTime (socket), id);
+        Capture_Packet (channel, socket, data, 1, DS_SocketSendTime (socket));
+    }
 
-/*
- * Holds the sent/received packets
- */
-static int sent_fms_packets = 0;
-static int sent_radio_packets = 0;
-static int sent_robot_packets = 0;
-static int received_fms_packets = 0;
-static int received_radio_packets = 0;
-static int received_robot_packets = 0;
+    /* Other addresses of the robot may still be probed */
+    if (channel == DS_CHANNEL_ROBOT)
+        Discovery_PacketSent (socket, data);
+}
 
-/*
- * Sent/received bytes
+/**
+ * Sends a packet through the given \a socket. If the protocol keeps a
+ * persistent packet for the channel (\a update is not \c NULL), the packet
+ * is patched and sent in place. Otherwise, a new packet is generated with
+ * \a create and deleted once it has been sent.
  */
-static unsigned long sent_fms_bytes = 0;
-static unsigned long recv_fms_bytes = 0;
-static unsigned long sent_radio_bytes = 0;
-static unsigned long recv_radio_bytes = 0;
-static unsigned long sent_robot_bytes = 0;
-static unsigned long recv_robot_bytes = 0;
+static void send_packet (const DS_Channel channel,
+                         DS_Socket* socket,
+                         DS_String (*create) (void),
+                         const DS_String* (*update) (void))
+{
+    State* s = state();
 
-/*
- * The thread ID for the protocol event loop
- */
-static pthread_t event_thread;
+    if (!s->enable_operations)
+        return;
+
+    /* Send the persistent packet of the protocol */
+    if (update)
+        transmit (channel, socket, update());
+
+    /* Generate, send and delete a new packet */
+    else if (create) {
+        DS_String data = create();
+        transmit (channel, socket, &data);
+        DS_StrRmBuf (&data);
+    }
+}
 
 /**
- * Sends a new packet to the FMS, the generated data is immediatly deleted
- * once the packet has been sent
+ * Sends a new packet to the FMS
  */
 static void send_fms_data()
 {
-    if (enable_operations) {
-        ++sent_fms_packets;
-        DS_String data = protocol.create_fms_packet();
-        sent_fms_bytes += DS_Max (DS_SocketSend (&protocol.fms_socket, &data), 0);
-        DS_StrRmBuf (&data);
-    }
+    State* s = state();
+
+    send_packet (DS_CHANNEL_FMS, &s->protocol.fms_socket,
+                 s->protocol.create_fms_packet, UPDATE_FMS_PACKET);
 }
 
 /**
- * Sends a new packet to the radio, the generated data is immediatly deleted
- * once the packet has been sent
+ * Sends a new packet to the radio
  */
 static void send_radio_data()
 {
-    if (enable_operations) {
-        ++sent_radio_packets;
-        DS_String data = protocol.create_radio_packet();
-        sent_radio_bytes += DS_Max (DS_SocketSend (&protocol.radio_socket, &data), 0);
-        DS_StrRmBuf (&data);
-    }
+    State* s = state();
+
+    send_packet (DS_CHANNEL_RADIO, &s->protocol.radio_socket,
+                 s->protocol.create_radio_packet, UPDATE_RADIO_PACKET);
 }
 
 /**
- * Sends a new packet to the robot, the generated data is immediatly deleted
- * once the packet has been sent
+ * Sends a new packet to the robot
  */
 static void send_robot_data()
 {
-    if (enable_operations) {
-        ++sent_robot_packets;
-        DS_String data = protocol.create_robot_packet();
-        sent_robot_bytes += DS_Max (DS_SocketSend (&protocol.robot_socket, &data), 0);
-        DS_StrRmBuf (&data);
-    }
+    State* s = state();
+
+    send_packet (DS_CHANNEL_ROBOT, &s->protocol.robot_socket,
+                 s->protocol.create_robot_packet, UPDATE_ROBOT_PACKET);
+}
+
+/**
+ * Returns the time at which the first packet of a channel that sends packets
+ * every \a interval milliseconds is sent, or 0 if the channel does not send
+ * packets
+ */
+static uint64_t first_send_time (const int interval, const uint64_t now)
+{
+    if (interval <= 0)
+        return 0;
+
+    return now + (uint64_t) interval * 1000000ULL;
+}
+
+/**
+ * Returns 1 if the packet scheduled at the given \a send_time must be sent
+ * at \a now, in which case the next packet is scheduled one \a interval
+ * later. If the caller fell behind by more than an interval, the next packet
+ * is scheduled one interval after \a now (instead of sending a burst).
+ */
+static int send_due (uint64_t* send_time, const int interval,
+                     const uint64_t now)
+{
+    if (*send_time == 0 || now < *send_time)
+        return 0;
+
+    uint64_t period = (uint64_t) DS_Max (interval, 1) * 1000000ULL;
+    *send_time += period;
+    if (*send_time <= now)
+        *send_time = now + period;
+
+    return 1;
 }
 
 /**
  * Sends data over the network using the functions of the current protocol.
  * If there is no protocol running, then this function will do nothing.
  */
-static void send_data()
+static void send_data (const uint64_t now)
 {
+    State* s = state();
+
     /* Protocol is NULL, abort */
-    if (!enable_operations)
+    if (!s->enable_operations)
         return;
 
     /* Send FMS packet */
-    if (fms_send_timer.expired) {
+    if (send_due (&s->fms_send_time, s->protocol.fms_interval, now))
         send_fms_data();
-        DS_TimerReset (&fms_send_timer);
-    }
 
     /* Send radio packet */
-    if (radio_send_timer.expired) {
+    if (send_due (&s->radio_send_time, s->protocol.radio_interval, now))
         send_radio_data();
-        DS_TimerReset (&radio_send_timer);
-    }
 
     /* Send robot packet */
-    if (robot_send_timer.expired) {
+    if (send_due (&s->robot_send_time, s->protocol.robot_interval, now))
         send_robot_data();
-        DS_TimerReset (&robot_send_timer);
+}
+
+/**
+ * Returns the time at which the protocol must be stepped again, which is the
+ * time of the next packet to send, or \c LOOP_INTERVAL milliseconds after
+ * \a now (so that the sockets and the watchdogs are checked regularly)
+ */
+static uint64_t next_deadline (const uint64_t now)
+{
+    State* s = state();
+    uint64_t deadline = now + LOOP_INTERVAL * 1000000ULL;
+
+    if (s->enable_operations) {
+        if (s->fms_send_time > 0)
+            deadline = DS_Min (deadline, s->fms_send_time);
+        if (s->radio_send_time > 0)
+            deadline = DS_Min (deadline, s->radio_send_time);
+        if (s->robot_send_time > 0)
+            deadline = DS_Min (deadline, s->robot_send_time);
     }
+
+    return deadline;
 }
 
 /**
@@ -184,10 +327,12 @@ static void send_data()
  */
 static void clear_recv_data()
 {
-    DS_StrRmBuf (&fms_data);
-    DS_StrRmBuf (&radio_data);
-    DS_StrRmBuf (&robot_data);
-    DS_StrRmBuf (&netcs_data);
+    State* s = state();
+
+    DS_StrRmBuf (&s->fms_data);
+    DS_StrRmBuf (&s->radio_data);
+    DS_StrRmBuf (&s->robot_data);
+    DS_StrRmBuf (&s->netcs_data);
 }
 
 /**
@@ -196,48 +341,30 @@ static void clear_recv_data()
  */
 static void recv_data()
 {
+    State* s = state();
+
     /* Protocol is NULL, abort */
-    if (!enable_operations)
+    if (!s->enable_operations)
         return;
 
     /* Clear buffers (just to be sure) */
     clear_recv_data();
 
     /* Read data from sockets */
-    fms_data = DS_SocketRead (&protocol.fms_socket);
-    radio_data = DS_SocketRead (&protocol.radio_socket);
-    robot_data = DS_SocketRead (&protocol.robot_socket);
-    netcs_data = DS_SocketRead (&protocol.netconsole_socket);
-
-    /* Update received data indicators */
-    recv_fms_bytes += DS_StrLen (&fms_data);
-    recv_radio_bytes += DS_StrLen (&radio_data);
-    recv_robot_bytes += DS_StrLen (&robot_data);
-
-    /* Read FMS packet */
-    if (DS_StrLen (&fms_data) > 0) {
-        ++received_fms_packets;
-        fms_read = protocol.read_fms_packet (&fms_data);
-        CFG_SetFMSCommunications (fms_read);
-    }
-
-    /* Read radio packet */
-    if (DS_StrLen (&radio_data) > 0) {
-        ++received_radio_packets;
-        radio_read = protocol.read_radio_packet (&radio_data);
-        CFG_SetRadioCommunications (radio_read);
-    }
-
-    /* Read robot packet */
-    if (DS_StrLen (&robot_data) > 0) {
-        ++received_robot_packets;
-        robot_read = protocol.read_robot_packet (&robot_data);
-        CFG_SetRobotCommunications (robot_read);
-    }
-
-    /* Add NetConsole message to event system */
-    if (netcs_data.len > 0)
-        CFG_AddNetConsoleMessage (&netcs_data);
+    s->fms_data = DS_SocketRead (&s->protocol.fms_socket);
+    s->radio_data = DS_SocketRead (&s->protocol.radio_socket);
+    s->robot_data = DS_SocketRead (&s->protocol.robot_socket);
+    s->netcs_data = DS_SocketRead (&s->protocol.netconsole_socket);
+
+    /* Interpret the received packets */
+    Protocols_ReadPacket (DS_CHANNEL_FMS, &s->fms_data,
+                          DS_SocketReceiveTime (&s->protocol.fms_socket));
+    Protocols_ReadPacket (DS_CHANNEL_RADIO, &s->radio_data,
+                          DS_SocketReceiveTime (&s->protocol.radio_socket));
+    Protocols_ReadPacket (DS_CHANNEL_ROBOT, &s->robot_data,
+                          DS_SocketReceiveTime (&s->protocol.robot_socket));
+    Protocols_ReadPacket (DS_CHANNEL_NETCONSOLE, &s->netcs_data,
+                          DS_SocketReceiveTime (&s->protocol.netconsole_socket));
 
     /* Reset the data pointers */
     clear_recv_data();
@@ -246,34 +373,85 @@ static void recv_data()
 /**
  * Feeds the watchdogs, updates them and checks if any of them has expired
  */
-static void update_watchdogs()
+static void update_watchdogs (const uint64_t now)
 {
+    State* s = state();
+
     /* Feed the watchdogs if packets are read */
-    if (fms_read)   DS_TimerReset (&fms_recv_timer);
-    if (radio_read) DS_TimerReset (&radio_recv_timer);
-    if (robot_read) DS_TimerReset (&robot_recv_timer);
+    if (s->fms_read)   Watchdog_Feed (DS_CHANNEL_FMS, now);
+    if (s->radio_read) Watchdog_Feed (DS_CHANNEL_RADIO, now);
+    if (s->robot_read) Watchdog_Feed (DS_CHANNEL_ROBOT, now);
 
     /* Clear the read success values */
-    fms_read = 0;
-    radio_read = 0;
-    robot_read = 0;
+    s->fms_read = 0;
+    s->radio_read = 0;
+    s->robot_read = 0;
 
     /* Reset the FMS if the watchdog expires */
-    if (fms_recv_timer.expired) {
-        CFG_FMSWatchdogExpired();
-        DS_TimerReset (&fms_recv_timer);
-    }
+    if (Watchdog_Check (DS_CHANNEL_FMS, now))
+        Protocols_WatchdogExpired (DS_CHANNEL_FMS);
 
     /* Reset the radio if the watchdog expires */
-    if (radio_recv_timer.expired) {
-        CFG_RadioWatchdogExpired();
-        DS_TimerReset (&radio_recv_timer);
-    }
+    if (Watchdog_Check (DS_CHANNEL_RADIO, now))
+        Protocols_WatchdogExpired (DS_CHANNEL_RADIO);
 
     /* Reset the robot if the watchdog expires */
-    if (robot_recv_timer.expired) {
-        CFG_RobotWatchdogExpired();
-        DS_TimerReset (&robot_recv_timer);
+    if (Watchdog_Check (DS_CHANNEL_ROBOT, now))
+        Protocols_WatchdogExpired (DS_CHANNEL_ROBOT);
+}
+
+/**
+ * Returns the watchdog timeout (in milliseconds) for a channel that
+ * sends packets every \a interval milliseconds
+ */
+static int watchdog_timeout (const int interval)
+{
+    return DS_Min (interval * 50, 1000);
+}
+
+/**
+ * Waits until the given \a deadline (returned by \c Protocols_Step()).
+ *
+ * If the robot socket is busy-polled, this function spins instead of
+ * sleeping: the robot socket is polled continuously and each robot packet
+ * is interpreted as soon as it arrives. The CPU is yielded between polls if
+ * no robot packet was received during the spin budget.
+ */
+static void wait_next_iteration (const uint64_t deadline)
+{
+    State* s = state();
+
+    /* Normal mode, just sleep */
+    if (!s->enable_operations || !s->protocol.robot_socket.busy_poll) {
+        DS_SleepUntil (deadline);
+        return;
+    }
+
+    /* Get the spin budget */
+    uint64_t last_packet = DS_GetTimeNs();
+    uint64_t budget = (uint64_t) Realtime_SpinBudget() * 1000ULL;
+
+    /* Poll the robot socket until the deadline */
+    while (s->running) {
+        uint64_t now = DS_GetTimeNs();
+        if (now >= deadline)
+            break;
+
+        /* Interpret the robot packet (if any) */
+        pthread_mutex_lock (&s->loop_mutex);
+        if (!s->suspended && s->enable_operations
+                && DS_SocketPoll (&s->protocol.robot_socket) > 0) {
+            DS_String data = DS_SocketRead (&s->protocol.robot_socket);
+            Protocols_ReadPacket (DS_CHANNEL_ROBOT, &data,
+                                  DS_SocketReceiveTime (&s->protocol.robot_socket));
+            DS_StrRmBuf (&data);
+            last_packet = now;
+        }
+        pthread_mutex_unlock (&s->loop_mutex);
+
+        /* Let other threads run if the robot is quiet */
+        if (now - last_packet >= budget)
+            Realtime_Yield();
     }
 }
 
@@ -286,49 +464,288 @@ static void update_watchdogs()
  */
 static void* run_event_loop()
 {
-    while (running) {
-        send_data();
-        recv_data();
-        update_watchdogs();
-        DS_Sleep (5);
+    State* s = state();
+
+    int realtime = -1;
+
+    while (s->running) {
+        /* Apply the real-time settings when they change */
+        if (realtime != Realtime_Generation()) {
+            realtime = Realtime_Generation();
+            Realtime_ConfigureThread (DS_THREAD_PROTOCOL, "ds-protocol");
+        }
+
+        wait_next_iteration (Protocols_Step (DS_GetTimeNs()));
     }
 
     return NULL;
 }
 
+/**
+ * Sends the packets that are due at \a now, reads the received packets and
+ * updates the watchdogs of the current context.
+ *
+ * This function is called by the event loop thread of the context, or by a
+ * worker of the scheduler if the context is a scheduled session.
+ *
+ * \returns the time (from \c DS_GetTimeNs) at which this function must be
+ *          called again
+ */
+uint64_t Protocols_Step (const uint64_t now)
+{
+    State* s = state();
+
+    pthread_mutex_lock (&s->loop_mutex);
+
+    if (!s->suspended) {
+        uint64_t late = now > s->next_deadline ? now - s->next_deadline : 0;
+
+        /* Apply the addresses changed by another thread */
+        if (s->reconfigure) {
+            int flags = s->reconfigure;
+            s->reconfigure = 0;
+            CFG_ReconfigureAddresses (flags);
+        }
+
+        send_data (now);
+        recv_data();
+        update_watchdogs (now);
+
+        uint64_t end = DS_GetTimeNs();
+        Metrics_LoopIteration (end > now ? end - now : 0, late);
+    }
+
+    uint64_t deadline = next_deadline (now);
+    s->next_deadline = deadline;
+    pthread_mutex_unlock (&s->loop_mutex);
+
+    return deadline;
+}
+
+/**
+ * Asks the protocol loop to re-open the sockets given by the \a flags
+ * (\c RECONFIGURE_* values) with their current addresses at the start of its
+ * next step. Threads that do not step the protocol (e.g. the robot discovery)
+ * use this function instead of \c CFG_ReconfigureAddresses(), so that the
+ * sockets are not closed while the loop sends or reads through them.
+ */
+void Protocols_Reconfigure (const int flags)
+{
+    State* s = state();
+
+    pthread_mutex_lock (&s->loop_mutex);
+    s->reconfigure |= flags;
+    pthread_mutex_unlock (&s->loop_mutex);
+}
+
 /**
  * Returns a pointer to the current protocol
  */
 DS_Protocol* DS_CurrentProtocol()
 {
-    if (enable_operations)
-        return &protocol;
+    State* s = state();
+
+    if (s->enable_operations)
+        return &s->protocol;
 
     return NULL;
 }
 
 /**
- * Initializes the protocol sender/receiver thread and the timers
+ * Reads the kernel transmit timestamps of the packets sent through the given
+ * \a channel, so that the trip time of the received reply starts when its
+ * packet left the socket. Timestamps are only read when a reply arrives, so
+ * sending a packet does not wait for them.
  */
-void Protocols_Init()
+static void collect_timestamps (const DS_Channel channel)
+{
+    int i;
+    uint32_t ids [TX_BATCH];
+    uint64_t times [TX_BATCH];
+
+    DS_Socket* socket = Protocols_GetSocket (channel);
+    if (!socket)
+        return;
+
+    int count = DS_SocketReadTxTimestamps (socket, ids, times, TX_BATCH);
+    for (i = 0; i < count; ++i)
+        Quality_PacketTimestamped (channel, ids [i], times [i]);
+}
+
+/**
+ * Interprets the given \a data received through the given \a channel using
+ * the functions of the current protocol, and updates the communication
+ * status of the channel.
+ *
+ * The receive \a time of the packet (e.g. its kernel timestamp) is used by
+ * the trip time statistics and by the packet capture, so that they do not
+ * include the time that the packet waited in the library. If \a time is 0,
+ * the current time is used instead.
+ *
+ * \returns 1 if the packet was read successfully, 0 on failure
+ */
+int Protocols_ReadPacket (const DS_Channel channel, const DS_String* data,
+                          const uint64_t time)
 {
-    /* Initialize sender timers */
-    DS_TimerInit (&fms_send_timer,   0, SEND_PRECISION);
-    DS_TimerInit (&radio_send_timer, 0, SEND_PRECISION);
-    DS_TimerInit (&robot_send_timer, 0, SEND_PRECISION);
+    State* s = state();
+
+    assert (data);
+
+    /* Protocol is NULL or packet is empty, abort */
+    if (!s->enable_operations || DS_StrLen (data) <= 0)
+        return 0;
+
+    /* Register the packet */
+    int read = 0;
+    Statistics_PacketReceived (channel, DS_StrLen (data));
+    Quality_SetReceiveTime (channel, time);
+    collect_timestamps (channel);
+
+    /* Read the packet */
+    switch (channel) {
+    case DS_CHANNEL_FMS:
+        Capture_Packet (channel, &s->protocol.fms_socket, data, 0, time);
+        read = s->fms_read = READ_FMS_PACKET (data);
+        CFG_SetFMSCommunications (s->fms_read);
+        break;
+    case DS_CHANNEL_RADIO:
+        Capture_Packet (channel, &s->protocol.radio_socket, data, 0, time);
+        read = s->radio_read = READ_RADIO_PACKET (data);
+        CFG_SetRadioCommunications (s->radio_read);
+        break;
+    case DS_CHANNEL_ROBOT:
+        Capture_Packet (channel, &s->protocol.robot_socket, data, 0, time);
+        read = s->robot_read = READ_ROBOT_PACKET (data);
+        CFG_SetRobotCommunications (s->robot_read);
+
+        if (s->robot_read)
+            Discovery_PacketReceived (&s->protocol.robot_socket);
+        break;
+    case DS_CHANNEL_NETCONSOLE:
+        Capture_Packet (channel, &s->protocol.netconsole_socket, data, 0, time);
+        CFG_AddNetConsoleMessage (data);
+        read = 1;
+        break;
+    }
+
+    /* Register decoding errors */
+    if (!read)
+        Statistics_DecodeFailure (channel);
+    else
+        Statistics_PacketDecoded (channel);
+
+    Quality_SetReceiveTime (channel, 0);
+    return read;
+}
+
+/**
+ * Notifies the rest of the library that the watchdog of the given
+ * \a channel has expired
+ */
+void Protocols_WatchdogExpired (const DS_Channel channel)
+{
+    Statistics_WatchdogExpired (channel);
+
+    switch (channel) {
+    case DS_CHANNEL_FMS:
+        CFG_FMSWatchdogExpired();
+        break;
+    case DS_CHANNEL_RADIO:
+        CFG_RadioWatchdogExpired();
+        break;
+    case DS_CHANNEL_ROBOT:
+        CFG_RobotWatchdogExpired();
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Returns the socket used by the current protocol for the given \a channel,
+ * or \c NULL if no protocol is loaded
+ */
+DS_Socket* Protocols_GetSocket (const DS_Channel channel)
+{
+    State* s = state();
+
+    if (!s->enable_operations)
+        return NULL;
+
+    switch (channel) {
+    case DS_CHANNEL_FMS:
+        return &s->protocol.fms_socket;
+    case DS_CHANNEL_RADIO:
+        return &s->protocol.radio_socket;
+    case DS_CHANNEL_ROBOT:
+        return &s->protocol.robot_socket;
+    case DS_CHANNEL_NETCONSOLE:
+        return &s->protocol.netconsole_socket;
+    }
+
+    return NULL;
+}
+
+/**
+ * Returns the watchdog timeout (in milliseconds) of the given \a channel
+ * for the current protocol, or 0 if the channel has no watchdog
+ */
+int Protocols_WatchdogTimeout (const DS_Channel channel)
+{
+    State* s = state();
+
+    switch (channel) {
+    case DS_CHANNEL_FMS:
+        return watchdog_timeout (s->protocol.fms_interval);
+    case DS_CHANNEL_RADIO:
+        return watchdog_timeout (s->protocol.radio_interval);
+    case DS_CHANNEL_ROBOT:
+        return watchdog_timeout (s->protocol.robot_interval);
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Stops (if \a suspend is set to 1) or resumes the data exchange done by the
+ * protocol event loop. When this function returns, the event loop is
+ * guaranteed to be idle, so that the caller can feed the protocol with
+ * its own data.
+ */
+void Protocols_Suspend (const int suspend)
+{
+    State* s = state();
+
+    pthread_mutex_lock (&s->loop_mutex);
+    s->suspended = suspend;
+    pthread_mutex_unlock (&s->loop_mutex);
+}
 
-    /* Initialize watchdog timers */
-    DS_TimerInit (&fms_recv_timer,   0, RECV_PRECISION);
-    DS_TimerInit (&radio_recv_timer, 0, RECV_PRECISION);
-    DS_TimerInit (&robot_recv_timer, 0, RECV_PRECISION);
+/**
+ * Initializes the protocol sender/receiver thread, or registers the context
+ * with the scheduler if it is running
+ */
+void Protocols_Init()
+{
+    State* s = state();
 
     /* Allow the event loop to run */
-    running = 1;
-    enable_operations = 0;
+    s->running = 1;
+    s->enable_operations = 0;
+    s->next_deadline = DS_GetTimeNs();
+
+    /* Let the application step the context */
+    s->manual = DS_ManualPump();
+    if (s->manual)
+        return;
+
+    /* Let the workers of the scheduler step the context */
+    s->scheduled = Scheduler_AddSession();
+    if (s->scheduled)
+        return;
 
     /* Configure the event thread */
-    int error = pthread_create (&event_thread, NULL,
-                                &run_event_loop, NULL);
+    int error = Context_CreateThread (&s->event_thread, &run_event_loop, NULL);
 
     /* Display error message if we cannot star the event loop */
     if (error) {
@@ -348,112 +765,353 @@ void Protocols_Init()
  */
 static void close_protocol()
 {
+    State* s = state();
+
     /* Protocol is empty, abort */
-    if (!enable_operations)
+    if (!s->enable_operations)
         return;
 
     /* Disable protocol operations */
-    enable_operations = 0;
+    s->enable_operations = 0;
 
-    /* Stop sender timers */
-    DS_TimerStop (&fms_send_timer);
-    DS_TimerStop (&radio_send_timer);
-    DS_TimerStop (&robot_send_timer);
+    /* Stop sending packets */
+    s->fms_send_time = 0;
+    s->radio_send_time = 0;
+    s->robot_send_time = 0;
 
-    /* Stop receiver timers */
-    DS_TimerStop (&fms_recv_timer);
-    DS_TimerStop (&radio_recv_timer);
-    DS_TimerStop (&robot_recv_timer);
+    /* Disable the watchdogs */
+    Watchdog_Reset (DS_CHANNEL_FMS, 0, 0);
+    Watchdog_Reset (DS_CHANNEL_RADIO, 0, 0);
+    Watchdog_Reset (DS_CHANNEL_ROBOT, 0, 0);
 
     /* Close the sockets */
-    DS_SocketClose (&protocol.fms_socket);
-    DS_SocketClose (&protocol.radio_socket);
-    DS_SocketClose (&protocol.robot_socket);
-    DS_SocketClose (&protocol.netconsole_socket);
-
-    /* Reset sent/recv bytes */
-    sent_fms_bytes = 0;
-    recv_fms_bytes = 0;
-    sent_radio_bytes = 0;
-    recv_radio_bytes = 0;
-    sent_robot_bytes = 0;
-    recv_robot_bytes = 0;
-
-    /* Reset sent/recv packets */
-    DS_ResetFMSPackets();
-    DS_ResetRadioPackets();
-    DS_ResetRobotPackets();
+    DS_SocketClose (&s->protocol.fms_socket);
+    DS_SocketClose (&s->protocol.radio_socket);
+    DS_SocketClose (&s->protocol.robot_socket);
+    DS_SocketClose (&s->protocol.netconsole_socket);
+
+    /* Reset sent/recv bytes and packets */
+    Statistics_Reset();
+
+    /* Reset sequence tracking and trip time statistics */
+    Quality_Reset (DS_CHANNEL_FMS);
+    Quality_Reset (DS_CHANNEL_RADIO);
+    Quality_Reset (DS_CHANNEL_ROBOT);
+    Quality_Reset (DS_CHANNEL_NETCONSOLE);
 
     /* Create notification string */
-    char* name = DS_StrToChar (&protocol.name);
+    char* name = DS_StrToChar (&s->protocol.name);
     DS_String str = DS_StrFormat ("Closed %s protocol", name);
     CFG_AddNotification (&str);
     DS_StrRmBuf (&str);
     DS_FREE (name);
 }
 
+/**
+ * Closes the current protocol (if any) and releases its sockets, so that
+ * another module (e.g. the protocol auto-detection) can use its ports
+ */
+void Protocols_Unload()
+{
+    State* s = state();
+
+    pthread_mutex_lock (&s->loop_mutex);
+    close_protocol();
+    pthread_mutex_unlock (&s->loop_mutex);
+}
+
 /**
  * Stops the sender/receiver thread and deletes the allocated protocol
  */
 void Protocols_Close()
 {
-    running = 0;
+    State* s = state();
+
+    /* Wait for the event loop, so that it does not use the sockets while
+     * they are closed (or keep running after the DS is initialized again) */
+    s->running = 0;
+    if (s->scheduled)
+        Scheduler_RemoveSession();
+    else if (!s->manual && !pthread_equal (s->event_thread, pthread_self()))
+        pthread_join (s->event_thread, NULL);
+
+    /* Close the protocol like DS_ConfigureProtocol() does */
+    pthread_mutex_lock (&s->loop_mutex);
+    s->manual = 0;
+    s->scheduled = 0;
     close_protocol();
     clear_recv_data();
+    pthread_mutex_unlock (&s->loop_mutex);
 }
 
 /**
- * De-allocates the current protocol and loads the given protocol
- *
- * Note the given \a ptr is not used directly, you should free it
- * after using it...
- *
- * \param ptr pointer to the new protocol implementation to load
+ * De-allocates the current protocol and loads the given protocol, the
+ * statistics of the new protocol start at \a start_time. The caller holds
+ * the loop mutex.
  */
-void DS_ConfigureProtocol (const DS_Protocol* ptr)
+static void load_protocol (const DS_Protocol* ptr, const uint64_t start_time)
 {
-    /* Pointer is NULL, abort */
-    assert (ptr != NULL);
+    State* s = state();
 
     /* Close previous protocol */
     close_protocol();
+    Statistics_Start (start_time);
+
+    /* The new sockets are opened with the current addresses */
+    s->reconfigure = 0;
 
     /* Re-assign the protocol */
-    protocol = *ptr;
+    s->protocol = *ptr;
+    s->protocol.robot_socket.busy_poll = Realtime_BusyPoll();
+
+    /* The sockets of scheduled sessions are read by the workers */
+    s->protocol.fms_socket.polled = s->scheduled;
+    s->protocol.radio_socket.polled = s->scheduled;
+    s->protocol.robot_socket.polled = s->scheduled;
+    s->protocol.netconsole_socket.polled = s->scheduled;
+
+    /* The sockets of manually pumped contexts never start a thread */
+    s->protocol.fms_socket.threadless = s->manual;
+    s->protocol.radio_socket.threadless = s->manual;
+    s->protocol.robot_socket.threadless = s->manual;
+    s->protocol.netconsole_socket.threadless = s->manual;
+
+    /* Bind the sockets to their network interfaces */
+    Interface_Configure (&s->protocol.fms_socket, DS_CHANNEL_FMS);
+    Interface_Configure (&s->protocol.radio_socket, DS_CHANNEL_RADIO);
+    Interface_Configure (&s->protocol.robot_socket, DS_CHANNEL_ROBOT);
+    Interface_Configure (&s->protocol.netconsole_socket, DS_CHANNEL_NETCONSOLE);
 
     /* Update sockets */
-    DS_SocketOpen (&protocol.fms_socket);
-    DS_SocketOpen (&protocol.radio_socket);
-    DS_SocketOpen (&protocol.robot_socket);
-    DS_SocketOpen (&protocol.netconsole_socket);
-
-    /* Update sender timers */
-    fms_send_timer.time = protocol.fms_interval;
-    radio_send_timer.time = protocol.radio_interval;
-    robot_send_timer.time = protocol.robot_interval;
+    DS_SocketOpen (&s->protocol.fms_socket);
+    DS_SocketOpen (&s->protocol.radio_socket);
+    DS_SocketOpen (&s->protocol.robot_socket);
+    DS_SocketOpen (&s->protocol.netconsole_socket);
 
     /* Update watchdogs */
-    fms_recv_timer.time = DS_Min (protocol.fms_interval * 50, 1000);
-    radio_recv_timer.time = DS_Min (protocol.radio_interval * 50, 1000);
-    robot_recv_timer.time = DS_Min (protocol.robot_interval * 50, 1000);
-
-    /* Start the timers */
-    DS_TimerStart (&fms_send_timer);
-    DS_TimerStart (&fms_recv_timer);
-    DS_TimerStart (&radio_send_timer);
-    DS_TimerStart (&radio_recv_timer);
-    DS_TimerStart (&robot_send_timer);
-    DS_TimerStart (&robot_recv_timer);
+    uint64_t now = DS_GetTimeNs();
+    int fms_timeout = watchdog_timeout (s->protocol.fms_interval);
+    int radio_timeout = watchdog_timeout (s->protocol.radio_interval);
+    int robot_timeout = watchdog_timeout (s->protocol.robot_interval);
+    Watchdog_Reset (DS_CHANNEL_FMS, fms_timeout, now);
+    Watchdog_Reset (DS_CHANNEL_RADIO, radio_timeout, now);
+    Watchdog_Reset (DS_CHANNEL_ROBOT, robot_timeout, now);
+
+    /* Schedule the first packets */
+    s->fms_send_time = first_send_time (s->protocol.fms_interval, now);
+    s->radio_send_time = first_send_time (s->protocol.radio_interval, now);
+    s->robot_send_time = first_send_time (s->protocol.robot_interval, now);
+    s->next_deadline = now;
 
     /* Create notification string */
-    char* name = DS_StrToChar (&protocol.name);
+    char* name = DS_StrToChar (&s->protocol.name);
     DS_String str = DS_StrFormat ("Loaded %s protocol", name);
     CFG_AddNotification (&str);
     DS_StrRmBuf (&str);
     DS_FREE (name);
 
     /* Restore protocol operations */
-    enable_operations = 1;
+    s->enable_operations = 1;
+}
+
+/**
+ * De-allocates the current protocol and loads the given protocol
+ *
+ * Note the given \a ptr is not used directly, you should free it
+ * after using it...
+ *
+ * A running protocol auto-detection is stopped first, so that its probes
+ * release the robot ports and its winner does not replace this protocol.
+ *
+ * \param ptr pointer to the new protocol implementation to load
+ */
+void DS_ConfigureProtocol (const DS_Protocol* ptr)
+{
+    State* s = state();
+
+    /* Pointer is NULL, abort */
+    assert (ptr != NULL);
+
+    /* Only the compiled-in protocol can be used by single-protocol builds */
+#if defined LIBDS_STATIC_PROTOCOL
+    if (!Protocol_IsStatic (ptr)) {
+        fprintf (stderr, "DS_ConfigureProtocol: LibDS was built for a "
+                 "different protocol!\n");
+        return;
+    }
+#endif
+
+    /* The protocol chosen by the user replaces the auto-detection */
+    DS_StopAutodetect();
+
+    /* Do not let the event loop (or a worker) step the protocol meanwhile */
+    pthread_mutex_lock (&s->loop_mutex);
+    load_protocol (ptr, DS_GetTimeNs());
+    pthread_mutex_unlock (&s->loop_mutex);
+}
+
+/**
+ * Loads the protocol found by the auto-detection and gives it the robot
+ * \a packet (received at \a packet_time) that it recognized, before the
+ * event loop can step the new protocol. The first packet statistic of the
+ * robot is measured from \a start_time, when the detection started.
+ */
+void Protocols_LoadDetected (const DS_Protocol* ptr, const uint64_t start_time,
+                             const DS_String* packet,
+                             const uint64_t packet_time)
+{
+    State* s = state();
+
+    assert (ptr);
+    assert (packet);
+
+    pthread_mutex_lock (&s->loop_mutex);
+    load_protocol (ptr, start_time);
+    Protocols_ReadPacket (DS_CHANNEL_ROBOT, packet, packet_time);
+    pthread_mutex_unlock (&s->loop_mutex);
+}
+
+/**
+ * Writes the QoS marks (DSCP code point and socket priority) of the packets
+ * sent through the given \a channel in \a marks. The marks are read from the
+ * open socket, so they are -1 if no protocol is loaded, if the channel is
+ * disabled or if the operating system does not support them.
+ */
+void DS_GetChannelMarks (const DS_Channel channel, DS_SocketMarks* marks)
+{
+    assert (marks);
+
+    marks->dscp = -1;
+    marks->priority = -1;
+
+    DS_Socket* socket = Protocols_GetSocket (channel);
+    if (socket)
+        DS_SocketGetMarks (socket, marks);
+}
+
+/**
+ * Returns the kernel timestamps used by the socket of the given \a channel,
+ * as a combination of the \c DS_TIMESTAMP_RX and \c DS_TIMESTAMP_TX flags.
+ * Packets of channels without kernel timestamps are timestamped by the
+ * library when they are read from (or given to) the socket.
+ */
+int DS_GetChannelTimestamping (const DS_Channel channel)
+{
+    DS_Socket* socket = Protocols_GetSocket (channel);
+    if (socket)
+        return DS_SocketTimestamping (socket);
+
+    return 0;
+}
+
+/**
+ * Returns the file descriptor that receives the packets of the given
+ * \a channel, or -1 if the channel is not open (or if its transport has no
+ * descriptor). Applications that use \c DS_INIT_MANUAL_PUMP can watch the
+ * descriptors of the channels and call \c DS_Step() when one of them is
+ * readable, instead of waiting for \c DS_NextDeadline().
+ *
+ * The descriptors change when a protocol is loaded and when the address of
+ * a channel changes, so they should be queried again after each step.
+ */
+int DS_GetChannelFd (const DS_Channel channel)
+{
+    DS_Socket* socket = Protocols_GetSocket (channel);
+    if (socket)
+        return DS_SocketDescriptor (socket);
+
+    return -1;
+}
+
+/**
+ * Sends the packets that are due at \a now, reads the received packets and
+ * checks the watchdogs. The application calls this function itself when
+ * the DS is initialized with \c DS_INIT_MANUAL_PUMP, otherwise it does
+ * nothing (the library steps the protocol in its own thread).
+ *
+ * \param now the current time, given by \c DS_GetTimeNs()
+ * \returns the time at which this function must be called again, see
+ *          \c DS_NextDeadline()
+ */
+uint64_t DS_Step (const uint64_t now)
+{
+    State* s = state();
+
+    if (s->manual && s->running)
+        return Protocols_Step (now);
+
+    return DS_NextDeadline();
+}
+
+/**
+ * Looks up the addresses of the channels that are host names (e.g. the mDNS
+ * name of the robot) when the DS is initialized with \c DS_INIT_MANUAL_PUMP.
+ * \c DS_Step() never waits for a DNS/mDNS lookup, so such channels send
+ * nothing until this function finds their addresses, numeric addresses
+ * work right away.
+ *
+ * A lookup can take several seconds (e.g. if the robot is not connected), so
+ * the application should call this function from a thread that does not run
+ * its frames (after selecting the context with \c DS_ContextMakeCurrent()),
+ * about once per second while the returned value is not 0. The channels can
+ * be stepped meanwhile, the lookups are done without holding the protocol.
+ *
+ * \returns the number of channels whose address is still unknown
+ */
+int DS_RetryLookups (void)
+{
+    int pending = 0;
+    State* s = state();
+    DS_SocketLookup lookup;
+
+    const DS_Channel channels [] = {
+        DS_CHANNEL_FMS,
+        DS_CHANNEL_RADIO,
+        DS_CHANNEL_ROBOT,
+        DS_CHANNEL_NETCONSOLE
+    };
+
+    unsigned int i;
+    for (i = 0; i < sizeof (channels) / sizeof (channels [0]); ++i) {
+        /* Copy the address of the channel */
+        pthread_mutex_lock (&s->loop_mutex);
+        DS_Socket* socket = Protocols_GetSocket (channels [i]);
+        int needed = s->manual && socket
+                     && DS_SocketLookupPrepare (socket, &lookup);
+        pthread_mutex_unlock (&s->loop_mutex);
+
+        if (!needed)
+            continue;
+
+        /* Wait for the lookup without blocking DS_Step() */
+        DS_SocketLookupRun (&lookup);
+
+        /* The protocol may have been changed (or closed) meanwhile */
+        pthread_mutex_lock (&s->loop_mutex);
+        socket = Protocols_GetSocket (channels [i]);
+        if (socket && !DS_SocketLookupApply (socket, &lookup))
+            ++pending;
+        pthread_mutex_unlock (&s->loop_mutex);
+    }
+
+    return pending;
+}
+
+/**
+ * Returns the time (in the clock of \c DS_GetTimeNs()) at which
+ * \c DS_Step() must be called again. The deadline is the time of the next
+ * packet to send, and is never more than a few milliseconds away, so that
+ * the received packets and the watchdogs are checked regularly.
+ */
+uint64_t DS_NextDeadline (void)
+{
+    State* s = state();
+
+    pthread_mutex_lock (&s->loop_mutex);
+    uint64_t deadline = s->next_deadline;
+    pthread_mutex_unlock (&s->loop_mutex);
+
+    return deadline;
 }
 
 /**
@@ -465,7 +1123,9 @@ void DS_ConfigureProtocol (const DS_Protocol* ptr)
  */
 unsigned long DS_SentFMSBytes()
 {
-    return sent_fms_bytes;
+    DS_Stats stats;
+    DS_GetStatistics (&stats);
+    return (unsigned long) stats.fms.sent_bytes;
 }
 
 /**
@@ -477,7 +1137,9 @@ unsigned long DS_SentFMSBytes()
  */
 unsigned long DS_SentRadioBytes()
 {
-    return sent_radio_bytes;
+    DS_Stats stats;
+    DS_GetStatistics (&stats);
+    return (unsigned long) stats.radio.sent_bytes;
 }
 
 /**
@@ -489,7 +1151,9 @@ unsigned long DS_SentRadioBytes()
  */
 unsigned long DS_SentRobotBytes()
 {
-    return sent_robot_bytes;
+    DS_Stats stats;
+    DS_GetStatistics (&stats);
+    return (unsigned long) stats.robot.sent_bytes;
 }
 
 /**
@@ -501,7 +1165,9 @@ unsigned long DS_SentRobotBytes()
  */
 unsigned long DS_ReceivedFMSBytes()
 {
-    return recv_fms_bytes;
+    DS_Stats stats;
+    DS_GetStatistics (&stats);
+    return (unsigned long) stats.fms.received_bytes;
 }
 
 /**
@@ -513,7 +1179,9 @@ unsigned long DS_ReceivedFMSBytes()
  */
 unsigned long DS_ReceivedRadioBytes()
 {
-    return recv_radio_bytes;
+    DS_Stats stats;
+    DS_GetStatistics (&stats);
+    return (unsigned long) stats.radio.received_bytes;
 }
 
 /**
@@ -525,7 +1193,9 @@ unsigned long DS_ReceivedRadioBytes()
  */
 unsigned long DS_ReceivedRobotBytes()
 {
-    return recv_robot_bytes;
+    DS_Stats stats;
+    DS_GetStatistics (&stats);
+    return (unsigned long) stats.robot.received_bytes;
 }
 
 /**
@@ -536,7 +1206,7 @@ unsigned long DS_ReceivedRobotBytes()
  */
 int DS_SentFMSPackets()
 {
-    return DS_Max (1, sent_fms_packets);
+    return DS_Max (1, (int) Statistics_SentPackets (DS_CHANNEL_FMS));
 }
 
 /**
@@ -547,7 +1217,7 @@ int DS_SentFMSPackets()
  */
 int DS_SentRadioPackets()
 {
-    return DS_Max (1, sent_radio_packets);
+    return DS_Max (1, (int) Statistics_SentPackets (DS_CHANNEL_RADIO));
 }
 
 /**
@@ -558,7 +1228,7 @@ int DS_SentRadioPackets()
  */
 int DS_SentRobotPackets()
 {
-    return DS_Max (1, sent_robot_packets);
+    return DS_Max (1, (int) Statistics_SentPackets (DS_CHANNEL_ROBOT));
 }
 
 /**
@@ -569,7 +1239,7 @@ int DS_SentRobotPackets()
  */
 int DS_ReceivedFMSPackets()
 {
-    return received_fms_packets;
+    return (int) Statistics_ReceivedPackets (DS_CHANNEL_FMS);
 }
 
 /**
@@ -580,7 +1250,7 @@ int DS_ReceivedFMSPackets()
  */
 int DS_ReceivedRadioPackets()
 {
-    return received_radio_packets;
+    return (int) Statistics_ReceivedPackets (DS_CHANNEL_RADIO);
 }
 
 /**
@@ -591,7 +1261,7 @@ int DS_ReceivedRadioPackets()
  */
 int DS_ReceivedRobotPackets()
 {
-    return received_robot_packets;
+    return (int) Statistics_ReceivedPackets (DS_CHANNEL_ROBOT);
 }
 
 /**
@@ -600,8 +1270,7 @@ int DS_ReceivedRobotPackets()
  */
 void DS_ResetFMSPackets()
 {
-    sent_fms_packets = 0;
-    received_fms_packets = 0;
+    Statistics_ResetPackets (DS_CHANNEL_FMS);
 }
 
 /**
@@ -610,8 +1279,7 @@ void DS_ResetFMSPackets()
  */
 void DS_ResetRadioPackets()
 {
-    sent_radio_packets = 0;
-    received_radio_packets = 0;
+    Statistics_ResetPackets (DS_CHANNEL_RADIO);
 }
 
 /**
@@ -620,6 +1288,5 @@ void DS_ResetRadioPackets()
  */
 void DS_ResetRobotPackets()
 {
-    sent_robot_packets = 0;
-    received_robot_packets = 0;
+    Statistics_ResetPackets (DS_CHANNEL_ROBOT);
 }
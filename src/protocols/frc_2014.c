@@ -22,17 +22,27 @@
  */
 
 #include <math.h>
+#include <string.h>
 
 #include "DS_Utils.h"
+#include "DS_Packet.h"
 #include "DS_Config.h"
+#include "DS_Context.h"
+#include "DS_Quality.h"
 #include "DS_Protocol.h"
 #include "DS_Joysticks.h"
 #include "DS_DefaultProtocols.h"
 
+/*
+ * Protocol bytes used by the packet layouts (these must be constants)
+ */
+enum {
+    cEnabled = 0x20,
+};
+
 /*
  * Protocol bytes
  */
-static const uint8_t cEnabled          = 0x20;
 static const uint8_t cTestMode         = 0x02;
 static const uint8_t cAutonomous       = 0x10;
 static const uint8_t cTeleoperated     = 0x00;
@@ -50,9 +60,20 @@ static const uint8_t cFMSAutonomous    = 0x53;
 static const uint8_t cFMSTeleoperated  = 0x43;
 
 /*
- * Sent robot packet counters, they are used as packet IDs
+ * Layout of the 1024-byte robot packet. Everything after the header (the
+ * DS version, the zero padding and the CRC field, which is zero while the
+ * checksum is calculated) is constant, so its CRC is calculated only once.
+ */
+#define ROBOT_PACKET_SIZE    1024
+#define ROBOT_HEADER_SIZE    72
+#define ROBOT_TAIL_SIZE      (ROBOT_PACKET_SIZE - ROBOT_HEADER_SIZE)
+static const uint8_t cVersion [8] = {0x31, 0x34, 0x30, 0x32, 0x31, 0x37, 0x30, 0x30};
+
+/*
+ * Returned instead of the (ignored) FMS and radio packets
  */
-static unsigned int sent_robot_packets = 0;
+static char empty_packet_buf [1];
+static DS_String empty_packet = {empty_packet_buf, 0};
 
 /*
  * Joystick properties
@@ -62,12 +83,58 @@ static int max_hats = 0;
 static int max_buttons = 10;
 static int max_joysticks = 4;
 
-/*
- * Control code flags
+/**
+ * Holds the packets and flags of the protocol in a context
+ */
+typedef struct {
+    /* Sent robot packet counters, they are used as packet IDs */
+    unsigned int sent_robot_packets;
+
+    /* Persistent robot packet, only the header and the CRC change between
+     * ticks */
+    char robot_packet_buf [ROBOT_PACKET_SIZE];
+    DS_String robot_packet;
+    uint32_t robot_tail_crc;
+
+    /* Control code flags */
+    int resync;
+    int reboot;
+    int restart_code;
+} State;
+
+/**
+ * Holds the states read to generate a robot packet, so that they are looked
+ * up once per packet instead of once per field
  */
-static int resync = 1;
-static int reboot = 0;
-static int restart_code = 0;
+typedef struct {
+    State* state;
+    DS_ConfigSnapshot config;
+} Source;
+
+/**
+ * Lays out the robot packet of a new context and checksums its constant
+ * part
+ */
+static void init_state (void* ptr)
+{
+    State* s = (State*) ptr;
+    char* tail = s->robot_packet_buf + ROBOT_HEADER_SIZE;
+
+    memcpy (tail, cVersion, sizeof (cVersion));
+    s->robot_tail_crc = DS_CRC32 (tail, ROBOT_TAIL_SIZE);
+    s->robot_packet.buf = s->robot_packet_buf;
+    s->robot_packet.len = ROBOT_PACKET_SIZE;
+    s->resync = 1;
+}
+
+/**
+ * Returns the state of the protocol in the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), &init_state, NULL);
+}
 
 /**
  * Gets the alliance type from the received \a byte
@@ -110,13 +177,17 @@ static DS_Position get_position (const uint8_t byte)
  *     - The FMS communication state (the robot wants it)
  *     - Extra commands to the robot (e.g. reboot & resync)
  */
-static uint8_t get_control_code (void)
+static int get_control_code (const void* source)
 {
+    const Source* src = (const Source*) source;
+    const DS_ConfigSnapshot* cfg = &src->config;
+    State* s = src->state;
+
     uint8_t code = cEmergencyStopOff;
-    uint8_t enabled = CFG_GetRobotEnabled() ? cEnabled : 0x00;
+    uint8_t enabled = cfg->robot_enabled ? cEnabled : 0x00;
 
     /* Get the control mode (Test, Auto or TeleOp) */
-    switch (CFG_GetControlMode()) {
+    switch (cfg->control_mode) {
     case DS_CONTROL_TEST:
         code |= enabled + cTestMode;
         break;
@@ -132,19 +203,19 @@ static uint8_t get_control_code (void)
     }
 
     /* Resync robot communications */
-    if (resync)
+    if (s->resync)
         code |= cResyncComms;
 
     /* Let robot know if we are connected to FMS */
-    if (CFG_GetFMSCommunications())
+    if (cfg->fms_communications)
         code |= cFMS_Attached;
 
     /* Set the emergency stop state */
-    if (CFG_GetEmergencyStopped())
+    if (cfg->emergency_stopped)
         code = cEmergencyStopOn;
 
     /* Send the reboot code if required */
-    if (reboot)
+    if (s->reboot)
         code = cRebootRobot;
 
     return code;
@@ -155,9 +226,11 @@ static uint8_t get_control_code (void)
  * The robot application can use this information to adjust its programming for
  * the current alliance.
  */
-static uint8_t get_alliance_code (void)
+static int get_alliance_code (const void* source)
 {
-    if (CFG_GetAlliance() == DS_ALLIANCE_RED)
+    const Source* src = (const Source*) source;
+
+    if (src->config.robot_alliance == DS_ALLIANCE_RED)
         return cAllianceRed;
 
     return cAllianceBlue;
@@ -166,11 +239,12 @@ static uint8_t get_alliance_code (void)
 /**
  * Returns the alliance position code sent to the robot.
  */
-static uint8_t get_position_code (void)
+static int get_position_code (const void* source)
 {
+    const Source* src = (const Source*) source;
     uint8_t code = cPosition1;
 
-    switch (CFG_GetPosition()) {
+    switch (src->config.robot_position) {
     case DS_POSITION_1:
         code = cPosition1;
         break;
@@ -188,11 +262,22 @@ static uint8_t get_position_code (void)
 /**
  * Returns the (number?) of digital inputs connected to the computer.
  */
-static uint8_t get_digital_inputs (void)
+static int get_digital_inputs (const void* source)
 {
+    (void) source;
     return 0x00;
 }
 
+/**
+ * Returns the team number sent to the robot
+ */
+static int get_team_number (const void* source)
+{
+    const Source* src = (const Source*) source;
+
+    return src->config.team;
+}
+
 /**
  * Adds joystick information to a DS-to-robot packet, beginning at the given
  * \a offset in the data packet.
@@ -206,33 +291,156 @@ static uint8_t get_digital_inputs (void)
  *
  * Button states are stored in a similar way as enumerated flags in a C/C++
  * program.
+ *
+ * As with the \c DS_GetJoystick* functions, neutral values are sent while
+ * the robot is disabled.
+ *
+ * Returns the number of bytes written to \a data
  */
-static DS_String get_joystick_data (void)
+static int write_joystick_data (char* data, const Source* src)
 {
     /* Initialize variables */
     int i = 0;
     int j = 0;
-    DS_String buf = DS_StrNewLen (0);
+    int len = 0;
+    int count = 0;
+    DS_Joystick** joysticks = Joysticks_List (&count);
+
+    /* Do not send joystick values to a disabled robot */
+    if (!src->config.robot_enabled)
+        count = 0;
 
     /* Add data for every joystick */
     for (i = 0; i < max_joysticks; ++i) {
+        const DS_Joystick* stick = (i < count) ? joysticks [i] : NULL;
+        int num_axes = stick ? stick->num_axes : 0;
+        int num_buttons = stick ? stick->num_buttons : 0;
+
         /* Add axis data */
-        for (j = 0; j < max_axes; ++j)
-            DS_StrAppend (&buf, DS_FloatToByte (DS_GetJoystickAxis (i, j), 1));
+        for (j = 0; j < max_axes; ++j) {
+            float value = (j < num_axes) ? stick->axes [j] : 0;
+            data [len++] = DS_FloatToByte (value, 1);
+        }
 
         /* Generate button data */
         uint16_t button_flags = 0;
-        for (j = 0; j < max_buttons; ++j)
-            button_flags += (uint16_t) DS_GetJoystickButton (i, j) ? j * j : 0;
+        for (j = 0; j < max_buttons; ++j) {
+            int pressed = (j < num_buttons) ? stick->buttons [j] : 0;
+            button_flags += (uint16_t) pressed ? j * j : 0;
+        }
 
         /* Add button data */
-        DS_StrAppend (&buf, (button_flags & 0xff00) >> 8);
-        DS_StrAppend (&buf, (button_flags & 0xff));
+        data [len++] = (button_flags & 0xff00) >> 8;
+        data [len++] = (button_flags & 0xff);
     }
 
-    return buf;
+    return len;
+}
+
+/**
+ * Returns the index of the next robot packet
+ */
+static int robot_packet_index (const void* source)
+{
+    const Source* src = (const Source*) source;
+
+    return (int) src->state->sent_robot_packets;
+}
+
+/**
+ * Switches to the control mode requested by the FMS
+ */
+static void set_fms_control_mode (const int robotmod)
+{
+    if (robotmod & cFMSAutonomous)
+        CFG_SetControlMode (DS_CONTROL_AUTONOMOUS);
+
+    if (robotmod & cFMSTeleoperated)
+        CFG_SetControlMode (DS_CONTROL_TELEOPERATED);
 }
 
+/**
+ * Updates the alliance with the code sent by the FMS
+ */
+static void set_fms_alliance (const int alliance)
+{
+    CFG_SetAlliance (get_alliance ((uint8_t) alliance));
+}
+
+/**
+ * Updates the position with the code sent by the FMS
+ */
+static void set_fms_position (const int position)
+{
+    CFG_SetPosition (get_position ((uint8_t) position));
+}
+
+/**
+ * Calculates the robot voltage from the two bytes sent by the cRIO, using
+ * the rule of three
+ */
+static void set_robot_voltage (const int voltage)
+{
+    uint8_t upper = ((uint8_t) (voltage >> 8) * 12) / 0x12;
+    uint8_t lower = ((uint8_t) (voltage) * 12) / 0x12;
+    CFG_SetRobotVoltage (((float) upper) + ((float) lower / 0xff));
+}
+
+/**
+ * Checks if the robot is e-stopped
+ */
+static void set_robot_status (const int status)
+{
+    CFG_SetEmergencyStopped (status == cEmergencyStopOn);
+}
+
+/**
+ * Tracks the packet index echoed by the cRIO
+ */
+static void robot_index_received (const int index)
+{
+    Quality_PacketReceived (DS_CHANNEL_ROBOT, (uint16_t) index);
+}
+
+//----------------------------------------------------------------------------//
+// Packet layouts                                                             //
+//----------------------------------------------------------------------------//
+
+/*
+ * Header of the DS-to-robot packet (followed by the joystick data)
+ */
+static const DS_Field robot_out_fields [] = {
+    {"index",    0, 2, DS_BIG_ENDIAN, 0, 0, &robot_packet_index, NULL},
+    {"control",  2, 1, DS_BIG_ENDIAN, 0, 0, &get_control_code,   NULL},
+    {"inputs",   3, 1, DS_BIG_ENDIAN, 0, 0, &get_digital_inputs, NULL},
+    {"team",     4, 2, DS_BIG_ENDIAN, 0, 0, &get_team_number,    NULL},
+    {"alliance", 6, 1, DS_BIG_ENDIAN, 0, 0, &get_alliance_code,  NULL},
+    {"position", 7, 1, DS_BIG_ENDIAN, 0, 0, &get_position_code,  NULL},
+};
+
+/*
+ * FMS-to-DS packet
+ */
+static const DS_Field fms_in_fields [] = {
+    {"mode",     2, 1, DS_BIG_ENDIAN, 0,        0, NULL, &set_fms_control_mode},
+    {"enabled",  2, 1, DS_BIG_ENDIAN, cEnabled, 0, NULL, &CFG_SetRobotEnabled},
+    {"alliance", 3, 1, DS_BIG_ENDIAN, 0,        0, NULL, &set_fms_alliance},
+    {"position", 4, 1, DS_BIG_ENDIAN, 0,        0, NULL, &set_fms_position},
+};
+
+/*
+ * cRIO-to-DS packet
+ */
+static const DS_Field robot_in_fields [] = {
+    {"voltage",  1,  2, DS_BIG_ENDIAN, 0, 0, NULL, &set_robot_voltage},
+    {"status",   0,  1, DS_BIG_ENDIAN, 0, 0, NULL, &set_robot_status},
+    {"index",    30, 2, DS_BIG_ENDIAN, 0, 0, NULL, &robot_index_received},
+};
+
+static const DS_PacketLayout robot_out = DS_LAYOUT (robot_out_fields, 8);
+static const DS_PacketLayout fms_in = DS_LAYOUT (fms_in_fields, 5);
+static const DS_PacketLayout robot_in = DS_LAYOUT (robot_in_fields, ROBOT_PACKET_SIZE);
+
 /**
  * The FMS address is not defined, it will be assigned automatically when the
  * DS receives a FMS packet
@@ -274,6 +482,14 @@ static DS_String create_radio_packet (void)
     return  DS_StrNewLen (0);
 }
 
+/**
+ * Returns an empty (ignored) FMS or radio packet.
+ */
+static const DS_String* update_empty_packet (void)
+{
+    return &empty_packet;
+}
+
 /**
  * Generates a DS-to-robot packet. The packet is 1024 bytes long and contains
  * the following data:
@@ -285,57 +501,49 @@ static DS_String create_radio_packet (void)
  *     - (Number?) of digital inputs
  *     - The version of the FRC Driver Station
  *     - The CRC32 checksum of the packet
+ *
+ * The packet is kept between calls, the version bytes and the zero padding
+ * are written once and only the header and the checksum are updated here.
  */
-static DS_String create_robot_packet (void)
+static const DS_String* update_robot_packet (void)
 {
-    /* Create initial packet */
-    DS_String data = DS_StrNewLen (8);
-
-    /* Add packet index */
-    DS_StrSetChar (&data, 0, (sent_robot_packets & 0xff00) >> 8);
-    DS_StrSetChar (&data, 1, (sent_robot_packets & 0xff));
-
-    /* Add control code and digital inputs */
-    DS_StrSetChar (&data, 2, get_control_code());
-    DS_StrSetChar (&data, 3,  get_digital_inputs());
-
-    /* Add team number */
-    DS_StrSetChar (&data, 4, (CFG_GetTeamNumber() & 0xff00) >> 8);
-    DS_StrSetChar (&data, 5, (CFG_GetTeamNumber() & 0xff));
-
-    /* Add alliance and position */
-    DS_StrSetChar (&data, 6, get_alliance_code());
-    DS_StrSetChar (&data, 7, get_position_code());
-
-    /* Add joystick data */
-    DS_String jsData = get_joystick_data();
-    DS_StrJoin (&data, &jsData);
-
-    /* Now resize the datagram to 1024 bytes */
-    DS_StrResize (&data, 1024);
-
-    /* Add FRC Driver Station version (same as FRC DS 17.01) */
-    DS_StrSetChar (&data, 72, (uint8_t) 0x31);
-    DS_StrSetChar (&data, 73, (uint8_t) 0x34);
-    DS_StrSetChar (&data, 74, (uint8_t) 0x30);
-    DS_StrSetChar (&data, 75, (uint8_t) 0x32);
-    DS_StrSetChar (&data, 76, (uint8_t) 0x31);
-    DS_StrSetChar (&data, 77, (uint8_t) 0x37);
-    DS_StrSetChar (&data, 78, (uint8_t) 0x30);
-    DS_StrSetChar (&data, 79, (uint8_t) 0x30);
-
-    /* Add CRC32 checksum */
-    uint32_t checksum = DS_CRC32 (data.buf, DS_StrLen (&data));
-    DS_StrSetChar (&data, 1020, (checksum & 0xff000000) >> 24);
-    DS_StrSetChar (&data, 1021, (checksum & 0xff0000) >> 16);
-    DS_StrSetChar (&data, 1022, (checksum & 0xff00) >> 8);
-    DS_StrSetChar (&data, 1023, (checksum & 0xff));
+    Source src;
+    src.state = state();
+    CFG_GetSnapshot (&src.config);
+
+    State* s = src.state;
+    char* data = s->robot_packet_buf;
+
+    /* Add packet index, control code, team number, alliance and position */
+    DS_PacketEncode (&robot_out, data, &src);
+
+    /* Add joystick data (always fits before the DS version) */
+    write_joystick_data (data + 8, &src);
+
+    /* Add CRC32 checksum (the tail of the packet is always the same) */
+    uint32_t checksum = DS_CRC32Combine (DS_CRC32 (data, ROBOT_HEADER_SIZE),
+                                         s->robot_tail_crc, ROBOT_TAIL_SIZE);
+    data [1020] = (checksum & 0xff000000) >> 24;
+    data [1021] = (checksum & 0xff0000) >> 16;
+    data [1022] = (checksum & 0xff00) >> 8;
+    data [1023] = (checksum & 0xff);
+
+    /* The cRIO echoes the packet index, use it to measure trip times */
+    Quality_PacketSent (DS_CHANNEL_ROBOT, (uint16_t) s->sent_robot_packets);
 
     /* Increase sent robot packets */
-    ++sent_robot_packets;
+    ++s->sent_robot_packets;
 
     /* Return address of data */
-    return data;
+    return &s->robot_packet;
+}
+
+/**
+ * Generates a copy of the DS-to-robot packet, see \c update_robot_packet
+ */
+static DS_String create_robot_packet (void)
+{
+    return DS_StrDup (update_robot_packet());
 }
 
 /**
@@ -343,35 +551,7 @@ static DS_String create_robot_packet (void)
  */
 static int read_fms_packet (const DS_String* data)
 {
-    /* Data pointer is invalid */
-    if (!data)
-        return 0;
-
-    /* Packet is too small */
-    if (DS_StrLen (data) < 5)
-        return 0;
-
-    /* Read FMS packet */
-    uint8_t robotmod = (uint8_t) DS_StrCharAt (data, 2);
-    uint8_t alliance = (uint8_t) DS_StrCharAt (data, 3);
-    uint8_t position = (uint8_t) DS_StrCharAt (data, 4);
-
-    /* Switch to autonomous */
-    if (robotmod & cFMSAutonomous)
-        CFG_SetControlMode (DS_CONTROL_AUTONOMOUS);
-
-    /* Switch to teleoperated */
-    if (robotmod & cFMSTeleoperated)
-        CFG_SetControlMode (DS_CONTROL_TELEOPERATED);
-
-    /* Enable (or disable) the robot */
-    CFG_SetRobotEnabled (robotmod & cEnabled);
-
-    /* Set team station */
-    CFG_SetAlliance (get_alliance (alliance));
-    CFG_SetPosition (get_position (position));
-
-    return 1;
+    return DS_PacketDecode (&fms_in, data);
 }
 
 /**
@@ -387,28 +567,16 @@ static int read_radio_packet (const DS_String* data)
 /**
  * Interprets the given robot packet \a data and updates the emergency stop
  * state and the robot voltage values.
+ *
+ * The cRIO echoes the index of the last DS packet in bytes 30 and 31,
+ * we use it to detect lost packets and to measure trip times.
  */
-int read_robot_packet (const DS_String* data)
+static int read_robot_packet (const DS_String* data)
 {
-    /* Data pointer is invalid */
-    if (!data)
+    /* Read voltage, e-stop state and echoed packet index */
+    if (!DS_PacketDecode (&robot_in, data))
         return 0;
 
-    /* Packet is too small */
-    if (DS_StrLen (data) < 1024)
-        return 0;
-
-    /* Calculate voltage using the rule of three */
-    uint8_t upper = ((uint8_t) DS_StrCharAt (data, 1) * 12) / 0x12;
-    uint8_t lower = ((uint8_t) DS_StrCharAt (data, 2) * 12) / 0x12;
-
-    /* Construct the voltage float */
-    float voltage = ((float) upper) + ((float) lower / 0xff);
-    CFG_SetRobotVoltage (voltage);
-
-    /* Check if robot is e-stopped */
-    CFG_SetEmergencyStopped ((uint8_t) DS_StrCharAt (data, 0) == cEmergencyStopOn);
-
     /* Assume that robot code is present (issue #31 in QDriverStation) */
     CFG_SetRobotCode (1);
 
@@ -416,6 +584,31 @@ int read_robot_packet (const DS_String* data)
     return 1;
 }
 
+/**
+ * Returns \c 1 if the given \a data is a cRIO packet: the packet must be
+ * exactly \c ROBOT_PACKET_SIZE bytes long and end with a valid CRC32
+ * (calculated with the CRC field set to zero, as in the DS-to-robot packet).
+ *
+ * The robot status is not updated, so this function is used to identify
+ * the protocol of the robot.
+ */
+static int probe_robot_packet (const DS_String* data)
+{
+    static const uint8_t zeros [4] = {0};
+
+    if (!data || DS_StrLen (data) != ROBOT_PACKET_SIZE)
+        return 0;
+
+    const uint8_t* bytes = (const uint8_t*) data->buf;
+    uint32_t checksum = ((uint32_t) bytes [1020] << 24)
+                        | ((uint32_t) bytes [1021] << 16)
+                        | ((uint32_t) bytes [1022] << 8)
+                        | ((uint32_t) bytes [1023]);
+
+    return DS_CRC32Combine (DS_CRC32 (bytes, 1020), DS_CRC32 (zeros, 4), 4)
+           == checksum;
+}
+
 /**
  * Called when the FMS watchdog expires, does nothing...
  */
@@ -438,9 +631,11 @@ static void reset_radio (void)
  */
 static void reset_robot (void)
 {
-    resync = 1;
-    reboot = 0;
-    restart_code = 0;
+    State* s = state();
+
+    s->resync = 1;
+    s->reboot = 0;
+    s->restart_code = 0;
 }
 
 /**
@@ -449,7 +644,9 @@ static void reset_robot (void)
  */
 static void reboot_robot (void)
 {
-    reboot = 1;
+    State* s = state();
+
+    s->reboot = 1;
 }
 
 /**
@@ -458,7 +655,9 @@ static void reboot_robot (void)
  */
 void restart_robot_code (void)
 {
-    restart_code = 1;
+    State* s = state();
+
+    s->restart_code = 1;
 }
 
 /**
@@ -481,11 +680,15 @@ DS_Protocol DS_GetProtocolFRC_2014 (void)
     protocol.create_fms_packet = &create_fms_packet;
     protocol.create_radio_packet = &create_radio_packet;
     protocol.create_robot_packet = &create_robot_packet;
+    protocol.update_fms_packet = &update_empty_packet;
+    protocol.update_radio_packet = &update_empty_packet;
+    protocol.update_robot_packet = &update_robot_packet;
 
     /* Set packet interpretation functions */
     protocol.read_fms_packet = &read_fms_packet;
     protocol.read_radio_packet = &read_radio_packet;
     protocol.read_robot_packet = &read_robot_packet;
+    protocol.probe_robot_packet = &probe_robot_packet;
 
     /* Set reset functions */
     protocol.reset_fms = &reset_fms;
@@ -525,6 +728,8 @@ DS_Protocol DS_GetProtocolFRC_2014 (void)
     protocol.robot_socket.in_port = 1150;
     protocol.robot_socket.out_port = 1110;
     protocol.robot_socket.type = DS_SOCKET_UDP;
+    protocol.robot_socket.dscp = DS_DSCP_EF;
+    protocol.robot_socket.priority = DS_PRIORITY_INTERACTIVE;
 
     /* Define netconsole socket properties */
     protocol.netconsole_socket = *DS_SocketEmpty();
@@ -533,3 +738,54 @@ DS_Protocol DS_GetProtocolFRC_2014 (void)
     /* Return the pointer */
     return protocol;
 }
+
+//----------------------------------------------------------------------------//
+// Single-protocol builds                                                     //
+//----------------------------------------------------------------------------//
+
+#if defined LIBDS_STATIC_PROTOCOL
+#if LIBDS_STATIC_PROTOCOL == FRC_2014
+
+/**
+ * Returns 1 if \a ptr is the FRC 2014 protocol compiled into this build
+ */
+int Protocol_IsStatic (const DS_Protocol* ptr)
+{
+    return ptr->read_robot_packet == &read_robot_packet;
+}
+
+/*
+ * Packet functions called directly by the event loop
+ */
+const DS_String* Protocol_UpdateFMSPacket (void)
+{
+    return update_empty_packet();
+}
+
+const DS_String* Protocol_UpdateRadioPacket (void)
+{
+    return update_empty_packet();
+}
+
+const DS_String* Protocol_UpdateRobotPacket (void)
+{
+    return update_robot_packet();
+}
+
+int Protocol_ReadFMSPacket (const DS_String* data)
+{
+    return read_fms_packet (data);
+}
+
+int Protocol_ReadRadioPacket (const DS_String* data)
+{
+    return read_radio_packet (data);
+}
+
+int Protocol_ReadRobotPacket (const DS_String* data)
+{
+    return read_robot_packet (data);
+}
+
+#endif
+#endif
@@ -22,13 +22,15 @@
  */
 
 #include "DS_Utils.h"
+#include "DS_Packet.h"
 #include "DS_Config.h"
+#include "DS_Context.h"
+#include "DS_Quality.h"
 #include "DS_Protocol.h"
 #include "DS_Joysticks.h"
 #include "DS_DefaultProtocols.h"
 
 #include <time.h>
-#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -36,15 +38,28 @@
     #include <windows.h>
 #endif
 
+/*
+ * Protocol bytes used by the packet layouts (these must be constants)
+ */
+enum {
+    cEnabled        = 0x04,
+    cEmergencyStop  = 0x80,
+    cFMS_DS_Version = 0x00,
+    cTagGeneral     = 0x01,
+    cRobotHasCode   = 0x20,
+    cRTagCANInfo    = 0x0e,
+    cRTagCPUInfo    = 0x05,
+    cRTagRAMInfo    = 0x06,
+    cRTagDiskInfo   = 0x04,
+};
+
 /*
  * Protocol bytes
  */
 static const uint8_t cTest               = 0x01;
-static const uint8_t cEnabled            = 0x04;
 static const uint8_t cAutonomous         = 0x02;
 static const uint8_t cTeleoperated       = 0x00;
 static const uint8_t cFMS_Attached       = 0x08;
-static const uint8_t cEmergencyStop      = 0x80;
 static const uint8_t cRequestReboot      = 0x08;
 static const uint8_t cRequestNormal      = 0x80;
 static const uint8_t cRequestUnconnected = 0x00;
@@ -52,9 +67,7 @@ static const uint8_t cRequestRestartCode = 0x04;
 static const uint8_t cFMS_RadioPing      = 0x10;
 static const uint8_t cFMS_RobotPing      = 0x08;
 static const uint8_t cFMS_RobotComms     = 0x20;
-static const uint8_t cFMS_DS_Version     = 0x00;
 static const uint8_t cTagDate            = 0x0f;
-static const uint8_t cTagGeneral         = 0x01;
 static const uint8_t cTagJoystick        = 0x0c;
 static const uint8_t cTagTimezone        = 0x10;
 static const uint8_t cRed1               = 0x00;
@@ -63,25 +76,73 @@ static const uint8_t cRed3               = 0x02;
 static const uint8_t cBlue1              = 0x03;
 static const uint8_t cBlue2              = 0x04;
 static const uint8_t cBlue3              = 0x05;
-static const uint8_t cRTagCANInfo        = 0x0e;
-static const uint8_t cRTagCPUInfo        = 0x05;
-static const uint8_t cRTagRAMInfo        = 0x06;
-static const uint8_t cRTagDiskInfo       = 0x04;
 static const uint8_t cRequestTime        = 0x01;
-static const uint8_t cRobotHasCode       = 0x20;
+static const uint8_t cCommVersion        = 0x01;
 
 /*
- * Sent robot and FMS packet counters
+ * Persistent packets, the robot packet is limited to the payload of a
+ * single Ethernet frame
  */
-static unsigned int send_time_data = 0;
-static unsigned int sent_fms_packets = 0;
-static unsigned int sent_robot_packets = 0;
+#define FMS_PACKET_SIZE    8
+#define ROBOT_HEADER_SIZE  6
+#define ROBOT_PACKET_SIZE  1472
 
 /*
- * Control code flags
+ * Returned instead of the (ignored) radio packet
+ */
+static char radio_packet_buf [1];
+static DS_String radio_packet = {radio_packet_buf, 0};
+
+/**
+ * Holds the packets and flags of the protocol in a context
+ */
+typedef struct {
+    /* Sent robot and FMS packet counters */
+    unsigned int send_time_data;
+    unsigned int sent_fms_packets;
+    unsigned int sent_robot_packets;
+
+    /* Persistent packets */
+    char fms_packet_buf [FMS_PACKET_SIZE];
+    char robot_packet_buf [ROBOT_PACKET_SIZE];
+    DS_String fms_packet;
+    DS_String robot_packet;
+
+    /* Control code flags */
+    int reboot;
+    int restart_code;
+} State;
+
+/**
+ * Holds the states read to generate a packet, so that they are looked up
+ * once per packet instead of once per field
+ */
+typedef struct {
+    State* state;
+    DS_ConfigSnapshot config;
+} Source;
+
+/**
+ * Points the persistent packets of a new context to their buffers
+ */
+static void init_state (void* ptr)
+{
+    State* s = (State*) ptr;
+
+    s->fms_packet.buf = s->fms_packet_buf;
+    s->fms_packet.len = FMS_PACKET_SIZE;
+    s->robot_packet.buf = s->robot_packet_buf;
+    s->robot_packet.len = 0;
+}
+
+/**
+ * Returns the state of the protocol in the current context
  */
-static int reboot = 0;
-static int restart_code = 0;
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), &init_state, NULL);
+}
 
 /**
  * Obtains the voltage float from the given \a upper and \a lower bytes
@@ -114,12 +175,13 @@ static void encode_voltage (float voltage, uint8_t* upper, uint8_t* lower)
  *    - Robot radio connected?
  *    - The operation state (e-stop, normal)
  */
-static uint8_t fms_control_code (void)
+static int fms_control_code (const void* source)
 {
+    const DS_ConfigSnapshot* cfg = &((const Source*) source)->config;
     uint8_t code = 0;
 
     /* Let the FMS know the operational status of the robot */
-    switch (CFG_GetControlMode()) {
+    switch (cfg->control_mode) {
     case DS_CONTROL_TEST:
         code |= cTest;
         break;
@@ -132,19 +194,19 @@ static uint8_t fms_control_code (void)
     }
 
     /* Let the FMS know if robot is e-stopped */
-    if (CFG_GetEmergencyStopped())
+    if (cfg->emergency_stopped)
         code |= cEmergencyStop;
 
     /* Let the FMS know if the robot is enabled */
-    if (CFG_GetRobotEnabled())
+    if (cfg->robot_enabled)
         code |= cEnabled;
 
     /* Let the FMS know if we are connected to radio */
-    if (CFG_GetRadioCommunications())
+    if (cfg->radio_communications)
         code |= cFMS_RadioPing;
 
     /* Let the FMS know if we are connected to robot */
-    if (CFG_GetRobotCommunications()) {
+    if (cfg->robot_communications) {
         code |= cFMS_RobotComms;
         code |= cFMS_RobotPing;
     }
@@ -159,12 +221,13 @@ static uint8_t fms_control_code (void)
  *    - The FMS attached keyword
  *    - The operation state (e-stop, normal)
  */
-static uint8_t get_control_code (void)
+static int get_control_code (const void* source)
 {
+    const DS_ConfigSnapshot* cfg = &((const Source*) source)->config;
     uint8_t code = 0;
 
     /* Get current control mode (Test, Auto or Teleop) */
-    switch (CFG_GetControlMode()) {
+    switch (cfg->control_mode) {
     case DS_CONTROL_TEST:
         code |= cTest;
         break;
@@ -179,15 +242,15 @@ static uint8_t get_control_code (void)
     }
 
     /* Let the robot know if we are connected to the FMS */
-    if (CFG_GetFMSCommunications())
+    if (cfg->fms_communications)
         code |= cFMS_Attached;
 
     /* Let the robot know if it should e-stop right now */
-    if (CFG_GetEmergencyStopped())
+    if (cfg->emergency_stopped)
         code |= cEmergencyStop;
 
     /* Append the robot enabled state */
-    if (CFG_GetRobotEnabled())
+    if (cfg->robot_enabled)
         code |= cEnabled;
 
     return code;
@@ -199,15 +262,18 @@ static uint8_t get_control_code (void)
  *    - Reboot the roboRIO
  *    - Restart the robot code process
  */
-static uint8_t get_request_code (void)
+static int get_request_code (const void* source)
 {
+    const Source* src = (const Source*) source;
+    State* s = src->state;
+
     uint8_t code = cRequestNormal;
 
     /* Robot has comms, check if we need to send additional flags */
-    if (CFG_GetRobotCommunications()) {
-        if (reboot)
+    if (src->config.robot_communications) {
+        if (s->reboot)
             code = cRequestReboot;
-        else if (restart_code)
+        else if (s->restart_code)
             code = cRequestRestartCode;
     }
 
@@ -223,27 +289,29 @@ static uint8_t get_request_code (void)
  * This value may be used by the robot program to use specialized autonomous
  * modes or adjust sensor input.
  */
-static uint8_t get_station_code (void)
+static int get_station_code (const void* source)
 {
+    const DS_ConfigSnapshot* cfg = &((const Source*) source)->config;
+
     /* Current config is set to position 1 */
-    if (CFG_GetPosition() == DS_POSITION_1) {
-        if (CFG_GetAlliance() == DS_ALLIANCE_RED)
+    if (cfg->robot_position == DS_POSITION_1) {
+        if (cfg->robot_alliance == DS_ALLIANCE_RED)
             return cRed1;
         else
             return cBlue1;
     }
 
     /* Current config is set to position 2 */
-    if (CFG_GetPosition() == DS_POSITION_2) {
-        if (CFG_GetAlliance() == DS_ALLIANCE_RED)
+    if (cfg->robot_position == DS_POSITION_2) {
+        if (cfg->robot_alliance == DS_ALLIANCE_RED)
             return cRed2;
         else
             return cBlue2;
     }
 
     /* Current config is set to position 3 */
-    if (CFG_GetPosition() == DS_POSITION_3) {
-        if (CFG_GetAlliance() == DS_ALLIANCE_RED)
+    if (cfg->robot_position == DS_POSITION_3) {
+        if (cfg->robot_alliance == DS_ALLIANCE_RED)
             return cRed3;
         else
             return cBlue3;
@@ -257,12 +325,12 @@ static uint8_t get_station_code (void)
  * joystick data (which is sent to the robot) and to resize the client->robot
  * datagram automatically.
  */
-static uint8_t get_joystick_size (const int joystick)
+static uint8_t get_joystick_size (const DS_Joystick* joystick)
 {
     int header_size = 2;
     int button_data = 3;
-    int axis_data = DS_GetJoystickNumAxes (joystick) + 1;
-    int hat_data = (DS_GetJoystickNumHats (joystick) * 2) + 1;
+    int axis_data = joystick->num_axes + 1;
+    int hat_data = (joystick->num_hats * 2) + 1;
 
     return header_size + button_data + axis_data + hat_data;
 }
@@ -331,6 +399,7 @@ static DS_String get_timezone_data (void)
 
     /* Add timezone string */
     DS_StrJoin (&data, &tz);
+    DS_StrRmBuf (&tz);
 
     /* Return the obtained data */
     return data;
@@ -340,75 +409,109 @@ static DS_String get_timezone_data (void)
  * Constructs a joystick information structure for every attached joystick.
  * Unlike the 2014 protocol, the 2015 protocol only generates joystick data
  * for the attached joysticks.
+ *
+ * The structures are written to \a data, joysticks that do not fit in the
+ * given \a size are not added. As with the \c DS_GetJoystick* functions,
+ * neutral values are sent while the robot is disabled. Returns the number
+ * of bytes written.
  */
-static DS_String get_joystick_data (void)
+static int write_joystick_data (char* data, const int size, const Source* src)
 {
     /* Initialize the variables */
     int i = 0;
     int j = 0;
-    DS_String data = DS_StrNewLen (0);
+    int len = 0;
+    int count = 0;
+    int enabled = src->config.robot_enabled;
+    DS_Joystick** joysticks = Joysticks_List (&count);
 
     /* Generate data for each joystick */
-    for (i = 0; i < DS_GetJoystickCount(); ++i) {
-        DS_StrAppend (&data, get_joystick_size (i));
-        DS_StrAppend (&data, cTagJoystick);
+    for (i = 0; i < count; ++i) {
+        const DS_Joystick* stick = joysticks [i];
+
+        /* Joystick structure does not fit in the packet */
+        uint8_t js_size = get_joystick_size (stick);
+        if (len + js_size > size)
+            break;
+
+        data [len++] = js_size;
+        data [len++] = cTagJoystick;
 
         /* Add axis data */
-        DS_StrAppend (&data, DS_GetJoystickNumAxes (i));
-        for (j = 0; j < DS_GetJoystickNumAxes (i); ++j)
-            DS_StrAppend (&data, DS_FloatToByte (DS_GetJoystickAxis (i, j), 1));
+        data [len++] = stick->num_axes;
+        for (j = 0; j < stick->num_axes; ++j)
+            data [len++] = DS_FloatToByte (enabled ? stick->axes [j] : 0, 1);
 
-        /* Generate button data */
+        /* Generate button data (only 16 buttons fit in the flags) */
         uint16_t button_flags = 0;
-        for (j = 0; j < DS_GetJoystickNumButtons (i); ++j)
-            button_flags += DS_GetJoystickButton (i, j) ? (int) pow (2, j) : 0;
+        int num_flags = DS_Min (stick->num_buttons, 16);
+        for (j = 0; enabled && j < num_flags; ++j)
+            button_flags |= stick->buttons [j] ? (1 << j) : 0;
 
         /* Add button data */
-        DS_StrAppend (&data, DS_GetJoystickNumButtons (i));
-        DS_StrAppend (&data, (uint8_t) (button_flags >> 8));
-        DS_StrAppend (&data, (uint8_t) (button_flags));
+        data [len++] = stick->num_buttons;
+        data [len++] = (uint8_t) (button_flags >> 8);
+        data [len++] = (uint8_t) (button_flags);
 
         /* Add hat data */
-        DS_StrAppend (&data, DS_GetJoystickNumHats (i));
-        for (j = 0; j < DS_GetJoystickNumHats (i); ++j) {
-            DS_StrAppend (&data, (uint8_t) (DS_GetJoystickHat (i, j) >> 8));
-            DS_StrAppend (&data, (uint8_t) (DS_GetJoystickHat (i, j)));
+        data [len++] = stick->num_hats;
+        for (j = 0; j < stick->num_hats; ++j) {
+            int angle = enabled ? stick->hats [j] : 0;
+            data [len++] = (uint8_t) (angle >> 8);
+            data [len++] = (uint8_t) (angle);
         }
     }
 
-    /* Return obtained data */
-    return data;
+    /* Return number of written bytes */
+    return len;
 }
 
 /**
- * Obtains the CPU, RAM, Disk and CAN information from the robot packet
+ * Obtains the CAN utilization from a CAN info tag
  */
-static void read_extended (const DS_String* data, const int offset)
+static void read_can_info (const uint8_t* payload, const int len)
 {
-    /* Check if data pointer is valid */
-    if (!data)
-        return;
-
-    /* Get header tag */
-    uint8_t tag = (uint8_t) DS_StrCharAt (data, offset + 1);
-
-    /* Get CAN information */
-    if (tag == cRTagCANInfo)
-        CFG_SetCANUtilization ((uint8_t) DS_StrCharAt (data, 10));
+    if (len > 0)
+        CFG_SetCANUtilization (payload [0]);
+}
 
-    /* Get CPU usage */
-    else if (tag == cRTagCPUInfo)
-        CFG_SetRobotCPUUsage ((uint8_t) DS_StrCharAt (data, 3));
+/**
+ * Obtains the CPU usage from a CPU info tag
+ */
+static void read_cpu_info (const uint8_t* payload, const int len)
+{
+    if (len > 0)
+        CFG_SetRobotCPUUsage (payload [0]);
+}
 
-    /* Get RAM usage */
-    else if (tag == cRTagRAMInfo)
-        CFG_SetRobotRAMUsage ((uint8_t) DS_StrCharAt (data, 4));
+/**
+ * Obtains the RAM usage from a RAM info tag
+ */
+static void read_ram_info (const uint8_t* payload, const int len)
+{
+    if (len > 0)
+        CFG_SetRobotRAMUsage (payload [0]);
+}
 
-    /* Get disk usage */
-    else if (tag == cRTagDiskInfo)
-        CFG_SetRobotDiskUsage ((uint8_t)  DS_StrCharAt (data, 4));
+/**
+ * Obtains the disk usage from a disk info tag
+ */
+static void read_disk_info (const uint8_t* payload, const int len)
+{
+    if (len > 0)
+        CFG_SetRobotDiskUsage (payload [0]);
 }
 
+/*
+ * Handlers of the extended tags sent by the robot, indexed by tag ID
+ */
+static const DS_TagHandler robot_tag_handlers [256] = {
+    [cRTagCANInfo]  = &read_can_info,
+    [cRTagCPUInfo]  = &read_cpu_info,
+    [cRTagRAMInfo]  = &read_ram_info,
+    [cRTagDiskInfo] = &read_disk_info,
+};
+
 /**
  * Gets the alliance type from the received \a byte
  * This function is used to update the robot configuration when receiving data
@@ -441,6 +544,157 @@ static DS_Position get_position (const uint8_t byte)
     return DS_POSITION_1;
 }
 
+/**
+ * Returns the index of the next FMS packet
+ */
+static int fms_packet_index (const void* source)
+{
+    const Source* src = (const Source*) source;
+
+    return (int) src->state->sent_fms_packets;
+}
+
+/**
+ * Returns the index of the next robot packet
+ */
+static int robot_packet_index (const void* source)
+{
+    const Source* src = (const Source*) source;
+
+    return (int) src->state->sent_robot_packets;
+}
+
+/**
+ * Returns the team number sent to the FMS
+ */
+static int get_team_number (const void* source)
+{
+    const Source* src = (const Source*) source;
+
+    return src->config.team;
+}
+
+/**
+ * Returns the robot voltage encoded in two bytes
+ */
+static int fms_robot_voltage (const void* source)
+{
+    const Source* src = (const Source*) source;
+
+    uint8_t integer = 0;
+    uint8_t decimal = 0;
+    encode_voltage (src->config.robot_voltage, &integer, &decimal);
+    return (integer << 8) | decimal;
+}
+
+/**
+ * Tracks the index of the received FMS packet to detect lost packets
+ */
+static void fms_index_received (const int index)
+{
+    Quality_PacketReceived (DS_CHANNEL_FMS, (uint16_t) index);
+}
+
+/**
+ * The robot echoes the index of our packets
+ */
+static void robot_index_received (const int index)
+{
+    Quality_PacketReceived (DS_CHANNEL_ROBOT, (uint16_t) index);
+}
+
+/**
+ * Changes the control mode based on what the FMS tells us to do
+ */
+static void set_fms_control_mode (const int control)
+{
+    if (control & cTeleoperated)
+        CFG_SetControlMode (DS_CONTROL_TELEOPERATED);
+    else if (control & cAutonomous)
+        CFG_SetControlMode (DS_CONTROL_AUTONOMOUS);
+    else if (control & cTest)
+        CFG_SetControlMode (DS_CONTROL_TEST);
+}
+
+/**
+ * Updates the alliance and position with the station sent by the FMS
+ */
+static void set_fms_station (const int station)
+{
+    CFG_SetAlliance (get_alliance ((uint8_t) station));
+    CFG_SetPosition (get_position ((uint8_t) station));
+}
+
+/**
+ * Updates the robot voltage with the two bytes sent by the robot
+ */
+static void set_robot_voltage (const int voltage)
+{
+    CFG_SetRobotVoltage (decode_voltage (voltage >> 8, voltage & 0xff));
+}
+
+/**
+ * Updates the date/time request flag
+ */
+static void set_request (const int request)
+{
+    State* s = state();
+
+    s->send_time_data = (request == cRequestTime);
+}
+
+//----------------------------------------------------------------------------//
+// Packet layouts                                                             //
+//----------------------------------------------------------------------------//
+
+/*
+ * DS-to-FMS packet
+ */
+static const DS_Field fms_out_fields [] = {
+    {"index",   0, 2, DS_BIG_ENDIAN, 0, 0,               &fms_packet_index,   NULL},
+    {"version", 2, 1, DS_BIG_ENDIAN, 0, cFMS_DS_Version, NULL,                NULL},
+    {"control", 3, 1, DS_BIG_ENDIAN, 0, 0,               &fms_control_code,   NULL},
+    {"team",    4, 2, DS_BIG_ENDIAN, 0, 0,               &get_team_number,    NULL},
+    {"voltage", 6, 2, DS_BIG_ENDIAN, 0, 0,               &fms_robot_voltage,  NULL},
+};
+
+/*
+ * Header of the DS-to-robot packet (followed by the date or joystick tags)
+ */
+static const DS_Field robot_out_fields [] = {
+    {"index",   0, 2, DS_BIG_ENDIAN, 0, 0,           &robot_packet_index, NULL},
+    {"tag",     2, 1, DS_BIG_ENDIAN, 0, cTagGeneral, NULL,                NULL},
+    {"control", 3, 1, DS_BIG_ENDIAN, 0, 0,           &get_control_code,   NULL},
+    {"request", 4, 1, DS_BIG_ENDIAN, 0, 0,           &get_request_code,   NULL},
+    {"station", 5, 1, DS_BIG_ENDIAN, 0, 0,           &get_station_code,   NULL},
+};
+
+/*
+ * FMS-to-DS packet (we do not use the match information after byte 5)
+ */
+static const DS_Field fms_in_fields [] = {
+    {"index",   0, 2, DS_BIG_ENDIAN, 0,        0, NULL, &fms_index_received},
+    {"enabled", 3, 1, DS_BIG_ENDIAN, cEnabled, 0, NULL, &CFG_SetRobotEnabled},
+    {"control", 3, 1, DS_BIG_ENDIAN, 0,        0, NULL, &set_fms_control_mode},
+    {"station", 5, 1, DS_BIG_ENDIAN, 0,        0, NULL, &set_fms_station},
+};
+
+/*
+ * Robot-to-DS packet (followed by the extended tags)
+ */
+static const DS_Field robot_in_fields [] = {
+    {"index",   0, 2, DS_BIG_ENDIAN, 0,              0, NULL, &robot_index_received},
+    {"code",    4, 1, DS_BIG_ENDIAN, cRobotHasCode,  0, NULL, &CFG_SetRobotCode},
+    {"estop",   3, 1, DS_BIG_ENDIAN, cEmergencyStop, 0, NULL, &CFG_SetEmergencyStopped},
+    {"request", 7, 1, DS_BIG_ENDIAN, 0,              0, NULL, &set_request},
+    {"voltage", 5, 2, DS_BIG_ENDIAN, 0,              0, NULL, &set_robot_voltage},
+};
+
+static const DS_PacketLayout fms_out = DS_LAYOUT (fms_out_fields, FMS_PACKET_SIZE);
+static const DS_PacketLayout robot_out = DS_LAYOUT (robot_out_fields, ROBOT_HEADER_SIZE);
+static const DS_PacketLayout fms_in = DS_LAYOUT (fms_in_fields, 22);
+static const DS_PacketLayout robot_in = DS_LAYOUT (robot_in_fields, 7);
+
 /**
  * The FMS address is not defined, it will be assigned automatically when the
  * DS receives a FMS packet
@@ -475,36 +729,29 @@ static DS_String robot_address (void)
  *    - Radio and robot ping flags
  *    - The team number
  */
-static DS_String create_fms_packet (void)
+static const DS_String* update_fms_packet (void)
 {
-    /* Create an 8-byte long packet */
-    DS_String data = DS_StrNewLen (8);
-
-    /* Get voltage bytes */
-    uint8_t integer = 0;
-    uint8_t decimal = 0;
-    encode_voltage (CFG_GetRobotVoltage(), &integer, &decimal);
-
-    /* Add FMS packet count */
-    DS_StrSetChar (&data, 0, (sent_fms_packets >> 8));
-    DS_StrSetChar (&data, 1, (sent_fms_packets));
+    Source src;
+    src.state = state();
+    CFG_GetSnapshot (&src.config);
 
-    /* Add DS version and FMS control code */
-    DS_StrSetChar (&data, 2, cFMS_DS_Version);
-    DS_StrSetChar (&data, 3, fms_control_code());
+    State* s = src.state;
 
-    /* Add team number */
-    DS_StrSetChar (&data, 4, (CFG_GetTeamNumber() >> 8));
-    DS_StrSetChar (&data, 5, (CFG_GetTeamNumber()));
-
-    /* Add robot voltage */
-    DS_StrSetChar (&data, 6, integer);
-    DS_StrSetChar (&data, 7, decimal);
+    /* Encode the FMS packet fields */
+    DS_PacketEncode (&fms_out, s->fms_packet_buf, &src);
 
     /* Increase FMS packet counter */
-    ++sent_fms_packets;
+    ++s->sent_fms_packets;
 
-    return data;
+    return &s->fms_packet;
+}
+
+/**
+ * Generates a copy of the DS-to-FMS packet, see \c update_fms_packet
+ */
+static DS_String create_fms_packet (void)
+{
+    return DS_StrDup (update_fms_packet());
 }
 
 /**
@@ -512,6 +759,14 @@ static DS_String create_fms_packet (void)
  * to the DS Radio / Bridge. For that reason, the 2015 communication protocol
  * generates empty radio packets.
  */
+static const DS_String* update_radio_packet (void)
+{
+    return &radio_packet;
+}
+
+/**
+ * Generates an empty radio packet
+ */
 static DS_String create_radio_packet (void)
 {
     return  DS_StrNewLen (0);
@@ -526,39 +781,53 @@ static DS_String create_radio_packet (void)
  *    - Team station (alliance & position)
  *    - Date and time data (if robot requests it)
  *    - Joystick information (if the robot does not want date/time)
+ *
+ * The packet is kept between calls and its fields are overwritten in place,
+ * so no memory is allocated unless the robot asks for the date and time.
  */
-static DS_String create_robot_packet (void)
+static const DS_String* update_robot_packet (void)
 {
-    DS_String data = DS_StrNewLen (6);
-
-    /* Add packet index */
-    DS_StrSetChar (&data, 0, (sent_robot_packets >> 8));
-    DS_StrSetChar (&data, 1, (sent_robot_packets));
+    Source src;
+    src.state = state();
+    CFG_GetSnapshot (&src.config);
 
-    /* Add packet header */
-    DS_StrSetChar (&data, 2, cTagGeneral);
+    State* s = src.state;
+    char* data = s->robot_packet_buf;
+    int len = ROBOT_HEADER_SIZE;
 
-    /* Add control code, request flags and team station */
-    DS_StrSetChar (&data, 3, get_control_code());
-    DS_StrSetChar (&data, 4, get_request_code());
-    DS_StrSetChar (&data, 5, get_station_code());
+    /* Add packet index, control code, request flags and team station */
+    DS_PacketEncode (&robot_out, data, &src);
 
     /* Add timezone data (if robot wants it) */
-    if (send_time_data) {
+    if (s->send_time_data) {
         DS_String tz = get_timezone_data();
-        DS_StrJoin (&data, &tz);
+        memcpy (data + len, tz.buf, tz.len);
+        len += (int) tz.len;
+        DS_StrRmBuf (&tz);
     }
 
     /* Add joystick data */
-    else if (sent_robot_packets > 5) {
-        DS_String js = get_joystick_data();
-        DS_StrJoin (&data, &js);
-    }
+    else if (s->sent_robot_packets > 5)
+        len += write_joystick_data (data + len, ROBOT_PACKET_SIZE - len, &src);
+
+    /* Update packet length */
+    s->robot_packet.len = len;
+
+    /* The robot echoes the packet index, use it to measure trip times */
+    Quality_PacketSent (DS_CHANNEL_ROBOT, (uint16_t) s->sent_robot_packets);
 
     /* Increase robot packet counter */
-    ++sent_robot_packets;
+    ++s->sent_robot_packets;
 
-    return data;
+    return &s->robot_packet;
+}
+
+/**
+ * Generates a copy of the DS-to-robot packet, see \c update_robot_packet
+ */
+static DS_String create_robot_packet (void)
+{
+    return DS_StrDup (update_robot_packet());
 }
 
 /**
@@ -571,38 +840,7 @@ static DS_String create_robot_packet (void)
  */
 static int read_fms_packet (const DS_String* data)
 {
-    /* Data pointer is invalid */
-    if (!data)
-        return 0;
-
-    /* Packet is too small */
-    if (DS_StrLen (data) < 22)
-        return 0;
-
-    /* Read FMS packet */
-    uint8_t control = (uint8_t) DS_StrCharAt (data, 3);
-    uint8_t station = (uint8_t) DS_StrCharAt (data, 5);
-
-    /* Change robot enabled state based on what FMS tells us to do*/
-    CFG_SetRobotEnabled (control & cEnabled);
-
-    /* Get FMS robot mode */
-    if (control & cTeleoperated)
-        CFG_SetControlMode (DS_CONTROL_TELEOPERATED);
-    else if (control & cAutonomous)
-        CFG_SetControlMode (DS_CONTROL_AUTONOMOUS);
-    else if (control & cTest)
-        CFG_SetControlMode (DS_CONTROL_TEST);
-
-    /* Update to correct alliance and position */
-    CFG_SetAlliance (get_alliance (station));
-    CFG_SetPosition (get_position (station));
-
-    /* After this, we have more information about the current match,
-     * but we do not really use it, so... */
-
-    /* Packet read successfully */
-    return 1;
+    return DS_PacketDecode (&fms_in, data);
 }
 
 /**
@@ -625,36 +863,47 @@ static int read_radio_packet (const DS_String* data)
  */
 static int read_robot_packet (const DS_String* data)
 {
-    /* Data pointer is invalid */
-    if (!data)
+    /* Read the fixed part of the robot packet */
+    if (!DS_PacketDecode (&robot_in, data))
         return 0;
 
-    /* Packet is too small */
-    if (DS_StrLen (data) < 7)
-        return 0;
+    /* This is an extended packet, read every tag of its extra data */
+    if (DS_StrLen (data) > 9)
+        DS_PacketReadTags (data, 8, robot_tag_handlers);
 
-    /* Read robot packet */
-    uint8_t control = (uint8_t) DS_StrCharAt (data, 3);
-    uint8_t rstatus = (uint8_t) DS_StrCharAt (data, 4);
-    uint8_t request = (uint8_t) DS_StrCharAt (data, 7);
+    /* Packet read, feed the watchdog some meat */
+    return 1;
+}
 
-    /* Update client information */
-    CFG_SetRobotCode (rstatus & cRobotHasCode);
-    CFG_SetEmergencyStopped (control & cEmergencyStop);
+/**
+ * Returns \c 1 if the given \a data is a roboRIO packet: the packet must
+ * hold the communication version in its third byte, and its extended tags
+ * must fill the rest of the packet exactly.
+ *
+ * The robot status is not updated, so this function is used to identify
+ * the protocol of the robot.
+ */
+static int probe_robot_packet (const DS_String* data)
+{
+    if (!data)
+        return 0;
 
-    /* Update date/time request flag */
-    send_time_data = (request == cRequestTime);
+    /* Check the size and the communication version */
+    int len = DS_StrLen (data);
+    const uint8_t* bytes = (const uint8_t*) data->buf;
+    if (len < robot_in.size || len > ROBOT_PACKET_SIZE || bytes [2] != cCommVersion)
+        return 0;
 
-    /* Calculate the voltage */
-    uint8_t upper = (uint8_t) DS_StrCharAt (data, 5);
-    uint8_t lower = (uint8_t) DS_StrCharAt (data, 6);
-    CFG_SetRobotVoltage (decode_voltage (upper, lower));
+    /* Every tag must be complete, and nothing may follow the last tag */
+    int pos = 8;
+    while (pos < len) {
+        int size = bytes [pos];
+        if (size < 1 || pos + 1 + size > len)
+            return 0;
 
-    /* This is an extended packet, read its extra data */
-    if (DS_StrLen (data) > 9)
-        read_extended (data, 8);
+        pos += size + 1;
+    }
 
-    /* Packet read, feed the watchdog some meat */
     return 1;
 }
 
@@ -679,9 +928,11 @@ static void reset_radio (void)
  */
 static void reset_robot (void)
 {
-    reboot = 0;
-    restart_code = 0;
-    send_time_data = 0;
+    State* s = state();
+
+    s->reboot = 0;
+    s->restart_code = 0;
+    s->send_time_data = 0;
 }
 
 /**
@@ -689,7 +940,9 @@ static void reset_robot (void)
  */
 static void reboot_robot (void)
 {
-    reboot = 1;
+    State* s = state();
+
+    s->reboot = 1;
 }
 
 /**
@@ -698,7 +951,9 @@ static void reboot_robot (void)
  */
 static void restart_robot_code (void)
 {
-    restart_code = 1;
+    State* s = state();
+
+    s->restart_code = 1;
 }
 
 /**
@@ -721,11 +976,15 @@ DS_Protocol DS_GetProtocolFRC_2015 (void)
     protocol.create_fms_packet = &create_fms_packet;
     protocol.create_radio_packet = &create_radio_packet;
     protocol.create_robot_packet = &create_robot_packet;
+    protocol.update_fms_packet = &update_fms_packet;
+    protocol.update_radio_packet = &update_radio_packet;
+    protocol.update_robot_packet = &update_robot_packet;
 
     /* Set packet interpretation functions */
     protocol.read_fms_packet = &read_fms_packet;
     protocol.read_radio_packet = &read_radio_packet;
     protocol.read_robot_packet = &read_robot_packet;
+    protocol.probe_robot_packet = &probe_robot_packet;
 
     /* Set reset functions */
     protocol.reset_fms = &reset_fms;
@@ -765,6 +1024,8 @@ DS_Protocol DS_GetProtocolFRC_2015 (void)
     protocol.robot_socket.in_port = 1150;
     protocol.robot_socket.out_port = 1110;
     protocol.robot_socket.type = DS_SOCKET_UDP;
+    protocol.robot_socket.dscp = DS_DSCP_EF;
+    protocol.robot_socket.priority = DS_PRIORITY_INTERACTIVE;
 
     /* Define netconsole socket properties */
     protocol.netconsole_socket = *DS_SocketEmpty();
@@ -773,7 +1034,63 @@ DS_Protocol DS_GetProtocolFRC_2015 (void)
     protocol.netconsole_socket.in_port = 6666;
     protocol.netconsole_socket.out_port = 6668;
     protocol.netconsole_socket.type = DS_SOCKET_UDP;
+    protocol.netconsole_socket.dscp = DS_DSCP_CS1;
+    protocol.netconsole_socket.priority = DS_PRIORITY_BULK;
 
     /* Return the protocol */
     return protocol;
 }
+
+//----------------------------------------------------------------------------//
+// Single-protocol builds                                                     //
+//----------------------------------------------------------------------------//
+
+#if defined LIBDS_STATIC_PROTOCOL
+#if LIBDS_STATIC_PROTOCOL == FRC_2015 || LIBDS_STATIC_PROTOCOL == FRC_2016
+
+#if LIBDS_STATIC_PROTOCOL == FRC_2015
+/**
+ * Returns 1 if \a ptr is the FRC 2015 protocol compiled into this build
+ */
+int Protocol_IsStatic (const DS_Protocol* ptr)
+{
+    return ptr->read_robot_packet == &read_robot_packet &&
+           ptr->robot_address == &robot_address;
+}
+#endif
+
+/*
+ * Packet functions called directly by the event loop
+ */
+const DS_String* Protocol_UpdateFMSPacket (void)
+{
+    return update_fms_packet();
+}
+
+const DS_String* Protocol_UpdateRadioPacket (void)
+{
+    return update_radio_packet();
+}
+
+const DS_String* Protocol_UpdateRobotPacket (void)
+{
+    return update_robot_packet();
+}
+
+int Protocol_ReadFMSPacket (const DS_String* data)
+{
+    return read_fms_packet (data);
+}
+
+int Protocol_ReadRadioPacket (const DS_String* data)
+{
+    return read_radio_packet (data);
+}
+
+int Protocol_ReadRobotPacket (const DS_String* data)
+{
+    return read_robot_packet (data);
+}
+
+#endif
+#endif
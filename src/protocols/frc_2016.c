@@ -55,3 +55,22 @@ DS_Protocol DS_GetProtocolFRC_2016 (void)
 
     return protocol;
 }
+
+//----------------------------------------------------------------------------//
+// Single-protocol builds                                                     //
+//----------------------------------------------------------------------------//
+
+#if defined LIBDS_STATIC_PROTOCOL
+#if LIBDS_STATIC_PROTOCOL == FRC_2016
+
+/*
+ * The packet functions are shared with the FRC 2015 protocol, only the
+ * robot address tells both protocols apart
+ */
+int Protocol_IsStatic (const DS_Protocol* ptr)
+{
+    return ptr->robot_address == &robot_address;
+}
+
+#endif
+#endif
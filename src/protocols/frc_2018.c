@@ -194,11 +194,15 @@ DS_Protocol DS_GetProtocolFRC_2018 (void)
     protocol.create_fms_packet = &create_fms_packet;
     protocol.create_radio_packet = &create_radio_packet;
     protocol.create_robot_packet = &create_robot_packet;
+    protocol.update_fms_packet = NULL;
+    protocol.update_radio_packet = NULL;
+    protocol.update_robot_packet = NULL;
 
     /* Set packet interpretation functions */
     protocol.read_fms_packet = &read_fms_packet;
     protocol.read_radio_packet = &read_radio_packet;
     protocol.read_robot_packet = &read_robot_packet;
+    protocol.probe_robot_packet = NULL;
 
     /* Set reset functions */
     protocol.reset_fms = &reset_fms;
@@ -238,6 +242,8 @@ DS_Protocol DS_GetProtocolFRC_2018 (void)
     protocol.robot_socket.in_port = 1150;
     protocol.robot_socket.out_port = 1110;
     protocol.robot_socket.type = DS_SOCKET_UDP;
+    protocol.robot_socket.dscp = DS_DSCP_EF;
+    protocol.robot_socket.priority = DS_PRIORITY_INTERACTIVE;
 
     /* Define netconsole socket properties */
     protocol.netconsole_socket = *DS_SocketEmpty();
@@ -246,3 +252,57 @@ DS_Protocol DS_GetProtocolFRC_2018 (void)
     /* Return the pointer */
     return protocol;
 }
+
+//----------------------------------------------------------------------------//
+// Single-protocol builds                                                     //
+//----------------------------------------------------------------------------//
+
+#if defined LIBDS_STATIC_PROTOCOL
+#if LIBDS_STATIC_PROTOCOL == FRC_2018
+
+static char empty_packet_buf [1];
+static DS_String empty_packet = {empty_packet_buf, 0};
+
+/**
+ * Returns 1 if \a ptr is the FRC 2018 protocol compiled into this build
+ */
+int Protocol_IsStatic (const DS_Protocol* ptr)
+{
+    return ptr->read_robot_packet == &read_robot_packet;
+}
+
+/*
+ * Packet functions called directly by the event loop
+ */
+const DS_String* Protocol_UpdateFMSPacket (void)
+{
+    return &empty_packet;
+}
+
+const DS_String* Protocol_UpdateRadioPacket (void)
+{
+    return &empty_packet;
+}
+
+const DS_String* Protocol_UpdateRobotPacket (void)
+{
+    return &empty_packet;
+}
+
+int Protocol_ReadFMSPacket (const DS_String* data)
+{
+    return read_fms_packet (data);
+}
+
+int Protocol_ReadRadioPacket (const DS_String* data)
+{
+    return read_radio_packet (data);
+}
+
+int Protocol_ReadRobotPacket (const DS_String* data)
+{
+    return read_robot_packet (data);
+}
+
+#endif
+#endif
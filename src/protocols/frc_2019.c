@@ -194,11 +194,15 @@ DS_Protocol DS_GetProtocolFRC_2019 (void)
     protocol.create_fms_packet = &create_fms_packet;
     protocol.create_radio_packet = &create_radio_packet;
     protocol.create_robot_packet = &create_robot_packet;
+    protocol.update_fms_packet = NULL;
+    protocol.update_radio_packet = NULL;
+    protocol.update_robot_packet = NULL;
 
     /* Set packet interpretation functions */
     protocol.read_fms_packet = &read_fms_packet;
     protocol.read_radio_packet = &read_radio_packet;
     protocol.read_robot_packet = &read_robot_packet;
+    protocol.probe_robot_packet = NULL;
 
     /* Set reset functions */
     protocol.reset_fms = &reset_fms;
@@ -238,6 +242,8 @@ DS_Protocol DS_GetProtocolFRC_2019 (void)
     protocol.robot_socket.in_port = 1150;
     protocol.robot_socket.out_port = 1110;
     protocol.robot_socket.type = DS_SOCKET_UDP;
+    protocol.robot_socket.dscp = DS_DSCP_EF;
+    protocol.robot_socket.priority = DS_PRIORITY_INTERACTIVE;
 
     /* Define netconsole socket properties */
     protocol.netconsole_socket = *DS_SocketEmpty();
@@ -0,0 +1,411 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "DS_Timer.h"
+#include "DS_Quality.h"
+#include "DS_Context.h"
+#include "DS_Metrics.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define CHANNEL_COUNT   4
+#define BUCKET_COUNT    100       /* Enough buckets for a 10 second window */
+#define BUCKET_LENGTH   100000000 /* Each bucket holds 100 ms of statistics */
+#define SENT_HISTORY    1024      /* Number of sent indexes to remember */
+#define TX_HISTORY      64        /* Number of sent datagram IDs to remember */
+#define RESYNC_DISTANCE 1024      /* Larger index jumps restart the tracking */
+
+/**
+ * Holds the statistics registered during a 100 ms period
+ */
+typedef struct {
+    uint64_t id;
+    int lost;
+    int received;
+    int duplicated;
+    int trip_count;
+    int out_of_order;
+    int stale;
+    uint64_t trip_sum;
+    uint64_t trip_max;
+} Bucket;
+
+/**
+ * Holds the time at which a packet with the given index was sent
+ */
+typedef struct {
+    int valid;
+    uint16_t index;
+    uint64_t time;
+} SentPacket;
+
+/**
+ * Holds the packet index of the datagram with the given transmit timestamp ID
+ */
+typedef struct {
+    int valid;
+    uint32_t id;
+    uint16_t index;
+} TxPacket;
+
+/**
+ * Holds the sequence tracking state of a channel
+ */
+typedef struct {
+    int initialized;      /**< Set to 1 after receiving the first packet */
+    uint16_t highest;     /**< Newest packet index received so far */
+    uint64_t history;     /**< Bit n is set if (highest - n) was received */
+    int last_sent;        /**< Index of the last sent packet, -1 if none */
+    uint64_t receive_time; /**< Time of the packet being read, 0 for now */
+    Bucket buckets [BUCKET_COUNT];
+    SentPacket sent [SENT_HISTORY];
+    TxPacket tx [TX_HISTORY];
+} Channel;
+
+/**
+ * Holds the channels of a context
+ */
+typedef struct {
+    Channel channels [CHANNEL_COUNT];
+} State;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the channels of the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), NULL, NULL);
+}
+
+/**
+ * Returns the bucket that holds the statistics of the current 100 ms period,
+ * the bucket is cleared if it still holds the data of an older period
+ */
+static Bucket* current_bucket (Channel* channel, const uint64_t now)
+{
+    uint64_t id = now / BUCKET_LENGTH;
+    Bucket* bucket = &channel->buckets [id % BUCKET_COUNT];
+
+    if (bucket->id != id) {
+        memset (bucket, 0, sizeof (Bucket));
+        bucket->id = id;
+    }
+
+    return bucket;
+}
+
+/**
+ * Calculates the trip time of the given packet \a index if we know when
+ * it was sent (e.g. if the robot echoes the index of our packets)
+ */
+static void register_trip_time (const DS_Channel id, Channel* channel,
+                                Bucket* bucket, const uint16_t index,
+                                const uint64_t now)
+{
+    SentPacket* packet = &channel->sent [index % SENT_HISTORY];
+
+    if (packet->valid && packet->index == index && now >= packet->time) {
+        uint64_t trip = now - packet->time;
+
+        bucket->trip_sum += trip;
+        bucket->trip_count += 1;
+        if (trip > bucket->trip_max)
+            bucket->trip_max = trip;
+
+        Metrics_TripTime (id, trip);
+        packet->valid = 0;
+    }
+}
+
+/**
+ * Adds the statistics of the last \a count buckets to the given \a window
+ */
+static void fill_window (const Channel* channel, DS_CommsWindow* window,
+                         const uint64_t now, const int count)
+{
+    int i;
+    int lost = 0;
+    int trip_count = 0;
+    uint64_t trip_sum = 0;
+    uint64_t trip_max = 0;
+    uint64_t newest = now / BUCKET_LENGTH;
+
+    memset (window, 0, sizeof (DS_CommsWindow));
+
+    for (i = 0; i < BUCKET_COUNT; ++i) {
+        const Bucket* bucket = &channel->buckets [i];
+
+        if (bucket->id + count <= newest || bucket->id > newest)
+            continue;
+
+        lost += bucket->lost;
+        trip_sum += bucket->trip_sum;
+        trip_count += bucket->trip_count;
+        window->received += bucket->received;
+        window->duplicated += bucket->duplicated;
+        window->out_of_order += bucket->out_of_order;
+        window->stale += bucket->stale;
+
+        if (bucket->trip_max > trip_max)
+            trip_max = bucket->trip_max;
+    }
+
+    /* Late packets may have been counted as lost in an older bucket */
+    window->lost = lost > 0 ? lost : 0;
+
+    /* Calculate loss percentage */
+    if (window->lost + window->received > 0)
+        window->loss = (window->lost * 100.0f) / (window->lost + window->received);
+
+    /* Calculate trip times (in milliseconds) */
+    if (trip_count > 0) {
+        window->trip_time = (float) ((trip_sum / trip_count) / 1.0e6);
+        window->max_trip_time = (float) (trip_max / 1.0e6);
+    }
+}
+
+/**
+ * Initializes the sequence tracking state of every channel
+ */
+void Quality_Init (void)
+{
+    int i;
+    for (i = 0; i < CHANNEL_COUNT; ++i)
+        Quality_Reset ((DS_Channel) i);
+}
+
+/**
+ * Clears the sequence tracking state of every channel
+ */
+void Quality_Close (void)
+{
+    Quality_Init();
+}
+
+/**
+ * Clears the statistics and sequence tracking state of the given \a channel,
+ * this function is called when the protocol is changed
+ */
+void Quality_Reset (const DS_Channel channel)
+{
+    State* s = state();
+
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    pthread_mutex_lock (&mutex);
+    memset (&s->channels [channel], 0, sizeof (Channel));
+    s->channels [channel].last_sent = -1;
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Registers the time at which a packet with the given \a index was sent
+ * through the given \a channel.
+ *
+ * Protocols should only call this function if the remote host echoes the
+ * index of our packets, the echoed index is used to measure trip times.
+ */
+void Quality_PacketSent (const DS_Channel channel, const uint16_t index)
+{
+    State* s = state();
+
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    pthread_mutex_lock (&mutex);
+    SentPacket* packet = &s->channels [channel].sent [index % SENT_HISTORY];
+    packet->valid = 1;
+    packet->index = index;
+    packet->time = DS_GetTimeNs();
+    s->channels [channel].last_sent = index;
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Replaces the send time of the last packet registered with
+ * \c Quality_PacketSent() with the given \a time, at which the packet
+ * was given to the socket.
+ *
+ * If the socket queues a kernel transmit timestamp for the packet, \a id is
+ * the ID of the timestamp (otherwise, it is -1), and the timestamp is applied
+ * later with \c Quality_PacketTimestamped().
+ */
+void Quality_PacketTransmitted (const DS_Channel channel, const uint64_t time,
+                                const int64_t id)
+{
+    State* s = state();
+
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    pthread_mutex_lock (&mutex);
+    Channel* ch = &s->channels [channel];
+    if (ch->last_sent >= 0 && time > 0) {
+        SentPacket* packet = &ch->sent [ch->last_sent % SENT_HISTORY];
+        if (packet->valid && packet->index == ch->last_sent && time >= packet->time)
+            packet->time = time;
+
+        if (id >= 0) {
+            TxPacket* tx = &ch->tx [(uint32_t) id % TX_HISTORY];
+            tx->valid = 1;
+            tx->id = (uint32_t) id;
+            tx->index = (uint16_t) ch->last_sent;
+        }
+    }
+
+    ch->last_sent = -1;
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Replaces the send time of the packet whose kernel transmit timestamp has
+ * the given \a id (see \c Quality_PacketTransmitted()) with the \a time at
+ * which the packet actually left the socket. Timestamps of packets that were
+ * already answered (or forgotten) are ignored.
+ */
+void Quality_PacketTimestamped (const DS_Channel channel, const uint32_t id,
+                                const uint64_t time)
+{
+    State* s = state();
+
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    pthread_mutex_lock (&mutex);
+    Channel* ch = &s->channels [channel];
+    TxPacket* tx = &ch->tx [id % TX_HISTORY];
+    if (tx->valid && tx->id == id) {
+        SentPacket* packet = &ch->sent [tx->index % SENT_HISTORY];
+        if (packet->valid && packet->index == tx->index && time >= packet->time)
+            packet->time = time;
+
+        tx->valid = 0;
+    }
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Sets the time at which the packet that is being read from the given
+ * \a channel was received (e.g. a kernel receive timestamp), so that the
+ * trip times do not include the time that the packet waited in the library.
+ * A \a time of 0 makes \c Quality_PacketReceived() use the current time.
+ */
+void Quality_SetReceiveTime (const DS_Channel channel, const uint64_t time)
+{
+    State* s = state();
+
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    pthread_mutex_lock (&mutex);
+    s->channels [channel].receive_time = time;
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Registers the \a index of a packet received through the given \a channel
+ * and updates the lost, duplicated and out-of-order packet counters.
+ *
+ * Gaps in the sequence are counted as lost packets, if a missing packet
+ * arrives later, it is counted as an out-of-order packet instead. Packets
+ * older than the last 64 indexes cannot be told apart from duplicates (or
+ * replays), so they are counted as stale packets and otherwise ignored.
+ */
+void Quality_PacketReceived (const DS_Channel channel, const uint16_t index)
+{
+    State* s = state();
+
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    pthread_mutex_lock (&mutex);
+
+    Channel* ch = &s->channels [channel];
+    uint64_t now = ch->receive_time > 0 ? ch->receive_time : DS_GetTimeNs();
+    Bucket* bucket = current_bucket (ch, now);
+    int distance = (int16_t) (uint16_t) (index - ch->highest);
+
+    /* First packet or the remote restarted its counter, start over */
+    if (!ch->initialized || abs (distance) >= RESYNC_DISTANCE) {
+        ch->history = 1;
+        ch->initialized = 1;
+        ch->highest = index;
+        bucket->received += 1;
+        register_trip_time (channel, ch, bucket, index, now);
+    }
+
+    /* Newer packet, anything between it and the previous one was lost */
+    else if (distance > 0) {
+        ch->history = (distance < 64) ? (ch->history << distance) | 1 : 1;
+        ch->highest = index;
+        bucket->lost += distance - 1;
+        bucket->received += 1;
+        register_trip_time (channel, ch, bucket, index, now);
+    }
+
+    /* Same index as the newest packet */
+    else if (distance == 0)
+        bucket->duplicated += 1;
+
+    /* Older packet, check if we already received it */
+    else if (-distance < 64) {
+        uint64_t mask = 1ULL << -distance;
+
+        if (ch->history & mask)
+            bucket->duplicated += 1;
+
+        else {
+            ch->history |= mask;
+            bucket->lost -= 1;
+            bucket->received += 1;
+            bucket->out_of_order += 1;
+            register_trip_time (channel, ch, bucket, index, now);
+        }
+    }
+
+    /* Older than the history, the packet may have been received already */
+    else
+        bucket->stale += 1;
+
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Writes the packet statistics of the last second and of the last ten
+ * seconds of the given \a channel into the \a quality structure
+ */
+void DS_GetCommsQuality (const DS_Channel channel, DS_CommsQuality* quality)
+{
+    State* s = state();
+
+    assert (quality);
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    pthread_mutex_lock (&mutex);
+    uint64_t now = DS_GetTimeNs();
+    fill_window (&s->channels [channel], &quality->last_second, now, 10);
+    fill_window (&s->channels [channel], &quality->last_ten_seconds, now, 100);
+    pthread_mutex_unlock (&mutex);
+}
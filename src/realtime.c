@@ -0,0 +1,349 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#if defined __linux__
+    #ifndef _GNU_SOURCE
+        #define _GNU_SOURCE
+    #endif
+#endif
+
+#include "DS_Utils.h"
+#include "DS_Realtime.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#if defined _WIN32
+    #include <windows.h>
+#else
+    #include <sched.h>
+    #include <sys/mman.h>
+#endif
+
+#define PREFAULT_STACK (64 * 1024) /* Stack bytes touched by each thread */
+
+/*
+ * Current settings, they are changed by the client and read by the threads
+ * when they start (and by the protocol thread when they change)
+ */
+static DS_RealtimeOptions options = { 0, 0, 0, -1, -1, 0, 0, 50 };
+static volatile int generation = 0;
+static int memory_locked = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Writes to every page of a stack buffer, so that the pages used by the
+ * calling thread are mapped (and locked) before they are needed
+ */
+static void prefault_stack (void)
+{
+    volatile char buffer [PREFAULT_STACK];
+
+    int i;
+    for (i = 0; i < PREFAULT_STACK; i += 4096)
+        buffer [i] = 0;
+
+    (void) buffer [0];
+}
+
+/**
+ * Locks the current and future memory of the process, so that the library
+ * never waits for a page to be loaded. The static buffers of the library
+ * (packet templates, socket buffers) are mapped by \c mlockall().
+ */
+static void lock_memory (void)
+{
+#if !defined _WIN32
+    if (memory_locked)
+        return;
+
+    if (mlockall (MCL_CURRENT | MCL_FUTURE) == 0)
+        memory_locked = 1;
+    else
+        perror ("LibDS: mlockall");
+#endif
+}
+
+/**
+ * Releases the memory locked by \c lock_memory()
+ */
+static void unlock_memory (void)
+{
+#if !defined _WIN32
+    if (memory_locked)
+        munlockall();
+
+    memory_locked = 0;
+#endif
+}
+
+/**
+ * Applies the scheduling policy of the given \a priority to the calling
+ * thread (\c SCHED_FIFO if \a priority is greater than 0)
+ */
+static void set_priority (const int priority)
+{
+#if !defined _WIN32
+    struct sched_param param;
+    memset (&param, 0, sizeof (param));
+
+    int policy = SCHED_OTHER;
+    if (priority > 0) {
+        policy = SCHED_FIFO;
+        param.sched_priority = DS_Min (priority, sched_get_priority_max (SCHED_FIFO));
+    }
+
+    int error = pthread_setschedparam (pthread_self(), policy, &param);
+    if (error)
+        fprintf (stderr, "LibDS: cannot set thread priority (%s)\n",
+                 strerror (error));
+#else
+    (void) priority;
+#endif
+}
+
+/**
+ * Pins the calling thread to the given \a cpu, or allows it to run on every
+ * CPU if \a cpu is negative
+ */
+static void set_cpu (const int cpu)
+{
+#if defined __linux__
+    cpu_set_t set;
+    CPU_ZERO (&set);
+
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+        CPU_SET (cpu, &set);
+    else {
+        int i;
+        for (i = 0; i < CPU_SETSIZE; ++i)
+            CPU_SET (i, &set);
+    }
+
+    int error = pthread_setaffinity_np (pthread_self(), sizeof (set), &set);
+    if (error && cpu >= 0)
+        fprintf (stderr, "LibDS: cannot pin thread to CPU %d (%s)\n",
+                 cpu, strerror (error));
+#else
+    (void) cpu;
+#endif
+}
+
+/**
+ * Gives the calling thread a \a name, which is shown by debuggers and
+ * tools such as \c top
+ */
+static void set_name (const char* name)
+{
+#if defined __linux__
+    char buffer [16];
+    strncpy (buffer, name, sizeof (buffer) - 1);
+    buffer [sizeof (buffer) - 1] = 0;
+    pthread_setname_np (pthread_self(), buffer);
+#elif defined __APPLE__
+    pthread_setname_np (name);
+#else
+    (void) name;
+#endif
+}
+
+/**
+ * Names the calling thread and applies the real-time settings of its
+ * \a role to it. Threads call this function when they start, the protocol
+ * thread calls it again when the settings change.
+ */
+void Realtime_ConfigureThread (const DS_ThreadRole role, const char* name)
+{
+    assert (name);
+
+    pthread_mutex_lock (&mutex);
+    DS_RealtimeOptions current = options;
+    pthread_mutex_unlock (&mutex);
+
+    set_name (name);
+
+    /* Restore the default settings (if they were changed before) */
+    if (!current.enabled) {
+        if (generation > 0) {
+            set_priority (0);
+            set_cpu (-1);
+        }
+
+        return;
+    }
+
+    /* Apply the settings of the role */
+    if (role == DS_THREAD_PROTOCOL) {
+        set_priority (current.protocol_priority);
+        set_cpu (current.protocol_cpu);
+    }
+
+    else {
+        set_priority (current.io_priority);
+        set_cpu (current.io_cpu);
+    }
+
+    if (current.lock_memory)
+        prefault_stack();
+}
+
+/**
+ * Names the calling scheduler worker and applies the real-time settings of
+ * the protocol thread to it. When the settings are enabled, the worker is
+ * pinned to the given \a cpu, so that each worker keeps the sessions it owns
+ * in the cache of its own CPU.
+ */
+void Realtime_ConfigureWorker (const int cpu, const char* name)
+{
+    assert (name);
+
+    pthread_mutex_lock (&mutex);
+    DS_RealtimeOptions current = options;
+    pthread_mutex_unlock (&mutex);
+
+    set_name (name);
+
+    if (!current.enabled)
+        return;
+
+    set_priority (current.protocol_priority);
+    set_cpu (cpu);
+
+    if (current.lock_memory)
+        prefault_stack();
+}
+
+/**
+ * Returns a number that changes every time the real-time settings change
+ */
+int Realtime_Generation (void)
+{
+    return generation;
+}
+
+/**
+ * Returns 1 if the robot socket shall be busy-polled by the protocol thread
+ */
+int Realtime_BusyPoll (void)
+{
+    pthread_mutex_lock (&mutex);
+    int busy_poll = options.enabled && options.busy_poll;
+    pthread_mutex_unlock (&mutex);
+
+    return busy_poll;
+}
+
+/**
+ * Returns the number of microseconds that the protocol thread spins without
+ * receiving a packet before it starts yielding the CPU between polls
+ */
+int Realtime_SpinBudget (void)
+{
+    return options.spin_budget;
+}
+
+/**
+ * Lets other threads of the same priority run on the CPU of the caller,
+ * without putting the calling thread to sleep
+ */
+void Realtime_Yield (void)
+{
+#if defined _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+/**
+ * Writes the current real-time settings in \a options
+ */
+void DS_GetRealtimeOptions (DS_RealtimeOptions* ptr)
+{
+    assert (ptr);
+
+    pthread_mutex_lock (&mutex);
+    *ptr = options;
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Changes the real-time settings of the library.
+ *
+ * When enabled, the protocol thread and the I/O threads (sockets and timers)
+ * run with the \c SCHED_FIFO policy and the given priorities (0 keeps the
+ * default policy), and can be pinned to a CPU. If \c lock_memory is set,
+ * the memory of the process is locked with \c mlockall() so that packets
+ * are never delayed by page faults.
+ *
+ * If \c busy_poll is set, the protocol thread does not sleep between
+ * iterations. Instead, it polls the robot socket continuously (using
+ * non-blocking reads and \c SO_BUSY_POLL where available) and interprets
+ * each robot packet as soon as it arrives. The thread spins for
+ * \c spin_budget microseconds after the last packet, and then yields the
+ * CPU between polls. This mode keeps a CPU busy, so the protocol thread
+ * should be pinned to a dedicated CPU (and the I/O threads to another one).
+ *
+ * The protocol thread applies the settings immediately. Socket and timer
+ * threads apply them when they start, so this function should be called
+ * before \c DS_Init() (or before loading a protocol).
+ *
+ * \note Real-time priorities and memory locking usually require elevated
+ *       privileges (e.g. \c CAP_SYS_NICE and \c CAP_IPC_LOCK on Linux),
+ *       failures are reported to \c stderr and the library keeps running
+ *       with the default settings.
+ *
+ * \returns 1 if the settings are valid, 0 otherwise
+ */
+int DS_SetRealtimeOptions (const DS_RealtimeOptions* ptr)
+{
+    assert (ptr);
+
+    /* Check the priorities */
+    if (ptr->protocol_priority < 0 || ptr->io_priority < 0) {
+        fprintf (stderr, "DS_SetRealtimeOptions: invalid priority\n");
+        return 0;
+    }
+
+    /* Check the spin budget */
+    if (ptr->spin_budget < 0) {
+        fprintf (stderr, "DS_SetRealtimeOptions: invalid spin budget\n");
+        return 0;
+    }
+
+    pthread_mutex_lock (&mutex);
+    options = *ptr;
+
+    if (options.enabled && options.lock_memory)
+        lock_memory();
+    else
+        unlock_memory();
+
+    ++generation;
+    pthread_mutex_unlock (&mutex);
+
+    return 1;
+}
@@ -0,0 +1,770 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "DS_Utils.h"
+#include "DS_Timer.h"
+#include "DS_Events.h"
+#include "DS_Replay.h"
+#include "DS_Protocol.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Capture file formats
+ */
+#define PCAP_MAGIC_US    0xA1B2C3D4
+#define PCAP_MAGIC_NS    0xA1B23C4D
+#define PCAPNG_SHB       0x0A0D0D0A
+#define PCAPNG_IDB       0x00000001
+#define PCAPNG_PB        0x00000002
+#define PCAPNG_SPB       0x00000003
+#define PCAPNG_EPB       0x00000006
+#define BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define OPT_IF_TSRESOL   9
+#define MAX_INTERFACES   64
+#define MAX_BLOCK_SIZE   (16 * 1024 * 1024)
+
+/*
+ * Supported link types
+ */
+#define LINKTYPE_NULL       0
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+#define LINKTYPE_LOOP       108
+#define LINKTYPE_LINUX_SLL  113
+#define LINKTYPE_IPV4       228
+#define LINKTYPE_LINUX_SLL2 276
+
+/**
+ * Holds the link type and timestamp resolution of a capture interface
+ */
+typedef struct {
+    int linktype;
+    uint64_t units; /**< Timestamp units per second */
+} Interface;
+
+/**
+ * Holds the state of a pcap/pcapng file reader
+ */
+typedef struct {
+    FILE* file;
+    int pcapng;
+    int swapped;
+    uint8_t* block;
+    uint32_t block_size;
+    uint64_t timestamp;
+    int interface_count;
+    Interface interfaces [MAX_INTERFACES];
+} Reader;
+
+/**
+ * Holds a captured frame
+ */
+typedef struct {
+    int len;
+    int linktype;
+    uint64_t timestamp; /**< Capture time in nanoseconds */
+    const uint8_t* data;
+} Frame;
+
+/**
+ * Holds the replay state of a channel watchdog
+ */
+typedef struct {
+    DS_Channel channel;
+    uint64_t timeout;
+    uint64_t last_feed;
+} Watchdog;
+
+/**
+ * Returns the given 16-bit value, byte-swapped if \a swap is set to 1
+ */
+static uint16_t swap16 (const uint16_t value, const int swap)
+{
+    if (swap)
+        return (uint16_t) ((value >> 8) | (value << 8));
+
+    return value;
+}
+
+/**
+ * Returns the given 32-bit value, byte-swapped if \a swap is set to 1
+ */
+static uint32_t swap32 (const uint32_t value, const int swap)
+{
+    if (swap) {
+        return ((value >> 24) & 0x000000FF) | ((value >> 8) & 0x0000FF00) |
+               ((value << 8) & 0x00FF0000) | ((value << 24) & 0xFF000000);
+    }
+
+    return value;
+}
+
+/**
+ * Reads a 16-bit value from the given \a buf in the byte order of the file
+ */
+static uint16_t get16 (const Reader* reader, const uint8_t* buf)
+{
+    uint16_t value;
+    memcpy (&value, buf, 2);
+    return swap16 (value, reader->swapped);
+}
+
+/**
+ * Reads a 32-bit value from the given \a buf in the byte order of the file
+ */
+static uint32_t get32 (const Reader* reader, const uint8_t* buf)
+{
+    uint32_t value;
+    memcpy (&value, buf, 4);
+    return swap32 (value, reader->swapped);
+}
+
+/**
+ * Reads a 16-bit big endian value from the given \a buf
+ */
+static uint16_t get_be16 (const uint8_t* buf)
+{
+    return (uint16_t) ((buf [0] << 8) | buf [1]);
+}
+
+/**
+ * Converts the given timestamp to nanoseconds
+ */
+static uint64_t to_ns (const uint64_t ts, const uint64_t units)
+{
+    if (units == 1000000000ULL || units == 0)
+        return ts;
+
+    return (ts / units) * 1000000000ULL + (ts % units) * 1000000000ULL / units;
+}
+
+/**
+ * Makes sure that the block buffer of the \a reader can hold \a size bytes
+ */
+static int reserve_block (Reader* reader, const uint32_t size)
+{
+    if (size > MAX_BLOCK_SIZE)
+        return 0;
+
+    if (size > reader->block_size) {
+        uint8_t* block = (uint8_t*) realloc (reader->block, size);
+        if (!block)
+            return 0;
+
+        reader->block = block;
+        reader->block_size = size;
+    }
+
+    return 1;
+}
+
+/**
+ * Opens the capture file at the given \a path and reads its header
+ */
+static int open_reader (Reader* reader, const char* path)
+{
+    uint32_t magic;
+    uint8_t header [24];
+
+    memset (reader, 0, sizeof (Reader));
+    reader->file = fopen (path, "rb");
+    if (!reader->file)
+        return 0;
+
+    if (fread (&magic, 1, 4, reader->file) != 4)
+        return 0;
+
+    /* pcapng file, the section header is read with the other blocks */
+    if (magic == PCAPNG_SHB) {
+        reader->pcapng = 1;
+        rewind (reader->file);
+        return 1;
+    }
+
+    /* Classic pcap file, get byte order and timestamp resolution */
+    Interface* iface = &reader->interfaces [0];
+    if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS)
+        reader->swapped = 0;
+    else if (swap32 (magic, 1) == PCAP_MAGIC_US || swap32 (magic, 1) == PCAP_MAGIC_NS)
+        reader->swapped = 1;
+    else
+        return 0;
+
+    magic = swap32 (magic, reader->swapped);
+    iface->units = (magic == PCAP_MAGIC_NS) ? 1000000000ULL : 1000000ULL;
+
+    /* Get link type */
+    memcpy (header, &magic, 4);
+    if (fread (header + 4, 1, 20, reader->file) != 20)
+        return 0;
+
+    iface->linktype = (int) (get32 (reader, header + 20) & 0xFFFF);
+    reader->interface_count = 1;
+    return 1;
+}
+
+/**
+ * Closes the file and frees the memory used by the given \a reader
+ */
+static void close_reader (Reader* reader)
+{
+    if (reader->file)
+        fclose (reader->file);
+
+    DS_FREE (reader->block);
+    reader->file = NULL;
+}
+
+/**
+ * Reads the next record of a classic pcap file
+ */
+static int read_pcap_frame (Reader* reader, Frame* frame)
+{
+    uint8_t header [16];
+    if (fread (header, 1, 16, reader->file) != 16)
+        return 0;
+
+    uint32_t len = get32 (reader, header + 8);
+    if (!reserve_block (reader, len) || fread (reader->block, 1, len, reader->file) != len)
+        return 0;
+
+    Interface* iface = &reader->interfaces [0];
+    uint64_t ts = (uint64_t) get32 (reader, header) * iface->units + get32 (reader, header + 4);
+
+    frame->len = (int) len;
+    frame->data = reader->block;
+    frame->linktype = iface->linktype;
+    frame->timestamp = to_ns (ts, iface->units);
+    return 1;
+}
+
+/**
+ * Registers the interface described by the given interface description block
+ */
+static void read_pcapng_interface (Reader* reader, const uint32_t len)
+{
+    if (reader->interface_count >= MAX_INTERFACES || len < 20)
+        return;
+
+    Interface* iface = &reader->interfaces [reader->interface_count++];
+    iface->linktype = get16 (reader, reader->block + 8);
+    iface->units = 1000000ULL;
+
+    /* Look for the timestamp resolution option */
+    uint32_t offset = 16;
+    while (offset + 4 <= len - 4) {
+        uint16_t code = get16 (reader, reader->block + offset);
+        uint16_t size = get16 (reader, reader->block + offset + 2);
+
+        if (code == 0 || offset + 4 + size > len - 4)
+            break;
+
+        if (code == OPT_IF_TSRESOL && size >= 1) {
+            int i;
+            uint8_t resol = reader->block [offset + 4];
+
+            iface->units = 1;
+            for (i = 0; i < (resol & 0x7F); ++i)
+                iface->units *= (resol & 0x80) ? 2 : 10;
+        }
+
+        offset += 4 + ((size + 3) & ~3);
+    }
+}
+
+/**
+ * Reads blocks from a pcapng file until a packet block is found
+ */
+static int read_pcapng_frame (Reader* reader, Frame* frame)
+{
+    while (1) {
+        uint8_t header [8];
+        if (fread (header, 1, 8, reader->file) != 8)
+            return 0;
+
+        /* Section header, update byte order and forget the interfaces */
+        uint32_t type;
+        memcpy (&type, header, 4);
+        if (type == PCAPNG_SHB) {
+            uint32_t magic;
+            if (fread (&magic, 1, 4, reader->file) != 4)
+                return 0;
+
+            if (magic == BYTE_ORDER_MAGIC)
+                reader->swapped = 0;
+            else if (swap32 (magic, 1) == BYTE_ORDER_MAGIC)
+                reader->swapped = 1;
+            else
+                return 0;
+
+            reader->interface_count = 0;
+            uint32_t len = get32 (reader, header + 4);
+            if (len < 12 || fseek (reader->file, len - 12, SEEK_CUR) != 0)
+                return 0;
+
+            continue;
+        }
+
+        /* Read the whole block */
+        type = get32 (reader, header);
+        uint32_t len = get32 (reader, header + 4);
+        if (len < 12 || !reserve_block (reader, len))
+            return 0;
+
+        memcpy (reader->block, header, 8);
+        if (fread (reader->block + 8, 1, len - 8, reader->file) != len - 8)
+            return 0;
+
+        /* Interface description block */
+        if (type == PCAPNG_IDB)
+            read_pcapng_interface (reader, len);
+
+        /* Enhanced (or obsolete) packet block */
+        else if ((type == PCAPNG_EPB || type == PCAPNG_PB) && len >= 32) {
+            uint32_t id = (type == PCAPNG_EPB) ? get32 (reader, reader->block + 8) :
+                          get16 (reader, reader->block + 8);
+            uint32_t caplen = get32 (reader, reader->block + 20);
+
+            if ((int) id >= reader->interface_count || caplen > len - 32)
+                continue;
+
+            Interface* iface = &reader->interfaces [id];
+            uint64_t ts = ((uint64_t) get32 (reader, reader->block + 12) << 32) |
+                          get32 (reader, reader->block + 16);
+
+            reader->timestamp = to_ns (ts, iface->units);
+            frame->len = (int) caplen;
+            frame->data = reader->block + 28;
+            frame->linktype = iface->linktype;
+            frame->timestamp = reader->timestamp;
+            return 1;
+        }
+
+        /* Simple packet block (no timestamp, use the previous one) */
+        else if (type == PCAPNG_SPB && len >= 16 && reader->interface_count > 0) {
+            uint32_t caplen = DS_Min (get32 (reader, reader->block + 8), len - 16);
+
+            frame->len = (int) caplen;
+            frame->data = reader->block + 12;
+            frame->linktype = reader->interfaces [0].linktype;
+            frame->timestamp = reader->timestamp;
+            return 1;
+        }
+    }
+}
+
+/**
+ * Reads the next frame of the capture file
+ */
+static int read_frame (Reader* reader, Frame* frame)
+{
+    if (reader->pcapng)
+        return read_pcapng_frame (reader, frame);
+
+    return read_pcap_frame (reader, frame);
+}
+
+/**
+ * Extracts the UDP payload and ports of the given \a frame
+ *
+ * \returns 1 if the frame contains an IPv4 UDP datagram, 0 if not
+ */
+static int get_udp_datagram (const Frame* frame, int* dst_port, DS_String* payload)
+{
+    int offset = 0;
+    int ethertype = 0x0800;
+    const uint8_t* data = frame->data;
+
+    /* Skip the link layer header */
+    switch (frame->linktype) {
+    case LINKTYPE_NULL:
+    case LINKTYPE_LOOP:
+        offset = 4;
+        ethertype = (frame->len > 4 && (data [4] >> 4) == 4) ? 0x0800 : 0;
+        break;
+    case LINKTYPE_ETHERNET:
+        offset = 14;
+        ethertype = frame->len >= 14 ? get_be16 (data + 12) : 0;
+        if (ethertype == 0x8100 && frame->len >= 18) {
+            offset = 18;
+            ethertype = get_be16 (data + 16);
+        }
+        break;
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+        offset = 0;
+        break;
+    case LINKTYPE_LINUX_SLL:
+        offset = 16;
+        ethertype = frame->len >= 16 ? get_be16 (data + 14) : 0;
+        break;
+    case LINKTYPE_LINUX_SLL2:
+        offset = 20;
+        ethertype = frame->len >= 20 ? get_be16 (data) : 0;
+        break;
+    default:
+        return 0;
+    }
+
+    /* Check IPv4 header */
+    if (ethertype != 0x0800 || frame->len < offset + 20)
+        return 0;
+
+    const uint8_t* ip = data + offset;
+    int ihl = (ip [0] & 0x0F) * 4;
+    if ((ip [0] >> 4) != 4 || ip [9] != 17 || ihl < 20)
+        return 0;
+
+    /* Fragmented datagrams are not supported */
+    if ((get_be16 (ip + 6) & 0x3FFF) != 0)
+        return 0;
+
+    /* Check UDP header */
+    int available = frame->len - offset - ihl;
+    const uint8_t* udp = ip + ihl;
+    if (available < 8)
+        return 0;
+
+    int len = DS_Min ((int) get_be16 (udp + 4) - 8, available - 8);
+    if (len < 0)
+        return 0;
+
+    /* Copy payload */
+    *dst_port = get_be16 (udp + 2);
+    payload->buf = (char*) udp + 8;
+    payload->len = (size_t) len;
+    return 1;
+}
+
+/**
+ * Returns the channel of the current protocol that listens on the given
+ * \a port, or -1 if the datagram was not sent to the driver station
+ */
+static int get_channel (const DS_Protocol* protocol, const int port)
+{
+    if (port <= 0)
+        return -1;
+
+    if (port == protocol->fms_socket.in_port)
+        return DS_CHANNEL_FMS;
+    if (port == protocol->radio_socket.in_port)
+        return DS_CHANNEL_RADIO;
+    if (port == protocol->robot_socket.in_port)
+        return DS_CHANNEL_ROBOT;
+    if (port == protocol->netconsole_socket.in_port)
+        return DS_CHANNEL_NETCONSOLE;
+
+    return -1;
+}
+
+/**
+ * Returns the name of the given event \a type
+ */
+static const char* event_name (const DS_EventType type)
+{
+    switch (type) {
+    case DS_FMS_COMMS_CHANGED:
+        return "FMS_COMMS_CHANGED";
+    case DS_RADIO_COMMS_CHANGED:
+        return "RADIO_COMMS_CHANGED";
+    case DS_JOYSTICK_COUNT_CHANGED:
+        return "JOYSTICK_COUNT_CHANGED";
+    case DS_NETCONSOLE_NEW_MESSAGE:
+        return "NETCONSOLE_NEW_MESSAGE";
+    case DS_ROBOT_ENABLED_CHANGED:
+        return "ROBOT_ENABLED_CHANGED";
+    case DS_ROBOT_MODE_CHANGED:
+        return "ROBOT_MODE_CHANGED";
+    case DS_ROBOT_REBOOTED:
+        return "ROBOT_REBOOTED";
+    case DS_ROBOT_COMMS_CHANGED:
+        return "ROBOT_COMMS_CHANGED";
+    case DS_ROBOT_CODE_CHANGED:
+        return "ROBOT_CODE_CHANGED";
+    case DS_ROBOT_CODE_RESTARTED:
+        return "ROBOT_CODE_RESTARTED";
+    case DS_ROBOT_VOLTAGE_CHANGED:
+        return "ROBOT_VOLTAGE_CHANGED";
+    case DS_ROBOT_CAN_UTIL_CHANGED:
+        return "ROBOT_CAN_UTIL_CHANGED";
+    case DS_ROBOT_CPU_INFO_CHANGED:
+        return "ROBOT_CPU_INFO_CHANGED";
+    case DS_ROBOT_RAM_INFO_CHANGED:
+        return "ROBOT_RAM_INFO_CHANGED";
+    case DS_ROBOT_DISK_INFO_CHANGED:
+        return "ROBOT_DISK_INFO_CHANGED";
+    case DS_ROBOT_STATION_CHANGED:
+        return "ROBOT_STATION_CHANGED";
+    case DS_ROBOT_ESTOP_CHANGED:
+        return "ROBOT_ESTOP_CHANGED";
+    case DS_STATUS_STRING_CHANGED:
+        return "STATUS_STRING_CHANGED";
+    default:
+        return "NULL_EVENT";
+    }
+}
+
+/**
+ * Writes the given \a event as a line of text, prefixed with the
+ * virtual time (in seconds) at which it was generated
+ */
+static void write_event (FILE* out, const uint64_t now, const DS_Event* event)
+{
+    fprintf (out, "%llu.%06llu %s",
+             (unsigned long long) (now / 1000000000ULL),
+             (unsigned long long) (now % 1000000000ULL) / 1000,
+             event_name (event->type));
+
+    switch (event->type) {
+    case DS_FMS_COMMS_CHANGED:
+        fprintf (out, " connected=%d", event->fms.connected);
+        break;
+    case DS_RADIO_COMMS_CHANGED:
+        fprintf (out, " connected=%d", event->radio.connected);
+        break;
+    case DS_JOYSTICK_COUNT_CHANGED:
+        fprintf (out, " count=%d", event->joystick.count);
+        break;
+    case DS_NETCONSOLE_NEW_MESSAGE:
+        fprintf (out, " message=\"%s\"", event->netconsole.message ? event->netconsole.message : "");
+        break;
+    case DS_ROBOT_ENABLED_CHANGED:
+        fprintf (out, " enabled=%d", event->robot.enabled);
+        break;
+    case DS_ROBOT_MODE_CHANGED:
+        fprintf (out, " mode=%d", (int) event->robot.mode);
+        break;
+    case DS_ROBOT_COMMS_CHANGED:
+        fprintf (out, " connected=%d", event->robot.connected);
+        break;
+    case DS_ROBOT_CODE_CHANGED:
+        fprintf (out, " code=%d", event->robot.code);
+        break;
+    case DS_ROBOT_VOLTAGE_CHANGED:
+        fprintf (out, " voltage=%.2f", event->robot.voltage);
+        break;
+    case DS_ROBOT_CAN_UTIL_CHANGED:
+        fprintf (out, " can=%d", event->robot.can_util);
+        break;
+    case DS_ROBOT_CPU_INFO_CHANGED:
+        fprintf (out, " cpu=%d", event->robot.cpu_usage);
+        break;
+    case DS_ROBOT_RAM_INFO_CHANGED:
+        fprintf (out, " ram=%d", event->robot.ram_usage);
+        break;
+    case DS_ROBOT_DISK_INFO_CHANGED:
+        fprintf (out, " disk=%d", event->robot.disk_usage);
+        break;
+    case DS_ROBOT_ESTOP_CHANGED:
+        fprintf (out, " estopped=%d", event->robot.estopped);
+        break;
+    default:
+        break;
+    }
+
+    fprintf (out, "\n");
+}
+
+/**
+ * Removes the pending events from the event queue, writing them to \a out
+ * (if not NULL) and returns the number of removed events
+ */
+static int process_events (FILE* out, const uint64_t now)
+{
+    int count = 0;
+    DS_Event event;
+
+    while (DS_PollEvent (&event)) {
+        if (out)
+            write_event (out, now, &event);
+
+        if (event.type == DS_NETCONSOLE_NEW_MESSAGE)
+            DS_FREE (event.netconsole.message);
+
+        ++count;
+    }
+
+    return count;
+}
+
+/**
+ * Checks the watchdogs against the virtual clock and notifies the library
+ * when no valid packets were replayed during the watchdog timeout
+ */
+static void update_watchdogs (Watchdog* watchdogs, const int count, const uint64_t now)
+{
+    int i;
+    for (i = 0; i < count; ++i) {
+        Watchdog* watchdog = &watchdogs [i];
+
+        if (watchdog->timeout > 0 && now - watchdog->last_feed >= watchdog->timeout) {
+            Protocols_WatchdogExpired (watchdog->channel);
+            watchdog->last_feed = now;
+        }
+    }
+}
+
+/**
+ * Waits until the wall clock reaches the virtual time \a now, measured
+ * from the \a start of the replay
+ */
+static void wait_until (const uint64_t start, const uint64_t now)
+{
+    uint64_t current = DS_GetTimeNs();
+
+    while (current < start + now) {
+        int msecs = (int) ((start + now - current) / 1000000);
+        DS_Sleep (DS_Max (msecs, 1));
+        current = DS_GetTimeNs();
+    }
+}
+
+/**
+ * Feeds the robot, FMS, radio and NetConsole datagrams recorded in the pcap
+ * or pcapng file at the given \a path to the current protocol.
+ *
+ * The datagrams are identified by their destination UDP port (which must
+ * match the input port of a socket of the current protocol), and they are
+ * processed by the same functions that read live data. The watchdogs
+ * follow a virtual clock driven by the capture timestamps, so that the
+ * resulting event stream is the same regardless of the replay speed.
+ *
+ * The network operations of the protocol are suspended during the replay,
+ * and the events generated by the replay are removed from the event queue
+ * (and written to \c options->events if it is not \c NULL).
+ *
+ * \returns 1 on success, 0 if the file cannot be read or if no protocol
+ *          is loaded
+ */
+int DS_Replay (const char* path,
+               const DS_ReplayOptions* options,
+               DS_ReplayResult* result)
+{
+    assert (path);
+    assert (options);
+    assert (result);
+
+    /* Get current protocol */
+    memset (result, 0, sizeof (DS_ReplayResult));
+    DS_Protocol* protocol = DS_CurrentProtocol();
+    if (!protocol)
+        return 0;
+
+    /* Open the capture file */
+    Reader reader;
+    if (!open_reader (&reader, path)) {
+        close_reader (&reader);
+        return 0;
+    }
+
+    /* Take control of the protocol */
+    Protocols_Suspend (1);
+
+    /* Start from a disconnected state and discard older events */
+    Protocols_WatchdogExpired (DS_CHANNEL_FMS);
+    Protocols_WatchdogExpired (DS_CHANNEL_RADIO);
+    Protocols_WatchdogExpired (DS_CHANNEL_ROBOT);
+    process_events (NULL, 0);
+
+    /* Configure the watchdogs */
+    Watchdog watchdogs [3] = {
+        {DS_CHANNEL_FMS, 0, 0},
+        {DS_CHANNEL_RADIO, 0, 0},
+        {DS_CHANNEL_ROBOT, 0, 0},
+    };
+
+    int i;
+    for (i = 0; i < 3; ++i)
+        watchdogs [i].timeout = (uint64_t) Protocols_WatchdogTimeout (watchdogs [i].channel) * 1000000;
+
+    /* Replay each frame */
+    Frame frame;
+    uint64_t now = 0;
+    uint64_t first = 0;
+    uint64_t start = DS_GetTimeNs();
+    while (read_frame (&reader, &frame)) {
+        /* Update virtual clock */
+        if (result->frames++ == 0)
+            first = frame.timestamp;
+        if (frame.timestamp > first)
+            now = DS_Max (now, frame.timestamp - first);
+
+        /* Keep the recorded timing */
+        if (options->realtime)
+            wait_until (start, now);
+
+        /* Update watchdogs */
+        update_watchdogs (watchdogs, 3, now);
+
+        /* Get the datagram */
+        int port = 0;
+        DS_String data;
+        if (!get_udp_datagram (&frame, &port, &data))
+            continue;
+
+        /* Check if the datagram was sent to the DS */
+        int channel = get_channel (protocol, port);
+        if (channel < 0 || data.len == 0)
+            continue;
+
+        /* Read the datagram */
+        if (Protocols_ReadPacket ((DS_Channel) channel, &data, 0)) {
+            if (channel != DS_CHANNEL_NETCONSOLE)
+                watchdogs [channel].last_feed = now;
+        }
+
+        else
+            ++result->decode_failures;
+
+        /* Update counters */
+        switch (channel) {
+        case DS_CHANNEL_FMS:
+            ++result->fms_packets;
+            break;
+        case DS_CHANNEL_RADIO:
+            ++result->radio_packets;
+            break;
+        case DS_CHANNEL_ROBOT:
+            ++result->robot_packets;
+            break;
+        case DS_CHANNEL_NETCONSOLE:
+            ++result->netconsole_messages;
+            break;
+        }
+
+        /* Write generated events */
+        result->events += process_events (options->events, now);
+    }
+
+    /* Give the protocol back to the event loop */
+    result->duration = now;
+    result->elapsed = DS_GetTimeNs() - start;
+    Protocols_Suspend (0);
+
+    close_reader (&reader);
+    return 1;
+}
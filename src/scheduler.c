@@ -0,0 +1,597 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "DS_Utils.h"
+#include "DS_Timer.h"
+#include "DS_Context.h"
+#include "DS_Protocol.h"
+#include "DS_Realtime.h"
+#include "DS_Scheduler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#if defined _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+#define MAX_WORKERS   64 /* Maximum number of worker threads */
+#define IDLE_INTERVAL  1 /* Idle workers look for work every millisecond */
+
+/**
+ * Represents where a session is, a session is only moved by the thread that
+ * holds the mutex of its owner
+ */
+typedef enum {
+    SESSION_WAITING, /* In the deadline heap of its owner */
+    SESSION_READY,   /* In the ready queue of its owner */
+    SESSION_RUNNING, /* Being stepped by a worker */
+    SESSION_DONE,    /* Removed, no worker will step it again */
+} SessionStatus;
+
+/**
+ * Holds the scheduling data of a context, \c registered is only accessed
+ * with the scheduler mutex held
+ */
+typedef struct {
+    int registered;
+    DS_Context* context;
+    uint64_t deadline;
+    int owner;
+    int removed;
+    int heap_index;
+    SessionStatus status;
+} Session;
+
+/**
+ * Holds the sessions owned by a worker: the sessions that wait for their
+ * deadline are kept in a min-heap, and the sessions whose deadline passed
+ * are kept in a ready queue. The owner takes the oldest ready session,
+ * other workers steal the newest one.
+ */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+
+    int index;
+    int sessions;
+    int capacity;
+
+    Session** heap;
+    int heap_size;
+
+    Session** ready;
+    int ready_head;
+    int ready_count;
+
+    unsigned long steps;
+    unsigned long steals;
+    uint64_t lateness;
+    uint64_t max_lateness;
+} Worker;
+
+/*
+ * The worker pool, shared by every context of the process
+ */
+static Worker workers [MAX_WORKERS];
+static int worker_count = 0;
+static int next_owner = 0;
+static int sessions = 0;
+static volatile int running = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the scheduling data of the current context
+ */
+static Session* session (void)
+{
+    static DS_ContextKey key = 0;
+    return (Session*) DS_ContextState (&key, sizeof (Session), NULL, NULL);
+}
+
+/**
+ * Returns the number of CPUs that the process can use
+ */
+static int cpu_count (void)
+{
+#if defined _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo (&info);
+    return (int) info.dwNumberOfProcessors;
+#else
+    return (int) sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+/**
+ * Swaps the sessions at the given heap indexes of the worker
+ */
+static void heap_swap (Worker* w, const int a, const int b)
+{
+    Session* session = w->heap [a];
+    w->heap [a] = w->heap [b];
+    w->heap [b] = session;
+
+    w->heap [a]->heap_index = a;
+    w->heap [b]->heap_index = b;
+}
+
+/**
+ * Moves the session at the given heap \a index up until its parent has an
+ * earlier deadline
+ */
+static void heap_up (Worker* w, int index)
+{
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (w->heap [parent]->deadline <= w->heap [index]->deadline)
+            break;
+
+        heap_swap (w, index, parent);
+        index = parent;
+    }
+}
+
+/**
+ * Moves the session at the given heap \a index down until its children have
+ * later deadlines
+ */
+static void heap_down (Worker* w, int index)
+{
+    for (;;) {
+        int left = index * 2 + 1;
+        int right = left + 1;
+        int first = index;
+
+        if (left < w->heap_size
+                && w->heap [left]->deadline < w->heap [first]->deadline)
+            first = left;
+        if (right < w->heap_size
+                && w->heap [right]->deadline < w->heap [first]->deadline)
+            first = right;
+
+        if (first == index)
+            break;
+
+        heap_swap (w, index, first);
+        index = first;
+    }
+}
+
+/**
+ * Adds the given \a session to the deadline heap of the worker
+ */
+static void heap_push (Worker* w, Session* session)
+{
+    assert (w->heap_size < w->capacity);
+
+    session->status = SESSION_WAITING;
+    session->heap_index = w->heap_size;
+    w->heap [w->heap_size++] = session;
+    heap_up (w, session->heap_index);
+}
+
+/**
+ * Removes the session at the given heap \a index of the worker
+ */
+static void heap_remove (Worker* w, const int index)
+{
+    assert (index >= 0 && index < w->heap_size);
+
+    w->heap [index]->heap_index = -1;
+    if (--w->heap_size == index)
+        return;
+
+    w->heap [index] = w->heap [w->heap_size];
+    w->heap [index]->heap_index = index;
+    heap_down (w, index);
+    heap_up (w, index);
+}
+
+/**
+ * Moves the sessions whose deadline passed from the heap of the worker to
+ * its ready queue
+ */
+static void promote (Worker* w, const uint64_t now)
+{
+    while (w->heap_size > 0 && w->heap [0]->deadline <= now) {
+        Session* session = w->heap [0];
+        heap_remove (w, 0);
+
+        int tail = (w->ready_head + w->ready_count) % w->capacity;
+        w->ready [tail] = session;
+        w->ready_count++;
+        session->status = SESSION_READY;
+    }
+}
+
+/**
+ * Takes a session from the ready queue of the worker, the oldest one if
+ * \a steal is 0, the newest one otherwise. Removed sessions are dropped.
+ */
+static Session* take_ready (Worker* w, const int steal)
+{
+    while (w->ready_count > 0) {
+        Session* session;
+
+        if (steal)
+            session = w->ready [(w->ready_head + w->ready_count - 1)
+                                % w->capacity];
+        else {
+            session = w->ready [w->ready_head];
+            w->ready_head = (w->ready_head + 1) % w->capacity;
+        }
+
+        w->ready_count--;
+
+        if (session->removed)
+            session->status = SESSION_DONE;
+
+        else {
+            session->status = SESSION_RUNNING;
+            return session;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Grows the heap and the ready queue of the worker, so that they can hold
+ * every session owned by the worker
+ */
+static void reserve (Worker* w, const int count)
+{
+    if (count <= w->capacity)
+        return;
+
+    int capacity = DS_Max (16, w->capacity * 2);
+    Session** heap = (Session**) calloc (capacity, sizeof (Session*));
+    Session** ready = (Session**) calloc (capacity, sizeof (Session*));
+    assert (heap && ready);
+
+    int i;
+    for (i = 0; i < w->heap_size; ++i)
+        heap [i] = w->heap [i];
+    for (i = 0; i < w->ready_count; ++i)
+        ready [i] = w->ready [(w->ready_head + i) % w->capacity];
+
+    DS_FREE (w->heap);
+    DS_FREE (w->ready);
+
+    w->heap = heap;
+    w->ready = ready;
+    w->ready_head = 0;
+    w->capacity = capacity;
+}
+
+/**
+ * Returns the next session to step: a ready session of the worker, or a
+ * ready session stolen from another worker (in which case \a stolen is set
+ * to 1). Busy workers are skipped by the thieves.
+ */
+static Session* next_session (Worker* w, const uint64_t now, int* stolen)
+{
+    pthread_mutex_lock (&w->mutex);
+    promote (w, now);
+    Session* session = take_ready (w, 0);
+    pthread_mutex_unlock (&w->mutex);
+
+    int i;
+    for (i = 1; !session && i < worker_count; ++i) {
+        Worker* victim = &workers [(w->index + i) % worker_count];
+        if (pthread_mutex_trylock (&victim->mutex) != 0)
+            continue;
+
+        promote (victim, now);
+        session = take_ready (victim, 1);
+        pthread_mutex_unlock (&victim->mutex);
+
+        *stolen = (session != NULL);
+    }
+
+    return session;
+}
+
+/**
+ * Steps the context of the given \a session, and gives the session back to
+ * its owner (or drops it if it was removed in the meantime)
+ */
+static void run_session (Worker* w, Session* session, const int stolen)
+{
+    uint64_t now = DS_GetTimeNs();
+    uint64_t lateness = 0;
+    if (now > session->deadline)
+        lateness = now - session->deadline;
+
+    DS_ContextMakeCurrent (session->context);
+    uint64_t deadline = Protocols_Step (now);
+    DS_ContextMakeCurrent (NULL);
+
+    Worker* owner = &workers [session->owner];
+    pthread_mutex_lock (&owner->mutex);
+    if (session->removed)
+        session->status = SESSION_DONE;
+    else {
+        session->deadline = deadline;
+        heap_push (owner, session);
+    }
+    pthread_mutex_unlock (&owner->mutex);
+
+    pthread_mutex_lock (&w->mutex);
+    w->steps++;
+    w->steals += stolen;
+    w->lateness += lateness;
+    w->max_lateness = DS_Max (w->max_lateness, lateness);
+    pthread_mutex_unlock (&w->mutex);
+}
+
+/**
+ * Runs the given worker, which steps the sessions whose deadline passed
+ * and sleeps until the next deadline when there is no work to do
+ */
+static void* run_worker (void* data)
+{
+    assert (data);
+    Worker* w = (Worker*) data;
+
+    char name [16];
+    snprintf (name, sizeof (name), "ds-worker-%d", w->index);
+    Realtime_ConfigureWorker (w->index % DS_Max (1, cpu_count()), name);
+
+    while (running) {
+        int stolen = 0;
+        uint64_t now = DS_GetTimeNs();
+        Session* session = next_session (w, now, &stolen);
+
+        if (session) {
+            run_session (w, session, stolen);
+            continue;
+        }
+
+        uint64_t wakeup = now + IDLE_INTERVAL * 1000000ULL;
+        pthread_mutex_lock (&w->mutex);
+        if (w->heap_size > 0)
+            wakeup = DS_Min (wakeup, w->heap [0]->deadline);
+        pthread_mutex_unlock (&w->mutex);
+
+        DS_SleepUntil (wakeup);
+    }
+
+    return NULL;
+}
+
+/**
+ * Registers the current context with the scheduler (if it is running), so
+ * that its protocol is stepped by the workers instead of its own thread.
+ *
+ * \returns 1 if the context is scheduled, 0 if the scheduler is not running
+ */
+int Scheduler_AddSession (void)
+{
+    pthread_mutex_lock (&mutex);
+
+    if (!running) {
+        pthread_mutex_unlock (&mutex);
+        return 0;
+    }
+
+    Session* s = session();
+    s->registered = 1;
+    s->context = DS_CurrentContext();
+    s->deadline = DS_GetTimeNs();
+    s->owner = next_owner;
+    s->removed = 0;
+    next_owner = (next_owner + 1) % worker_count;
+
+    Worker* owner = &workers [s->owner];
+    pthread_mutex_lock (&owner->mutex);
+    reserve (owner, owner->sessions + 1);
+    owner->sessions++;
+    heap_push (owner, s);
+    pthread_mutex_unlock (&owner->mutex);
+
+    ++sessions;
+    pthread_mutex_unlock (&mutex);
+
+    return 1;
+}
+
+/**
+ * Unregisters the current context from the scheduler, and waits until no
+ * worker is stepping it
+ */
+void Scheduler_RemoveSession (void)
+{
+    Session* s = session();
+    pthread_mutex_lock (&mutex);
+
+    if (!s->registered) {
+        pthread_mutex_unlock (&mutex);
+        return;
+    }
+
+    Worker* owner = &workers [s->owner];
+    pthread_mutex_lock (&owner->mutex);
+    s->removed = 1;
+    if (s->status == SESSION_WAITING) {
+        heap_remove (owner, s->heap_index);
+        s->status = SESSION_DONE;
+    }
+
+    while (s->status != SESSION_DONE) {
+        pthread_mutex_unlock (&owner->mutex);
+        Timers_SystemSleep (1);
+        pthread_mutex_lock (&owner->mutex);
+    }
+
+    owner->sessions--;
+    s->registered = 0;
+    pthread_mutex_unlock (&owner->mutex);
+
+    --sessions;
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Starts a pool of \a workers threads (one per CPU if \a workers is 0) that
+ * run the driver stations of every context of the process.
+ *
+ * Without the scheduler, each context runs its own protocol thread. With
+ * the scheduler, the contexts initialized afterwards (with \c DS_Init())
+ * are sessions of the pool: each session is owned by a worker and stepped
+ * when its deadline (the next packet to send, or the next time to read its
+ * sockets) passes. Idle workers steal the ready sessions of busy workers,
+ * and the sockets of the sessions are read by the workers, so a process
+ * can run hundreds of driver stations with a handful of threads.
+ *
+ * \returns 1 if the scheduler was started, 0 if it was already running or
+ *          if the workers could not be started
+ */
+int DS_SchedulerStart (const int count)
+{
+    pthread_mutex_lock (&mutex);
+
+    if (running || count < 0) {
+        pthread_mutex_unlock (&mutex);
+        return 0;
+    }
+
+    worker_count = count > 0 ? count : cpu_count();
+    worker_count = DS_Max (1, DS_Min (worker_count, MAX_WORKERS));
+    next_owner = 0;
+    running = 1;
+
+    /* Initialize every worker before any of them looks for work */
+    int i;
+    for (i = 0; i < worker_count; ++i) {
+        memset (&workers [i], 0, sizeof (Worker));
+        workers [i].index = i;
+        pthread_mutex_init (&workers [i].mutex, NULL);
+    }
+
+    int started = 0;
+    while (started < worker_count) {
+        Worker* w = &workers [started];
+        if (pthread_create (&w->thread, NULL, &run_worker, (void*) w) != 0)
+            break;
+
+        ++started;
+    }
+
+    /* Some workers failed to start, stop the others */
+    if (started < worker_count) {
+        fprintf (stderr, "DS_SchedulerStart: cannot start workers\n");
+
+        running = 0;
+        for (i = 0; i < started; ++i)
+            pthread_join (workers [i].thread, NULL);
+        for (i = 0; i < worker_count; ++i)
+            pthread_mutex_destroy (&workers [i].mutex);
+
+        worker_count = 0;
+    }
+
+    pthread_mutex_unlock (&mutex);
+    return running;
+}
+
+/**
+ * Stops the worker threads of the scheduler. The scheduled contexts must be
+ * closed (with \c DS_Close() or \c DS_ContextDestroy()) before.
+ *
+ * \returns 1 if the scheduler was stopped, 0 if it was not running or if
+ *          there are scheduled contexts
+ */
+int DS_SchedulerStop (void)
+{
+    pthread_mutex_lock (&mutex);
+
+    if (!running || sessions > 0) {
+        pthread_mutex_unlock (&mutex);
+        return 0;
+    }
+
+    running = 0;
+
+    /* Workers may still steal from each other until they all exit */
+    int i;
+    for (i = 0; i < worker_count; ++i)
+        pthread_join (workers [i].thread, NULL);
+
+    for (i = 0; i < worker_count; ++i) {
+        pthread_mutex_destroy (&workers [i].mutex);
+        DS_FREE (workers [i].heap);
+        DS_FREE (workers [i].ready);
+    }
+
+    worker_count = 0;
+    pthread_mutex_unlock (&mutex);
+
+    return 1;
+}
+
+/**
+ * Returns 1 if the scheduler is running
+ */
+int DS_SchedulerRunning (void)
+{
+    return running;
+}
+
+/**
+ * Writes the statistics of the scheduler in \a stats
+ */
+void DS_GetSchedulerStats (DS_SchedulerStats* stats)
+{
+    assert (stats);
+    memset (stats, 0, sizeof (DS_SchedulerStats));
+
+    pthread_mutex_lock (&mutex);
+    stats->workers = worker_count;
+    stats->sessions = sessions;
+
+    int i;
+    uint64_t lateness = 0;
+    uint64_t max_lateness = 0;
+    for (i = 0; i < worker_count; ++i) {
+        pthread_mutex_lock (&workers [i].mutex);
+        stats->steps += workers [i].steps;
+        stats->steals += workers [i].steals;
+        lateness += workers [i].lateness;
+        max_lateness = DS_Max (max_lateness, workers [i].max_lateness);
+        pthread_mutex_unlock (&workers [i].mutex);
+    }
+
+    pthread_mutex_unlock (&mutex);
+
+    if (stats->steps > 0)
+        stats->mean_lateness = (float) (lateness / stats->steps) / 1000000.0f;
+
+    stats->max_lateness = (float) max_lateness / 1000000.0f;
+}
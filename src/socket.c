@@ -21,50 +21,679 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#if defined __linux__
+    #ifndef _GNU_SOURCE
+        #define _GNU_SOURCE
+    #endif
+#endif
+
 #include "DS_Utils.h"
+#include "DS_Timer.h"
 #include "DS_Socket.h"
+#include "DS_Context.h"
+#include "DS_Metrics.h"
+#include "DS_Realtime.h"
+#include "DS_Loopback.h"
 
 #include <socky.h>
 #include <assert.h>
 
+#if !defined _WIN32
+    #include <time.h>
+    #include <net/if.h>
+    #include <arpa/inet.h>
+#endif
+
+#if defined __linux__
+    #include <linux/errqueue.h>
+    #include <linux/net_tstamp.h>
+#endif
+
+#define RESOLVE_INTERVAL 1000 /* Retry failed address lookups every second */
+#define BUSY_POLL_TIME     50 /* Microseconds the kernel polls the NIC */
+#define TX_BATCH           16 /* Transmit timestamps read per system call */
+
 #define SPRINTF_S snprintf
 #ifdef _WIN32
     #ifndef __MINGW32__
         #undef  SPRINTF_S
         #define SPRINTF_S sprintf_s
     #endif
+
+    #define SHUT_RD SD_RECEIVE
 #endif
 
 /**
- * Copies the received data from the socket in its data buffer
+ * Holds the socket opened by a socket thread, the \c open_count is used to
+ * detect if the socket was closed (or re-opened) in the meantime
+ */
+typedef struct {
+    DS_Socket* socket;
+    int open_count;
+    const DS_Transport* transport;
+} OpenRequest;
+
+/*
+ * Transport used by sockets that do not specify their own transport
+ */
+static const DS_Transport* default_transport = NULL;
+
+/**
+ * Looks up the given host \a address and \a service and writes the first
+ * address found to \a addr, which can hold \a size bytes. With \a numeric
+ * set to 1, only numeric addresses are accepted, so that the lookup never
+ * waits for a DNS/mDNS server.
+ *
+ * Returns the size of the address, or 0 if the lookup failed
  */
-static void read_socket (DS_Socket* ptr)
+static int lookup_address (const char* address, const char* service,
+                           uint64_t* addr, const size_t size,
+                           const int numeric)
 {
-    /* Check arguments */
-    assert (ptr);
+    struct addrinfo hints;
+    struct addrinfo* info = NULL;
+
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (numeric)
+        hints.ai_flags = AI_NUMERICHOST;
+
+    if (getaddrinfo (address, service, &hints, &info) != 0 || !info)
+        return 0;
+
+    int length = 0;
+    if (info->ai_addrlen <= size) {
+        memcpy (addr, info->ai_addr, info->ai_addrlen);
+        length = (int) info->ai_addrlen;
+    }
+
+    freeaddrinfo (info);
+    return length;
+}
+
+/**
+ * Looks up the remote address of the given UDP socket once, so that sending
+ * a datagram does not need a DNS/mDNS lookup. If the lookup fails, the socket
+ * sends nothing (\c DS_SocketCanSend() returns 0 and \c socky_send() fails)
+ * until the server loop of the socket finds the address, the loop retries the
+ * lookup every \c RESOLVE_INTERVAL milliseconds (see \c retry_resolve()).
+ *
+ * Threadless sockets are opened by the thread of their owner, so they only
+ * accept numeric addresses here. Their host names are looked up when the
+ * owner asks for it (see \c DS_SocketLookupRun()).
+ */
+static void resolve_address (DS_Socket* ptr)
+{
+    ptr->info.out_addr_len = lookup_address (ptr->address,
+                                             ptr->info.out_service,
+                                             ptr->info.out_addr,
+                                             sizeof (ptr->info.out_addr),
+                                             ptr->threadless);
+}
+
+/**
+ * Makes the given input socket non-blocking, so that it can be read by its
+ * owner without waiting for a datagram
+ */
+static void set_non_blocking (const int sock)
+{
+#if defined _WIN32
+    u_long non_blocking = 1;
+    ioctlsocket (sock, FIONBIO, &non_blocking);
+#else
+    set_socket_block (sock, 0);
+#endif
+}
+
+/**
+ * Makes the given input socket non-blocking and asks the kernel to poll the
+ * network device when the socket is read, instead of waiting for interrupts
+ */
+static void set_busy_poll (const int sock)
+{
+    set_non_blocking (sock);
+
+#if defined SO_BUSY_POLL
+    int time = BUSY_POLL_TIME;
+    setsockopt (sock, SOL_SOCKET, SO_BUSY_POLL, (char*) &time, sizeof (time));
+#endif
+}
+
+/**
+ * Binds the given socket file descriptor to the network interface with the
+ * given \a name, returns 1 on success
+ */
+static int bind_device (const int sock, const char* name)
+{
+    if (sock <= 0)
+        return 0;
+
+#if defined SO_BINDTODEVICE
+    return setsockopt (sock, SOL_SOCKET, SO_BINDTODEVICE,
+                       name, (socklen_t) strlen (name)) == 0;
+#elif defined IP_BOUND_IF
+    unsigned int index = if_nametoindex (name);
+    return index > 0 && setsockopt (sock, IPPROTO_IP, IP_BOUND_IF,
+                                    &index, sizeof (index)) == 0;
+#else
+    (void) name;
+    return 0;
+#endif
+}
+
+/**
+ * Binds the sockets of the given socket structure to its network interface,
+ * which is either the name of an interface or a local IPv4 address. In the
+ * latter case, only the output socket is bound (so that the address is used
+ * as the source of the sent packets), and the input socket keeps receiving
+ * from every interface.
+ */
+static void bind_interface (DS_Socket* ptr)
+{
+    ptr->info.interface_bound = 0;
+
+    /* Socket uses every interface */
+    if (strlen (ptr->network_interface) == 0)
+        return;
+
+    /* Bind the output socket to the local address */
+    struct sockaddr_in local;
+    memset (&local, 0, sizeof (local));
+    if (inet_pton (AF_INET, ptr->network_interface, &local.sin_addr) == 1) {
+        local.sin_family = AF_INET;
+        if (ptr->type == DS_SOCKET_UDP && ptr->info.sock_out > 0) {
+            ptr->info.interface_bound = bind (ptr->info.sock_out,
+                                              (struct sockaddr*) &local,
+                                              sizeof (local)) == 0;
+        }
+    }
+
+    /* Bind both sockets to the interface */
+    else {
+        int in = bind_device (ptr->info.sock_in, ptr->network_interface);
+        int out = bind_device (ptr->info.sock_out, ptr->network_interface);
+        ptr->info.interface_bound = in && out;
+    }
+
+    if (!ptr->info.interface_bound)
+        fprintf (stderr, "LibDS: cannot bind socket to %s\n",
+                 ptr->network_interface);
+}
+
+/**
+ * Applies the DSCP code point and the priority of the given socket structure
+ * to its output socket, and reads back the marks accepted by the operating
+ * system (so that the application can check the marks in use)
+ */
+static void apply_marks (DS_Socket* ptr)
+{
+    int sock = ptr->info.sock_out;
+    ptr->info.marks.dscp = -1;
+    ptr->info.marks.priority = -1;
+
+    if (sock <= 0)
+        return;
+
+#if defined IP_TOS
+    int tos = (ptr->dscp & 0x3f) << 2;
+    socklen_t tos_len = sizeof (tos);
+    if (ptr->dscp > 0)
+        setsockopt (sock, IPPROTO_IP, IP_TOS, (char*) &tos, sizeof (tos));
+
+    if (getsockopt (sock, IPPROTO_IP, IP_TOS, (char*) &tos, &tos_len) == 0)
+        ptr->info.marks.dscp = (tos >> 2) & 0x3f;
+#endif
+
+#if defined SO_PRIORITY
+    int priority = ptr->priority;
+    socklen_t priority_len = sizeof (priority);
+    if (ptr->priority > 0)
+        setsockopt (sock, SOL_SOCKET, SO_PRIORITY, &priority, sizeof (priority));
+
+    if (getsockopt (sock, SOL_SOCKET, SO_PRIORITY, &priority, &priority_len) == 0)
+        ptr->info.marks.priority = priority;
+#endif
+}
+
+/**
+ * Asks the kernel to timestamp the datagrams received by the input socket
+ * and (on Linux) the datagrams sent by the output socket. Each transmit
+ * timestamp carries the ID of its datagram, the kernel counts the sent
+ * datagrams from zero once timestamping is enabled.
+ */
+static void enable_timestamps (DS_Socket* ptr)
+{
+    int on = 1;
+    ptr->info.timestamping = 0;
+    ptr->info.tx_id = 0;
+    ptr->info.tx_next_id = 0;
+    ptr->info.tx_pending = 0;
+
+    if (ptr->type != DS_SOCKET_UDP)
+        return;
+
+#if defined SO_TIMESTAMPNS
+    if (setsockopt (ptr->info.sock_in, SOL_SOCKET, SO_TIMESTAMPNS,
+                    &on, sizeof (on)) == 0)
+        ptr->info.timestamping |= DS_TIMESTAMP_RX;
+#elif defined SO_TIMESTAMP && !defined _WIN32
+    if (setsockopt (ptr->info.sock_in, SOL_SOCKET, SO_TIMESTAMP,
+                    &on, sizeof (on)) == 0)
+        ptr->info.timestamping |= DS_TIMESTAMP_RX;
+#else
+    (void) on;
+#endif
+
+#if defined __linux__ && defined SO_TIMESTAMPING
+    int flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE
+                | SOF_TIMESTAMPING_OPT_TSONLY | SOF_TIMESTAMPING_OPT_ID;
+    if (setsockopt (ptr->info.sock_out, SOL_SOCKET, SO_TIMESTAMPING,
+                    &flags, sizeof (flags)) == 0)
+        ptr->info.timestamping |= DS_TIMESTAMP_TX;
+#endif
+}
+
+/**
+ * Creates the UDP/TCP sockets used by the given socket structure
+ */
+static void socky_open (DS_Socket* ptr)
+{
+    /* Open TCP socket */
+    if (ptr->type == DS_SOCKET_TCP) {
+        ptr->info.sock_in = create_server_tcp (ptr->info.in_service, SOCKY_IPv4, 0);
+        ptr->info.sock_out = create_client_tcp (ptr->address, ptr->info.out_service, SOCKY_IPv4, 0);
+    }
+
+    /* Open UDP socket */
+    else if (ptr->type == DS_SOCKET_UDP) {
+        ptr->info.sock_out = create_client_udp (SOCKY_IPv4, 0);
+        ptr->info.sock_in = create_server_udp (ptr->info.in_service, SOCKY_IPv4, 0);
+        resolve_address (ptr);
+    }
+
+    /* Disable socket blocking */
+#ifndef _WIN32
+    if (ptr->info.sock_in > 0)
+        set_socket_block (ptr->info.sock_in, 0);
+#endif
+
+    /* Bind the sockets to their network interface */
+    bind_interface (ptr);
+
+    /* Mark the sent packets */
+    apply_marks (ptr);
+
+    /* Timestamp the sent and received datagrams */
+    enable_timestamps (ptr);
+
+    /* Configure busy-polled sockets */
+    if (ptr->info.sock_in > 0 && ptr->busy_poll)
+        set_busy_poll (ptr->info.sock_in);
+
+    /* Sockets read by their owner must not block the owner */
+    else if (ptr->info.sock_in > 0 && ptr->polled)
+        set_non_blocking (ptr->info.sock_in);
+
+    /* Update initialized states */
+    ptr->info.server_init = (ptr->info.sock_in > 0);
+    ptr->info.client_init = (ptr->info.sock_out > 0);
+}
+
+/**
+ * Closes the UDP/TCP sockets used by the given socket structure
+ */
+static void socky_close (DS_Socket* ptr)
+{
+    /* Wake up the server loop, a socket that is still watched by select()
+     * keeps its port and may steal the datagrams sent to a new socket */
+    if (ptr->info.sock_in > 0)
+        shutdown (ptr->info.sock_in, SHUT_RD);
 
-    /* Initialize temporary buffer */
+#if defined (__ANDROID__)
+    socket_close_threaded (ptr->info.sock_in);
+    socket_close_threaded (ptr->info.sock_out);
+#else
+    socket_close (ptr->info.sock_in);
+    socket_close (ptr->info.sock_out);
+#endif
+
+    ptr->info.out_addr_len = 0;
+    ptr->info.in_addr_len = 0;
+    ptr->info.interface_bound = 0;
+    ptr->info.marks.dscp = -1;
+    ptr->info.marks.priority = -1;
+    ptr->info.timestamping = 0;
+}
+
+/**
+ * Sends the given \a data using the output socket of the socket structure
+ */
+static int socky_send (const DS_Socket* ptr, const char* data, const int len)
+{
+    /* Send data using TCP */
+    if (ptr->type == DS_SOCKET_TCP)
+        return send (ptr->info.sock_out, data, len, 0);
+
+    /* Send data using UDP to the resolved address */
+    else if (ptr->type == DS_SOCKET_UDP && ptr->info.out_addr_len > 0) {
+        return sendto (ptr->info.sock_out, data, len, 0,
+                       (const struct sockaddr*) ptr->info.out_addr,
+                       ptr->info.out_addr_len);
+    }
+
+    /* Address lookup failed, the server loop retries it (if running) so
+     * that the sender is never blocked by a slow DNS/mDNS lookup */
+    else if (ptr->type == DS_SOCKET_UDP && ptr->info.server_init)
+        return -1;
+
+    /* Send data using UDP, resolving the address */
+    else if (ptr->type == DS_SOCKET_UDP) {
+        return udp_sendto (ptr->info.sock_out, data, len,
+                           ptr->address, ptr->info.out_service, 0);
+    }
+
+    return -1;
+}
+
+/**
+ * Returns 1 if the remote address of the given UDP socket could not be
+ * looked up yet
+ */
+static int lookup_pending (const DS_Socket* ptr)
+{
+    if (ptr->type != DS_SOCKET_UDP || ptr->info.out_addr_len > 0)
+        return 0;
+
+    return (strlen (ptr->address) > 0 && ptr->out_port > 0);
+}
+
+/**
+ * Looks up the remote address of the given UDP socket again if the last
+ * lookup failed and \c RESOLVE_INTERVAL milliseconds have passed since then.
+ * This function is called by the server loop of the socket.
+ */
+static void retry_resolve (DS_Socket* ptr, uint64_t* last_lookup)
+{
+    if (!lookup_pending (ptr))
+        return;
+
+    uint64_t now = DS_GetTimeNs();
+    if (now - *last_lookup < RESOLVE_INTERVAL * 1000000ULL)
+        return;
+
+    *last_lookup = now;
+    resolve_address (ptr);
+}
+
+#if !defined _WIN32
+/**
+ * Converts a kernel timestamp (given by the real-time clock) to the
+ * monotonic clock used by \c DS_GetTimeNs(), returns 0 if the library does
+ * not use the system clock
+ */
+static uint64_t kernel_time (const struct timespec* stamp)
+{
+    if (!DS_SystemClock())
+        return 0;
+
+    struct timespec now;
+    clock_gettime (CLOCK_REALTIME, &now);
+    uint64_t monotonic = DS_GetTimeNs();
+
+    int64_t age = (int64_t) (now.tv_sec - stamp->tv_sec) * 1000000000LL
+                  + (int64_t) (now.tv_nsec - stamp->tv_nsec);
+
+    if (age < 0)
+        return monotonic;
+
+    if ((uint64_t) age > monotonic)
+        return 0;
+
+    return monotonic - (uint64_t) age;
+}
+
+/**
+ * Returns the kernel receive timestamp of the given message, or 0 if the
+ * message has no timestamp
+ */
+static uint64_t rx_timestamp (struct msghdr* msg)
+{
+    struct cmsghdr* cmsg;
+    for (cmsg = CMSG_FIRSTHDR (msg); cmsg; cmsg = CMSG_NXTHDR (msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+
+#if defined SCM_TIMESTAMPNS
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec stamp;
+            memcpy (&stamp, CMSG_DATA (cmsg), sizeof (stamp));
+            return kernel_time (&stamp);
+        }
+#endif
+
+#if defined SCM_TIMESTAMP
+        if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval tv;
+            struct timespec stamp;
+            memcpy (&tv, CMSG_DATA (cmsg), sizeof (tv));
+            stamp.tv_sec = tv.tv_sec;
+            stamp.tv_nsec = tv.tv_usec * 1000;
+            return kernel_time (&stamp);
+        }
+#endif
+    }
+
+    return 0;
+}
+#endif
+
+/**
+ * Reads up to \a max transmit timestamps queued by the kernel for the output
+ * socket with a single system call. The ID of each timestamped datagram is
+ * written to \a ids and its transmit time to \a times, both arrays may be
+ * \c NULL to discard the timestamps.
+ *
+ * Returns the number of timestamps read
+ */
+static int tx_timestamps (DS_Socket* ptr, uint32_t* ids, uint64_t* times,
+                          const int max)
+{
+    int count = 0;
+
+#if defined __linux__ && defined SO_TIMESTAMPING
+    int i;
+    int batch = DS_Min (max, TX_BATCH);
+    char control [TX_BATCH][128];
+    struct mmsghdr msgs [TX_BATCH];
+
+    if (batch <= 0)
+        return 0;
+
+    memset (msgs, 0, sizeof (msgs));
+    for (i = 0; i < batch; ++i) {
+        msgs [i].msg_hdr.msg_control = control [i];
+        msgs [i].msg_hdr.msg_controllen = sizeof (control [i]);
+    }
+
+    /* The queue is empty, the remaining timestamps were lost or are late */
+    int received = recvmmsg (ptr->info.sock_out, msgs, batch,
+                             MSG_ERRQUEUE | MSG_DONTWAIT, NULL);
+    if (received <= 0) {
+        ptr->info.tx_pending = 0;
+        return 0;
+    }
+
+    ptr->info.tx_pending = DS_Max (ptr->info.tx_pending - received, 0);
+
+    for (i = 0; i < received; ++i) {
+        int tagged = 0;
+        uint32_t id = 0;
+        uint64_t time = 0;
+
+        struct cmsghdr* cmsg;
+        struct msghdr* msg = &msgs [i].msg_hdr;
+        for (cmsg = CMSG_FIRSTHDR (msg); cmsg; cmsg = CMSG_NXTHDR (msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET
+                    && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                struct scm_timestamping stamps;
+                memcpy (&stamps, CMSG_DATA (cmsg), sizeof (stamps));
+                time = kernel_time (&stamps.ts [0]);
+            }
+
+            else if ((cmsg->cmsg_level == IPPROTO_IP
+                      && cmsg->cmsg_type == IP_RECVERR)
+                     || (cmsg->cmsg_level == IPPROTO_IPV6
+                         && cmsg->cmsg_type == IPV6_RECVERR)) {
+                struct sock_extended_err error;
+                memcpy (&error, CMSG_DATA (cmsg), sizeof (error));
+                if (error.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                    id = error.ee_data;
+                    tagged = 1;
+                }
+            }
+        }
+
+        if (!tagged)
+            continue;
+
+        /* Failed sends do not consume an ID, follow the kernel counter */
+        if ((int32_t) (id + 1 - ptr->info.tx_next_id) > 0)
+            ptr->info.tx_next_id = id + 1;
+
+        if (time > 0) {
+            if (ids)
+                ids [count] = id;
+            if (times)
+                times [count] = time;
+
+            ++count;
+        }
+    }
+#else
+    (void) ptr;
+    (void) ids;
+    (void) max;
+    (void) times;
+#endif
+
+    return count;
+}
+
+/**
+ * Reads a datagram from the input socket of the given socket structure, the
+ * sender address is written to \a from and its kernel receive timestamp
+ * (if any) to the socket information structure
+ */
+static int receive_datagram (DS_Socket* ptr, struct sockaddr_storage* from,
+                             socklen_t* from_len)
+{
+#if defined _WIN32
+    return recvfrom (ptr->info.sock_in, ptr->info.view,
+                     sizeof (ptr->info.view), 0,
+                     (struct sockaddr*) from, from_len);
+#else
+    char control [256];
+    struct iovec iov;
+    struct msghdr msg;
+
+    iov.iov_base = ptr->info.view;
+    iov.iov_len = sizeof (ptr->info.view);
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_name = from;
+    msg.msg_namelen = *from_len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof (control);
+
+    int read = recvmsg (ptr->info.sock_in, &msg, 0);
+    *from_len = msg.msg_namelen;
+
+    if (read > 0)
+        ptr->info.kernel_rx_time = rx_timestamp (&msg);
+
+    return read;
+#endif
+}
+
+/**
+ * Reads the data available in the input socket of the socket structure
+ */
+static int socky_recv_view (DS_Socket* ptr, const char** data)
+{
     int read = -1;
-    char data [4096] = {0};
+    *data = ptr->info.view;
 
     /* Read TCP socket */
     if (ptr->type == DS_SOCKET_TCP)
-        read = recv (ptr->info.sock_in, data, sizeof (data), 0);
+        read = recv (ptr->info.sock_in, ptr->info.view, sizeof (ptr->info.view), 0);
 
-    /* Read UDP socket */
+    /* Read UDP socket and remember the sender of the datagram */
     if (ptr->type == DS_SOCKET_UDP) {
-        read = udp_recvfrom (ptr->info.sock_in, data, sizeof (data),
-                             ptr->address, ptr->info.in_service, 0);
+        struct sockaddr_storage from;
+        socklen_t from_len = sizeof (from);
+        read = receive_datagram (ptr, &from, &from_len);
+
+        if (read > 0 && from_len <= (socklen_t) sizeof (ptr->info.in_addr)) {
+            memcpy (ptr->info.in_addr, &from, from_len);
+            ptr->info.in_addr_len = (int) from_len;
+        }
     }
 
+    return read;
+}
+
+/**
+ * Returns the input socket file descriptor of the socket structure
+ */
+static int socky_fd (const DS_Socket* ptr)
+{
+    return ptr->info.sock_in;
+}
+
+/*
+ * Operating system sockets (through Socky)
+ */
+static const DS_Transport SockyTransport = {
+    "socky",
+    &socky_open,
+    &socky_close,
+    &socky_send,
+    &socky_recv_view,
+    &socky_fd,
+};
+
+/**
+ * Copies the received data from the socket in its data buffer
+ */
+static void read_socket (DS_Socket* ptr, const DS_Transport* transport)
+{
+    /* Check arguments */
+    assert (ptr);
+    assert (transport);
+
+    /* Get the received datagram */
+    const char* data = NULL;
+    ptr->info.kernel_rx_time = 0;
+    int read = transport->recv_view (ptr, &data);
+
     /* We received some data, copy it to socket's buffer */
-    if (read > 0) {
+    if (read > 0 && data) {
+        /* The previous datagram was not read yet, it is lost */
+        if (ptr->info.buffer_size > 0)
+            Metrics_SocketDrop();
+
+        read = DS_Min (read, (int) sizeof (ptr->info.buffer));
+        memcpy (ptr->info.buffer, data, read);
         ptr->info.buffer_size = read;
-        memset (ptr->info.buffer, 0, ptr->info.buffer_size);
 
-        int i;
-        for (i = 0; i < read; ++i)
-            ptr->info.buffer [i] = data [i];
+        /* Use the kernel timestamp if we have one */
+        if (ptr->info.kernel_rx_time > 0)
+            ptr->info.rx_time = ptr->info.kernel_rx_time;
+        else
+            ptr->info.rx_time = DS_GetTimeNs();
     }
 }
 
@@ -73,54 +702,75 @@ static void read_socket (DS_Socket* ptr)
  * to copy received data into the socket's buffer only when the
  * operating system detects that the socket received some data.
  *
+ * The \a transport is given by the caller, because the socket may be closed
+ * (and its transport reset) while the loop is running. The loop exits when
+ * the socket is closed, even if it is re-opened in the meantime.
+ *
+ * Busy-polled and polled sockets are read by their owner, the loop only
+ * retries the failed address lookups of such sockets. The loop of a polled
+ * socket exits once its address is known, so that the socket does not need a
+ * thread while it is open.
+ *
  * \param ptr a pointer to a \c DS_Socket structure
+ * \param transport the transport used to open the socket
+ * \param open_count the open count of the socket when it was opened
  */
-static void server_loop (DS_Socket* ptr)
+static void server_loop (DS_Socket* ptr, const DS_Transport* transport,
+                         const int open_count)
 {
     /* Check arguments */
     assert (ptr);
+    assert (transport);
 
     /* Initialize variables for select */
-    int rc, fd;
+    int rc, fd, sock;
     fd_set set;
     struct timeval tv;
 
-    /* Disable socket blocking */
-#ifndef _WIN32
-    set_socket_block (ptr->info.sock_in, 0);
-#endif
+    /* Time of the last address lookup */
+    uint64_t last_lookup = DS_GetTimeNs();
 
     /* Run the server while the socket is valid */
-    while (ptr->info.server_init && ptr->info.sock_in > 0) {
+    sock = transport->fd (ptr);
+    while (ptr->info.server_init && sock > 0
+           && ptr->info.open_count == open_count) {
+        if (transport == &SockyTransport)
+            retry_resolve (ptr, &last_lookup);
+
+        if (ptr->polled && (transport != &SockyTransport
+                            || !lookup_pending (ptr)))
+            break;
+
+        if (ptr->busy_poll || ptr->polled) {
+            Timers_SystemSleep (100);
+            continue;
+        }
+
         tv.tv_sec = 0;
         tv.tv_usec = 5000 * 100;
 
         FD_ZERO (&set);
-        FD_SET (ptr->info.sock_in, &set);
+        FD_SET (sock, &set);
 
 #if defined _WIN32
         fd = 0;
 #else
-        fd = ptr->info.sock_in + 1;
+        fd = sock + 1;
 #endif
 
         rc = select (fd, &set, NULL, NULL, &tv);
-        if (rc > 0 && FD_ISSET (ptr->info.sock_in, &set))
-            read_socket (ptr);
+        if (rc > 0 && FD_ISSET (sock, &set))
+            read_socket (ptr, transport);
+
+        sock = transport->fd (ptr);
     }
 }
 
 /**
- * Initializes the given socket structure
- *
- * \param data raw pointer to a \c DS_Socket structure
+ * Prepares the service strings of the given socket and opens its transport
  */
-static void* create_socket (void* data)
+static void open_transport (DS_Socket* ptr, const DS_Transport* transport)
 {
-    /* Check arguments */
-    assert (data);
-    DS_Socket* ptr = (DS_Socket*) data;
-
     /* Ensure that buffer and service strings are set to 0 */
     memset (ptr->info.buffer, 0, sizeof (ptr->info.buffer));
     memset (ptr->info.in_service, 0, sizeof (ptr->info.in_service));
@@ -131,24 +781,42 @@ static void* create_socket (void* data)
     SPRINTF_S (ptr->info.in_service, len, "%d", ptr->in_port);
     SPRINTF_S (ptr->info.out_service, len, "%d", ptr->out_port);
 
-    /* Open TCP socket */
-    if (ptr->type == DS_SOCKET_TCP) {
-        ptr->info.sock_in = create_server_tcp (ptr->info.in_service, SOCKY_IPv4, 0);
-        ptr->info.sock_out = create_client_tcp (ptr->address, ptr->info.out_service, SOCKY_IPv4, 0);
-    }
+    /* Create the resources of the transport */
+    transport->open (ptr);
+}
 
-    /* Open UDP socket */
-    else if (ptr->type == DS_SOCKET_UDP) {
-        ptr->info.sock_out = create_client_udp (SOCKY_IPv4, 0);
-        ptr->info.sock_in = create_server_udp (ptr->info.in_service, SOCKY_IPv4, 0);
-    }
+/**
+ * Initializes the given socket structure
+ *
+ * \param data raw pointer to an \c OpenRequest structure
+ */
+static void* create_socket (void* data)
+{
+    /* Check arguments */
+    assert (data);
+    OpenRequest request = * (OpenRequest*) data;
+    DS_Socket* ptr = request.socket;
+    const DS_Transport* transport = request.transport;
+    DS_FREE (data);
 
-    /* Update initialized states */
-    ptr->info.server_init = (ptr->info.sock_in > 0);
-    ptr->info.client_init = (ptr->info.sock_out > 0);
+    /* Configure the thread */
+    Realtime_ConfigureThread (DS_THREAD_IO, "ds-socket");
+
+    /* Socket was closed before the thread started */
+    if (ptr->info.open_count != request.open_count)
+        return NULL;
+
+    /* Open the socket */
+    open_transport (ptr, transport);
+
+    /* Socket was closed while opening (e.g. during a slow DNS lookup) */
+    if (ptr->info.open_count != request.open_count) {
+        transport->close (ptr);
+        return NULL;
+    }
 
     /* Start server loop */
-    server_loop (ptr);
+    server_loop (ptr, transport, request.open_count);
 
     /* Exit */
     return NULL;
@@ -175,6 +843,8 @@ DS_Socket* DS_SocketEmpty (void)
     socket->info.buffer_size = 0;
     socket->info.server_init = 0;
     socket->info.client_init = 0;
+    socket->info.marks.dscp = -1;
+    socket->info.marks.priority = -1;
 
     /* Fill strings with 0 */
     memset (socket->address, 0, sizeof (socket->address));
@@ -200,13 +870,48 @@ void Sockets_Init (void)
 void Sockets_Close (void)
 {
     sockets_exit();
+    Loopback_Close();
+}
+
+/**
+ * Returns the transport that uses the UDP/TCP sockets of the operating system
+ */
+const DS_Transport* DS_SockyTransport (void)
+{
+    return &SockyTransport;
+}
+
+/**
+ * Returns the transport used by sockets that do not specify their own
+ * transport
+ */
+const DS_Transport* DS_GetDefaultTransport (void)
+{
+    if (default_transport)
+        return default_transport;
+
+    return &SockyTransport;
+}
+
+/**
+ * Changes the transport used by sockets that do not specify their own
+ * transport. Sockets that are already open keep using their current
+ * transport, so this function should be called before configuring a
+ * protocol. Use \c NULL to restore the operating system sockets.
+ */
+void DS_SetDefaultTransport (const DS_Transport* transport)
+{
+    default_transport = transport;
 }
 
 /**
  * Initializes and configures the given socket
  *
  * \note The socket will be initialzed in another thread to avoid blocking
- *       the main thread of the application
+ *       the main thread of the application, unless the socket is
+ *       \c threadless. Threadless sockets are opened in the calling thread
+ *       and read by their owner, their host names are only looked up when
+ *       the owner calls \c DS_SocketLookupRun().
  */
 void DS_SocketOpen (DS_Socket* ptr)
 {
@@ -217,13 +922,34 @@ void DS_SocketOpen (DS_Socket* ptr)
     if (ptr->disabled)
         return;
 
-    /* Initialize the socket in another thread */
+    /* Select the transport */
+    if (ptr->transport)
+        ptr->info.transport = ptr->transport;
+    else
+        ptr->info.transport = DS_GetDefaultTransport();
+
+    /* Transport has no file descriptor (or the socket cannot start a
+     * thread), open it directly */
+    if (!ptr->info.transport->fd || ptr->threadless) {
+        ptr->polled |= ptr->threadless;
+        open_transport (ptr, ptr->info.transport);
+        return;
+    }
+
+    /* Initialize the socket in another thread (the context of the socket is
+     * not destroyed while the thread uses it) */
+    OpenRequest* request = (OpenRequest*) calloc (1, sizeof (OpenRequest));
+    request->socket = ptr;
+    request->open_count = ptr->info.open_count;
+    request->transport = ptr->info.transport;
+
     pthread_t thread;
-    int error = pthread_create (&thread, NULL,
-                                &create_socket, (void*) ptr);
+    int error = Context_CreateThread (&thread, &create_socket,
+                                      (void*) request);
 
     /* Warn the user when the socket cannot start */
     if (error) {
+        DS_FREE (request);
         DS_String caption = DS_StrNew ("LibDS");
         DS_String message = DS_StrNew ("Cannot start socket thread!");
         DS_ShowMessageBox (&caption, &message, DS_ICON_ERROR);
@@ -247,17 +973,15 @@ void DS_SocketClose (DS_Socket* ptr)
     assert (ptr);
 
     /* Reset socket properties */
+    ptr->info.open_count++;
     ptr->info.server_init = 0;
     ptr->info.client_init = 0;
 
     /* Close sockets */
-#if defined (__ANDROID__)
-    socket_close_threaded (ptr->info.sock_in);
-    socket_close_threaded (ptr->info.sock_out);
-#else
-    socket_close (ptr->info.sock_in);
-    socket_close (ptr->info.sock_out);
-#endif
+    if (ptr->info.transport)
+        ptr->info.transport->close (ptr);
+
+    ptr->info.transport = NULL;
 
     /* Reset socket information structure */
     ptr->info.sock_in = -1;
@@ -270,6 +994,31 @@ void DS_SocketClose (DS_Socket* ptr)
     memset (ptr->info.out_service, 0, sizeof (ptr->info.out_service));
 }
 
+/**
+ * Reads the transport of the given socket if it is not watched by the server
+ * loop (e.g. busy-polled sockets) and returns the number of received bytes
+ * that are waiting to be read with \c DS_SocketRead()
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ */
+int DS_SocketPoll (DS_Socket* ptr)
+{
+    /* Check arguments */
+    assert (ptr);
+
+    /* Socket is disabled or uninitialized */
+    if ((ptr->info.server_init == 0) || (ptr->disabled == 1))
+        return 0;
+
+    /* Read the transport if nobody else does it */
+    if (!ptr->info.transport->fd || ptr->busy_poll || ptr->polled) {
+        if (ptr->info.buffer_size == 0)
+            read_socket (ptr, ptr->info.transport);
+    }
+
+    return (int) ptr->info.buffer_size;
+}
+
 /**
  * Returns any data received by the given socket
  *
@@ -284,6 +1033,9 @@ DS_String DS_SocketRead (DS_Socket* ptr)
     if ((ptr->info.server_init == 0) || (ptr->disabled == 1))
         return DS_StrNewLen (0);
 
+    /* Transport is not watched by the server loop, poll it */
+    DS_SocketPoll (ptr);
+
     /* Copy the current buffer and clear it */
     if (ptr->info.buffer_size > 0) {
         DS_String buffer = DS_StrNewLen (ptr->info.buffer_size);
@@ -313,7 +1065,7 @@ DS_String DS_SocketRead (DS_Socket* ptr)
  *
  * \returns number of bytes written on success, -1 on failure
  */
-int DS_SocketSend (const DS_Socket* ptr, const DS_String* data)
+int DS_SocketSend (DS_Socket* ptr, const DS_String* data)
 {
     /* Check arguments */
     assert (ptr);
@@ -327,26 +1079,290 @@ int DS_SocketSend (const DS_Socket* ptr, const DS_String* data)
     if (DS_StrEmpty (data))
         return 0;
 
-    /* Initialize variables*/
-    int bytes_written = 0;
-    int len = DS_StrLen (data);
-    char* bytes = DS_StrToChar (data);
+    /* Send the string buffer directly using the transport */
+    ptr->info.tx_time = DS_GetTimeNs();
+    int bytes = ptr->info.transport->send (ptr, data->buf, DS_StrLen (data));
 
-    /* Send data using TCP */
-    if (ptr->type == DS_SOCKET_TCP)
-        bytes_written = send (ptr->info.sock_out, bytes, len, 0);
+    /* The kernel queues the transmit timestamp of the datagram under its ID,
+     * the owner reads it later with DS_SocketReadTxTimestamps() */
+    if ((ptr->info.timestamping & DS_TIMESTAMP_TX) && bytes > 0) {
+        ptr->info.tx_id = ptr->info.tx_next_id++;
+        ++ptr->info.tx_pending;
 
-    /* Send data using UDP */
-    else if (ptr->type == DS_SOCKET_UDP) {
-        bytes_written = udp_sendto (ptr->info.sock_out, bytes, len,
-                                    ptr->address, ptr->info.out_service, 0);
+        /* Nobody reads the timestamps, keep the error queue from filling */
+        if (ptr->info.tx_pending >= TX_BATCH)
+            tx_timestamps (ptr, NULL, NULL, TX_BATCH);
+    }
+
+    return bytes;
+}
+
+/**
+ * Returns \c 1 if the given socket has somewhere to send its data, or \c 0 if
+ * the socket is disabled, is not open yet, or if the remote address is still
+ * being looked up by the server loop.
+ *
+ * Sending through such a socket always fails, but that does not mean that the
+ * network failed (e.g. there is no FMS, or the robot is not connected), so
+ * the caller may skip the datagram instead of counting it as an error.
+ */
+int DS_SocketCanSend (const DS_Socket* ptr)
+{
+    /* Check arguments */
+    assert (ptr);
+
+    /* Socket is disabled or uninitialized */
+    if ((ptr->info.client_init == 0) || ptr->disabled)
+        return 0;
+
+    /* The server loop has not resolved the remote address yet */
+    if (ptr->info.transport == &SockyTransport && ptr->type == DS_SOCKET_UDP
+            && ptr->info.out_addr_len <= 0 && ptr->info.server_init)
+        return 0;
+
+    return 1;
+}
+
+/**
+ * Checks if the last datagram received by the socket \a ptr was sent by
+ * the host that the socket \a remote sends its data to (the ports are
+ * not compared).
+ *
+ * \returns 1 if the hosts match, 0 if they do not match and -1 if any of
+ *          the addresses is unknown (e.g. with transports that do not use
+ *          the operating system sockets)
+ */
+int DS_SocketReceivedFrom (const DS_Socket* ptr, const DS_Socket* remote)
+{
+    /* Check arguments */
+    assert (ptr);
+    assert (remote);
+
+    /* Addresses are unknown */
+    if (ptr->info.in_addr_len <= 0 || remote->info.out_addr_len <= 0)
+        return -1;
+
+    const struct sockaddr* a = (const struct sockaddr*) ptr->info.in_addr;
+    const struct sockaddr* b = (const struct sockaddr*) remote->info.out_addr;
+
+    /* Different address families */
+    if (a->sa_family != b->sa_family)
+        return 0;
+
+    /* Compare IPv4 hosts */
+    if (a->sa_family == AF_INET) {
+        const struct sockaddr_in* a4 = (const struct sockaddr_in*) a;
+        const struct sockaddr_in* b4 = (const struct sockaddr_in*) b;
+        return a4->sin_addr.s_addr == b4->sin_addr.s_addr;
     }
 
-    /* Delete temp. buffer */
-    DS_FREE (bytes);
+    /* Compare IPv6 hosts */
+    if (a->sa_family == AF_INET6) {
+        const struct sockaddr_in6* a6 = (const struct sockaddr_in6*) a;
+        const struct sockaddr_in6* b6 = (const struct sockaddr_in6*) b;
+        return memcmp (&a6->sin6_addr, &b6->sin6_addr, sizeof (a6->sin6_addr)) == 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Writes the QoS marks applied to the packets sent by the given socket in
+ * \a marks, the values are -1 if the socket is closed or if the operating
+ * system does not support the mark
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ * \param marks the structure in which to write the marks
+ */
+void DS_SocketGetMarks (const DS_Socket* ptr, DS_SocketMarks* marks)
+{
+    /* Check arguments */
+    assert (ptr);
+    assert (marks);
+
+    *marks = ptr->info.marks;
+}
+
+/**
+ * Returns the kernel timestamps enabled for the given socket, as a
+ * combination of the \c DS_TIMESTAMP_RX and \c DS_TIMESTAMP_TX flags
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ */
+int DS_SocketTimestamping (const DS_Socket* ptr)
+{
+    assert (ptr);
+    return ptr->info.timestamping;
+}
+
+/**
+ * Returns the file descriptor that receives the data of the given socket,
+ * or -1 if the socket is not open or if its transport has no descriptor.
+ * Applications that read the socket themselves can watch the descriptor
+ * with \c select() or \c poll().
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ */
+int DS_SocketDescriptor (const DS_Socket* ptr)
+{
+    assert (ptr);
+
+    if (!ptr->info.server_init || !ptr->info.transport)
+        return -1;
+
+    if (!ptr->info.transport->fd)
+        return -1;
 
-    /* Return error code */
-    return bytes_written;
+    return ptr->info.transport->fd (ptr);
+}
+
+/**
+ * Returns the time (in the clock of \c DS_GetTimeNs()) at which the last
+ * datagram returned by \c DS_SocketRead() was received. The kernel
+ * timestamp is used if available, otherwise, the time at which the socket
+ * read the datagram is used.
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ */
+uint64_t DS_SocketReceiveTime (const DS_Socket* ptr)
+{
+    assert (ptr);
+    return ptr->info.rx_time;
+}
+
+/**
+ * Returns the time (in the clock of \c DS_GetTimeNs()) at which the last
+ * datagram was given to the socket. The kernel transmit timestamp of the
+ * datagram is queued under \c DS_SocketSendId() and can be read later with
+ * \c DS_SocketReadTxTimestamps().
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ */
+uint64_t DS_SocketSendTime (const DS_Socket* ptr)
+{
+    assert (ptr);
+    return ptr->info.tx_time;
+}
+
+/**
+ * Returns the ID of the last datagram sent by the given socket, which is the
+ * ID that \c DS_SocketReadTxTimestamps() reports for its transmit timestamp.
+ * The value is meaningless if the socket has no \c DS_TIMESTAMP_TX flag.
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ */
+uint32_t DS_SocketSendId (const DS_Socket* ptr)
+{
+    assert (ptr);
+    return ptr->info.tx_id;
+}
+
+/**
+ * Reads up to \a max of the transmit timestamps queued by the kernel for the
+ * datagrams sent by the given socket. The ID of each datagram (see
+ * \c DS_SocketSendId()) is written to \a ids and the time at which it left
+ * the socket (in the clock of \c DS_GetTimeNs()) to \a times.
+ *
+ * No system call is made if the socket has no transmit timestamps or if all
+ * of them were already read, so the function is meant to be called when a
+ * reply is received, and from the thread that sends the datagrams.
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ * \param ids array that receives the datagram IDs, may be \c NULL
+ * \param times array that receives the transmit times, may be \c NULL
+ * \param max maximum number of timestamps to read
+ *
+ * \returns the number of timestamps read
+ */
+int DS_SocketReadTxTimestamps (DS_Socket* ptr, uint32_t* ids,
+                               uint64_t* times, const int max)
+{
+    assert (ptr);
+
+    if (!(ptr->info.timestamping & DS_TIMESTAMP_TX))
+        return 0;
+
+    if (ptr->info.tx_pending <= 0 || !ptr->info.client_init)
+        return 0;
+
+    return tx_timestamps (ptr, ids, times, max);
+}
+
+/**
+ * Prepares the \a lookup of the remote address of the given threadless
+ * socket, if the address is a host name that was not looked up yet. The
+ * sockets that have a thread look up their own addresses.
+ *
+ * The owner of the socket calls this function (and
+ * \c DS_SocketLookupApply()) while nobody else uses the socket, and may run
+ * the lookup itself with \c DS_SocketLookupRun() in any thread.
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ * \param lookup the lookup to prepare
+ *
+ * \returns 1 if the address must be looked up, 0 otherwise
+ */
+int DS_SocketLookupPrepare (const DS_Socket* ptr, DS_SocketLookup* lookup)
+{
+    assert (ptr);
+    assert (lookup);
+
+    if (!ptr->threadless || ptr->info.transport != &SockyTransport)
+        return 0;
+
+    if (!ptr->info.client_init || ptr->disabled || !lookup_pending (ptr))
+        return 0;
+
+    memset (lookup, 0, sizeof (DS_SocketLookup));
+    SPRINTF_S (lookup->address, sizeof (lookup->address), "%s", ptr->address);
+    SPRINTF_S (lookup->service, sizeof (lookup->service), "%s",
+               ptr->info.out_service);
+
+    return 1;
+}
+
+/**
+ * Looks up the address of the given \a lookup, this function blocks until
+ * the DNS/mDNS lookup finishes (or fails), but it does not use the socket, so
+ * it can run in any thread.
+ *
+ * \param lookup a lookup prepared with \c DS_SocketLookupPrepare()
+ */
+void DS_SocketLookupRun (DS_SocketLookup* lookup)
+{
+    assert (lookup);
+
+    lookup->length = lookup_address (lookup->address, lookup->service,
+                                     lookup->addr, sizeof (lookup->addr), 0);
+}
+
+/**
+ * Gives the address found by the given \a lookup to the socket, unless the
+ * address (or the port) of the socket changed in the meantime.
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ * \param lookup a lookup done with \c DS_SocketLookupRun()
+ *
+ * \returns 1 if the socket knows its remote address, 0 otherwise
+ */
+int DS_SocketLookupApply (DS_Socket* ptr, const DS_SocketLookup* lookup)
+{
+    assert (ptr);
+    assert (lookup);
+
+    if (!lookup_pending (ptr))
+        return 1;
+
+    if (lookup->length <= 0 || !ptr->info.client_init)
+        return 0;
+
+    if (strcmp (lookup->address, ptr->address) != 0
+            || strcmp (lookup->service, ptr->info.out_service) != 0)
+        return 0;
+
+    memcpy (ptr->info.out_addr, lookup->addr, (size_t) lookup->length);
+    ptr->info.out_addr_len = lookup->length;
+    return 1;
 }
 
 /**
@@ -372,3 +1388,29 @@ void DS_SocketChangeAddress (DS_Socket* ptr, const char* address)
     DS_SocketClose (ptr);
     DS_SocketOpen (ptr);
 }
+
+/**
+ * Changes the network interface (or local address) used by the given
+ * socket structure, an empty \a name allows the socket to use every
+ * interface
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ * \param name the interface name or local address to bind to
+ */
+void DS_SocketChangeInterface (DS_Socket* ptr, const char* name)
+{
+    /* Check arguments */
+    assert (ptr);
+
+    /* Abort if name is NULL */
+    if (!name)
+        return;
+
+    /* Re-assign the interface */
+    memset (ptr->network_interface, 0, sizeof (ptr->network_interface));
+    strncpy (ptr->network_interface, name, sizeof (ptr->network_interface) - 1);
+
+    /* Re-open the socket */
+    DS_SocketClose (ptr);
+    DS_SocketOpen (ptr);
+}
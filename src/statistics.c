@@ -0,0 +1,264 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "DS_Timer.h"
+#include "DS_Atomic.h"
+#include "DS_Context.h"
+#include "DS_Statistics.h"
+
+#include <assert.h>
+
+#define CHANNEL_COUNT 4
+
+/**
+ * Holds the counters written by the send path of a channel.
+ * Each direction lives in its own cache line, so that updating the send
+ * counters never invalidates the line that holds the receive counters
+ * (and vice versa) while other threads read them.
+ */
+typedef struct {
+    DS_CACHELINE_ALIGN volatile uint64_t packets;
+    volatile uint64_t bytes;
+    volatile uint64_t errors;
+    volatile uint64_t packets_base;
+} TxCounters;
+
+/**
+ * Holds the counters written by the receive path of a channel
+ */
+typedef struct {
+    DS_CACHELINE_ALIGN volatile uint64_t packets;
+    volatile uint64_t bytes;
+    volatile uint64_t decode_failures;
+    volatile uint64_t watchdog_expirations;
+    volatile uint64_t packets_base;
+    volatile uint64_t first_packet_time;
+} RxCounters;
+
+/**
+ * Holds the send and receive counters of a channel
+ */
+typedef struct {
+    TxCounters tx;
+    RxCounters rx;
+} Counters;
+
+/**
+ * Holds the counters of every channel of a context
+ */
+typedef struct {
+    Counters counters [CHANNEL_COUNT];
+
+    /* Time (from DS_GetTimeNs) when the current protocol started to
+     * communicate */
+    volatile uint64_t start_time;
+} State;
+
+/**
+ * Returns the counters of the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), NULL, NULL);
+}
+
+/**
+ * Returns the counters of the given \a channel
+ */
+static Counters* get_counters (const DS_Channel channel)
+{
+    State* s = state();
+
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+    return &s->counters [channel];
+}
+
+/**
+ * Writes a snapshot of the counters of the given \a channel in \a stats
+ */
+static void read_counters (const DS_Channel channel, DS_ChannelStats* stats)
+{
+    Counters* c = get_counters (channel);
+
+    stats->sent_packets = DS_AtomicLoad64 (&c->tx.packets);
+    stats->sent_bytes = DS_AtomicLoad64 (&c->tx.bytes);
+    stats->socket_errors = DS_AtomicLoad64 (&c->tx.errors);
+    stats->received_packets = DS_AtomicLoad64 (&c->rx.packets);
+    stats->received_bytes = DS_AtomicLoad64 (&c->rx.bytes);
+    stats->decode_failures = DS_AtomicLoad64 (&c->rx.decode_failures);
+    stats->watchdog_expirations = DS_AtomicLoad64 (&c->rx.watchdog_expirations);
+    stats->first_packet_time = DS_AtomicLoad64 (&c->rx.first_packet_time);
+}
+
+/**
+ * Resets all the counters of every channel to 0, this function is called
+ * when the current protocol is closed
+ */
+void Statistics_Reset (void)
+{
+    State* s = state();
+
+    int i;
+    for (i = 0; i < CHANNEL_COUNT; ++i) {
+        Counters* c = &s->counters [i];
+
+        DS_AtomicStore64 (&c->tx.packets, 0);
+        DS_AtomicStore64 (&c->tx.bytes, 0);
+        DS_AtomicStore64 (&c->tx.errors, 0);
+        DS_AtomicStore64 (&c->tx.packets_base, 0);
+        DS_AtomicStore64 (&c->rx.packets, 0);
+        DS_AtomicStore64 (&c->rx.bytes, 0);
+        DS_AtomicStore64 (&c->rx.decode_failures, 0);
+        DS_AtomicStore64 (&c->rx.watchdog_expirations, 0);
+        DS_AtomicStore64 (&c->rx.packets_base, 0);
+        DS_AtomicStore64 (&c->rx.first_packet_time, 0);
+    }
+}
+
+/**
+ * Restarts the sent/received packet counts used to calculate the packet loss
+ * of the given \a channel. The totals reported by \c DS_GetStatistics() are
+ * not affected by this function.
+ */
+void Statistics_ResetPackets (const DS_Channel channel)
+{
+    Counters* c = get_counters (channel);
+    DS_AtomicStore64 (&c->tx.packets_base, DS_AtomicLoad64 (&c->tx.packets));
+    DS_AtomicStore64 (&c->rx.packets_base, DS_AtomicLoad64 (&c->rx.packets));
+}
+
+/**
+ * Sets the \a time (obtained with \c DS_GetTimeNs()) when the current
+ * protocol started to communicate. The time-to-first-packet of each channel
+ * is measured from this moment.
+ */
+void Statistics_Start (const uint64_t time)
+{
+    State* s = state();
+
+    DS_AtomicStore64 (&s->start_time, time);
+}
+
+/**
+ * Registers a packet sent through the given \a channel.
+ * If \a bytes is negative, the send operation is counted as a socket error.
+ */
+void Statistics_PacketSent (const DS_Channel channel, const int bytes)
+{
+    Counters* c = get_counters (channel);
+    DS_AtomicAdd64 (&c->tx.packets, 1);
+
+    if (bytes >= 0)
+        DS_AtomicAdd64 (&c->tx.bytes, (uint64_t) bytes);
+    else
+        DS_AtomicAdd64 (&c->tx.errors, 1);
+}
+
+/**
+ * Registers a packet with the given number of \a bytes received through
+ * the given \a channel
+ */
+void Statistics_PacketReceived (const DS_Channel channel, const int bytes)
+{
+    Counters* c = get_counters (channel);
+    DS_AtomicAdd64 (&c->rx.packets, 1);
+    DS_AtomicAdd64 (&c->rx.bytes, (uint64_t) (bytes > 0 ? bytes : 0));
+}
+
+/**
+ * Registers a received packet that the protocol could not interpret
+ */
+void Statistics_DecodeFailure (const DS_Channel channel)
+{
+    DS_AtomicAdd64 (&get_counters (channel)->rx.decode_failures, 1);
+}
+
+/**
+ * Registers a received packet that the protocol interpreted successfully,
+ * the first one of each channel sets its time-to-first-packet
+ */
+void Statistics_PacketDecoded (const DS_Channel channel)
+{
+    State* s = state();
+
+    Counters* c = get_counters (channel);
+    if (DS_AtomicLoad64 (&c->rx.first_packet_time) != 0)
+        return;
+
+    uint64_t start = DS_AtomicLoad64 (&s->start_time);
+    uint64_t now = DS_GetTimeNs();
+    uint64_t elapsed = (start > 0 && now > start) ? now - start : 1;
+    DS_AtomicCompareExchange64 (&c->rx.first_packet_time, 0, elapsed);
+}
+
+/**
+ * Registers the expiration of the watchdog of the given \a channel
+ */
+void Statistics_WatchdogExpired (const DS_Channel channel)
+{
+    DS_AtomicAdd64 (&get_counters (channel)->rx.watchdog_expirations, 1);
+}
+
+/**
+ * Returns the number of packets sent through the given \a channel since
+ * the last call to \c Statistics_ResetPackets()
+ */
+uint64_t Statistics_SentPackets (const DS_Channel channel)
+{
+    Counters* c = get_counters (channel);
+    uint64_t base = DS_AtomicLoad64 (&c->tx.packets_base);
+    uint64_t total = DS_AtomicLoad64 (&c->tx.packets);
+    return total >= base ? total - base : 0;
+}
+
+/**
+ * Returns the number of packets received through the given \a channel since
+ * the last call to \c Statistics_ResetPackets()
+ */
+uint64_t Statistics_ReceivedPackets (const DS_Channel channel)
+{
+    Counters* c = get_counters (channel);
+    uint64_t base = DS_AtomicLoad64 (&c->rx.packets_base);
+    uint64_t total = DS_AtomicLoad64 (&c->rx.packets);
+    return total >= base ? total - base : 0;
+}
+
+/**
+ * Writes a snapshot of the traffic counters of every channel into the
+ * given \a stats structure.
+ *
+ * The counters are updated with relaxed atomic operations, so each value is
+ * always consistent by itself, even if the protocol thread is sending or
+ * receiving data while this function runs.
+ */
+void DS_GetStatistics (DS_Stats* stats)
+{
+    assert (stats);
+
+    read_counters (DS_CHANNEL_FMS, &stats->fms);
+    read_counters (DS_CHANNEL_RADIO, &stats->radio);
+    read_counters (DS_CHANNEL_ROBOT, &stats->robot);
+    read_counters (DS_CHANNEL_NETCONSOLE, &stats->netconsole);
+}
@@ -24,18 +24,42 @@
 #include "DS_Utils.h"
 #include "DS_Array.h"
 #include "DS_Timer.h"
+#include "DS_Context.h"
+#include "DS_Realtime.h"
 
 #include <stdio.h>
+#include <errno.h>
 #include <assert.h>
 
 #if defined _WIN32
     #include <windows.h>
 #else
+    #include <time.h>
     #include <unistd.h>
 #endif
 
-static DS_Array timers;
-static int running = 0;
+/*
+ * Clock used by the library, NULL for the monotonic clock of the system
+ */
+static DS_ClockFunc clock_now = NULL;
+static DS_SleepFunc clock_sleep_until = NULL;
+
+/**
+ * Holds the timers of a context
+ */
+typedef struct {
+    DS_Array timers;
+    int running;
+} State;
+
+/**
+ * Returns the timers of the current context
+ */
+static State* state (void)
+{
+    static DS_ContextKey key = 0;
+    return (State*) DS_ContextState (&key, sizeof (State), NULL, NULL);
+}
 
 /**
  * Updates the properties of the given \a timer
@@ -46,10 +70,13 @@ static int running = 0;
  */
 static void* update_timer (void* ptr)
 {
+    State* s = state();
+
     assert (ptr);
     DS_Timer* timer = (DS_Timer*) ptr;
+    Realtime_ConfigureThread (DS_THREAD_IO, "ds-timer");
 
-    while (running == 1) {
+    while (s->running == 1) {
         if (timer->enabled && timer->time > 0 && !timer->expired) {
             timer->elapsed += timer->precision;
 
@@ -70,8 +97,10 @@ static void* update_timer (void* ptr)
  */
 void Timers_Init (void)
 {
-    running = 1;
-    DS_ArrayInit (&timers, 10);
+    State* s = state();
+
+    s->running = 1;
+    DS_ArrayInit (&s->timers, 10);
 }
 
 /**
@@ -79,17 +108,63 @@ void Timers_Init (void)
  */
 void Timers_Close (void)
 {
-    running = 0;
-    DS_ArrayFree (&timers);
+    State* s = state();
+
+    s->running = 0;
+    DS_ArrayFree (&s->timers);
 }
 
 /**
- * Pauses the execution state of the program/thread for the given
- * number of \a millisecs.
- *
- * We use this function to update each timer based on its precision
+ * Returns the value of the monotonic clock of the system in nanoseconds
  */
-void DS_Sleep (const int millisecs)
+static uint64_t system_time (void)
+{
+#if defined _WIN32
+    LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    QueryPerformanceFrequency (&freq);
+    QueryPerformanceCounter (&count);
+    return (uint64_t) (count.QuadPart / freq.QuadPart) * 1000000000ULL
+           + (uint64_t) (count.QuadPart % freq.QuadPart) * 1000000000ULL
+           / (uint64_t) freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+/**
+ * Sleeps until the monotonic clock of the system reaches the given \a time
+ */
+static void system_sleep_until (const uint64_t time)
+{
+    uint64_t now = system_time();
+    if (time <= now)
+        return;
+
+#if defined _WIN32
+    Sleep ((DWORD) ((time - now + 999999ULL) / 1000000ULL));
+#elif defined __linux__
+    struct timespec ts;
+    ts.tv_sec = (time_t) (time / 1000000000ULL);
+    ts.tv_nsec = (long) (time % 1000000000ULL);
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t) ((time - now) / 1000000000ULL);
+    ts.tv_nsec = (long) ((time - now) % 1000000000ULL);
+    nanosleep (&ts, NULL);
+#endif
+}
+
+/**
+ * Pauses the calling thread for the given number of \a millisecs of the
+ * system clock, even if the library uses another clock. This function is
+ * used to wait for other threads (which do not run faster when the clock
+ * of the library does).
+ */
+void Timers_SystemSleep (const int millisecs)
 {
 #if defined _WIN32
     Sleep (millisecs);
@@ -98,6 +173,92 @@ void DS_Sleep (const int millisecs)
 #endif
 }
 
+/**
+ * Pauses the execution state of the program/thread for the given
+ * number of \a millisecs.
+ *
+ * We use this function to update each timer based on its precision
+ */
+void DS_Sleep (const int millisecs)
+{
+    if (clock_sleep_until)
+        clock_sleep_until (DS_GetTimeNs() + (uint64_t) millisecs * 1000000ULL);
+    else
+        Timers_SystemSleep (millisecs);
+}
+
+/**
+ * Pauses the execution state of the program/thread until the monotonic clock
+ * (see \c DS_GetTimeNs) reaches the given \a time.
+ *
+ * Sleeping until an absolute time (instead of sleeping for an interval) keeps
+ * periodic loops from drifting when each iteration takes a different time.
+ */
+void DS_SleepUntil (const uint64_t time)
+{
+    if (clock_sleep_until)
+        clock_sleep_until (time);
+    else
+        system_sleep_until (time);
+}
+
+/**
+ * Returns the value of a monotonic clock in nanoseconds. The value has no
+ * meaning by itself, it should only be used to measure time intervals.
+ *
+ * The clock is the monotonic clock of the system, unless the application
+ * installed its own clock with \c DS_SetClock().
+ */
+uint64_t DS_GetTimeNs (void)
+{
+    if (clock_now)
+        return clock_now();
+
+    return system_time();
+}
+
+/**
+ * Returns \c 1 if the library uses the monotonic clock of the system, or
+ * \c 0 if the application installed its own clock with \c DS_SetClock()
+ */
+int DS_SystemClock (void)
+{
+    return clock_now == NULL;
+}
+
+/**
+ * Replaces the clock used by the library: the send deadlines of the
+ * protocols, the watchdogs, the timers, the trip time statistics and every
+ * sleep of the library follow the given clock.
+ *
+ * The \a now function returns the current time in nanoseconds, and the
+ * \a sleep_until function returns when the clock reaches the given time. A
+ * simulated clock can advance its time in \a sleep_until (or wait until the
+ * simulation advances it), so that a whole match (with its watchdog
+ * timeouts and reconnections) runs in a few milliseconds. The clock must
+ * never go backwards.
+ *
+ * Use \c NULL for both functions to restore the system clock. The clock
+ * should be changed before \c DS_Init(), since the deadlines that are
+ * pending are not converted to the new clock.
+ *
+ * \note Kernel timestamps are given by the system clock, so they are not
+ *       used while another clock is installed.
+ *
+ * \returns 1 on success, 0 if only one of the functions is \c NULL
+ */
+int DS_SetClock (DS_ClockFunc now, DS_SleepFunc sleep_until)
+{
+    if ((now == NULL) != (sleep_until == NULL)) {
+        fprintf (stderr, "DS_SetClock: both functions must be set\n");
+        return 0;
+    }
+
+    clock_now = now;
+    clock_sleep_until = sleep_until;
+    return 1;
+}
+
 /**
  * Resets and disables the given \a timer
  */
@@ -161,10 +322,9 @@ void DS_TimerInit (DS_Timer* timer, const int time, const int precision)
     timer->initialized = 1;
     timer->precision = precision;
 
-    /* Configure the thread */
+    /* Configure the thread (it stops with the timers of the context) */
     pthread_t thread;
-    int error = pthread_create (&thread, NULL,
-                                &update_timer, (void*) timer);
+    int error = Context_CreateThread (&thread, &update_timer, (void*) timer);
 
     /* Check if thread was started */
     assert (!error);
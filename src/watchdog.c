@@ -0,0 +1,259 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (c) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "DS_Utils.h"
+#include "DS_Timer.h"
+#include "DS_Context.h"
+#include "DS_Watchdog.h"
+
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define CHANNEL_COUNT 4
+#define MIN_SAMPLES   16       /* Intervals measured before adapting */
+#define ALPHA         (1 / 16.0) /* Weight of each new interval */
+
+/**
+ * Holds the configuration and the packet arrival statistics of the
+ * watchdog of a channel
+ */
+typedef struct {
+    DS_WatchdogConfig config;
+    int fixed_timeout;
+    int samples;
+    int expired;
+    double mean;
+    double variance;
+    uint64_t last_feed;
+} Watchdog;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Assigns the default configuration to the watchdog of each channel of a
+ * new context, which keeps the fixed timeouts of the protocol
+ */
+static void init_watchdogs (void* ptr)
+{
+    int i;
+    Watchdog* watchdogs = (Watchdog*) ptr;
+    const DS_WatchdogConfig config = { 0, 6, 100, 0 };
+
+    for (i = 0; i < CHANNEL_COUNT; ++i)
+        watchdogs [i].config = config;
+}
+
+/**
+ * Returns the watchdog of the given \a channel in the current context
+ */
+static Watchdog* get_watchdog (const DS_Channel channel)
+{
+    static DS_ContextKey key = 0;
+    assert ((int) channel >= 0 && (int) channel < CHANNEL_COUNT);
+
+    size_t size = sizeof (Watchdog) * CHANNEL_COUNT;
+    Watchdog* w = (Watchdog*) DS_ContextState (&key, size,
+                                               &init_watchdogs, NULL);
+    return &w [channel];
+}
+
+/**
+ * Returns the timeout (in milliseconds) that the given watchdog shall use.
+ * Adaptive watchdogs expire after \c mean+k*stddev milliseconds without
+ * packets (within the configured bounds) once enough intervals have been
+ * measured, otherwise the fixed timeout of the protocol is used.
+ */
+static int current_timeout (const Watchdog* w)
+{
+    if (w->fixed_timeout <= 0)
+        return 0;
+
+    if (!w->config.adaptive || w->samples < MIN_SAMPLES)
+        return w->fixed_timeout;
+
+    int max = w->fixed_timeout;
+    if (w->config.max_timeout > 0)
+        max = w->config.max_timeout;
+
+    double value = w->mean + w->config.k * sqrt (w->variance);
+    value = DS_Max (value, (double) w->config.min_timeout);
+    value = DS_Min (value, (double) max);
+
+    return (int) ceil (value);
+}
+
+/**
+ * Returns the milliseconds elapsed between \a then and \a now
+ */
+static double elapsed_ms (const uint64_t then, const uint64_t now)
+{
+    if (now <= then)
+        return 0;
+
+    return (double) (now - then) / 1000000.0;
+}
+
+/**
+ * Registers a packet received through the given \a channel at the time
+ * \a now (obtained with \c DS_GetTimeNs()). The interval since the previous
+ * packet is added to the arrival statistics of the channel, unless the
+ * watchdog had expired (the gap would not be a normal interval).
+ */
+void Watchdog_Feed (const DS_Channel channel, const uint64_t now)
+{
+    pthread_mutex_lock (&mutex);
+
+    Watchdog* w = get_watchdog (channel);
+    double interval = elapsed_ms (w->last_feed, now);
+
+    /* Update the exponentially weighted mean and variance */
+    if (!w->expired && w->last_feed > 0) {
+        if (w->samples == 0) {
+            w->mean = interval;
+            w->variance = 0;
+        }
+
+        else {
+            double diff = interval - w->mean;
+            double incr = ALPHA * diff;
+            w->mean += incr;
+            w->variance = (1 - ALPHA) * (w->variance + diff * incr);
+        }
+
+        w->samples = DS_Min (w->samples + 1, MIN_SAMPLES * 1000);
+    }
+
+    w->expired = 0;
+    w->last_feed = now;
+
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Checks if the watchdog of the given \a channel expired at the time \a now.
+ * When this happens, the watchdog starts counting again, so that it expires
+ * periodically while no packets are received.
+ *
+ * \returns 1 if the watchdog expired, 0 otherwise
+ */
+int Watchdog_Check (const DS_Channel channel, const uint64_t now)
+{
+    pthread_mutex_lock (&mutex);
+
+    int expired = 0;
+    Watchdog* w = get_watchdog (channel);
+    int timeout = current_timeout (w);
+
+    if (timeout > 0 && elapsed_ms (w->last_feed, now) >= timeout) {
+        expired = 1;
+        w->expired = 1;
+        w->last_feed = now;
+    }
+
+    pthread_mutex_unlock (&mutex);
+    return expired;
+}
+
+/**
+ * Clears the arrival statistics of the given \a channel and changes the
+ * fixed \a timeout (in milliseconds) defined by the protocol. A timeout of
+ * 0 disables the watchdog. The watchdog starts counting at \a now.
+ */
+void Watchdog_Reset (const DS_Channel channel, const int timeout,
+                     const uint64_t now)
+{
+    pthread_mutex_lock (&mutex);
+
+    Watchdog* w = get_watchdog (channel);
+    w->fixed_timeout = DS_Max (timeout, 0);
+    w->samples = 0;
+    w->expired = 0;
+    w->mean = 0;
+    w->variance = 0;
+    w->last_feed = now;
+
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Writes the current state of the watchdog of the given \a channel
+ * in \a state
+ */
+void DS_GetWatchdogState (const DS_Channel channel, DS_WatchdogState* state)
+{
+    assert (state);
+
+    pthread_mutex_lock (&mutex);
+
+    const Watchdog* w = get_watchdog (channel);
+    state->timeout = current_timeout (w);
+    state->fixed_timeout = w->fixed_timeout;
+    state->samples = w->samples;
+    state->mean_interval = (float) w->mean;
+    state->stddev = (float) sqrt (w->variance);
+    state->elapsed = (float) elapsed_ms (w->last_feed, DS_GetTimeNs());
+    state->expired = w->expired;
+
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Writes the watchdog settings of the given \a channel in \a config
+ */
+void DS_GetWatchdogConfig (const DS_Channel channel, DS_WatchdogConfig* config)
+{
+    assert (config);
+
+    pthread_mutex_lock (&mutex);
+    *config = get_watchdog (channel)->config;
+    pthread_mutex_unlock (&mutex);
+}
+
+/**
+ * Changes the watchdog settings of the given \a channel.
+ *
+ * By default, the watchdogs use the fixed timeouts of the protocol (50
+ * packet intervals, up to one second). An adaptive watchdog measures the
+ * time between received packets and declares the communications lost after
+ * \c mean+k*stddev milliseconds without packets, limited to the range
+ * given by \c min_timeout and \c max_timeout. This detects a lost link
+ * faster on a steady link, while a jittery link gets a longer timeout.
+ */
+void DS_SetWatchdogConfig (const DS_Channel channel,
+                           const DS_WatchdogConfig* config)
+{
+    assert (config);
+
+    /* Check the settings */
+    if (config->k < 0 || config->min_timeout < 0 || config->max_timeout < 0) {
+        fprintf (stderr, "DS_SetWatchdogConfig: invalid settings\n");
+        return;
+    }
+
+    pthread_mutex_lock (&mutex);
+    get_watchdog (channel)->config = *config;
+    pthread_mutex_unlock (&mutex);
+}
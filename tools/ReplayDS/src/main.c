@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2015-2017 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <LibDS.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * Prints the command line options of the application
+ */
+static void usage (const char* name)
+{
+    printf ("Usage: %s [options] <capture> [<capture> ...]\n\n", name);
+    printf ("Replays the robot/FMS traffic recorded in pcap or pcapng files\n");
+    printf ("through the LibDS protocol and event layers.\n\n");
+    printf ("Options:\n");
+    printf ("  -p <year>  Protocol to use (2014, 2015 or 2016, default 2016)\n");
+    printf ("  -r         Keep the recorded timing (default: as fast as possible)\n");
+    printf ("  -o <file>  Write the generated events to the given file\n");
+    printf ("  -h         Show this message\n");
+}
+
+/**
+ * Returns the protocol for the given \a year, with all its sockets disabled
+ * so that the replay is not mixed with live traffic
+ */
+static int get_protocol (const int year, DS_Protocol* protocol)
+{
+    switch (year) {
+    case 2014:
+        *protocol = DS_GetProtocolFRC_2014();
+        break;
+    case 2015:
+        *protocol = DS_GetProtocolFRC_2015();
+        break;
+    case 2016:
+        *protocol = DS_GetProtocolFRC_2016();
+        break;
+    default:
+        return 0;
+    }
+
+    protocol->fms_socket.disabled = 1;
+    protocol->radio_socket.disabled = 1;
+    protocol->robot_socket.disabled = 1;
+    protocol->netconsole_socket.disabled = 1;
+    return 1;
+}
+
+/**
+ * Main entry point of the application
+ */
+int main (int argc, char** argv)
+{
+    int i;
+    int year = 2016;
+    int failures = 0;
+    FILE* events = NULL;
+    DS_ReplayOptions options;
+
+    /* Parse options */
+    memset (&options, 0, sizeof (options));
+    for (i = 1; i < argc && argv [i][0] == '-'; ++i) {
+        if (strcmp (argv [i], "-r") == 0)
+            options.realtime = 1;
+
+        else if (strcmp (argv [i], "-p") == 0 && i + 1 < argc)
+            year = atoi (argv [++i]);
+
+        else if (strcmp (argv [i], "-o") == 0 && i + 1 < argc) {
+            events = fopen (argv [++i], "w");
+            if (!events) {
+                fprintf (stderr, "Cannot open %s\n", argv [i]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        else {
+            usage (argv [0]);
+            return strcmp (argv [i], "-h") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    /* No capture files */
+    if (i >= argc) {
+        usage (argv [0]);
+        return EXIT_FAILURE;
+    }
+
+    /* Load the protocol */
+    DS_Protocol protocol;
+    if (!get_protocol (year, &protocol)) {
+        fprintf (stderr, "Unsupported protocol: %d\n", year);
+        return EXIT_FAILURE;
+    }
+
+    DS_Init();
+    DS_ConfigureProtocol (&protocol);
+    options.events = events;
+
+    /* Replay each capture file */
+    for (; i < argc; ++i) {
+        DS_ReplayResult result;
+
+        if (events)
+            fprintf (events, "# %s\n", argv [i]);
+
+        if (!DS_Replay (argv [i], &options, &result)) {
+            fprintf (stderr, "%s: cannot read capture\n", argv [i]);
+            ++failures;
+            continue;
+        }
+
+        double duration = result.duration / 1e9;
+        double elapsed = result.elapsed / 1e9;
+        printf ("%s: %d frames, %d robot, %d fms, %d radio, %d netconsole, "
+                "%d decode failures, %d events, %.3f s replayed in %.3f s "
+                "(%.1fx)\n", argv [i], result.frames, result.robot_packets,
+                result.fms_packets, result.radio_packets,
+                result.netconsole_messages, result.decode_failures,
+                result.events, duration, elapsed,
+                elapsed > 0 ? duration / elapsed : 0);
+    }
+
+    /* Clean up */
+    DS_Close();
+    if (events)
+        fclose (events);
+
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}